@@ -3,7 +3,17 @@ function request_handler(request)
     response_text = "これはLuaのスクリプトです。\r\n"
 
     for key, val in pairs(request) do
-        response_text = response_text .. "key=" .. key .. ", value=" .. val .. "\r\n"
+        if key == "parts" then
+            -- multipart/form-data のパート
+            for index, part in ipairs(val) do
+                response_text = response_text .. "part[" .. index .. "] name=" .. part.name
+                    .. ", filename=" .. part.filename
+                    .. ", contentType=" .. part.contentType
+                    .. ", size=" .. part.size .. "\r\n"
+            end
+        else
+            response_text = response_text .. "key=" .. key .. ", value=" .. val .. "\r\n"
+        end
     end
     return response_text
 end
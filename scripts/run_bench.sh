@@ -0,0 +1,237 @@
+#!/usr/bin/env bash
+#
+# 4つのサーバを1つずつ起動して load-generator で負荷を掛け、結果を比べる
+#
+# $ scripts/run_bench.sh <ビルドディレクトリ> [結果の JSON ファイル]
+#
+# 環境変数
+#
+# * BENCH_ARGS      load-generator に渡す引数 (既定 "--connections 32 --duration 10 --warmup 1")
+# * BENCH_SERVERS   測るサーバ (既定 "01 02 03 04")
+# * BENCH_BASELINE  前回の結果の JSON ファイル. 指定した場合は比べて、悪くなっていたら失敗する
+# * BENCH_TOLERANCE 許容する悪化の割合 (既定 0.1 = 10%)
+# * BENCH_UNIX      1 の場合は、Unix ドメインソケット (抽象名前空間) でも待ち受けさせて、
+#                   127.0.0.1 の TCP と同じ負荷を掛けて比べる (結果の名前は "<サーバ>-unix")
+# * BENCH_TCP_PROFILES ソケットのオプションの組み合わせ (空白区切り. 例 "baseline nodelay cork all")。
+#                   組み合わせ毎にサーバを起動し直して測り、baseline と比べる (結果の名前は "<サーバ>-tcp-<組み合わせ>")
+#                   baseline は accept4 を使わず (accept + fcntl)、他も何も付けない。それ以外は baseline に1つだけ付ける (all は全部)
+#                   fastopen はサーバ側の sysctl net.ipv4.tcp_fastopen が 3 でないと効かない
+# * BENCH_OVERLOAD_PROTECTION 1 の場合は、サーバのレート制限とアドミッション制御を有効にしたまま測る
+#                   (既定 0. 有効だと 1 つのクライアントからの負荷はほとんど 429 / 503 で断られてしまう)
+#
+# req/s は 2xx のレスポンスだけを数える。ステータス毎の件数も表示する。
+#
+# ビルドされていないサーバ (Lua がない環境の 04 など) は飛ばす。
+#
+
+set -u
+
+BUILD_DIR=${1:?usage: $0 <build-dir> [output.json]}
+OUTPUT=${2:-bench-results.json}
+BENCH_ARGS=${BENCH_ARGS:-"--connections 32 --duration 10 --warmup 1"}
+BENCH_SERVERS=${BENCH_SERVERS:-"01 02 03 04"}
+BENCH_TOLERANCE=${BENCH_TOLERANCE:-0.1}
+BENCH_UNIX=${BENCH_UNIX:-0}
+BENCH_TCP_PROFILES=${BENCH_TCP_PROFILES:-}
+BENCH_OVERLOAD_PROTECTION=${BENCH_OVERLOAD_PROTECTION:-0}
+
+LOAD_GENERATOR="$BUILD_DIR/simple-server-bench/load-generator"
+if [ ! -x "$LOAD_GENERATOR" ]; then
+    echo "load-generator がありません: $LOAD_GENERATOR" >&2
+    exit 1
+fi
+
+# サーバの番号から、名前・実行ファイル・ポートを決める
+server_info() {
+    case "$1" in
+        01) echo "blocking simple-server-01/simple-server-01 12345" ;;
+        02) echo "fork-cgi simple-server-02-cgi/simple-server-02-cgi 12346" ;;
+        03) echo "asio simple-server-03-event-driven/simple-server-03-event-driven 12347" ;;
+        04) echo "thread-lua simple-server-04-mod_lua/simple-server-04-mod_lua 12348" ;;
+        *) return 1 ;;
+    esac
+}
+
+# ソケットのオプションの組み合わせから、サーバに設定する環境変数を決める (socket_options_t)
+tcp_profile_env() {
+    case "$1" in
+        baseline) echo "SIMPLE_SERVER_ACCEPT4=0" ;;
+        defer-accept) echo "SIMPLE_SERVER_ACCEPT4=0 SIMPLE_SERVER_TCP_DEFER_ACCEPT=1" ;;
+        fastopen) echo "SIMPLE_SERVER_ACCEPT4=0 SIMPLE_SERVER_TCP_FASTOPEN=256" ;;
+        nodelay) echo "SIMPLE_SERVER_ACCEPT4=0 SIMPLE_SERVER_TCP_SEGMENTS=nodelay" ;;
+        cork) echo "SIMPLE_SERVER_ACCEPT4=0 SIMPLE_SERVER_TCP_SEGMENTS=cork" ;;
+        busy-poll) echo "SIMPLE_SERVER_ACCEPT4=0 SIMPLE_SERVER_SO_BUSY_POLL=50" ;;
+        accept4) echo "SIMPLE_SERVER_ACCEPT4=1" ;;
+        all) echo "SIMPLE_SERVER_ACCEPT4=1 SIMPLE_SERVER_TCP_DEFER_ACCEPT=1 SIMPLE_SERVER_TCP_FASTOPEN=256 SIMPLE_SERVER_TCP_SEGMENTS=cork SIMPLE_SERVER_SO_BUSY_POLL=50" ;;
+        *) return 1 ;;
+    esac
+}
+
+# ポートが接続を受け付けるようになるまで待つ (最大 5 秒)
+wait_for_port() {
+    i=0
+    while [ $i -lt 50 ]; do
+        if (exec 3<>"/dev/tcp/127.0.0.1/$1") 2>/dev/null; then
+            return 0
+        fi
+        sleep 0.1
+        i=$((i + 1))
+    done
+    return 1
+}
+
+RESULTS=$(mktemp)
+trap 'rm -f "$RESULTS"' EXIT
+
+# サーバを起動して負荷を掛け、止める
+# $ run_server <結果の名前> <実行ファイル> <ポート> <load-generator への追加の引数> [環境変数=値 ...]
+run_server() {
+    result_name=$1
+    binary=$2
+    port=$3
+    extra_args=$4
+    shift 4
+
+    unix_socket=""
+    if [ "$BENCH_UNIX" = "1" ]; then
+        unix_socket="@simple-server-bench-$port"
+    fi
+
+    echo "$result_name: ポート $port で起動します $*" >&2
+    (cd "$(dirname "$binary")" && exec env SIMPLE_SERVER_UNIX_SOCKET="$unix_socket" \
+        SIMPLE_SERVER_OVERLOAD_PROTECTION="$BENCH_OVERLOAD_PROTECTION" "$@" "$binary" >/dev/null 2>&1) &
+    pid=$!
+
+    if wait_for_port "$port"; then
+        # shellcheck disable=SC2086
+        if ! "$LOAD_GENERATOR" --name "$result_name" --port "$port" $extra_args $BENCH_ARGS >>"$RESULTS"; then
+            echo "$result_name: load-generator が失敗しました" >&2
+        fi
+        # shellcheck disable=SC2086
+        if [ -n "$unix_socket" ] && ! "$LOAD_GENERATOR" --name "$result_name-unix" --unix "$unix_socket" $BENCH_ARGS >>"$RESULTS"; then
+            echo "$result_name: load-generator (unix) が失敗しました" >&2
+        fi
+    else
+        echo "$result_name: ポート $port が開きませんでした" >&2
+    fi
+
+    kill -TERM "$pid" 2>/dev/null
+    wait "$pid" 2>/dev/null
+}
+
+for server in $BENCH_SERVERS; do
+    info=$(server_info "$server") || { echo "不明なサーバ: $server" >&2; continue; }
+    set -- $info
+    name=$1
+    binary="$BUILD_DIR/$2"
+    port=$3
+
+    if [ ! -x "$binary" ]; then
+        echo "$name: $binary がないので飛ばします" >&2
+        continue
+    fi
+
+    if [ -z "$BENCH_TCP_PROFILES" ]; then
+        run_server "$name" "$binary" "$port" ""
+        continue
+    fi
+
+    for profile in $BENCH_TCP_PROFILES; do
+        profile_env=$(tcp_profile_env "$profile") || { echo "不明な組み合わせ: $profile" >&2; continue; }
+        extra_args=""
+        case "$profile" in
+            fastopen|all) extra_args="--fastopen" ;;
+        esac
+        # shellcheck disable=SC2086
+        run_server "$name-tcp-$profile" "$binary" "$port" "$extra_args" $profile_env
+    done
+done
+
+# 1行1つの結果を JSON の配列にまとめる
+{
+    echo "["
+    sed '$!s/$/,/' "$RESULTS"
+    echo "]"
+} >"$OUTPUT"
+echo "結果: $OUTPUT" >&2
+
+if ! command -v python3 >/dev/null 2>&1; then
+    cat "$OUTPUT"
+    exit 0
+fi
+
+python3 - "$OUTPUT" "${BENCH_BASELINE:-}" "$BENCH_TOLERANCE" <<'EOF'
+import json
+import sys
+
+results = json.load(open(sys.argv[1]))
+baseline_path = sys.argv[2]
+tolerance = float(sys.argv[3])
+
+print("%-28s %12s %10s %10s %10s %10s %8s  %s" % (
+    "server", "req/s", "p50 us", "p99 us", "p99.9 us", "max us", "errors", "status"))
+for result in results:
+    latency = result["latency_us"]["corrected"]
+    errors = sum(result["errors"].values())
+    status = " ".join("%s=%d" % (name, count) for name, count in result["status"].items() if count > 0)
+    print("%-28s %12.1f %10.1f %10.1f %10.1f %10.1f %8d  %s" % (
+        result["name"], result["throughput_rps"], latency["p50"], latency["p99"], latency["p99.9"], latency["max"], errors,
+        status))
+
+# 2xx 以外が返ってきた場合は、req/s には数えていないので目立つようにする
+for result in results:
+    rejected = sum(count for name, count in result["status"].items() if name != "2xx")
+    if rejected > 0:
+        print("%-28s WARNING: %d / %d responses were not 2xx (not counted in req/s)" % (
+            result["name"], rejected, result["requests"]))
+
+# Unix ドメインソケットでも測った場合は、TCP と比べる
+by_name = {result["name"]: result for result in results}
+for result in results:
+    unix = by_name.get(result["name"] + "-unix")
+    if unix is None:
+        continue
+    tcp_latency = result["latency_us"]["corrected"]
+    unix_latency = unix["latency_us"]["corrected"]
+    print("%-12s unix/tcp throughput x%.3f  p50 x%.3f  p99 x%.3f" % (
+        result["name"],
+        unix["throughput_rps"] / max(result["throughput_rps"], 1e-9),
+        unix_latency["p50"] / max(tcp_latency["p50"], 1e-9),
+        unix_latency["p99"] / max(tcp_latency["p99"], 1e-9)))
+
+# ソケットのオプションの組み合わせ毎に測った場合は、baseline と比べる
+for result in results:
+    name = result["name"]
+    if "-tcp-" not in name or name.endswith("-tcp-baseline"):
+        continue
+    base = by_name.get(name[:name.index("-tcp-")] + "-tcp-baseline" + ("-unix" if name.endswith("-unix") else ""))
+    if base is None:
+        continue
+    base_latency = base["latency_us"]["corrected"]
+    latency = result["latency_us"]["corrected"]
+    print("%-28s /baseline throughput x%.3f  p50 x%.3f  p99 x%.3f" % (
+        name,
+        result["throughput_rps"] / max(base["throughput_rps"], 1e-9),
+        latency["p50"] / max(base_latency["p50"], 1e-9),
+        latency["p99"] / max(base_latency["p99"], 1e-9)))
+
+if not baseline_path:
+    sys.exit(0)
+
+# 前回より悪くなっていないか (スループットが下がっていないか、p99 が伸びていないか)
+baseline = {result["name"]: result for result in json.load(open(baseline_path))}
+failed = False
+for result in results:
+    previous = baseline.get(result["name"])
+    if previous is None:
+        continue
+    throughput = result["throughput_rps"] / max(previous["throughput_rps"], 1e-9)
+    p99 = result["latency_us"]["corrected"]["p99"] / max(previous["latency_us"]["corrected"]["p99"], 1e-9)
+    status = "ok"
+    if throughput < 1 - tolerance or p99 > 1 + tolerance:
+        status = "REGRESSION"
+        failed = True
+    print("%-12s throughput x%.3f  p99 x%.3f  %s" % (result["name"], throughput, p99, status))
+
+sys.exit(1 if failed else 0)
+EOF
@@ -6,6 +6,13 @@
 #include "http_request_t.h"
 #include "http_response_t.h"
 #include "http_server_t.h"
+#include "connection_arena_t.h"
+#include "server_metrics_t.h"
+#include "allocation_accounting_t.h"
+#include "trace_probes.h"
+#include "compression_stream_t.h"
+#include "http_compressor_t.h"
+#include "http_response_writer_t.h"
 #include <sys/socket.h>
 
 #include <vector>
@@ -25,10 +32,20 @@ void in_process_process_http_socket(int sd, const char* client_addr);
 
 /**
  * レスポンスを書き込む
+ *
+ * `http_response_writer_t` でヘッダとボディを別々に書く
+ * (`SIMPLE_SERVER_TCP_SEGMENTS=cork` の場合は、ヘッダを MSG_MORE で送ってボディと同じセグメントにまとめる)。
+ *
  * @param [in] sd クライアントとの通信用ソケット
  * @param [in] response 書き込むレスポンス
+ * @return 送信したバイト数
  */
-void write_response(int sd, const http_response_t &response);
+size_t write_response(int sd, const http_response_t &response);
+
+/**
+ * レスポンスボディの圧縮
+ */
+static http_compressor_t g_compressor{http_compressor_t::config_t{}};
 
 
 /**
@@ -54,60 +71,65 @@ int main() {
 
 
 void in_process_process_http_socket(int sd, const char* client_addr) {
-    const auto request = http_server_t::read_request(sd);
+    const auto started = std::chrono::steady_clock::now();
+    auto &metrics = server_metrics_t::get_default();
+    const auto connection_scope = metrics.track_connection();
+    allocation_accounting_t::request_scope_t allocation_scope;
+
+    // リクエストとレスポンスはコネクション毎のアリーナから確保する (アリーナはリクエストより先に宣言すること)
+    const auto arena = connection_arena_t::acquire();
+    const auto request = http_server_t::read_request(sd, nullptr, arena->get_resource());
 
     if (request) {
-        // 単純にエコーする
-        http_response_t response;
-        response.set_status(200);
-        response.add_header("Content-Type", "text/plain;charset=UTF-8");
-
-        std::vector<std::string> response_lines;
-        response_lines.push_back(request->get_request_line());
-
-        for (const auto &header : request->get_header()) {
-            response_lines.push_back(
-                header.first
-                + http_constants_t::HEADER_DELIMITER
-                + header.second);
+        allocation_scope.set_route(request->get_method(), request->get_uri());
+        const auto in_flight_scope = metrics.track_in_flight();
+
+        http_response_t response(arena->get_resource());
+        if (metrics.is_metrics_request(*request)) {
+            // メトリクスのパスの場合はエコーせずにメトリクスを返す
+            metrics.write_response(response);
+        } else {
+            // 単純にエコーする
+            HTTP_SERVER_PROBE2(handler__start, sd, "echo");
+            server_metrics_t::stage_timer_t handler_timer(metrics, server_metrics_t::stage_t::handler);
+            response.set_status(200);
+            response.add_header("Content-Type", "text/plain;charset=UTF-8");
+
+            std::vector<std::string> response_lines;
+            response_lines.emplace_back(request->get_request_line());
+
+            for (const auto &header : request->get_header()) {
+                response_lines.push_back(
+                    std::string(header.first)
+                        .append(http_constants_t::HEADER_DELIMITER)
+                        .append(header.second));
+            }
+            response.set_body(
+                boost::join(response_lines, http_constants_t::CRLF)
+                    .append(http_constants_t::CRLF)
+                    .append(request->get_body())
+                    .append(http_constants_t::CRLF)
+            );
+            g_compressor.apply(*request, response);
+            HTTP_SERVER_PROBE2(handler__end, sd, "echo");
         }
-        response.set_body(
-            boost::join(response_lines, http_constants_t::CRLF)
-                .append(http_constants_t::CRLF)
-                .append(request->get_body())
-                .append(http_constants_t::CRLF)
-        );
-
-        write_response(sd, response);
+
+        const auto sent_bytes = write_response(sd, response);
+        http_server_t::log_access(client_addr, *request, response.get_status(), sent_bytes, started);
     }
 
     shutdown(sd, SHUT_RDWR);
+    HTTP_SERVER_PROBE1(connection__close, sd);
     close(sd);
 }
 
-void write_response(int sd, const http_response_t &response) {
-    const std::string response_text = response.to_string();
-    std::vector<char> buffer(response_text.begin(), response_text.end());
-    auto remaining_size = buffer.size();
-
-    while (remaining_size > 0) {
-        auto current_size = ::send(sd, (&*response_text.begin()) + (response_text.size() - remaining_size), remaining_size, MSG_DONTWAIT);
-        if (static_cast<int>(current_size) == -1) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                continue;
-            }
+size_t write_response(int sd, const http_response_t &response) {
+    server_metrics_t::stage_timer_t write_timer(server_metrics_t::get_default(), server_metrics_t::stage_t::write);
 
-            if (errno == EINTR) {
-                if (http_server_t::is_shutdown_required()) {
-                    return;
-                }
-                continue;
-            }
-            http_server_t::print_error(errno);
-            return;
-        }
-        remaining_size -= current_size;
+    http_response_writer_t writer(sd, http_response_writer_t::config_t{});
+    const auto &body = response.get_body();
+    if (writer.start(response, body.size()) && writer.write(body)) {
+        writer.finish();
     }
-
+    return writer.get_sent_bytes();
 }
-
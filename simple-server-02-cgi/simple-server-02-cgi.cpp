@@ -5,12 +5,25 @@
 #include "common.h"
 
 #include <boost/filesystem.hpp>
-#include <boost/format.hpp>
 #include <fcntl.h>
+#include <strings.h>
+#include <fstream>
+#include <sys/wait.h>
 #include <http_response_t.h>
+#include <http_response_cache_t.h>
+#include <compression_stream_t.h>
+#include <http_compressor_t.h>
+#include <rate_limiter_t.h>
+#include <async_logger_t.h>
+#include <server_metrics_t.h>
+#include <allocation_accounting_t.h>
+#include <trace_probes.h>
 
 #include "http_request_t.h"
+#include "request_body_t.h"
 #include "http_server_t.h"
+#include "connection_arena_t.h"
+#include "cgi_environment_t.h"
 
 /**
  * CGIを実行する
@@ -19,8 +32,62 @@
  */
 static void run_cgi(int sd, const char* client_addr);
 
+/**
+ * 子プロセスで CGI スクリプトを実行してレスポンスを作成する
+ * @param [in] request リクエスト
+ * @return レスポンス (CGI が何も出力しなかった場合は `std::nullopt`)
+ */
+static std::optional<http_response_t> execute_cgi(const http_request_t &request);
+
+/**
+ * CGI を実行して、送信する (キャッシュに入れる) 形のレスポンスを作成する
+ *
+ * キャッシュのキーは `Accept-Encoding` で分けるので、キャッシュに入れるレスポンスは全て圧縮を済ませておく
+ * (キャッシュがない場合と stale-while-revalidate の再生成で、同じ形になるようにこの関数を通す)。
+ *
+ * @param [in] request リクエスト
+ * @return レスポンス (CGI が何も出力しなかった場合は `std::nullopt`)
+ */
+static std::optional<http_response_t> generate_cgi_response(const http_request_t &request);
+
+/**
+ * CGI の出力からレスポンスを作成する
+ *
+ * 出力の先頭が `名前: 値` の行と空行で始まる場合は、CGI のヘッダとして扱う (RFC 3875)。
+ * `Status` はステータスコードに、それ以外はレスポンスヘッダにする (`Cache-Control` を返すとキャッシュされる)。
+ * ヘッダがない場合は、出力全体をボディにする。
+ *
+ * @param [in] output CGI の標準出力
+ * @return レスポンス
+ */
+static http_response_t make_cgi_response(std::string &&output);
+
+/**
+ * レスポンスキャッシュ (nullptr の場合はキャッシュしない)
+ */
+static std::unique_ptr<http_response_cache_t> g_response_cache;
+
+/**
+ * レスポンスボディの圧縮 (圧縮結果はレスポンスキャッシュにも入る)
+ */
+static http_compressor_t g_compressor{http_compressor_t::config_t{}};
+
 int main() {
+    // レスポンスキャッシュを有効にする
+    // CGI がヘッダで `Cache-Control: max-age` を返したレスポンスだけがキャッシュされる
+    http_response_cache_t::config_t cache_config;
+    cache_config.vary_headers = {"Accept-Encoding"};
+    g_response_cache = std::make_unique<http_response_cache_t>(cache_config);
+
     http_server_t server;
+    // 1リクエストずつ処理するので、同時に処理するハンドラ数は常に1。
+    // 接続待ちキューを短くしておくと、過負荷のときに溢れた接続はカーネルが断るので、待ち時間が伸び続けない
+    server.set_backlog(16);
+    // CGI は fork するので重い。同じIPアドレスからのリクエストは 10 リクエスト/秒 (瞬間的には 20 リクエスト) まで
+    rate_limiter_t::config_t rate_limiter_config;
+    rate_limiter_config.rate = 10;
+    rate_limiter_config.burst = 20;
+    server.set_rate_limiter(std::make_shared<rate_limiter_t>(rate_limiter_config));
     server.set_client_handler(
         run_cgi
     );
@@ -33,11 +100,103 @@ int main() {
 
 
 void run_cgi(int sd, const char* client_addr) {
+    const auto started = std::chrono::steady_clock::now();
+    auto &metrics = server_metrics_t::get_default();
+    const auto connection_scope = metrics.track_connection();
+    allocation_accounting_t::request_scope_t allocation_scope;
+
+    // リクエストを読み込む
+    // (キャッシュを引くために、fork する前に親プロセスで読み込む)
+    // (リクエストはコネクション毎のアリーナから確保する。アリーナはリクエストより先に宣言すること)
+    const auto arena = connection_arena_t::acquire();
+    const auto request = http_server_t::read_request(sd, nullptr, arena->get_resource());
+    if (!request) {
+        HTTP_SERVER_PROBE1(connection__close, sd);
+        close(sd);
+        return;
+    }
+    allocation_scope.set_route(request->get_method(), request->get_uri());
+    const auto in_flight_scope = metrics.track_in_flight();
+
+    // メトリクスのパスの場合は CGI を実行しない
+    if (auto metrics_response = metrics.handle_request(*request)) {
+        const auto metrics_response_text = metrics_response->to_string();
+        http_server_t::send_all(sd, metrics_response_text);
+        HTTP_SERVER_PROBE1(connection__close, sd);
+        close(sd);
+        http_server_t::log_access(client_addr, *request, metrics_response_text, started);
+        return;
+    }
+
+    // キャッシュが有効な場合はまずキャッシュを探す
+    std::string cache_key;
+    const auto use_cache = g_response_cache && http_response_cache_t::is_cacheable_request(*request);
+    if (use_cache) {
+        cache_key = g_response_cache->make_key(*request);
+        const auto cached = g_response_cache->lookup(cache_key);
+        if (cached.state != http_response_cache_t::lookup_state_t::miss) {
+            http_server_t::send_all(sd, *cached.response_text);
+            HTTP_SERVER_PROBE1(connection__close, sd);
+            close(sd);
+            http_server_t::log_access(client_addr, *request, *cached.response_text, started);
+
+            // stale-while-revalidate の場合は、古いレスポンスを返した後に再生成だけ行う
+            if (cached.state == http_response_cache_t::lookup_state_t::stale_revalidate) {
+                const auto response = generate_cgi_response(*request);
+                if (response) {
+                    g_response_cache->store(cache_key, *response);
+                }
+            }
+            return;
+        }
+    }
+
+    // CGI を実行する
+    // (1接続ずつ処理するので、同じリクエストが同時に処理中になることはない。single-flight でまとめる必要はない)
+    std::optional<http_response_t> response;
+    {
+        HTTP_SERVER_PROBE2(handler__start, sd, "cgi");
+        server_metrics_t::stage_timer_t handler_timer(metrics, server_metrics_t::stage_t::handler);
+        response = generate_cgi_response(*request);
+        HTTP_SERVER_PROBE2(handler__end, sd, "cgi");
+    }
+
+    std::shared_ptr<const std::string> response_text;
+    if (response) {
+        server_metrics_t::stage_timer_t serialize_timer(metrics, server_metrics_t::stage_t::serialize);
+        if (use_cache) {
+            response_text = g_response_cache->store(cache_key, *response);
+        } else {
+            response_text = std::make_shared<const std::string>(response->to_string());
+        }
+    }
+
+    if (response_text) {
+        http_server_t::send_all(sd, *response_text);
+    }
+
+    HTTP_SERVER_PROBE1(connection__close, sd);
+
+    close(sd);
+
+    if (response_text) {
+        http_server_t::log_access(client_addr, *request, *response_text, started);
+    }
+}
+
+std::optional<http_response_t> generate_cgi_response(const http_request_t &request) {
+    auto response = execute_cgi(request);
+    if (response) {
+        g_compressor.apply(request, *response);
+    }
+    return response;
+}
+
+std::optional<http_response_t> execute_cgi(const http_request_t &request) {
     // CGIとのIO用のファイル
     const auto temp_in = boost::filesystem::unique_path();
     const auto temp_out = boost::filesystem::unique_path();
 
-    std::ofstream out_fs;
     auto out_fd = open(temp_out.native().c_str(), O_CLOEXEC | O_RDWR | O_CREAT, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH); // NOLINT(hicpp-signed-bitwise)
 
     // CGIの標準出力 にリクエストボディを渡す
@@ -46,88 +205,56 @@ void run_cgi(int sd, const char* client_addr) {
     auto pid = fork();
 
     if (pid) {
+        HTTP_SERVER_PROBE1(cgi__spawn, pid);
 
         auto status = 0;
         waitpid(pid, &status, 0);
+        HTTP_SERVER_PROBE2(cgi__exit, pid, status);
+        close(out_fd);
         // 親プロセスは処理終了
 
+        std::optional<http_response_t> response;
+
         const auto file_size = boost::filesystem::file_size(temp_out);
-        std::cout << file_size << std::endl;
+        if (async_logger_t::get_default().is_enabled(async_logger_t::level_t::debug)) {
+            async_logger_t::get_default().log(async_logger_t::level_t::debug, "cgi output size=" + std::to_string(file_size));
+        }
         if (file_size > 0) {
-            http_response_t response;
-
             std::ifstream ifs;
             ifs.open(temp_out.native(), std::ios::in | std::ios::binary);
             std::vector<char> buffer(file_size, '\0');
             ifs.read(&*buffer.begin(), file_size);
-            response.set_body(std::string(&*buffer.begin()));
-            const auto response_text = response.to_string();
-            auto remain_size = response_text.size();
-
-            while(remain_size > 0) {
-                auto temp_size = send(sd, (&*response_text.begin()) + (response_text.size() - remain_size), remain_size, MSG_DONTWAIT);
-                if (static_cast<int>(temp_size) == -1) {
-                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                        continue;
-                    }
-
-                    if (errno == EINTR) {
-                        if (http_server_t::is_shutdown_required()) {
-                            break;
-                        }
-                        continue;
-                    }
-                }
-                remain_size -= temp_size;
-            }
-        }
 
-        close(sd);
+            response = make_cgi_response(std::string(buffer.begin(), buffer.end()));
+        }
 
         boost::filesystem::remove(temp_in);
         boost::filesystem::remove(temp_out);
 
-        return;
+        return response;
     }
 
-    auto fd_flags = fcntl(sd, F_GETFD);
-    fd_flags |= FD_CLOEXEC; // NOLINT(hicpp-signed-bitwise)
-    fcntl(sd, F_SETFD, fd_flags);
-
     // シグナル処理用にダミーでサーバーインスタンスを作っておく
     // HTTPの説明には特に関係ない
     http_server_t server;
 
-    // リクエストを読み込む
-    const auto request = http_server_t::read_request(sd);
-    input_fs.open(temp_in.native(), std::ios::out | std::ios::binary);
-    input_fs << request->get_body();
-    input_fs.flush();
-    input_fs.close();
-    auto in_fd = open(temp_in.native().c_str(), O_CLOEXEC | O_RDONLY, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH); // NOLINT(hicpp-signed-bitwise)
-
-    // CGIスクリプトに必要な環境変数を設定する
-    std::vector<std::string> environment_source;
-    environment_source.push_back(
-        (boost::format("CONTENT_LENGTH=%d") % request->get_body().size()).str()
-    );
-    const auto header = request->get_header();
-    auto it = header.find("Content-Type");
-    if (it != header.end()) {
-        environment_source.push_back(
-            (boost::format("CONTENT_TYPE=%s") % it->second).str()
-        );
+    // 大きなボディは既に一時ファイルに書き出されているので、そのファイルをそのまま標準入力にする
+    const auto &body = request.get_body_storage();
+    int in_fd;
+    if (body.is_spilled()) {
+        in_fd = body.get_fd();
+        lseek(in_fd, 0, SEEK_SET);
+    } else {
+        input_fs.open(temp_in.native(), std::ios::out | std::ios::binary);
+        const auto body_view = body.view();
+        input_fs.write(body_view.data(), body_view.size());
+        input_fs.flush();
+        input_fs.close();
+        in_fd = open(temp_in.native().c_str(), O_CLOEXEC | O_RDONLY, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH); // NOLINT(hicpp-signed-bitwise)
     }
 
-    char** env = new char*[environment_source.size() + 1];
-
-    auto i = 0;
-    for (const auto &str : environment_source) {
-        env[i] = new char[str.length() + 1];
-        strcpy(env[i], str.c_str());
-        i++;
-    }
-    env[i] = nullptr;
+    // CGIスクリプトに必要な環境変数を設定する
+    cgi_environment_t environment(request);
 
     char* argv[] = {
         nullptr
@@ -138,21 +265,85 @@ void run_cgi(int sd, const char* client_addr) {
 
     auto ret = execve("/Users/munenaga/projects/mm0205/http-server/cgi/index.cgi",
            argv,
-           env
+           environment.get_envp()
     );
 
     // ※ ここに来るのは execve が失敗したときのみ
     // execve は成功すると制御を返さない
+    // fork した子プロセスでは async_logger_t を使わない
+    // (親の書き出しスレッドが fork したときにロックを持っていたかもしれず、子には書き出すスレッドもない)
     if (ret) {
-        http_server_t::print_error(errno);
-        shutdown(sd, SHUT_RDWR);
-        close(sd);
+        std::array<char, 128> reason{};
+        std::array<char, 256> message{};
+        const auto length = std::snprintf(message.data(), message.size(), "execve failed: %s\n", strerror_r(errno, reason.data(), reason.size()));
+        [[maybe_unused]] const auto written = write(STDERR_FILENO, message.data(), std::min(static_cast<size_t>(std::max(length, 0)), message.size() - 1));
+    }
+    // exit だと、fork する前に動かしていたスレッドを持つ static なオブジェクト (timing_wheel_t など) の
+    // デストラクタが走り、子プロセスにはないスレッドを join しようとする。デストラクタを呼ばずに終了する
+    _exit(127);
+}
+
+http_response_t make_cgi_response(std::string &&output) {
+    http_response_t response;
 
-        for (i = 0; i < environment_source.size(); i++) {
-            delete[] env[i];
+    // ヘッダの終わりの空行 (CGI は LF だけの改行も使う)
+    auto header_end = output.find("\n\n");
+    auto separator_size = 2;
+    const auto crlf_end = output.find("\r\n\r\n");
+    if (crlf_end != std::string::npos && crlf_end < header_end) {
+        header_end = crlf_end;
+        separator_size = 4;
+    }
+
+    std::vector<std::pair<std::string, std::string>> headers;
+    bool has_header = header_end != std::string::npos;
+    for (size_t line_start = 0; has_header && line_start < header_end;) {
+        auto line_end = output.find('\n', line_start);
+        if (line_end == std::string::npos || line_end > header_end) {
+            line_end = header_end;
+        }
+        const auto line = std::string_view(output).substr(line_start, line_end - line_start);
+        line_start = line_end + 1;
+
+        // "名前: 値" でない行があれば、ヘッダのない出力とみなす
+        const auto colon = line.find(':');
+        const auto name = line.substr(0, colon);
+        if (colon == std::string_view::npos || name.empty()
+            || !std::all_of(name.begin(), name.end(), [](char c) { return std::isalnum(static_cast<unsigned char>(c)) || c == '-' || c == '_'; })) {
+            has_header = false;
+            break;
         }
-        delete[] env;
+        auto value = line.substr(colon + 1);
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+            value.remove_prefix(1);
+        }
+        while (!value.empty() && (value.back() == '\r' || value.back() == ' ')) {
+            value.remove_suffix(1);
+        }
+        headers.emplace_back(name, value);
+    }
 
-        exit(0);
+    if (!has_header) {
+        response.add_header("Content-Type", "text/plain;charset=UTF-8");
+        response.set_body(std::move(output));
+        return response;
     }
-}
\ No newline at end of file
+
+    bool has_content_type = false;
+    for (const auto &[name, value] : headers) {
+        if (strcasecmp(name.c_str(), "Status") == 0) {
+            const auto status = std::atoi(value.c_str());
+            if (status >= 100 && status <= 599) {
+                response.set_status(status);
+            }
+            continue;
+        }
+        has_content_type = has_content_type || strcasecmp(name.c_str(), "Content-Type") == 0;
+        response.add_header(name, value);
+    }
+    if (!has_content_type) {
+        response.add_header("Content-Type", "text/plain;charset=UTF-8");
+    }
+    response.set_body(output.substr(header_end + separator_size));
+    return response;
+}
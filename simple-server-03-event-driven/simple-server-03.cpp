@@ -7,42 +7,160 @@
 #include <boost/asio.hpp>
 #include <http_response_t.h>
 #include "http_request_t.h"
+#include "compression_stream_t.h"
+#include "http_compressor_t.h"
+#include "timing_wheel_t.h"
+#include "connection_deadline_t.h"
+#include "admission_controller_t.h"
+#include "rate_limiter_t.h"
+#include "buffer_pool_t.h"
+#include "async_logger_t.h"
+#include "http_server_t.h"
+#include "server_metrics_t.h"
+#include "allocation_accounting_t.h"
+#include "request_capture_t.h"
+#include "unix_listener_t.h"
+#include "socket_options_t.h"
+#include "trace_probes.h"
+
+/**
+ * アドミッション制御 (同時接続数の上限)
+ */
+static admission_controller_t g_admission_controller{admission_controller_t::config_t{}};
+
+/**
+ * クライアントのIPアドレス毎のレート制限
+ */
+static rate_limiter_t g_rate_limiter{rate_limiter_t::config_t{}};
+
+/**
+ * クライアントのソケット
+ * (TCP と Unix ドメインソケットの接続を同じ処理で扱えるように、プロトコルを問わない型にする)
+ */
+using client_socket_t = boost::asio::generic::stream_protocol::socket;
 
 /**
  * boost::ip::tcp::socket が ムーブコンストラクタしか持ってないので、ホルダを用意して管理する
+ *
+ * タイムアウトもソケットと一緒に持つ。期限が切れるとソケットが shutdown され、
+ * 待っている async_read_some / async_write がエラーで終わるので、そこでクローズされる。
  */
 class socket_holder_t {
 public:
-    inline boost::asio::ip::tcp::socket &get_socket() {
+    inline client_socket_t &get_socket() {
         return _socket;
     }
 
-    socket_holder_t(boost::asio::ip::tcp::socket &&socket)
-        : _socket(std::move(socket)) {}
+    inline connection_deadline_t &get_deadline() {
+        return _deadline;
+    }
+
+    /**
+     * 接続を受け付けた時刻 (アクセスログの処理時間用)
+     */
+    inline std::chrono::steady_clock::time_point get_accepted_at() const {
+        return _accepted_at;
+    }
+
+    /**
+     * 最初のバイトを受信した時刻 (ヘッダの解析時間用)
+     */
+    inline std::chrono::steady_clock::time_point get_first_byte_at() const {
+        return _first_byte_at;
+    }
+
+    inline void set_first_byte_at(std::chrono::steady_clock::time_point first_byte_at) {
+        _first_byte_at = first_byte_at;
+    }
+
+    /**
+     * 受信したリクエストの記録 (記録しない場合は空)
+     */
+    inline request_capture_t::recording_t &get_recording() {
+        return _recording;
+    }
+
+    /**
+     * タイマーを取り消してからソケットを閉じる
+     * (閉じた後に shutdown すると、同じ番号で開き直した別のソケットを切断してしまう)
+     */
+    inline void close() {
+        _deadline.cancel();
+        if (_socket.is_open()) {
+            HTTP_SERVER_PROBE1(connection__close, _socket.native_handle());
+        }
+        boost::system::error_code ignored_ec;
+        _socket.close(ignored_ec);
+        if (!_released) {
+            _released = true;
+            g_admission_controller.release_connection();
+        }
+    }
+
+    socket_holder_t(client_socket_t &&socket)
+        : _socket(std::move(socket)),
+          _deadline(_socket.native_handle()),
+          _accepted_at(std::chrono::steady_clock::now()),
+          _first_byte_at(_accepted_at),
+          _connection_scope(server_metrics_t::get_default().track_connection()) {}
 
 private:
-    boost::asio::ip::tcp::socket _socket;
+    client_socket_t _socket;
+
+    connection_deadline_t _deadline;
+
+    std::chrono::steady_clock::time_point _accepted_at;
+
+    std::chrono::steady_clock::time_point _first_byte_at;
+
+    request_capture_t::recording_t _recording;
+
+    /**
+     * 生きている間、接続数のメトリクスを増やしておく
+     */
+    server_metrics_t::gauge_scope_t _connection_scope;
+
+    /**
+     * 接続数を減らしたか
+     */
+    bool _released = false;
 };
 
 void do_signal_handler_async(
     boost::asio::signal_set &signals,
     boost::asio::ip::tcp::acceptor &acceptor,
+    boost::asio::local::stream_protocol::acceptor &unix_acceptor,
     std::vector<std::shared_ptr<socket_holder_t>> &sockets
 );
 
-void process_request(std::vector<std::shared_ptr<socket_holder_t>> &sockets, boost::asio::ip::tcp::socket &socket);
+void process_request(std::shared_ptr<socket_holder_t> holder);
 
-void process_request_with_buffer(
-    std::vector<std::shared_ptr<socket_holder_t>> &sockets, boost::asio::ip::tcp::socket &socket,
-    std::shared_ptr<std::array<char, 1024>> buffer,
-    std::shared_ptr<http_request_t> request
+void wait_for_request(
+    std::shared_ptr<socket_holder_t> holder,
+    std::shared_ptr<http_request_t> request,
+    size_t buffer_size
 );
 
-void write_response(boost::asio::ip::tcp::socket &socket, std::shared_ptr<http_response_t> response);
+void write_response(
+    std::shared_ptr<socket_holder_t> holder,
+    std::shared_ptr<http_request_t> request,
+    std::shared_ptr<http_response_t> response
+);
 
-void do_accept(boost::asio::ip::tcp::acceptor& acceptor,
+template<typename acceptor_t>
+void do_accept(acceptor_t& acceptor,
     std::vector<std::shared_ptr<socket_holder_t>> &sockets);
 
+/**
+ * クライアントのIPアドレスを文字列にする (Unix ドメインソケットの場合は "unix")
+ */
+std::string get_client_address(const boost::asio::generic::stream_protocol::endpoint &endpoint);
+
+/**
+ * レスポンスボディの圧縮
+ */
+static http_compressor_t g_compressor{http_compressor_t::config_t{}};
+
 /**
  * Boost.Asio を使って非同期I/O HTTPサーバーを構築する
  * @return
@@ -61,6 +179,8 @@ int main() {
     boost::asio::io_context _io_context(1);
     // Acceptor (後述)
     boost::asio::ip::tcp::acceptor _acceptor(_io_context);
+    // Unix ドメインソケットの Acceptor (環境変数 SIMPLE_SERVER_UNIX_SOCKET を設定した場合だけ開く)
+    boost::asio::local::stream_protocol::acceptor _unix_acceptor(_io_context);
 
     /* #####################################################################
      * シグナルハンドラの登録処理 (Boostは便利)
@@ -76,6 +196,7 @@ int main() {
     do_signal_handler_async(
         _signals,
         _acceptor,
+        _unix_acceptor,
         sockets
     );
 
@@ -93,93 +214,271 @@ int main() {
 
 
     _acceptor.open(end_point.endpoint().protocol());
-    _acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+    // SO_REUSEADDR, TCP_DEFER_ACCEPT などは http_server_t と同じ設定を付ける
+    // (accept は Asio が呼ぶので、accept4 の設定は使わない)
+    socket_options_t::get_default().apply_to_listener(_acceptor.native_handle());
     _acceptor.bind(end_point);
     _acceptor.listen();
     std::cout << "address: " << end_point.endpoint().address().to_string() << std::endl;
 
+    // 同じホストのサイドカーからの接続用に、Unix ドメインソケットでも待ち受ける
+    // (開くのは http_server_t と同じ処理で、開いたディスクリプタを Asio に渡す)
+    const auto unix_socket = unix_listener_t::get_config_from_environment();
+    if (unix_socket) {
+        const auto unix_sd = unix_listener_t::open(*unix_socket, boost::asio::socket_base::max_listen_connections);
+        if (unix_sd == -1) {
+            return 1;
+        }
+        _unix_acceptor.assign(boost::asio::local::stream_protocol(), unix_sd);
+        std::cout << "unix socket: " << unix_socket->path << std::endl;
+    }
+
     /* #####################################################################
      * 待ち受けを開始します。
      * クライアントから接続があると引数のラムダが実行されます。
      * ##################################################################### */
 
     do_accept(_acceptor, sockets);
+    if (_unix_acceptor.is_open()) {
+        do_accept(_unix_acceptor, sockets);
+    }
 
     _io_context.run();
 
+    if (unix_socket) {
+        unix_listener_t::remove(*unix_socket);
+    }
     return 0;
 }
 
-void do_accept(boost::asio::ip::tcp::acceptor& _acceptor, std::vector<std::shared_ptr<socket_holder_t>> &sockets) {
+template<typename acceptor_t>
+void do_accept(acceptor_t& _acceptor, std::vector<std::shared_ptr<socket_holder_t>> &sockets) {
+    // TCP の場合だけクライアントのIPアドレス毎にレート制限する
+    // (Unix ドメインソケットは同じホストのサイドカーからなので、全てのクライアントが1つにまとまってしまう)
+    constexpr auto is_tcp = std::is_same_v<typename acceptor_t::protocol_type, boost::asio::ip::tcp>;
+
     _acceptor.async_accept(
-        [&_acceptor, &sockets](boost::system::error_code error_code, boost::asio::ip::tcp::socket socket) {
-            std::cerr << error_code << std::endl;
-            auto holder = std::make_shared<socket_holder_t>(std::move(socket));
-            sockets.push_back(holder);
-            process_request(sockets, holder->get_socket());
+        [&_acceptor, &sockets](boost::system::error_code error_code, typename acceptor_t::protocol_type::socket socket) {
+            if (error_code && error_code != boost::asio::error::operation_aborted) {
+                async_logger_t::get_default().log(async_logger_t::level_t::warning, "accept: " + error_code.message());
+            }
+            if (!_acceptor.is_open()) {
+                return;
+            }
+
+            // 閉じたソケットはリストから取り除く
+            sockets.erase(
+                std::remove_if(sockets.begin(), sockets.end(), [](const std::shared_ptr<socket_holder_t> &holder) {
+                    return !holder->get_socket().is_open();
+                }),
+                sockets.end()
+            );
+
+            boost::system::error_code endpoint_ec;
+            const auto remote_endpoint = error_code || !is_tcp ? typename acceptor_t::endpoint_type() : socket.remote_endpoint(endpoint_ec);
+            if (!error_code && !endpoint_ec && is_tcp && !g_rate_limiter.try_acquire(get_client_address(remote_endpoint))) {
+                // レート制限を超えている場合は、リクエストを読まずに断る
+                g_rate_limiter.reject(socket.release());
+            } else if (!error_code && !g_admission_controller.try_accept_connection()) {
+                // 同時接続数が上限に達している場合は、何もせずに断る
+                // (ディスクリプタの所有権を Asio から外してから閉じる)
+                g_admission_controller.reject(socket.release());
+            } else if (!error_code) {
+                HTTP_SERVER_PROBE1(connection__accept, socket.native_handle());
+                server_metrics_t::get_default().add_connection();
+                auto holder = std::make_shared<socket_holder_t>(client_socket_t(std::move(socket)));
+                sockets.push_back(holder);
+                process_request(holder);
+            }
             do_accept(_acceptor, sockets);
         }
     );
 }
 
-void process_request(std::vector<std::shared_ptr<socket_holder_t>> &sockets, boost::asio::ip::tcp::socket &socket) {
-    auto buffer = std::make_shared<std::array<char, 1024>>();
+std::string get_client_address(const boost::asio::generic::stream_protocol::endpoint &endpoint) {
+    if (endpoint.data()->sa_family != AF_INET) {
+        return "unix";
+    }
+    std::array<char, INET_ADDRSTRLEN> buffer{};
+    ::inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in*>(endpoint.data())->sin_addr, buffer.data(), buffer.size());
+    return buffer.data();
+}
+
+void process_request(std::shared_ptr<socket_holder_t> holder) {
     auto request = std::make_shared<http_request_t>();
 
-    process_request_with_buffer(sockets, socket, buffer, request);
+    // ヘッダを受信し終わったら、ここからはボディのタイムアウト
+    std::weak_ptr<socket_holder_t> weak_holder = holder;
+    request->set_header_handler([weak_holder](http_request_t &) {
+        if (auto locked_holder = weak_holder.lock()) {
+            server_metrics_t::get_default().record(
+                server_metrics_t::stage_t::header_parse,
+                std::chrono::steady_clock::now() - locked_holder->get_first_byte_at()
+            );
+            locked_holder->get_deadline().enter(connection_deadline_t::phase_t::body);
+        }
+    });
+
+    // 読めるようになってから read_some で読めるだけ読むので、ソケットはノンブロッキングにする
+    boost::system::error_code ec;
+    holder->get_socket().non_blocking(true, ec);
+    if (ec) {
+        holder->close();
+        return;
+    }
+
+    holder->get_deadline().enter(connection_deadline_t::phase_t::idle);
+    wait_for_request(holder, request, buffer_pool_t::get_min_size());
 }
 
-void process_request_with_buffer(
-    std::vector<std::shared_ptr<socket_holder_t>> &sockets, boost::asio::ip::tcp::socket &socket,
-    std::shared_ptr<std::array<char, 1024>> buffer,
-    std::shared_ptr<http_request_t> request
+void wait_for_request(
+    std::shared_ptr<socket_holder_t> holder,
+    std::shared_ptr<http_request_t> request,
+    size_t buffer_size
 ) {
-    socket.async_read_some(boost::asio::buffer(*buffer), [&sockets, &socket, buffer, request](
-        boost::system::error_code ec, std::size_t bytes_transferred
-    ) {
-        std::cout << "called" << std::endl;
+    // 読めるようになるまではバッファを持たずに待つ
+    // (async_read_some だと待っている間もバッファを確保しておく必要があるので、
+    //  待っているだけのコネクションが多いとバッファのメモリが無駄になる)
+    holder->get_socket().async_wait(boost::asio::socket_base::wait_read, [holder, request, buffer_size](
+        boost::system::error_code ec
+    ) mutable {
         if (ec) {
-            socket.close();
-            return;
-        }
-        if (bytes_transferred == 0) {
-            process_request_with_buffer(sockets, socket, buffer, request);
-            return;
-        }
-        std::string current_text(buffer->data(), buffer->data() + bytes_transferred);
-        request->add_bytes(current_text);
-        if (!request->is_ready()) {
-            process_request_with_buffer(sockets, socket, buffer, request);
+            if (holder->get_deadline().is_expired()) {
+                async_logger_t::get_default().log(async_logger_t::level_t::warning, "request timed out");
+            }
+            holder->close();
             return;
         }
 
-        auto response = std::make_shared<http_response_t>();
-        response->add_header("Content-Type", "text/plain");
-        response->set_body("受信した内容\r\n" + request->get_body());
+        // 読めるようになってからバッファを借りて、読めるだけ読む (読み終わったらプールに返す)
+        auto buffer = buffer_pool_t::acquire(buffer_size);
+        for (;;) {
+            const auto bytes_transferred = holder->get_socket().read_some(
+                boost::asio::buffer(buffer.get_data(), buffer.get_size()),
+                ec
+            );
+            if (ec == boost::asio::error::would_block) {
+                break;
+            }
+            if (ec) {
+                // 相手が切断した場合 (eof) や、タイムアウトで shutdown した場合
+                if (holder->get_deadline().is_expired()) {
+                    async_logger_t::get_default().log(async_logger_t::level_t::warning, "request timed out");
+                }
+                holder->close();
+                return;
+            }
+
+            // 最初のバイトを受信したら、ここからはヘッダのタイムアウト
+            if (holder->get_deadline().get_phase() == connection_deadline_t::phase_t::idle) {
+                holder->get_deadline().enter(connection_deadline_t::phase_t::header);
+                holder->set_first_byte_at(std::chrono::steady_clock::now());
+                server_metrics_t::get_default().record(
+                    server_metrics_t::stage_t::accept_to_first_byte,
+                    holder->get_first_byte_at() - holder->get_accepted_at()
+                );
+                auto &capture = request_capture_t::get_default();
+                if (capture.is_enabled()) {
+                    holder->get_recording() = capture.start(holder->get_first_byte_at());
+                }
+            }
+            server_metrics_t::get_default().add_received_bytes(bytes_transferred);
+            HTTP_SERVER_PROBE2(request__chunk, holder->get_socket().native_handle(), bytes_transferred);
+
+            // 確保はこのコールバックの間だけリクエストの分として数える
+            // (ルートを設定するのはリクエストを読み終わったときだけなので、ルート毎の合計には
+            // 最後の受信からレスポンスを組み立てるまでの分が入る. 送信は処理段階毎の合計にだけ入る)
+            allocation_accounting_t::request_scope_t allocation_scope;
+            holder->get_recording().append(buffer.get_data(), bytes_transferred);
+            try {
+                allocation_accounting_t::phase_scope_t allocation_phase(allocation_accounting_t::phase_t::parse);
+                request->add_bytes(buffer.get_data(), bytes_transferred);
+            } catch (const std::exception &ex) {
+                async_logger_t::get_default().log(async_logger_t::level_t::warning, ex.what());
+                server_metrics_t::get_default().add_error();
+                holder->close();
+                return;
+            }
+            if (request->is_ready()) {
+                buffer.reset();
+                allocation_scope.set_route(request->get_method(), request->get_uri());
+                holder->get_recording().commit();
+                [[maybe_unused]] const auto sd = holder->get_socket().native_handle();
+                HTTP_SERVER_PROBE3(request__headers, sd, request->get_method().c_str(), request->get_uri().c_str());
+
+                auto &metrics = server_metrics_t::get_default();
+                metrics.add_in_flight(1);
+
+                auto response = std::make_shared<http_response_t>();
+                if (metrics.is_metrics_request(*request)) {
+                    metrics.write_response(*response);
+                } else {
+                    HTTP_SERVER_PROBE2(handler__start, sd, "echo");
+                    server_metrics_t::stage_timer_t handler_timer(metrics, server_metrics_t::stage_t::handler);
+                    response->add_header("Content-Type", "text/plain");
+                    response->set_body("受信した内容\r\n" + request->get_body());
+                    g_compressor.apply(*request, *response);
+                    HTTP_SERVER_PROBE2(handler__end, sd, "echo");
+                }
+
+                write_response(holder, request, response);
+                return;
+            }
 
-        write_response(socket, response);
+            // バッファが一杯になった場合は、大きいヘッダやボディが続いているので大きいバッファに替える
+            if (bytes_transferred == buffer.get_size() && buffer_size < buffer_pool_t::CLASS_SIZES.back()) {
+                buffer_size = buffer_pool_t::get_next_size(buffer_size);
+                buffer = buffer_pool_t::acquire(buffer_size);
+            }
+        }
+
+        buffer.reset();
+        wait_for_request(holder, request, buffer_size);
     });
 }
 
-void write_response(boost::asio::ip::tcp::socket &socket, std::shared_ptr<http_response_t> response) {
-    // バッファに書き込む
-    std::vector<boost::asio::const_buffer> buffers;
-    buffers.push_back(
-        boost::asio::buffer(response->to_string())
-    );
+void write_response(
+    std::shared_ptr<socket_holder_t> holder,
+    std::shared_ptr<http_request_t> request,
+    std::shared_ptr<http_response_t> response
+) {
+    auto &metrics = server_metrics_t::get_default();
+
+    // 送信し終わるまで文字列を保持する
+    std::shared_ptr<std::string> data;
+    {
+        server_metrics_t::stage_timer_t serialize_timer(metrics, server_metrics_t::stage_t::serialize);
+        data = std::make_shared<std::string>(response->to_string());
+    }
+
+    holder->get_deadline().enter(connection_deadline_t::phase_t::write);
+    const auto write_started = std::chrono::steady_clock::now();
+
     // 書き込みが終わると、ラムダが呼ばれる
     boost::asio::async_write(
-        socket,
-        buffers,
-        [&socket](boost::system::error_code ec, std::size_t) {
+        holder->get_socket(),
+        boost::asio::buffer(*data),
+        [holder, request, data, write_started](boost::system::error_code ec, std::size_t bytes_transferred) {
+            auto &write_metrics = server_metrics_t::get_default();
+            write_metrics.record(server_metrics_t::stage_t::write, std::chrono::steady_clock::now() - write_started);
+            write_metrics.add_sent_bytes(bytes_transferred);
+            HTTP_SERVER_PROBE3(response__sent, holder->get_socket().native_handle(), bytes_transferred, data->size() - bytes_transferred);
+            write_metrics.add_in_flight(-1);
+
             if (!ec) {
+                // クライアントのアドレスは閉じる前に取っておく
+                boost::system::error_code endpoint_ec;
+                const auto remote_endpoint = holder->get_socket().remote_endpoint(endpoint_ec);
+                const auto client_addr = endpoint_ec ? std::string() : get_client_address(remote_endpoint);
+                http_server_t::log_access(client_addr.c_str(), *request, *data, holder->get_accepted_at());
+
                 boost::system::error_code ignored_ec;
-                socket.shutdown(boost::asio::ip::tcp::socket::shutdown_both,
-                                ignored_ec);
+                holder->get_socket().shutdown(boost::asio::socket_base::shutdown_both,
+                                              ignored_ec);
             }
 
             if (ec != boost::asio::error::operation_aborted) {
-                socket.close();
+                holder->close();
             }
         });
 }
@@ -187,19 +486,22 @@ void write_response(boost::asio::ip::tcp::socket &socket, std::shared_ptr<http_r
 void do_signal_handler_async(
     boost::asio::signal_set &_signals,
     boost::asio::ip::tcp::acceptor &acceptor,
+    boost::asio::local::stream_protocol::acceptor &unix_acceptor,
     std::vector<std::shared_ptr<socket_holder_t>> &sockets
 ) {
 
     // _signals に登録されたシグナルを受信したら、
     // 引数のラムダを実行してくれる!
-    _signals.async_wait([&acceptor, &sockets](boost::system::error_code /*ec*/, int /*signum*/) {
+    _signals.async_wait([&acceptor, &unix_acceptor, &sockets](boost::system::error_code /*ec*/, int /*signum*/) {
         // 待ち受けをやめる
         acceptor.close();
+        boost::system::error_code ignored_ec;
+        unix_acceptor.close(ignored_ec);
 
         // 既存の接続を全部クローズ
         for (auto &socket: sockets) {
             if (socket->get_socket().is_open()) {
-                socket->get_socket().close();
+                socket->close();
             }
         }
     });
@@ -0,0 +1,72 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <http_request_t.h>
+#include <request_body_t.h>
+#include "lua_request_table_t.h"
+
+void lua_request_table_t::push(lua_State* L, const http_request_t &request, const multipart_form_t &form) {
+    const auto &header = request.get_header();
+    const auto is_multipart = form.is_attached();
+
+    // ヘッダの数とリクエスト行・ボディの分だけ、最初から領域を確保しておく
+    lua_createtable(L, 0, static_cast<int>(header.size()) + 2);
+
+    // リクエスト行をテーブルにセット
+    const auto &request_line = request.get_request_line();
+    lua_pushlstring(L, request_line.data(), request_line.size());
+    lua_setfield(L, -2, "requestLine");
+
+    for (const auto &header_item : header) {
+        lua_pushlstring(L, header_item.first.data(), header_item.first.size());
+        lua_pushlstring(L, header_item.second.data(), header_item.second.size());
+        lua_settable(L, -3);
+    }
+
+    if (is_multipart) {
+        // multipart/form-data のパートをテーブルの配列にしてセット
+        const auto &parts = form.get_parts();
+        lua_createtable(L, static_cast<int>(parts.size()), 0);
+        auto index = 1;
+        for (const auto &part : parts) {
+            push_part(L, part);
+            lua_rawseti(L, -2, index++);
+        }
+        lua_setfield(L, -2, "parts");
+    } else {
+        // リクエストボディもテーブルにセット
+        // (大きなボディは一時ファイルを mmap したものを直接渡す)
+        const auto body = request.get_body_storage().view();
+        lua_pushlstring(L, body.data(), body.size());
+        lua_setfield(L, -2, "body");
+    }
+}
+
+void lua_request_table_t::push_part(lua_State* L, const multipart_form_t::part_t &part) {
+    lua_createtable(L, 0, 5);
+
+    lua_pushlstring(L, part.name.data(), part.name.size());
+    lua_setfield(L, -2, "name");
+
+    lua_pushlstring(L, part.filename.data(), part.filename.size());
+    lua_setfield(L, -2, "filename");
+
+    lua_pushlstring(L, part.content_type.data(), part.content_type.size());
+    lua_setfield(L, -2, "contentType");
+
+    lua_pushinteger(L, static_cast<lua_Integer>(part.data->size()));
+    lua_setfield(L, -2, "size");
+
+    if (part.data->is_spilled()) {
+        // 一時ファイルには名前がないので、Linux の /proc から開けるパスを渡す
+        const auto path = "/proc/self/fd/" + std::to_string(part.data->get_fd());
+        lua_pushlstring(L, path.data(), path.size());
+        lua_setfield(L, -2, "path");
+    } else {
+        const auto data = part.data->view();
+        lua_pushlstring(L, data.data(), data.size());
+        lua_setfield(L, -2, "body");
+    }
+}
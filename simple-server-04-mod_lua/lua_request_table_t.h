@@ -0,0 +1,49 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_LUA_REQUEST_TABLE_T_H
+#define HTTP_SERVER_LUA_REQUEST_TABLE_T_H
+
+#include <multipart_form_t.h>
+
+extern "C" {
+#include <lua/lua.h>
+}
+
+class http_request_t;
+
+/**
+ * リクエストを Lua の `request_handler` に渡すテーブルにする
+ *
+ * テーブルには
+ *
+ * * `requestLine` リクエスト行
+ * * リクエストヘッダ (ヘッダ名をそのままキーにする)
+ * * multipart/form-data の場合は `parts` (パートの配列)、それ以外は `body`
+ *
+ * を入れる。各パートは `name`, `filename`, `contentType`, `size` と、
+ * メモリ上のデータなら `body`、一時ファイルに書き出したデータなら `path` を持つ。
+ *
+ * 文字列は長さ付きで積む (`strlen` しない、ボディに '\0' があってもそのまま渡す)。
+ */
+class lua_request_table_t {
+public:
+    /**
+     * リクエストのテーブルをスタックに積む
+     * @param [in] L Lua の環境
+     * @param [in] request リクエスト
+     * @param [in] form multipart/form-data のパート
+     */
+    static void push(lua_State* L, const http_request_t &request, const multipart_form_t &form);
+
+    /**
+     * multipart/form-data のパートをテーブルにしてスタックに積む
+     * @param [in] L Lua の環境
+     * @param [in] part パート
+     */
+    static void push_part(lua_State* L, const multipart_form_t::part_t &part);
+};
+
+
+#endif //HTTP_SERVER_LUA_REQUEST_TABLE_T_H
@@ -4,8 +4,27 @@
 
 #include "common.h"
 #include <http_server_t.h>
+#include <connection_arena_t.h>
+#include <server_metrics_t.h>
+#include <allocation_accounting_t.h>
+#include <trace_probes.h>
 #include <http_request_t.h>
+#include <request_body_t.h>
+#include <multipart_form_t.h>
 #include <http_response_t.h>
+#include <http_response_cache_t.h>
+#include <http_request_key_t.h>
+#include <single_flight_t.h>
+#include <compression_stream_t.h>
+#include <http_compressor_t.h>
+#include <admission_controller_t.h>
+#include <rate_limiter_t.h>
+#include <http_router_t.h>
+#include <static_route_table_t.h>
+#include <middleware_pipeline_t.h>
+#include <response_header_stage_t.h>
+#include <compression_stage_t.h>
+#include "lua_request_table_t.h"
 
 extern "C" {
 #include <lua/lua.h>
@@ -26,9 +45,91 @@ void run_lua(int sd, const char* client_ip);
 
 void run_lua_impl(int sd, std::string client_ip);
 
-void write_response(int sd, const http_response_t &response);
+/**
+ * Lua のリクエストハンドラを実行してレスポンスを作成する
+ *
+ * `request_handler` は1つ目の戻り値でボディを、2つ目の戻り値 (省略可) でレスポンスヘッダのテーブルを返す。
+ * `Cache-Control: max-age=N` を返すとレスポンスキャッシュの対象になる。
+ *
+ * multipart/form-data のリクエストの場合は、リクエストのテーブルの `parts` にパートの配列を入れる。
+ * 各パートは `name`, `filename`, `contentType`, `size` と、
+ * メモリ上のデータなら `body`、一時ファイルに書き出したデータなら `path` を持つ。
+ *
+ * @param [in] request リクエスト
+ * @param [in] form multipart/form-data のパート
+ * @return レスポンス
+ */
+http_response_t execute_lua(const http_request_t &request, const multipart_form_t &form);
+
+/**
+ * ネイティブ (C++) のルートを実行する
+ *
+ * コンパイル時のルート表、ルーター の順に探して、一致しない場合は Lua に任せる。
+ * ルーターのパスに一致してメソッドが違う場合は、Lua に任せずに 405 (`Allow` 付き) を返す。
+ *
+ * @param [in] request リクエスト
+ * @return 一致するルートがあった場合はレスポンス. ない場合は `std::nullopt`
+ */
+std::optional<http_response_t> execute_native_route(const http_request_t &request);
+
+/**
+ * Lua のリクエストハンドラを、共通のミドルウェアを通して実行する
+ *
+ * @param [in] request リクエスト
+ * @param [in] form multipart/form-data のパート
+ * @return レスポンス
+ */
+http_response_t generate_lua_response(const http_request_t &request, const multipart_form_t &form);
 
-std::vector<std::thread> g_threads;
+/**
+ * ヘルスチェック
+ */
+void handle_health(const http_request_t &request, http_response_t &response);
+
+/**
+ * コンパイル時に決まるネイティブのルート
+ */
+using native_routes_t = static_route_table_t<
+    static_route_t<"GET", "/health", handle_health>
+>;
+
+/**
+ * パスパラメータを使うネイティブのルート (main で登録する)
+ */
+http_router_t g_router;
+
+/**
+ * アドミッション制御 (スレッド数と接続数の上限、過負荷時の 503)
+ */
+std::shared_ptr<admission_controller_t> g_admission_controller;
+
+/**
+ * レスポンスキャッシュ (nullptr の場合はキャッシュしない)
+ */
+std::unique_ptr<http_response_cache_t> g_response_cache;
+
+/**
+ * 同時に来た同じリクエストをまとめる (最大 64 リクエストまで相乗りさせる)
+ */
+single_flight_t<std::string> g_single_flight(64);
+
+/**
+ * single-flight で「同じリクエスト」とみなすキーの構成
+ */
+http_request_key_t::config_t g_single_flight_key_config;
+
+/**
+ * レスポンスボディの圧縮 (圧縮結果はレスポンスキャッシュにも入る)
+ */
+http_compressor_t g_compressor{http_compressor_t::config_t{}};
+
+/**
+ * 全てのハンドラ (ネイティブのルートと Lua) に共通のミドルウェア
+ */
+auto g_pipeline = make_middleware_pipeline( // NOLINT(cert-err58-cpp)
+    response_header_stage_t({{"Server", "simple-server-04"}, {"X-Content-Type-Options", "nosniff"}}),
+    compression_stage_t(g_compressor)
+);
 
 /**
  * lua を サーバープロセスに取り込んで、サーバー側の子スレッドでインタープリットする
@@ -36,7 +137,35 @@ std::vector<std::thread> g_threads;
  * @return
  */
 int main() {
+    // レスポンスキャッシュを有効にする
+    // Lua 側で `Cache-Control: max-age` を返したレスポンスだけがキャッシュされる
+    http_response_cache_t::config_t cache_config;
+    cache_config.vary_headers = {"Accept", "Accept-Encoding"};
+    g_response_cache = std::make_unique<http_response_cache_t>(cache_config);
+
+    // Lua スクリプトはリクエストヘッダとボディをエコーするので、キャッシュしないレスポンスも含めてまとめる場合は、
+    // ヘッダとボディが全て同じリクエストだけをまとめる (Cookie や Authorization が違うクライアントに別の人のレスポンスを返さない)
+    g_single_flight_key_config.all_headers = true;
+    g_single_flight_key_config.body = true;
+
+    // パスパラメータを使うルートを登録する
+    g_router.add("GET", "/hello/:name", [](const http_request_t &, const http_router_t::params_t &params, http_response_t &response) {
+        response.add_header("Content-Type", "text/plain;charset=UTF-8");
+        response.set_body("Hello, " + std::string(params.get("name").value_or("")) + "\n");
+    });
+
+    // メトリクス (パスは環境変数 SIMPLE_SERVER_METRICS_PATH で変えられる)
+    g_router.add("GET", server_metrics_t::get_default().get_path(), [](const http_request_t &, const http_router_t::params_t &, http_response_t &response) {
+        server_metrics_t::get_default().write_response(response);
+    });
+
+    // 1リクエスト 1スレッドなので、処理中のハンドラ数の上限がそのままスレッド数の上限になる
+    g_admission_controller = std::make_shared<admission_controller_t>(admission_controller_t::config_t{});
+
     http_server_t server;
+    server.set_admission_controller(g_admission_controller);
+    // 同じIPアドレスからのリクエストは 50 リクエスト/秒 (瞬間的には 100 リクエスト) まで
+    server.set_rate_limiter(std::make_shared<rate_limiter_t>(rate_limiter_t::config_t{}));
     server.set_client_handler(
         run_lua
     );
@@ -51,22 +180,198 @@ void run_lua(int sd, const char* client_ip) {
     // C++ はコールバックで渡されたポインタを、この関数を抜けても使いたい場合は、
     // コピーしておきましょう。
     std::string client_ip_text(client_ip);
+    const auto accepted_at = admission_controller_t::clock_t::now();
+    // accept のキューで待っていた時間も待ち時間に入れる
+    const auto arrived_at = admission_controller_t::get_arrived_at(sd);
+
+    // 処理中のスレッドが上限に達している場合は、スレッドを作らずにすぐ断る
+    if (!g_admission_controller->try_begin()) {
+        g_admission_controller->reject(sd);
+        g_admission_controller->release_connection();
+        return;
+    }
 
     // スレッドを起動する
-    std::thread new_thread([sd, client_ip_text] {
-        run_lua_impl(sd, client_ip_text);
-    });
+    // (終了待ちはしないので切り離す。切り離さないと終了したスレッドのスタックが残り続ける)
+    try {
+        std::thread new_thread([sd, client_ip_text, accepted_at, arrived_at] {
+            // accept が追いつかなかったり、CPU が足りずにスレッドが動き出すまで待たされた場合は、仕事を始める前に断る
+            if (g_admission_controller->is_queue_time_exceeded(arrived_at)) {
+                g_admission_controller->reject(sd);
+                g_admission_controller->shed();
+            } else {
+                run_lua_impl(sd, client_ip_text);
+                g_admission_controller->end(accepted_at);
+            }
+            g_admission_controller->release_connection();
+        });
+        new_thread.detach();
+    } catch (const std::system_error &ex) {
+        // スレッドを作れなかった (スレッド数やメモリの上限) 場合は、ここで断って
+        // try_begin で確保した処理中の枠・接続数・ソケットを返す (返さないと枠が減り続けて、いずれ全部断るようになる)
+        std::cerr << "スレッドの作成に失敗しました: " << ex.what() << std::endl;
+        g_admission_controller->reject(sd);
+        g_admission_controller->shed();
+        g_admission_controller->release_connection();
+    }
+}
 
+void run_lua_impl(int sd, std::string client_ip) { // NOLINT(performance-unnecessary-value-param)
+    const auto started = std::chrono::steady_clock::now();
+    auto &metrics = server_metrics_t::get_default();
+    const auto connection_scope = metrics.track_connection();
+    allocation_accounting_t::request_scope_t allocation_scope;
+
+    // リクエストはコネクション毎のアリーナから確保する (アリーナはリクエストより先に宣言すること)
+    const auto arena = connection_arena_t::acquire();
+
+    // multipart/form-data の場合は受信しながらパートに分ける
+    const auto form = std::make_shared<multipart_form_t>();
+    const auto request = http_server_t::read_request(sd, [&form](http_request_t &request) {
+        form->attach(request);
+    }, arena->get_resource());
+    if (!request) {
+        HTTP_SERVER_PROBE1(connection__close, sd);
+        close(sd);
+        return;
+    }
+    allocation_scope.set_route(request->get_method(), request->get_uri());
+    const auto in_flight_scope = metrics.track_in_flight();
+
+    // multipart/form-data のボディが終端の境界より前で終わった場合は、途中までのパートを Lua に渡さない
+    if (!form->is_complete()) {
+        http_response_t bad_request;
+        bad_request.set_status(400);
+        bad_request.add_header("Content-Type", "text/plain");
+        bad_request.add_header("Cache-Control", "no-store");
+        bad_request.set_body("Bad Request");
+        const auto bad_request_text = bad_request.to_string();
+        http_server_t::send_all(sd, bad_request_text);
+        HTTP_SERVER_PROBE1(connection__close, sd);
+        close(sd);
+        http_server_t::log_access(client_ip.c_str(), *request, bad_request_text, started);
+        return;
+    }
 
-    g_threads.push_back(std::move(new_thread));
+    // ネイティブのルートに一致する場合は Lua を実行しない
+    std::optional<http_response_t> native_response;
+    {
+        HTTP_SERVER_PROBE2(handler__start, sd, "native");
+        server_metrics_t::stage_timer_t handler_timer(metrics, server_metrics_t::stage_t::handler);
+        native_response = execute_native_route(*request);
+        HTTP_SERVER_PROBE2(handler__end, sd, "native");
+    }
+    if (native_response) {
+        std::string native_response_text;
+        {
+            server_metrics_t::stage_timer_t serialize_timer(metrics, server_metrics_t::stage_t::serialize);
+            native_response_text = native_response->to_string();
+        }
+        http_server_t::send_all(sd, native_response_text);
+        HTTP_SERVER_PROBE1(connection__close, sd);
+        close(sd);
+        http_server_t::log_access(client_ip.c_str(), *request, native_response_text, started);
+        return;
+    }
+
+    // キャッシュが有効な場合はまずキャッシュを探す
+    std::string cache_key;
+    const auto use_cache = g_response_cache && http_response_cache_t::is_cacheable_request(*request);
+    if (use_cache) {
+        cache_key = g_response_cache->make_key(*request);
+        const auto cached = g_response_cache->lookup(cache_key);
+        if (cached.state != http_response_cache_t::lookup_state_t::miss) {
+            http_server_t::send_all(sd, *cached.response_text);
+            HTTP_SERVER_PROBE1(connection__close, sd);
+            close(sd);
+            http_server_t::log_access(client_ip.c_str(), *request, *cached.response_text, started);
+
+            // stale-while-revalidate の場合は、古いレスポンスを返した後に再生成だけ行う
+            if (cached.state == http_response_cache_t::lookup_state_t::stale_revalidate) {
+                g_response_cache->store(cache_key, generate_lua_response(*request, *form));
+            }
+            return;
+        }
+    }
+
+    // 同じリクエストが同時に来ている場合は Lua の実行を1回にまとめる
+    // (副作用があるかもしれないので GET/HEAD だけ)
+    const auto generate = [sd, &request, &form, &use_cache, &cache_key, &metrics]() {
+        std::optional<http_response_t> generated;
+        {
+            HTTP_SERVER_PROBE2(handler__start, sd, "lua");
+            server_metrics_t::stage_timer_t handler_timer(metrics, server_metrics_t::stage_t::handler);
+            generated = generate_lua_response(*request, *form);
+            HTTP_SERVER_PROBE2(handler__end, sd, "lua");
+        }
+        const auto &response = *generated;
+
+        server_metrics_t::stage_timer_t serialize_timer(metrics, server_metrics_t::stage_t::serialize);
+        if (use_cache) {
+            return g_response_cache->store(cache_key, response);
+        }
+        return std::make_shared<const std::string>(response.to_string());
+    };
+    const auto response_text = http_response_cache_t::is_cacheable_request(*request)
+        ? g_single_flight.execute(http_request_key_t::make(*request, g_single_flight_key_config), generate)
+        : generate();
+
+    http_server_t::send_all(sd, *response_text);
+
+    // ソケットのクローズ
+    HTTP_SERVER_PROBE1(connection__close, sd);
+    close(sd);
+
+    http_server_t::log_access(client_ip.c_str(), *request, *response_text, started);
 }
 
-void run_lua_impl(int sd, std::string client_ip) { // NOLINT(performance-unnecessary-value-param)
+std::optional<http_response_t> execute_native_route(const http_request_t &request) {
+    http_response_t response;
+
+    const auto path = http_router_t::get_path(request.get_uri());
+    if (const auto static_handler = native_routes_t::find(request.get_method(), path)) {
+        g_pipeline(request, response, static_handler);
+        return response;
+    }
+
+    http_router_t::params_t params;
+    if (const auto handler = g_router.find(request.get_method(), path, params)) {
+        g_pipeline(request, response, [handler, &params](const http_request_t &routed_request, http_response_t &routed_response) {
+            (*handler)(routed_request, params, routed_response);
+        });
+        return response;
+    }
+
+    // パスがないのか (Lua に任せる)、メソッドが違うのか (405) は、ルーターの dispatch に判定させる
+    // (ここに来るのは find で見つからなかった場合だけなので、dispatch がハンドラを実行することはない)
+    http_response_t routed;
+    if (!g_router.dispatch(request, routed) && routed.get_status() == 405) {
+        g_pipeline(request, response, [&routed](const http_request_t &, http_response_t &routed_response) {
+            routed_response = std::move(routed);
+        });
+        return response;
+    }
+    return std::nullopt;
+}
+
+http_response_t generate_lua_response(const http_request_t &request, const multipart_form_t &form) {
+    http_response_t response;
+    g_pipeline(request, response, [&form](const http_request_t &lua_request, http_response_t &lua_response) {
+        lua_response = execute_lua(lua_request, form);
+    });
+    return response;
+}
 
-    const auto request = http_server_t::read_request(sd);
+void handle_health(const http_request_t &request, http_response_t &response) {
+    response.add_header("Content-Type", "text/plain");
+    response.add_header("Cache-Control", "no-store");
+    response.set_body("OK\n");
+}
 
+http_response_t execute_lua(const http_request_t &request, const multipart_form_t &form) {
     // lua の環境
     lua_State* L = luaL_newstate();
+    HTTP_SERVER_PROBE1(lua__acquire, L);
     if (!L) {
         std::cerr << "Lua の初期化に失敗しました。" << std::endl;
     }
@@ -86,74 +391,43 @@ void run_lua_impl(int sd, std::string client_ip) { // NOLINT(performance-unneces
 
 
     // リクエストを渡すようにテーブルを作成する
-    lua_newtable(L);
-
-    // リクエスト行をテーブルにセット
-    lua_pushstring(L, "requestLine");
-    lua_pushstring(L, request->get_request_line().c_str());
-    lua_settable(L, -3);
-
-    const auto &header = request->get_header();
-    for (const auto &header_item : header) {
-        lua_pushstring(L, header_item.first.c_str());
-        lua_pushstring(L, header_item.second.c_str());
-        lua_settable(L, -3);
-    }
-
-    // リクエストボディもテーブルにセット
-    lua_pushstring(L, "body");
-    lua_pushstring(L, request->get_body().c_str());
-    lua_settable(L, -3);
+    lua_request_table_t::push(L, request, form);
 
     // 今、スタックには
     // * 引数のテーブル
     // * request_handler
     // という感じで積まれている
     // この関数を実行する
-    // `lua_call` の引数は Lua関数の引数の数:1, 戻り値の数が1 という意味
-    lua_call(L, 1, 1);
-
-    const char* response_ptr = lua_tostring(L, -1);
+    // `lua_call` の引数は Lua関数の引数の数:1, 戻り値の数が2 という意味
+    // (2つ目の戻り値はレスポンスヘッダのテーブル. 返さない場合は nil になる)
+    lua_call(L, 1, 2);
 
-    const std::string response_text(response_ptr);
+    http_response_t response;
 
-    // lua の環境を閉じる
-    lua_close(L);
+    // レスポンスヘッダ (`Cache-Control` など) をレスポンスにセットする
+    if (lua_istable(L, -1)) {
+        lua_pushnil(L);
+        while (lua_next(L, -2) != 0) {
+            // key は -2, value は -1
+            if (lua_type(L, -2) == LUA_TSTRING && lua_isstring(L, -1)) {
+                response.add_header(lua_tostring(L, -2), lua_tostring(L, -1));
+            }
+            lua_pop(L, 1);
+        }
+    }
 
-    http_response_t response;
+    // Lua が Content-Type を返さなかった場合だけ既定にする
+    // (add_header は既にあるヘッダを上書きしないので、先に付けると Lua の Content-Type が無視される)
     response.add_header("Content-Type", "text/plain");
-    response.set_body(response_text);
 
-    write_response(sd, response);
+    const char* response_ptr = lua_tostring(L, -2);
 
-    // ソケットのクローズ
-    close(sd);
-}
+    const std::string response_text(response_ptr ? response_ptr : "");
 
-void write_response(int sd, const http_response_t &response) {
-    const std::string response_text = response.to_string();
-    std::vector<char> buffer(response_text.begin(), response_text.end());
-    auto remaining_size = buffer.size();
-
-    while (remaining_size > 0) {
-        auto current_size = ::send(sd, (&*response_text.begin()) + (response_text.size() - remaining_size),
-                                   remaining_size, MSG_DONTWAIT);
-        if (static_cast<int>(current_size) == -1) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                continue;
-            }
-
-            if (errno == EINTR) {
-                if (http_server_t::is_shutdown_required()) {
-                    return;
-                }
-                continue;
-            }
-            http_server_t::print_error(errno);
-            return;
-        }
-        remaining_size -= current_size;
-    }
+    // lua の環境を閉じる
+    HTTP_SERVER_PROBE1(lua__release, L);
+    lua_close(L);
 
+    response.set_body(response_text);
+    return response;
 }
-
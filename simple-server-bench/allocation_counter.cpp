@@ -0,0 +1,77 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <new>
+#include "allocation_counter.h"
+
+namespace {
+    std::atomic<uint64_t> g_allocation_count(0);
+}
+
+uint64_t get_allocation_count() {
+    return g_allocation_count.load(std::memory_order_relaxed);
+}
+
+/*
+ * malloc の回数を数えるための operator new / delete
+ */
+
+void* operator new(size_t size) {
+    g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (auto pointer = std::malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return ::operator new(size);
+}
+
+// pmr の new_delete_resource はアラインメント付きの方を呼ぶ
+void* operator new(size_t size, std::align_val_t alignment) {
+    g_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    const auto align = std::max(static_cast<size_t>(alignment), sizeof(void*));
+    if (auto pointer = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return ::operator new(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
@@ -0,0 +1,41 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_ALLOCATION_COUNTER_H
+#define HTTP_SERVER_ALLOCATION_COUNTER_H
+
+#include <benchmark/benchmark.h>
+
+/**
+ * ベンチマークのバイナリ全体の `operator new` の回数
+ *
+ * `allocation_counter.cpp` をリンクすると `operator new` / `delete` が差し替わり、
+ * そのバイナリの全ての new (pmr の `new_delete_resource` が呼ぶアラインメント付きのものも含む) を数える。
+ *
+ * ```
+ * uint64_t allocations = 0;
+ * for (auto _ : state) {
+ *     const auto before = get_allocation_count();
+ *     ...
+ *     allocations += get_allocation_count() - before;
+ * }
+ * report_allocations(state, allocations);
+ * ```
+ */
+uint64_t get_allocation_count();
+
+/**
+ * 1回あたりの new の回数を `allocs/op` として結果に出す
+ * @param [in,out] state ベンチマークの状態
+ * @param [in] allocations 全ての繰り返しでの new の回数
+ * @param [in] name カウンタの名前
+ */
+inline void report_allocations(benchmark::State &state, uint64_t allocations, const char* name = "allocs/op") {
+    state.counters[name] = benchmark::Counter(
+        static_cast<double>(allocations),
+        benchmark::Counter::kAvgIterations
+    );
+}
+
+#endif //HTTP_SERVER_ALLOCATION_COUNTER_H
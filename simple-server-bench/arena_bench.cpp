@@ -0,0 +1,86 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <benchmark/benchmark.h>
+#include "http_request_t.h"
+#include "http_response_t.h"
+#include "connection_arena_t.h"
+#include "allocation_counter.h"
+
+/**
+ * コネクション毎のアリーナの効果を測る
+ *
+ * 典型的なブラウザのリクエストを解析してレスポンスを組み立てる処理を
+ *
+ * * 既定のメモリリソース (malloc)
+ * * プールから借りたアリーナ (`connection_arena_t`)
+ *
+ * で実行して、1リクエストあたりの時間と malloc の回数 (`allocs/req`) を比べる。
+ * malloc の回数は、このバイナリの `operator new` を差し替えて数える (`allocation_counter.h`)。
+ */
+
+namespace {
+    const std::string REQUEST_TEXT =
+        "GET /index.html?lang=ja HTTP/1.1\r\n"
+        "Host: localhost:12345\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+        "Accept-Language: ja,en-US;q=0.9,en;q=0.8\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Cache-Control: max-age=0\r\n"
+        "Connection: keep-alive\r\n"
+        "Cookie: session=0123456789abcdef0123456789abcdef; theme=dark\r\n"
+        "Upgrade-Insecure-Requests: 1\r\n"
+        "\r\n";
+
+    /**
+     * 1リクエスト分の処理 (解析して、ヘッダを見て、レスポンスを組み立てる)
+     */
+    void handle_request(std::pmr::memory_resource* resource) {
+        auto request = std::allocate_shared<http_request_t>(std::pmr::polymorphic_allocator<http_request_t>(resource), resource);
+        request->add_bytes(REQUEST_TEXT.data(), REQUEST_TEXT.size());
+        benchmark::DoNotOptimize(request->is_ready());
+
+        http_response_t response(resource);
+        response.set_status(200);
+        response.add_header("Content-Type", "text/plain;charset=UTF-8");
+        response.add_header("Cache-Control", "no-cache");
+        const auto &header = request->get_header();
+        const auto it = header.find("host");
+        if (it != header.end()) {
+            response.add_header("X-Host", it->second);
+        }
+        response.set_body("hello");
+        benchmark::DoNotOptimize(response.to_header_string());
+    }
+
+    void BM_default_resource(benchmark::State &state) {
+        uint64_t allocations = 0;
+        for (auto _ : state) {
+            const auto before = get_allocation_count();
+            handle_request(std::pmr::get_default_resource());
+            allocations += get_allocation_count() - before;
+        }
+        report_allocations(state, allocations, "allocs/req");
+    }
+    BENCHMARK(BM_default_resource);
+
+    void BM_connection_arena(benchmark::State &state) {
+        uint64_t allocations = 0;
+        for (auto _ : state) {
+            const auto before = get_allocation_count();
+            {
+                // サーバと同じく、リクエスト毎にプールから借りて、終わったらリセットして返す
+                const auto arena = connection_arena_t::acquire();
+                handle_request(arena->get_resource());
+            }
+            allocations += get_allocation_count() - before;
+        }
+        report_allocations(state, allocations, "allocs/req");
+    }
+    BENCHMARK(BM_connection_arena);
+}
+
+BENCHMARK_MAIN();
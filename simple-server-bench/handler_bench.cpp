@@ -0,0 +1,50 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <benchmark/benchmark.h>
+#include "http_request_t.h"
+#include "cgi_environment_t.h"
+#include "allocation_counter.h"
+
+/**
+ * ハンドラとの受け渡し (CGI の環境変数) を作るコストを測る
+ *
+ * リクエスト1つ分の `cgi_environment_t` を作って `execve` に渡す配列を取り出すまで。
+ * 作った環境変数のバイト数 (`bytes_per_second`) と1回あたりの new の回数 (`allocs/op`) を出す。
+ *
+ * Lua のテーブルへの受け渡しは Lua をリンクする `lua-bench` で測る。
+ */
+
+namespace {
+    void BM_cgi_environment(benchmark::State &state) {
+        const std::string text =
+            "POST /cgi/index.cgi HTTP/1.1\r\n"
+            "Host: localhost:12346\r\n"
+            "Content-Type: application/x-www-form-urlencoded\r\n"
+            "Content-Length: 27\r\n"
+            "\r\n"
+            "name=simple&value=server-02";
+        http_request_t request;
+        request.add_bytes(text.data(), text.size());
+
+        size_t bytes = 0;
+        uint64_t allocations = 0;
+        for (auto _ : state) {
+            const auto before = get_allocation_count();
+            cgi_environment_t environment(request);
+            auto envp = environment.get_envp();
+            benchmark::DoNotOptimize(envp);
+            for (; *envp; envp++) {
+                bytes += std::strlen(*envp) + 1;
+            }
+            allocations += get_allocation_count() - before;
+        }
+        state.SetBytesProcessed(static_cast<int64_t>(bytes));
+        report_allocations(state, allocations);
+    }
+    BENCHMARK(BM_cgi_environment);
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,124 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <benchmark/benchmark.h>
+#include "http_request_t.h"
+#include "http_response_t.h"
+#include "allocation_counter.h"
+
+/**
+ * リクエストの解析とレスポンスの組み立ての、ホットパスの処理を測る
+ *
+ * * `http_request_t::add_bytes` (受信の区切り・ヘッダの数・ボディの大きさを変える)
+ * * `http_response_t::to_string` (ボディの大きさを変える)
+ * * ヘッダの検索 (ヘッダの数を変える、大文字小文字が違う名前、ないヘッダ)
+ *
+ * どれも処理したバイト数 (`bytes_per_second`) と1回あたりの new の回数 (`allocs/op`) を出す。
+ */
+
+namespace {
+    /**
+     * ヘッダを `header_count` 個、ボディを `body_size` バイト持つリクエスト
+     */
+    std::string make_request_text(size_t header_count, size_t body_size) {
+        std::string text = body_size > 0 ? "POST /upload?lang=ja HTTP/1.1\r\n" : "GET /index.html?lang=ja HTTP/1.1\r\n";
+        text += "Host: localhost:12345\r\n";
+        text += "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0\r\n";
+        for (size_t i = 2; i < header_count; i++) {
+            text += "X-Custom-Header-" + std::to_string(i) + ": value-" + std::to_string(i * 7919) + "\r\n";
+        }
+        if (body_size > 0) {
+            text += "Content-Type: application/octet-stream\r\n";
+            text += "Content-Length: " + std::to_string(body_size) + "\r\n";
+        }
+        text += "\r\n";
+        text.append(body_size, 'x');
+        return text;
+    }
+
+    /**
+     * 引数: 受信の区切りのバイト数, ヘッダの数, ボディのバイト数
+     */
+    void BM_request_add_bytes(benchmark::State &state) {
+        const auto chunk_size = static_cast<size_t>(state.range(0));
+        const auto text = make_request_text(static_cast<size_t>(state.range(1)), static_cast<size_t>(state.range(2)));
+
+        uint64_t allocations = 0;
+        for (auto _ : state) {
+            const auto before = get_allocation_count();
+            http_request_t request;
+            for (size_t offset = 0; offset < text.size(); offset += chunk_size) {
+                request.add_bytes(text.data() + offset, std::min(chunk_size, text.size() - offset));
+            }
+            benchmark::DoNotOptimize(request.is_ready());
+            allocations += get_allocation_count() - before;
+        }
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * text.size()));
+        report_allocations(state, allocations);
+    }
+    BENCHMARK(BM_request_add_bytes)
+        ->ArgNames({"chunk", "headers", "body"})
+        ->ArgsProduct({{64, 1460, 16384}, {4, 32}, {0, 4096, 65536}});
+
+    /**
+     * 引数: ボディのバイト数
+     */
+    void BM_response_to_string(benchmark::State &state) {
+        http_response_t response;
+        response.set_status(200);
+        response.add_header("Content-Type", "text/plain;charset=UTF-8");
+        response.add_header("Cache-Control", "no-cache");
+        response.add_header("Vary", "Accept-Encoding");
+        response.set_body(std::string(static_cast<size_t>(state.range(0)), 'x'));
+
+        size_t bytes = 0;
+        uint64_t allocations = 0;
+        for (auto _ : state) {
+            const auto before = get_allocation_count();
+            const auto text = response.to_string();
+            benchmark::DoNotOptimize(text.data());
+            bytes += text.size();
+            allocations += get_allocation_count() - before;
+        }
+        state.SetBytesProcessed(static_cast<int64_t>(bytes));
+        report_allocations(state, allocations);
+    }
+    BENCHMARK(BM_response_to_string)
+        ->ArgName("body")
+        ->Arg(0)->Arg(1024)->Arg(65536);
+
+    /**
+     * 引数: ヘッダの数
+     */
+    void BM_header_lookup(benchmark::State &state) {
+        const auto text = make_request_text(static_cast<size_t>(state.range(0)), 0);
+        http_request_t request;
+        request.add_bytes(text.data(), text.size());
+        const auto &header = request.get_header();
+
+        // 実際のサーバと同じく、登録されたものと大文字小文字の違う名前 ("host", "user-agent") と、ないヘッダを探す
+        // (ヘッダ名は大文字小文字を区別せずに比べるので、大文字小文字の違う名前も見つかる)
+        const std::array<std::string_view, 3> names = {"host", "Accept-Encoding", "user-agent"};
+
+        size_t bytes = 0;
+        uint64_t allocations = 0;
+        for (auto _ : state) {
+            const auto before = get_allocation_count();
+            for (const auto name : names) {
+                const auto it = header.find(name);
+                benchmark::DoNotOptimize(it);
+                bytes += name.size();
+            }
+            allocations += get_allocation_count() - before;
+        }
+        state.SetBytesProcessed(static_cast<int64_t>(bytes));
+        report_allocations(state, allocations);
+    }
+    BENCHMARK(BM_header_lookup)
+        ->ArgName("headers")
+        ->Arg(4)->Arg(32);
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,171 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include "http_response_reader_t.h"
+
+http_response_reader_t::http_response_reader_t()
+    : state(state_t::header),
+      is_head(false),
+      status(0),
+      close(false),
+      remaining(0) {
+}
+
+void http_response_reader_t::reset(bool _is_head) {
+    this->state = state_t::header;
+    this->is_head = _is_head;
+    this->status = 0;
+    this->close = false;
+    this->remaining = 0;
+    this->line.clear();
+}
+
+size_t http_response_reader_t::feed(const char* data, size_t size) {
+    size_t offset = 0;
+    while (offset < size) {
+        bool found = false;
+        switch (this->state) {
+            case state_t::header:
+                offset += this->read_line(data + offset, size - offset, "\r\n\r\n", found);
+                if (!found) {
+                    if (this->line.size() > MAX_HEADER_SIZE) {
+                        this->state = state_t::failed;
+                    }
+                    break;
+                }
+                if (!this->parse_header(this->line)) {
+                    this->state = state_t::failed;
+                }
+                this->line.clear();
+                break;
+
+            case state_t::body_length:
+            case state_t::chunk_data: {
+                const auto length = std::min(this->remaining, size - offset);
+                this->remaining -= length;
+                offset += length;
+                if (this->remaining == 0) {
+                    this->state = this->state == state_t::body_length ? state_t::complete : state_t::chunk_size;
+                }
+                break;
+            }
+
+            case state_t::chunk_size:
+                offset += this->read_line(data + offset, size - offset, "\r\n", found);
+                if (!found) {
+                    break;
+                }
+                // チャンク拡張 (;name=value) は無視する
+                this->remaining = std::strtoul(this->line.c_str(), nullptr, 16);
+                this->line.clear();
+                if (this->remaining == 0) {
+                    this->state = state_t::chunk_trailer;
+                } else {
+                    // チャンクの後ろの \r\n も読み飛ばす
+                    this->remaining += 2;
+                    this->state = state_t::chunk_data;
+                }
+                break;
+
+            case state_t::chunk_trailer:
+                offset += this->read_line(data + offset, size - offset, "\r\n", found);
+                if (!found) {
+                    break;
+                }
+                // 空行でトレイラーが終わる
+                if (this->line == "\r\n") {
+                    this->state = state_t::complete;
+                }
+                this->line.clear();
+                break;
+
+            case state_t::until_close:
+                offset = size;
+                break;
+
+            case state_t::complete:
+            case state_t::failed:
+                return offset;
+        }
+    }
+    return offset;
+}
+
+bool http_response_reader_t::finish() {
+    if (this->state == state_t::until_close) {
+        this->state = state_t::complete;
+        return true;
+    }
+    return false;
+}
+
+bool http_response_reader_t::parse_header(std::string_view header) {
+    // ステータス行: HTTP/1.1 200 OK
+    if (header.size() < 12 || header.substr(0, 5) != "HTTP/") {
+        return false;
+    }
+    this->status = std::atoi(std::string(header.substr(9, 3)).c_str());
+    this->close = header.substr(0, 8) == "HTTP/1.0";
+
+    bool chunked = false;
+    std::optional<size_t> content_length;
+    size_t position = header.find("\r\n") + 2;
+    while (position < header.size()) {
+        const auto end = header.find("\r\n", position);
+        const auto field = header.substr(position, end - position);
+        position = end == std::string_view::npos ? header.size() : end + 2;
+
+        const auto colon = field.find(':');
+        if (colon == std::string_view::npos) {
+            continue;
+        }
+        std::string name(field.substr(0, colon));
+        std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return std::tolower(c); });
+        std::string value(field.substr(colon + 1));
+        value.erase(0, value.find_first_not_of(" \t"));
+        std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return std::tolower(c); });
+
+        if (name == "content-length") {
+            content_length = std::strtoul(value.c_str(), nullptr, 10);
+        } else if (name == "transfer-encoding") {
+            chunked = value.find("chunked") != std::string::npos;
+        } else if (name == "connection") {
+            this->close = value.find("close") != std::string::npos;
+        }
+    }
+
+    if (this->is_head || this->status == 204 || this->status == 304 || (this->status >= 100 && this->status < 200)) {
+        this->remaining = 0;
+        this->state = state_t::body_length;
+    } else if (chunked) {
+        this->state = state_t::chunk_size;
+    } else if (content_length) {
+        this->remaining = *content_length;
+        this->state = state_t::body_length;
+    } else {
+        this->state = state_t::until_close;
+    }
+    if (this->state == state_t::body_length && this->remaining == 0) {
+        this->state = state_t::complete;
+    }
+    return true;
+}
+
+size_t http_response_reader_t::read_line(const char* data, size_t size, std::string_view delimiter, bool &found) {
+    // 区切りが前回受信した分とまたがっている場合も見つけられるように、溜めた分の末尾から探す
+    const auto previous_size = this->line.size();
+    const auto search_from = previous_size >= delimiter.size() ? previous_size - delimiter.size() + 1 : 0;
+    this->line.append(data, size);
+
+    const auto end = this->line.find(delimiter, search_from);
+    if (end == std::string::npos) {
+        found = false;
+        return size;
+    }
+    found = true;
+    const auto line_size = end + delimiter.size();
+    this->line.resize(line_size);
+    return line_size - previous_size;
+}
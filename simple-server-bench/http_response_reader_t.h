@@ -0,0 +1,126 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_HTTP_RESPONSE_READER_T_H
+#define HTTP_SERVER_HTTP_RESPONSE_READER_T_H
+
+/**
+ * 受信したバイト列から HTTP のレスポンスの区切りを見つける (負荷生成ツールと再生ツール用)
+ *
+ * ボディの中身は見ずに、ステータスと `Content-Length` / `Transfer-Encoding: chunked` /
+ * `Connection: close` だけを読んで、レスポンス1つ分を読み終わったかを判定する。
+ * 長さの分からないボディは、切断されたとき (`finish`) に読み終わったことにする。
+ *
+ * ```
+ * http_response_reader_t reader;
+ * reader.reset(false);
+ * while (offset < size) {
+ *     offset += reader.feed(data + offset, size - offset);
+ *     if (reader.is_failed()) { ... }
+ *     if (reader.is_complete()) { ...; reader.reset(false); }
+ * }
+ * ```
+ */
+class http_response_reader_t {
+public:
+    /**
+     * ヘッダの最大バイト数 (超えたら解析できないことにする)
+     */
+    static const size_t MAX_HEADER_SIZE = 64 * 1024;
+
+    http_response_reader_t();
+
+    /**
+     * 次のレスポンスを読む準備をする
+     * @param [in] is_head HEAD のレスポンス (ボディがない) か
+     */
+    void reset(bool is_head);
+
+    /**
+     * 受信したバイト列を読む (レスポンスの終わりで止まる)
+     * @param [in] data バイト列
+     * @param [in] size バイト数
+     * @return 読んだバイト数 (残りは次のレスポンス)
+     */
+    size_t feed(const char* data, size_t size);
+
+    /**
+     * 切断されたときに呼ぶ
+     * @return 長さの分からないボディを読んでいた場合は、読み終わったことにして `true`
+     */
+    bool finish();
+
+    /**
+     * レスポンスを1つ読み終わったか
+     */
+    [[nodiscard]] inline bool is_complete() const {
+        return this->state == state_t::complete;
+    }
+
+    /**
+     * 解析できなかったか
+     */
+    [[nodiscard]] inline bool is_failed() const {
+        return this->state == state_t::failed;
+    }
+
+    /**
+     * ヘッダを読み始めてから、何か受信したか
+     */
+    [[nodiscard]] inline bool is_started() const {
+        return this->state != state_t::header || !this->line.empty();
+    }
+
+    [[nodiscard]] inline int get_status() const {
+        return this->status;
+    }
+
+    /**
+     * サーバがこのレスポンスの後に接続を閉じるか
+     */
+    [[nodiscard]] inline bool is_close() const {
+        return this->close;
+    }
+
+private:
+    enum class state_t {
+        header,
+        body_length,
+        chunk_size,
+        chunk_data,
+        chunk_trailer,
+        until_close,
+        complete,
+        failed,
+    };
+
+    state_t state;
+
+    bool is_head;
+
+    int status;
+
+    bool close;
+
+    size_t remaining;
+
+    /**
+     * 途中まで受信したヘッダや、チャンクのサイズの行
+     */
+    std::string line;
+
+    /**
+     * ヘッダを解析して、ボディの読み方を決める
+     */
+    bool parse_header(std::string_view header);
+
+    /**
+     * `\r\n` (ヘッダの場合は `\r\n\r\n`) まで `line` に溜める
+     * @return 読んだバイト数. 区切りまで読めた場合は `found` が `true`
+     */
+    size_t read_line(const char* data, size_t size, std::string_view delimiter, bool &found);
+};
+
+
+#endif //HTTP_SERVER_HTTP_RESPONSE_READER_T_H
@@ -0,0 +1,865 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <random>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/prctl.h>
+#include "latency_histogram_t.h"
+#include "http_response_reader_t.h"
+#include "unix_listener_t.h"
+
+/**
+ * サーバに HTTP のリクエストを送り続けて、スループットと処理時間を測る負荷生成ツール
+ *
+ * 1スレッドで epoll を使って、多数の接続を同時に扱う。
+ *
+ * * クローズドループ (`--rate 0`、既定) は、接続毎にレスポンスが返ってきたら次のリクエストを送る
+ * * オープンループ (`--rate N`) は、全体で毎秒 N 件になるように接続毎の送信予定時刻を決めて送る。
+ *   サーバが遅れても予定は遅らせない
+ *
+ * 処理時間は、実際に送った時刻からではなく送る予定だった時刻から数える (coordinated omission の補正)。
+ * サーバが詰まっている間に送れなかったリクエストの待ち時間も処理時間に含めるため。
+ * クローズドループには予定の時刻がないので、HdrHistogram の `recordValueWithExpectedInterval` と同じく、
+ * 想定の間隔 (補正前の中央値) より長かった処理時間について、その間に送れたはずのリクエストの分を補う。
+ * 補正前の値も `uncorrected` として出力する。
+ *
+ * スループット (`throughput_rps`) は 2xx のレスポンスだけを数える。レート制限などで断られた
+ * 429 / 503 は速く返ってくるので、数えるとサーバが速くなったように見えてしまう。
+ * ステータス毎の件数は `status` に、全てのレスポンスの件数は `requests` に出力する。
+ *
+ * ```
+ * $ load-generator --port 12345 --connections 64 --duration 10 --request 'GET /' --request '3*POST /echo hello'
+ * $ load-generator --port 12347 --rate 20000 --pipeline 4 --name asio
+ * $ load-generator --unix @simple-server --name blocking-unix
+ * ```
+ *
+ * 結果は JSON で標準出力に書く。
+ */
+
+namespace {
+    using clock_t = std::chrono::steady_clock;
+
+    /**
+     * 送るリクエストの種類
+     */
+    struct request_template_t {
+        /**
+         * 選ばれる重み
+         */
+        uint32_t weight = 1;
+
+        /**
+         * 送信するバイト列 (HTTP のリクエスト全体)
+         */
+        std::string data;
+
+        /**
+         * HEAD のレスポンスにはボディがない
+         */
+        bool is_head = false;
+    };
+
+    /**
+     * コマンドラインの設定
+     */
+    struct options_t {
+        std::string name;
+
+        std::string host = "127.0.0.1";
+
+        std::string port = "12345";
+
+        /**
+         * Unix ドメインソケットのパス (`@` で始まる場合は抽象名前空間. 指定した場合は host と port は使わない)
+         */
+        std::string unix_path;
+
+        size_t connections = 32;
+
+        std::chrono::milliseconds duration = std::chrono::seconds(10);
+
+        std::chrono::milliseconds warmup = std::chrono::seconds(1);
+
+        /**
+         * 全体の毎秒のリクエスト数 (0 の場合はクローズドループ)
+         */
+        double rate = 0;
+
+        bool keep_alive = true;
+
+        /**
+         * TCP Fast Open で接続する (最初のリクエストを SYN と一緒に送る)
+         */
+        bool fastopen = false;
+
+        /**
+         * 1つの接続でレスポンスを待たずに送るリクエスト数
+         */
+        size_t pipeline = 1;
+
+        std::chrono::milliseconds timeout = std::chrono::seconds(5);
+
+        uint32_t seed = 1;
+
+        /**
+         * `[重み*]メソッド パス [ボディ]` の形式
+         */
+        std::vector<std::string> requests;
+    };
+
+    /**
+     * 送信済みでレスポンスを待っているリクエスト
+     */
+    struct pending_t {
+        /**
+         * 送る予定だった時刻
+         */
+        clock_t::time_point intended;
+
+        /**
+         * 実際に送った時刻
+         */
+        clock_t::time_point sent;
+
+        /**
+         * 送ったリクエストの種類 (送り直すときに同じものを送る)
+         */
+        size_t template_index;
+    };
+
+    struct connection_t {
+        int fd = -1;
+
+        bool connecting = false;
+
+        std::string output;
+
+        size_t output_offset = 0;
+
+        http_response_reader_t reader;
+
+        std::deque<pending_t> pending;
+
+        /**
+         * 接続が切れて、送り直すリクエスト (予定の時刻はそのまま)
+         */
+        std::deque<pending_t> retry;
+
+        /**
+         * オープンループの次の送信予定時刻
+         */
+        clock_t::time_point next_intended;
+
+        /**
+         * 今の接続で送ったリクエスト数 (keep-alive でない場合は1つ送ったら閉じる)
+         */
+        size_t sent_on_connection = 0;
+    };
+
+    /**
+     * 集計
+     */
+    struct result_t {
+        uint64_t completed = 0;
+
+        uint64_t bytes_received = 0;
+
+        std::array<uint64_t, 5> status_classes{};
+
+        uint64_t connect_errors = 0;
+
+        uint64_t read_errors = 0;
+
+        uint64_t timeouts = 0;
+
+        uint64_t parse_errors = 0;
+
+        uint64_t reconnects = 0;
+
+        /**
+         * 測定した時間 (ウォームアップを除く)
+         */
+        std::chrono::nanoseconds elapsed{};
+
+        /**
+         * 予定の時刻から数えた処理時間 (ns)
+         */
+        std::vector<uint64_t> intended_latencies;
+
+        /**
+         * 実際に送った時刻から数えた処理時間 (ns)
+         */
+        std::vector<uint64_t> sent_latencies;
+    };
+
+    void print_usage(const char* program) {
+        std::cerr << "usage: " << program << " [options]\n"
+                  << "  --name NAME            結果に付ける名前\n"
+                  << "  --host HOST            接続先 (既定 127.0.0.1)\n"
+                  << "  --port PORT            ポート (既定 12345)\n"
+                  << "  --unix PATH            Unix ドメインソケットに接続する (@ で始まる場合は抽象名前空間)\n"
+                  << "  --connections N        同時接続数 (既定 32)\n"
+                  << "  --duration SECONDS     測定する時間 (既定 10)\n"
+                  << "  --warmup SECONDS       測定前に捨てる時間 (既定 1)\n"
+                  << "  --rate N               毎秒のリクエスト数 (0 はクローズドループ、既定 0)\n"
+                  << "  --pipeline N           レスポンスを待たずに送る数 (既定 1)\n"
+                  << "  --no-keep-alive        1リクエスト毎に接続し直す\n"
+                  << "  --fastopen             TCP Fast Open で接続する (サーバの SIMPLE_SERVER_TCP_FASTOPEN と組み合わせる)\n"
+                  << "  --timeout SECONDS      レスポンスを待つ時間 (既定 5)\n"
+                  << "  --seed N               リクエストを選ぶ乱数の種\n"
+                  << "  --request SPEC         '[重み*]メソッド パス [ボディ]' (複数指定可、既定 'GET /')\n";
+    }
+
+    std::chrono::milliseconds parse_seconds(const std::string &value) {
+        return std::chrono::milliseconds(static_cast<int64_t>(std::stod(value) * 1000));
+    }
+
+    bool parse_options(int argc, char* argv[], options_t &options) {
+        for (int i = 1; i < argc; i++) {
+            const std::string_view arg(argv[i]);
+            const auto next = [&]() -> std::string {
+                if (i + 1 >= argc) {
+                    throw std::invalid_argument(std::string(arg) + " には値が必要です。");
+                }
+                return argv[++i];
+            };
+
+            if (arg == "--name") {
+                options.name = next();
+            } else if (arg == "--host") {
+                options.host = next();
+            } else if (arg == "--port") {
+                options.port = next();
+            } else if (arg == "--unix") {
+                options.unix_path = next();
+            } else if (arg == "--connections") {
+                options.connections = std::max<size_t>(std::stoul(next()), 1);
+            } else if (arg == "--duration") {
+                options.duration = parse_seconds(next());
+            } else if (arg == "--warmup") {
+                options.warmup = parse_seconds(next());
+            } else if (arg == "--rate") {
+                options.rate = std::stod(next());
+            } else if (arg == "--pipeline") {
+                options.pipeline = std::max<size_t>(std::stoul(next()), 1);
+            } else if (arg == "--no-keep-alive") {
+                options.keep_alive = false;
+            } else if (arg == "--keep-alive") {
+                options.keep_alive = true;
+            } else if (arg == "--fastopen") {
+                options.fastopen = true;
+            } else if (arg == "--timeout") {
+                options.timeout = parse_seconds(next());
+            } else if (arg == "--seed") {
+                options.seed = static_cast<uint32_t>(std::stoul(next()));
+            } else if (arg == "--request") {
+                options.requests.push_back(next());
+            } else {
+                return false;
+            }
+        }
+        if (options.requests.empty()) {
+            options.requests.emplace_back("GET /");
+        }
+        // 接続し直す場合は、1つの接続で1つしか送れない
+        if (!options.keep_alive) {
+            options.pipeline = 1;
+        }
+        return true;
+    }
+
+    request_template_t make_request_template(const std::string &spec, const options_t &options) {
+        request_template_t result;
+
+        std::string rest = spec;
+        const auto star = rest.find('*');
+        const auto space = rest.find(' ');
+        if (star != std::string::npos && star < space) {
+            result.weight = static_cast<uint32_t>(std::stoul(rest.substr(0, star)));
+            rest = rest.substr(star + 1);
+        }
+
+        std::istringstream stream(rest);
+        std::string method;
+        std::string path;
+        stream >> method >> path;
+        if (method.empty() || path.empty()) {
+            throw std::invalid_argument("リクエストの指定が正しくありません: " + spec);
+        }
+        std::string body;
+        std::getline(stream >> std::ws, body);
+
+        result.is_head = method == "HEAD";
+        result.data = method + " " + path + " HTTP/1.1\r\n"
+                      + "Host: " + options.host + ":" + options.port + "\r\n"
+                      + "User-Agent: simple-server-load-generator\r\n"
+                      + (options.keep_alive ? "" : "Connection: close\r\n");
+        if (!body.empty() || method == "POST" || method == "PUT") {
+            result.data += "Content-Type: text/plain\r\n"
+                           "Content-Length: " + std::to_string(body.size()) + "\r\n";
+        }
+        result.data += "\r\n" + body;
+        return result;
+    }
+
+    /**
+     * 負荷を掛ける
+     */
+    class load_generator_t {
+    public:
+        load_generator_t(const options_t &options, std::vector<request_template_t> &&templates)
+            : options(options),
+              templates(std::move(templates)),
+              connections(options.connections),
+              random(options.seed),
+              epoll_fd(epoll_create1(EPOLL_CLOEXEC)) {
+            if (this->epoll_fd == -1) {
+                throw std::system_error(errno, std::generic_category(), "epoll_create1");
+            }
+
+            std::vector<uint32_t> weights;
+            for (const auto &request_template : this->templates) {
+                weights.push_back(request_template.weight);
+            }
+            this->choose = std::discrete_distribution<size_t>(weights.begin(), weights.end());
+
+            if (!options.unix_path.empty()) {
+                sockaddr_un addr{};
+                this->address_length = unix_listener_t::make_address(options.unix_path, addr);
+                if (this->address_length == 0) {
+                    throw std::invalid_argument("Unix ドメインソケットのパスが不正です: " + options.unix_path);
+                }
+                std::memcpy(&this->address, &addr, this->address_length);
+                return;
+            }
+
+            addrinfo hints{};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            addrinfo* found = nullptr;
+            const auto error = getaddrinfo(options.host.c_str(), options.port.c_str(), &hints, &found);
+            if (error != 0) {
+                throw std::runtime_error(std::string("getaddrinfo: ") + gai_strerror(error));
+            }
+            std::memcpy(&this->address, found->ai_addr, found->ai_addrlen);
+            this->address_length = found->ai_addrlen;
+            freeaddrinfo(found);
+        }
+
+        ~load_generator_t() {
+            for (auto &connection : this->connections) {
+                if (connection.fd != -1) {
+                    close(connection.fd);
+                }
+            }
+            close(this->epoll_fd);
+        }
+
+        load_generator_t(const load_generator_t &) = delete;
+
+        load_generator_t &operator=(const load_generator_t &) = delete;
+
+        result_t run() {
+            const auto started = clock_t::now();
+            this->measure_from = started + this->options.warmup;
+            const auto finish_at = this->measure_from + this->options.duration;
+
+            // オープンループの場合は、接続毎の送信予定を少しずつずらして、同時に送らないようにする
+            if (this->is_open_loop()) {
+                this->interval = std::chrono::duration_cast<clock_t::duration>(
+                    std::chrono::duration<double>(static_cast<double>(this->connections.size()) / this->options.rate)
+                );
+                for (size_t i = 0; i < this->connections.size(); i++) {
+                    this->connections[i].next_intended = started + this->interval * i / this->connections.size();
+                }
+            }
+
+            for (auto &connection : this->connections) {
+                this->open(connection);
+            }
+
+            // オープンループは送信予定時刻にマイクロ秒単位で起きたいので、タイマーの遅延 (既定 50us) を詰める
+            if (this->is_open_loop()) {
+                prctl(PR_SET_TIMERSLACK, 1UL);
+            }
+
+            std::array<epoll_event, 256> events{};
+            while (true) {
+                const auto now = clock_t::now();
+                if (now >= finish_at) {
+                    break;
+                }
+
+                for (auto &connection : this->connections) {
+                    this->send_requests(connection, now);
+                    this->check_timeout(connection, now);
+                }
+
+                const auto count = this->wait(events, this->get_wait(now));
+                if (count == -1) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw std::system_error(errno, std::generic_category(), "epoll_wait");
+                }
+                for (int i = 0; i < count; i++) {
+                    auto &connection = this->connections[events[i].data.u64];
+                    this->handle_event(connection, events[i].events);
+                }
+            }
+
+            this->result.elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(clock_t::now() - this->measure_from);
+            return std::move(this->result);
+        }
+
+        [[nodiscard]] bool is_open_loop() const {
+            return this->options.rate > 0;
+        }
+
+    private:
+        const options_t &options;
+
+        std::vector<request_template_t> templates;
+
+        std::vector<connection_t> connections;
+
+        std::mt19937 random;
+
+        std::discrete_distribution<size_t> choose;
+
+        int epoll_fd;
+
+        /**
+         * epoll_pwait2 が使えるか (ENOSYS が返ったら epoll_wait にする)
+         */
+        bool has_epoll_pwait2 = true;
+
+        sockaddr_storage address{};
+
+        socklen_t address_length = 0;
+
+        clock_t::time_point measure_from;
+
+        /**
+         * オープンループの接続毎の送信間隔
+         */
+        clock_t::duration interval{};
+
+        result_t result;
+
+        [[nodiscard]] size_t get_index(const connection_t &connection) const {
+            return static_cast<size_t>(&connection - this->connections.data());
+        }
+
+        void open(connection_t &connection) {
+            connection.fd = socket(this->address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (connection.fd == -1) {
+                throw std::system_error(errno, std::generic_category(), "socket");
+            }
+            if (this->address.ss_family != AF_UNIX) {
+                const int on = 1;
+                setsockopt(connection.fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                // connect はすぐに返り、最初の send で SYN と一緒にリクエストを送る
+                // (サーバのクッキーがまだない場合は、普通の接続になる)
+                if (this->options.fastopen) {
+                    setsockopt(connection.fd, IPPROTO_TCP, TCP_FASTOPEN_CONNECT, &on, sizeof(on));
+                }
+            }
+
+            connection.connecting = true;
+            connection.output.clear();
+            connection.output_offset = 0;
+            connection.reader.reset(false);
+            connection.sent_on_connection = 0;
+
+            if (connect(connection.fd, reinterpret_cast<const sockaddr*>(&this->address), this->address_length) == 0) {
+                connection.connecting = false;
+            } else if (errno != EINPROGRESS) {
+                this->result.connect_errors++;
+            }
+
+            epoll_event event{};
+            event.events = EPOLLIN | EPOLLOUT;
+            event.data.u64 = this->get_index(connection);
+            epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, connection.fd, &event);
+        }
+
+        /**
+         * 接続を閉じて開き直す (レスポンスが返ってこなかったリクエストは送り直す)
+         */
+        void reopen(connection_t &connection) {
+            epoll_ctl(this->epoll_fd, EPOLL_CTL_DEL, connection.fd, nullptr);
+            close(connection.fd);
+            connection.fd = -1;
+            while (!connection.pending.empty()) {
+                connection.retry.push_front(connection.pending.back());
+                connection.pending.pop_back();
+            }
+            this->result.reconnects++;
+            this->open(connection);
+        }
+
+        void send_requests(connection_t &connection, clock_t::time_point now) {
+            if (connection.connecting) {
+                return;
+            }
+            const auto limit = this->options.keep_alive ? SIZE_MAX : 1;
+            bool added = false;
+            while (connection.pending.size() < this->options.pipeline && connection.sent_on_connection < limit) {
+                pending_t pending{now, now, 0};
+                if (!connection.retry.empty()) {
+                    pending.intended = connection.retry.front().intended;
+                    pending.template_index = connection.retry.front().template_index;
+                    connection.retry.pop_front();
+                } else {
+                    if (this->is_open_loop()) {
+                        if (connection.next_intended > now) {
+                            break;
+                        }
+                        pending.intended = connection.next_intended;
+                        connection.next_intended += this->interval;
+                    }
+                    pending.template_index = this->choose(this->random);
+                }
+                connection.output.append(this->templates[pending.template_index].data);
+                connection.pending.push_back(pending);
+                connection.sent_on_connection++;
+                added = true;
+            }
+            if (added) {
+                this->flush(connection);
+            }
+        }
+
+        void check_timeout(connection_t &connection, clock_t::time_point now) {
+            if (connection.pending.empty() || now - connection.pending.front().sent < this->options.timeout) {
+                return;
+            }
+            // 返ってこないリクエストは送り直さずに捨てる
+            this->result.timeouts += connection.pending.size();
+            connection.pending.clear();
+            this->reopen(connection);
+        }
+
+        /**
+         * 次に送る予定の時刻までの時間 (クローズドループの場合は、タイムアウトを確かめる間隔)
+         */
+        [[nodiscard]] clock_t::duration get_wait(clock_t::time_point now) const {
+            if (!this->is_open_loop()) {
+                return std::chrono::milliseconds(10);
+            }
+            auto next = now + std::chrono::milliseconds(10);
+            for (const auto &connection : this->connections) {
+                if (!connection.connecting && connection.pending.size() < this->options.pipeline) {
+                    next = std::min(next, connection.next_intended);
+                }
+            }
+            return std::max(next - now, clock_t::duration::zero());
+        }
+
+        /**
+         * イベントを待つ
+         *
+         * epoll_wait はミリ秒単位でしか待てず、1ms 未満の待ちを 1ms に切り上げると、
+         * その分だけ送信が遅れてサーバの処理時間に数えてしまう。epoll_pwait2 でナノ秒単位で待つ
+         * (epoll_pwait2 がないカーネルでは epoll_wait で、1ms 未満はその場で回って待つ)。
+         */
+        int wait(std::array<epoll_event, 256> &events, clock_t::duration timeout) {
+            const auto max_events = static_cast<int>(events.size());
+            if (this->has_epoll_pwait2) {
+                const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(timeout).count();
+                const timespec spec{static_cast<time_t>(ns / 1000000000), static_cast<long>(ns % 1000000000)};
+                const auto count = epoll_pwait2(this->epoll_fd, events.data(), max_events, &spec, nullptr);
+                if (count != -1 || errno != ENOSYS) {
+                    return count;
+                }
+                this->has_epoll_pwait2 = false;
+            }
+            const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(timeout).count();
+            return epoll_wait(this->epoll_fd, events.data(), max_events, static_cast<int>(ms));
+        }
+
+        void handle_event(connection_t &connection, uint32_t events) {
+            if (connection.connecting && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+                int error = 0;
+                socklen_t length = sizeof(error);
+                getsockopt(connection.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+                if (error != 0) {
+                    this->result.connect_errors++;
+                    this->reopen(connection);
+                    return;
+                }
+                connection.connecting = false;
+                this->update_events(connection);
+                this->send_requests(connection, clock_t::now());
+                return;
+            }
+            if (events & EPOLLOUT) {
+                this->flush(connection);
+            }
+            if (events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                this->receive(connection);
+            }
+        }
+
+        void update_events(connection_t &connection) {
+            epoll_event event{};
+            event.events = EPOLLIN;
+            if (connection.output_offset < connection.output.size()) {
+                event.events |= EPOLLOUT;
+            }
+            event.data.u64 = this->get_index(connection);
+            epoll_ctl(this->epoll_fd, EPOLL_CTL_MOD, connection.fd, &event);
+        }
+
+        void flush(connection_t &connection) {
+            while (connection.output_offset < connection.output.size()) {
+                const auto sent = send(
+                    connection.fd,
+                    connection.output.data() + connection.output_offset,
+                    connection.output.size() - connection.output_offset,
+                    MSG_NOSIGNAL
+                );
+                if (sent == -1) {
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                        break;
+                    }
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    // 相手が先に閉じた. 読み込み側で切断を処理する
+                    connection.output_offset = connection.output.size();
+                    break;
+                }
+                connection.output_offset += static_cast<size_t>(sent);
+            }
+            if (connection.output_offset == connection.output.size()) {
+                connection.output.clear();
+                connection.output_offset = 0;
+            }
+            this->update_events(connection);
+        }
+
+        void receive(connection_t &connection) {
+            std::array<char, 16384> buffer{};
+            while (true) {
+                const auto received = recv(connection.fd, buffer.data(), buffer.size(), 0);
+                if (received > 0) {
+                    this->count_bytes(static_cast<size_t>(received));
+                    if (!this->parse(connection, buffer.data(), static_cast<size_t>(received))) {
+                        this->result.parse_errors++;
+                        connection.pending.clear();
+                        this->reopen(connection);
+                        return;
+                    }
+                    if (connection.fd == -1 || connection.connecting) {
+                        return;
+                    }
+                    continue;
+                }
+                if (received == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    return;
+                }
+                if (received == -1 && errno == EINTR) {
+                    continue;
+                }
+
+                // 切断された. 長さの分からないボディはここで終わり
+                // (レスポンスを返した後にサーバが閉じた接続に、次のリクエストを送ってしまった場合は、送り直すだけでエラーにしない.
+                //  Unix ドメインソケットでは、読まれなかったリクエストが残ったまま閉じられると ECONNRESET になる)
+                const auto is_keep_alive_race = received == -1 && errno == ECONNRESET
+                                                && connection.sent_on_connection > connection.pending.size();
+                if (!connection.pending.empty() && connection.reader.finish()) {
+                    this->complete(connection);
+                } else if (received == -1 && !connection.pending.empty() && !is_keep_alive_race) {
+                    this->result.read_errors++;
+                }
+                this->reopen(connection);
+                return;
+            }
+        }
+
+        /**
+         * 受信した分を読み進める
+         * @return 解析できない場合は `false`
+         */
+        bool parse(connection_t &connection, const char* data, size_t size) {
+            size_t offset = 0;
+            while (offset < size) {
+                // 頼んでいないレスポンス
+                if (connection.pending.empty()) {
+                    return false;
+                }
+                auto &reader = connection.reader;
+                if (!reader.is_started() || reader.is_complete()) {
+                    reader.reset(this->templates[connection.pending.front().template_index].is_head);
+                }
+
+                offset += reader.feed(data + offset, size - offset);
+                if (reader.is_failed()) {
+                    return false;
+                }
+                if (reader.is_complete() && !this->complete(connection)) {
+                    return true;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * レスポンスを1つ受信し終わった
+         * @return 同じ接続で読み続ける場合は `true` (閉じて開き直した場合は `false`)
+         */
+        bool complete(connection_t &connection) {
+            const auto now = clock_t::now();
+            const auto pending = connection.pending.front();
+            connection.pending.pop_front();
+
+            if (now >= this->measure_from) {
+                auto &data = this->result;
+                data.completed++;
+                data.status_classes[std::clamp(connection.reader.get_status() / 100, 1, 5) - 1]++;
+                data.intended_latencies.push_back(static_cast<uint64_t>((now - pending.intended).count()));
+                data.sent_latencies.push_back(static_cast<uint64_t>((now - pending.sent).count()));
+            }
+
+            // サーバが閉じると言った場合や、keep-alive でない場合は開き直す
+            if (connection.reader.is_close() || !this->options.keep_alive) {
+                this->reopen(connection);
+                return false;
+            }
+            this->send_requests(connection, now);
+            return true;
+        }
+
+        void count_bytes(size_t bytes) {
+            if (clock_t::now() >= this->measure_from) {
+                this->result.bytes_received += bytes;
+            }
+        }
+    };
+
+    /**
+     * 処理時間の分布を JSON で書く (単位はマイクロ秒)
+     */
+    void write_latency_json(std::ostream &out, const latency_histogram_t &histogram, uint64_t max_ns) {
+        const auto snapshot = histogram.get_snapshot();
+        // パーセンタイルはバケットの上限なので、実際の最大値を超えないようにする
+        const auto to_us = [max_ns](uint64_t ns) {
+            return static_cast<double>(std::min(ns, max_ns)) / 1000.0;
+        };
+        out << "{\"count\":" << snapshot.count
+            << ",\"mean\":" << (snapshot.count == 0 ? 0.0 : static_cast<double>(snapshot.sum_ns) / 1000.0 / static_cast<double>(snapshot.count))
+            << ",\"p50\":" << to_us(snapshot.get_value_at_percentile(50))
+            << ",\"p90\":" << to_us(snapshot.get_value_at_percentile(90))
+            << ",\"p99\":" << to_us(snapshot.get_value_at_percentile(99))
+            << ",\"p99.9\":" << to_us(snapshot.get_value_at_percentile(99.9))
+            << ",\"p99.99\":" << to_us(snapshot.get_value_at_percentile(99.99))
+            << ",\"max\":" << to_us(max_ns)
+            << "}";
+    }
+
+    std::string escape_json(const std::string &value) {
+        std::string escaped;
+        for (const auto c : value) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    options_t options;
+    std::vector<request_template_t> templates;
+    try {
+        if (!parse_options(argc, argv, options)) {
+            print_usage(argv[0]);
+            return 2;
+        }
+        for (const auto &spec : options.requests) {
+            templates.push_back(make_request_template(spec, options));
+        }
+    } catch (const std::exception &ex) {
+        std::cerr << ex.what() << std::endl;
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    load_generator_t generator(options, std::move(templates));
+    const auto result = generator.run();
+    const auto elapsed_s = std::chrono::duration<double>(result.elapsed).count();
+
+    // 補正前: 実際に送った時刻から
+    latency_histogram_t uncorrected;
+    uint64_t uncorrected_max = 0;
+    for (const auto value : result.sent_latencies) {
+        uncorrected.record(std::chrono::nanoseconds(value));
+        uncorrected_max = std::max(uncorrected_max, value);
+    }
+
+    // 補正後: オープンループは予定の時刻から. クローズドループは想定の間隔で補う
+    latency_histogram_t corrected;
+    uint64_t corrected_max = 0;
+    uint64_t expected_interval = 0;
+    if (generator.is_open_loop()) {
+        for (const auto value : result.intended_latencies) {
+            corrected.record(std::chrono::nanoseconds(value));
+            corrected_max = std::max(corrected_max, value);
+        }
+    } else {
+        expected_interval = uncorrected.get_snapshot().get_value_at_percentile(50);
+        for (const auto value : result.sent_latencies) {
+            corrected.record(std::chrono::nanoseconds(value));
+            corrected_max = std::max(corrected_max, value);
+            if (expected_interval == 0) {
+                continue;
+            }
+            for (auto missing = value - std::min(value, expected_interval); missing >= expected_interval; missing -= expected_interval) {
+                corrected.record(std::chrono::nanoseconds(missing));
+            }
+        }
+    }
+
+    const char* status_names[] = {"1xx", "2xx", "3xx", "4xx", "5xx"};
+    // スループットは 2xx だけ (断られたレスポンスは数えない)
+    const auto successes = result.status_classes[1];
+
+    std::ostringstream out;
+    out << "{\"name\":\"" << escape_json(options.name) << "\""
+        << ",\"target\":\"" << escape_json(options.unix_path.empty() ? options.host + ":" + options.port : "unix:" + options.unix_path) << "\""
+        << ",\"mode\":\"" << (generator.is_open_loop() ? "open" : "closed") << "\""
+        << ",\"connections\":" << options.connections
+        << ",\"pipeline\":" << options.pipeline
+        << ",\"keep_alive\":" << (options.keep_alive ? "true" : "false")
+        << ",\"rate\":" << options.rate
+        << ",\"duration_s\":" << elapsed_s
+        << ",\"requests\":" << result.completed
+        << ",\"throughput_rps\":" << (elapsed_s > 0 ? static_cast<double>(successes) / elapsed_s : 0.0)
+        << ",\"bytes_received\":" << result.bytes_received
+        << ",\"status\":{";
+    for (size_t i = 0; i < result.status_classes.size(); i++) {
+        out << (i == 0 ? "" : ",") << "\"" << status_names[i] << "\":" << result.status_classes[i];
+    }
+    out << "},\"errors\":{\"connect\":" << result.connect_errors
+        << ",\"read\":" << result.read_errors
+        << ",\"timeout\":" << result.timeouts
+        << ",\"parse\":" << result.parse_errors
+        << "},\"reconnects\":" << result.reconnects
+        << ",\"expected_interval_us\":" << static_cast<double>(expected_interval) / 1000.0
+        << ",\"latency_us\":{\"corrected\":";
+    write_latency_json(out, corrected, corrected_max);
+    out << ",\"uncorrected\":";
+    write_latency_json(out, uncorrected, uncorrected_max);
+    out << "}}";
+
+    std::cout << out.str() << std::endl;
+    return 0;
+}
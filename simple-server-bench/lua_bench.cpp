@@ -0,0 +1,123 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <benchmark/benchmark.h>
+#include "http_request_t.h"
+#include "multipart_form_t.h"
+#include "lua_request_table_t.h"
+#include "allocation_counter.h"
+
+extern "C" {
+#include <lua/lauxlib.h>
+}
+
+/**
+ * リクエストを Lua のテーブルにする (`lua_request_table_t::push`) コストを測る
+ *
+ * Lua の状態は最初に1つだけ作り、テーブルを積んで捨てるのを繰り返す。
+ * リクエストのバイト数 (`bytes_per_second`) と、1回あたりの
+ *
+ * * `allocs/op` C++ 側の new の回数
+ * * `lua_allocs/op` Lua のアロケータで確保した回数 (テーブルと文字列)
+ *
+ * を出す。
+ */
+
+namespace {
+    std::atomic<uint64_t> g_lua_allocation_count(0);
+
+    /**
+     * 確保した回数を数える Lua のアロケータ (`luaL_newstate` の既定と同じく realloc / free を使う)
+     */
+    void* counting_lua_alloc(void*, void* pointer, size_t, size_t new_size) {
+        if (new_size == 0) {
+            std::free(pointer);
+            return nullptr;
+        }
+        g_lua_allocation_count.fetch_add(1, std::memory_order_relaxed);
+        return std::realloc(pointer, new_size);
+    }
+
+    std::string make_request_text(size_t header_count, size_t body_size) {
+        std::string text = "POST /request_handler HTTP/1.1\r\n";
+        text += "Host: localhost:12348\r\n";
+        for (size_t i = 1; i < header_count; i++) {
+            text += "X-Custom-Header-" + std::to_string(i) + ": value-" + std::to_string(i * 7919) + "\r\n";
+        }
+        text += "Content-Length: " + std::to_string(body_size) + "\r\n\r\n";
+        text.append(body_size, 'x');
+        return text;
+    }
+
+    std::string make_multipart_text(size_t part_count) {
+        const std::string boundary = "----simple-server-boundary";
+        std::string body;
+        for (size_t i = 0; i < part_count; i++) {
+            body += "--" + boundary + "\r\n";
+            body += "Content-Disposition: form-data; name=\"field" + std::to_string(i) + "\"; filename=\"file" + std::to_string(i) + ".txt\"\r\n";
+            body += "Content-Type: text/plain\r\n\r\n";
+            body += std::string(256, static_cast<char>('a' + i % 26)) + "\r\n";
+        }
+        body += "--" + boundary + "--\r\n";
+
+        return "POST /upload HTTP/1.1\r\n"
+               "Host: localhost:12348\r\n"
+               "Content-Type: multipart/form-data; boundary=" + boundary + "\r\n"
+               "Content-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+    }
+
+    void run(benchmark::State &state, const http_request_t &request, const multipart_form_t &form, size_t request_size) {
+        lua_State* L = lua_newstate(counting_lua_alloc, nullptr);
+
+        uint64_t allocations = 0;
+        uint64_t lua_allocations = 0;
+        for (auto _ : state) {
+            const auto before = get_allocation_count();
+            const auto lua_before = g_lua_allocation_count.load(std::memory_order_relaxed);
+            lua_request_table_t::push(L, request, form);
+            lua_settop(L, 0);
+            allocations += get_allocation_count() - before;
+            lua_allocations += g_lua_allocation_count.load(std::memory_order_relaxed) - lua_before;
+        }
+        lua_close(L);
+
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * request_size));
+        report_allocations(state, allocations);
+        report_allocations(state, lua_allocations, "lua_allocs/op");
+    }
+
+    /**
+     * 引数: ヘッダの数, ボディのバイト数
+     */
+    void BM_lua_request_table(benchmark::State &state) {
+        const auto text = make_request_text(static_cast<size_t>(state.range(0)), static_cast<size_t>(state.range(1)));
+        http_request_t request;
+        request.add_bytes(text.data(), text.size());
+        multipart_form_t form;
+        run(state, request, form, text.size());
+    }
+    BENCHMARK(BM_lua_request_table)
+        ->ArgNames({"headers", "body"})
+        ->ArgsProduct({{4, 32}, {0, 4096, 65536}});
+
+    /**
+     * 引数: パートの数
+     */
+    void BM_lua_request_table_multipart(benchmark::State &state) {
+        const auto text = make_multipart_text(static_cast<size_t>(state.range(0)));
+        multipart_form_t form;
+        http_request_t request;
+        request.set_header_handler([&form](http_request_t &parsed_request) {
+            form.attach(parsed_request);
+        });
+        request.add_bytes(text.data(), text.size());
+        run(state, request, form, text.size());
+    }
+    BENCHMARK(BM_lua_request_table_multipart)
+        ->ArgName("parts")
+        ->Arg(1)->Arg(8);
+}
+
+BENCHMARK_MAIN();
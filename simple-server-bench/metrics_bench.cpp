@@ -0,0 +1,59 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <benchmark/benchmark.h>
+#include "latency_histogram_t.h"
+#include "server_metrics_t.h"
+
+/**
+ * メトリクスを記録するコストを測る (目標は 1 件 50ns 未満)
+ *
+ * * ヒストグラムに値を1件記録する
+ * * カウンタを増やす
+ * * 処理段階のタイマー (時刻の取得2回 + 記録)
+ *
+ * スレッド数を変えて、別スレッドの記録と互いに邪魔しないことも確認する。
+ */
+
+namespace {
+    latency_histogram_t g_histogram;
+
+    sharded_counter_t g_counter;
+
+    void BM_histogram_record(benchmark::State &state) {
+        int64_t value = 1000 + state.thread_index() * 7;
+        for (auto _ : state) {
+            g_histogram.record(std::chrono::nanoseconds(value));
+            value = (value * 13 + 17) & 0xFFFFFF;
+        }
+    }
+    BENCHMARK(BM_histogram_record)->ThreadRange(1, 8);
+
+    void BM_counter_add(benchmark::State &state) {
+        for (auto _ : state) {
+            g_counter.add(64);
+        }
+    }
+    BENCHMARK(BM_counter_add)->ThreadRange(1, 8);
+
+    void BM_stage_timer(benchmark::State &state) {
+        auto &metrics = server_metrics_t::get_default();
+        for (auto _ : state) {
+            server_metrics_t::stage_timer_t timer(metrics, server_metrics_t::stage_t::handler);
+            benchmark::ClobberMemory();
+        }
+    }
+    BENCHMARK(BM_stage_timer)->ThreadRange(1, 8);
+
+    void BM_to_prometheus(benchmark::State &state) {
+        auto &metrics = server_metrics_t::get_default();
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(metrics.to_prometheus());
+        }
+    }
+    BENCHMARK(BM_to_prometheus);
+}
+
+BENCHMARK_MAIN();
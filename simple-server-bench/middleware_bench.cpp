@@ -0,0 +1,105 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <benchmark/benchmark.h>
+#include "http_request_t.h"
+#include "http_response_t.h"
+#include "middleware_pipeline_t.h"
+
+/**
+ * ミドルウェアのパイプラインのオーバーヘッドを測る
+ *
+ * 5段のミドルウェアを
+ *
+ * * 直接呼ぶ (ミドルウェアの処理を手で書いた場合)
+ * * コンパイル時のパイプライン (`middleware_pipeline_t`)
+ * * 型消去したパイプライン (`dynamic_middleware_stage_t`)
+ *
+ * で実行して比べる。段の処理はカウンタを増やすだけにして、呼び出しのコストだけが見えるようにする。
+ */
+
+namespace {
+    /**
+     * リクエスト側とレスポンス側でカウンタを増やすだけの段
+     */
+    struct counting_stage_t {
+        uint64_t* counter;
+
+        template<typename Next>
+        inline void handle(const http_request_t &, http_response_t &, Next &&next) {
+            (*this->counter)++;
+            next();
+            (*this->counter)++;
+        }
+    };
+
+    void handle_request(const http_request_t &, http_response_t &response) {
+        benchmark::DoNotOptimize(&response);
+    }
+
+    http_request_t make_request() {
+        http_request_t request;
+        request.add_bytes("GET /health HTTP/1.1\r\nHost: localhost\r\n\r\n");
+        return request;
+    }
+}
+
+static void BM_direct(benchmark::State &state) {
+    const auto request = make_request();
+    http_response_t response;
+    uint64_t counter = 0;
+
+    for (auto _ : state) {
+        for (int i = 0; i < 5; i++) {
+            counter++;
+        }
+        handle_request(request, response);
+        for (int i = 0; i < 5; i++) {
+            counter++;
+        }
+        benchmark::DoNotOptimize(counter);
+    }
+}
+BENCHMARK(BM_direct);
+
+static void BM_static_pipeline(benchmark::State &state) {
+    const auto request = make_request();
+    http_response_t response;
+    uint64_t counter = 0;
+
+    auto pipeline = make_middleware_pipeline(
+        counting_stage_t{&counter},
+        counting_stage_t{&counter},
+        counting_stage_t{&counter},
+        counting_stage_t{&counter},
+        counting_stage_t{&counter}
+    );
+
+    for (auto _ : state) {
+        pipeline(request, response, handle_request);
+        benchmark::DoNotOptimize(counter);
+    }
+}
+BENCHMARK(BM_static_pipeline);
+
+static void BM_dynamic_pipeline(benchmark::State &state) {
+    const auto request = make_request();
+    http_response_t response;
+    uint64_t counter = 0;
+
+    dynamic_middleware_stage_t dynamic_stage;
+    for (int i = 0; i < 5; i++) {
+        dynamic_stage.add_stage(counting_stage_t{&counter});
+    }
+    auto pipeline = make_middleware_pipeline(std::move(dynamic_stage));
+
+    for (auto _ : state) {
+        pipeline(request, response, handle_request);
+        benchmark::DoNotOptimize(counter);
+    }
+}
+BENCHMARK(BM_dynamic_pipeline);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,641 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <fstream>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "latency_histogram_t.h"
+#include "request_capture_t.h"
+#include "http_response_reader_t.h"
+
+/**
+ * `request_capture_t` で記録したトレースを、記録したときと同じ間隔でサーバに送り直す
+ *
+ * 1スレッドで epoll を使う。リクエスト毎に接続し (サーバは1つのレスポンスを返すと閉じるため)、
+ * 記録したバイト列をそのまま送る。
+ *
+ * * `--speed 1` (既定) は記録したときの間隔で、`--speed 2` は2倍の速さで送る
+ * * `--speed 0` は間隔を空けずに、同時接続数 (`--max-connections`) の上限まで詰めて送る
+ *
+ * 処理時間は load-generator と同じく、送る予定だった時刻から数える (coordinated omission の補正)。
+ * 同時接続数の上限で送れずに待った時間も含む。実際に送った時刻から数えた値も `uncorrected` として出力する。
+ *
+ * ```
+ * $ SIMPLE_SERVER_CAPTURE_PATH=/tmp/trace.bin simple-server-01
+ * $ replay /tmp/trace.bin --port 12347 --speed 2 --output /tmp/replay.csv
+ * ```
+ *
+ * 結果の概要は JSON で標準出力に、リクエスト毎の結果は `--output` に CSV で書く。
+ */
+
+namespace {
+    using clock_t = std::chrono::steady_clock;
+
+    /**
+     * コマンドラインの設定
+     */
+    struct options_t {
+        std::string trace_path;
+
+        std::string name;
+
+        std::string host = "127.0.0.1";
+
+        std::string port = "12345";
+
+        /**
+         * 記録したときの何倍の速さで送るか (0 の場合は間隔を空けない)
+         */
+        double speed = 1;
+
+        /**
+         * 送るリクエスト数の上限 (0 の場合は全て)
+         */
+        size_t limit = 0;
+
+        size_t max_connections = 256;
+
+        std::chrono::milliseconds timeout = std::chrono::seconds(5);
+
+        /**
+         * リクエスト毎の結果を書く CSV (空の場合は書かない)
+         */
+        std::string output_path;
+    };
+
+    /**
+     * トレースの1レコード (mmap した領域を指す)
+     */
+    struct record_t {
+        std::string_view data;
+
+        uint32_t connection_id;
+
+        uint64_t arrival_ns;
+    };
+
+    /**
+     * リクエスト毎の結果
+     */
+    struct outcome_t {
+        /**
+         * 最初のリクエストを送る予定だった時刻から、このリクエストを送る予定の時刻まで
+         */
+        clock_t::duration scheduled_offset{};
+
+        /**
+         * 送る予定だった時刻からレスポンスを受信し終わるまで
+         */
+        clock_t::duration latency{};
+
+        /**
+         * 実際に送った時刻からレスポンスを受信し終わるまで
+         */
+        clock_t::duration service_time{};
+
+        /**
+         * ステータスコード (レスポンスを受信できなかった場合は 0)
+         */
+        int status = 0;
+
+        size_t bytes_received = 0;
+
+        /**
+         * 失敗した理由 (成功した場合は空)
+         */
+        const char* error = "";
+    };
+
+    /**
+     * 送信中のリクエスト
+     */
+    struct in_flight_t {
+        int fd = -1;
+
+        size_t index = 0;
+
+        clock_t::time_point scheduled;
+
+        clock_t::time_point sent;
+
+        size_t output_offset = 0;
+
+        bool connecting = false;
+
+        http_response_reader_t reader;
+    };
+
+    void print_usage(const char* program) {
+        std::cerr << "usage: " << program << " TRACE [options]\n"
+                  << "  --name NAME            結果に付ける名前\n"
+                  << "  --host HOST            接続先 (既定 127.0.0.1)\n"
+                  << "  --port PORT            ポート (既定 12345)\n"
+                  << "  --speed X              記録したときの X 倍の速さで送る (0 は間隔を空けない、既定 1)\n"
+                  << "  --limit N              送るリクエスト数の上限 (既定 全て)\n"
+                  << "  --max-connections N    同時接続数の上限 (既定 256)\n"
+                  << "  --timeout SECONDS      レスポンスを待つ時間 (既定 5)\n"
+                  << "  --output PATH          リクエスト毎の結果を CSV で書く\n";
+    }
+
+    bool parse_options(int argc, char* argv[], options_t &options) {
+        for (int i = 1; i < argc; i++) {
+            const std::string_view arg(argv[i]);
+            const auto next = [&]() -> std::string {
+                if (i + 1 >= argc) {
+                    throw std::invalid_argument(std::string(arg) + " には値が必要です。");
+                }
+                return argv[++i];
+            };
+
+            if (arg == "--name") {
+                options.name = next();
+            } else if (arg == "--host") {
+                options.host = next();
+            } else if (arg == "--port") {
+                options.port = next();
+            } else if (arg == "--speed") {
+                options.speed = std::max(std::stod(next()), 0.0);
+            } else if (arg == "--limit") {
+                options.limit = std::stoul(next());
+            } else if (arg == "--max-connections") {
+                options.max_connections = std::max<size_t>(std::stoul(next()), 1);
+            } else if (arg == "--timeout") {
+                options.timeout = std::chrono::milliseconds(static_cast<int64_t>(std::stod(next()) * 1000));
+            } else if (arg == "--output") {
+                options.output_path = next();
+            } else if (!arg.starts_with("--") && options.trace_path.empty()) {
+                options.trace_path = arg;
+            } else {
+                return false;
+            }
+        }
+        return !options.trace_path.empty();
+    }
+
+    /**
+     * トレースファイルを mmap して読む
+     */
+    class trace_file_t {
+    public:
+        explicit trace_file_t(const std::string &path) {
+            const auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC); // NOLINT(hicpp-signed-bitwise)
+            if (fd == -1) {
+                throw std::system_error(errno, std::generic_category(), path);
+            }
+            struct stat status{};
+            if (fstat(fd, &status) == -1) {
+                close(fd);
+                throw std::system_error(errno, std::generic_category(), path);
+            }
+            this->size = static_cast<size_t>(status.st_size);
+            if (this->size < sizeof(request_capture_t::file_header_t)) {
+                close(fd);
+                throw std::runtime_error(path + " はトレースファイルではありません。");
+            }
+            this->address = mmap(nullptr, this->size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (this->address == MAP_FAILED) {
+                throw std::system_error(errno, std::generic_category(), "mmap");
+            }
+
+            const auto base = static_cast<const char*>(this->address);
+            request_capture_t::file_header_t header{};
+            std::memcpy(&header, base, sizeof(header));
+            if (header.magic != request_capture_t::MAGIC || header.version != request_capture_t::VERSION) {
+                munmap(this->address, this->size);
+                throw std::runtime_error(path + " はトレースファイルではありません。");
+            }
+
+            // 最後のレコードが途中で切れている場合 (記録中に止まった場合) は、そこまでにする
+            size_t offset = header.header_size;
+            while (offset + sizeof(request_capture_t::record_header_t) <= this->size) {
+                request_capture_t::record_header_t record{};
+                std::memcpy(&record, base + offset, sizeof(record));
+                const auto data_offset = offset + sizeof(record);
+                if (data_offset + record.size > this->size) {
+                    break;
+                }
+                this->records.push_back({
+                    std::string_view(base + data_offset, record.size),
+                    record.connection_id,
+                    record.arrival_ns,
+                });
+                const auto alignment = request_capture_t::RECORD_ALIGNMENT;
+                offset = data_offset + (record.size + alignment - 1) / alignment * alignment;
+            }
+
+            // 複数のスレッドで記録すると、到着時刻の順に並んでいないことがある
+            std::stable_sort(this->records.begin(), this->records.end(), [](const record_t &a, const record_t &b) {
+                return a.arrival_ns < b.arrival_ns;
+            });
+        }
+
+        ~trace_file_t() {
+            munmap(this->address, this->size);
+        }
+
+        trace_file_t(const trace_file_t &) = delete;
+
+        trace_file_t &operator=(const trace_file_t &) = delete;
+
+        [[nodiscard]] const std::vector<record_t> &get_records() const {
+            return this->records;
+        }
+
+    private:
+        void* address = nullptr;
+
+        size_t size = 0;
+
+        std::vector<record_t> records;
+    };
+
+    /**
+     * トレースを送り直す
+     */
+    class replayer_t {
+    public:
+        replayer_t(const options_t &options, const std::vector<record_t> &records)
+            : options(options),
+              records(records),
+              slots(options.max_connections),
+              epoll_fd(epoll_create1(EPOLL_CLOEXEC)) {
+            if (this->epoll_fd == -1) {
+                throw std::system_error(errno, std::generic_category(), "epoll_create1");
+            }
+            for (size_t i = this->slots.size(); i > 0; i--) {
+                this->free_slots.push_back(i - 1);
+            }
+
+            addrinfo hints{};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            addrinfo* found = nullptr;
+            const auto error = getaddrinfo(options.host.c_str(), options.port.c_str(), &hints, &found);
+            if (error != 0) {
+                throw std::runtime_error(std::string("getaddrinfo: ") + gai_strerror(error));
+            }
+            std::memcpy(&this->address, found->ai_addr, found->ai_addrlen);
+            this->address_length = found->ai_addrlen;
+            freeaddrinfo(found);
+        }
+
+        ~replayer_t() {
+            for (auto &slot : this->slots) {
+                if (slot.fd != -1) {
+                    close(slot.fd);
+                }
+            }
+            close(this->epoll_fd);
+        }
+
+        replayer_t(const replayer_t &) = delete;
+
+        replayer_t &operator=(const replayer_t &) = delete;
+
+        /**
+         * 全て送って、レスポンスを受信し終わるまで待つ
+         * @return リクエスト毎の結果
+         */
+        std::vector<outcome_t> run() {
+            const auto count = this->options.limit == 0
+                               ? this->records.size()
+                               : std::min(this->options.limit, this->records.size());
+            this->outcomes.assign(count, outcome_t());
+            if (count == 0) {
+                return std::move(this->outcomes);
+            }
+
+            this->started = clock_t::now();
+            const auto first_arrival = this->records.front().arrival_ns;
+            size_t next = 0;
+
+            std::array<epoll_event, 256> events{};
+            while (next < count || this->free_slots.size() < this->slots.size()) {
+                auto now = clock_t::now();
+
+                // 予定の時刻が来たものを送る (同時接続数の上限に達したら、空くまで待たせる)
+                while (next < count && !this->free_slots.empty()) {
+                    const auto scheduled = this->get_scheduled(this->records[next].arrival_ns - first_arrival);
+                    if (scheduled > now) {
+                        break;
+                    }
+                    this->start(next++, scheduled, now);
+                }
+
+                for (size_t i = 0; i < this->slots.size(); i++) {
+                    auto &slot = this->slots[i];
+                    if (slot.fd != -1 && now - slot.sent >= this->options.timeout) {
+                        this->finish(i, now, "timeout");
+                    }
+                }
+
+                // 次の予定の時刻まで待つ (ms 単位なので、1ms 以内は待たずに回す)
+                int wait_ms = 100;
+                if (next < count && !this->free_slots.empty()) {
+                    const auto scheduled = this->get_scheduled(this->records[next].arrival_ns - first_arrival);
+                    wait_ms = static_cast<int>(std::clamp<int64_t>(
+                        std::chrono::duration_cast<std::chrono::milliseconds>(scheduled - now).count(), 0, 100
+                    ));
+                }
+
+                const auto ready = epoll_wait(this->epoll_fd, events.data(), static_cast<int>(events.size()), wait_ms);
+                if (ready == -1) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    throw std::system_error(errno, std::generic_category(), "epoll_wait");
+                }
+                for (int i = 0; i < ready; i++) {
+                    this->handle_event(static_cast<size_t>(events[i].data.u64), events[i].events);
+                }
+            }
+
+            this->elapsed = clock_t::now() - this->started;
+            return std::move(this->outcomes);
+        }
+
+        [[nodiscard]] clock_t::duration get_elapsed() const {
+            return this->elapsed;
+        }
+
+    private:
+        const options_t &options;
+
+        const std::vector<record_t> &records;
+
+        std::vector<in_flight_t> slots;
+
+        std::vector<size_t> free_slots;
+
+        std::vector<outcome_t> outcomes;
+
+        int epoll_fd;
+
+        sockaddr_storage address{};
+
+        socklen_t address_length = 0;
+
+        clock_t::time_point started;
+
+        clock_t::duration elapsed{};
+
+        /**
+         * 記録を始めてからの時刻を、送る予定の時刻にする
+         */
+        [[nodiscard]] clock_t::time_point get_scheduled(uint64_t offset_ns) const {
+            if (this->options.speed <= 0) {
+                return this->started;
+            }
+            return this->started + std::chrono::duration_cast<clock_t::duration>(
+                std::chrono::duration<double, std::nano>(static_cast<double>(offset_ns) / this->options.speed)
+            );
+        }
+
+        void start(size_t index, clock_t::time_point scheduled, clock_t::time_point now) {
+            const auto slot_index = this->free_slots.back();
+            this->free_slots.pop_back();
+
+            auto &slot = this->slots[slot_index];
+            slot.index = index;
+            slot.scheduled = scheduled;
+            slot.sent = now;
+            slot.output_offset = 0;
+            slot.reader.reset(this->records[index].data.starts_with("HEAD "));
+            this->outcomes[index].scheduled_offset = scheduled - this->started;
+
+            slot.fd = socket(this->address.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+            if (slot.fd == -1) {
+                throw std::system_error(errno, std::generic_category(), "socket");
+            }
+            const int on = 1;
+            setsockopt(slot.fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+
+            slot.connecting = false;
+            if (connect(slot.fd, reinterpret_cast<const sockaddr*>(&this->address), this->address_length) == -1) {
+                if (errno != EINPROGRESS) {
+                    this->finish(slot_index, now, "connect");
+                    return;
+                }
+                slot.connecting = true;
+            }
+
+            epoll_event event{};
+            event.events = EPOLLIN | EPOLLOUT;
+            event.data.u64 = slot_index;
+            epoll_ctl(this->epoll_fd, EPOLL_CTL_ADD, slot.fd, &event);
+        }
+
+        void handle_event(size_t slot_index, uint32_t events) {
+            auto &slot = this->slots[slot_index];
+            if (slot.fd == -1) {
+                return;
+            }
+
+            if (slot.connecting && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) != 0) {
+                int error = 0;
+                socklen_t length = sizeof(error);
+                getsockopt(slot.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+                if (error != 0) {
+                    this->finish(slot_index, clock_t::now(), "connect");
+                    return;
+                }
+                slot.connecting = false;
+            }
+
+            const auto data = this->records[slot.index].data;
+            if ((events & EPOLLOUT) != 0 && slot.output_offset < data.size()) {
+                const auto sent = send(slot.fd, data.data() + slot.output_offset, data.size() - slot.output_offset, MSG_NOSIGNAL);
+                if (sent == -1 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    this->finish(slot_index, clock_t::now(), "write");
+                    return;
+                }
+                if (sent > 0) {
+                    slot.output_offset += static_cast<size_t>(sent);
+                }
+                // 送り終わったら書き込みは待たない
+                if (slot.output_offset == data.size()) {
+                    epoll_event event{};
+                    event.events = EPOLLIN;
+                    event.data.u64 = slot_index;
+                    epoll_ctl(this->epoll_fd, EPOLL_CTL_MOD, slot.fd, &event);
+                }
+            }
+
+            if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0) {
+                this->receive(slot_index);
+            }
+        }
+
+        void receive(size_t slot_index) {
+            auto &slot = this->slots[slot_index];
+            std::array<char, 16384> buffer{};
+            while (true) {
+                const auto received = recv(slot.fd, buffer.data(), buffer.size(), 0);
+                if (received > 0) {
+                    this->outcomes[slot.index].bytes_received += static_cast<size_t>(received);
+                    slot.reader.feed(buffer.data(), static_cast<size_t>(received));
+                    if (slot.reader.is_failed()) {
+                        this->finish(slot_index, clock_t::now(), "parse");
+                        return;
+                    }
+                    if (slot.reader.is_complete()) {
+                        this->finish(slot_index, clock_t::now(), "");
+                        return;
+                    }
+                    continue;
+                }
+                if (received == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    return;
+                }
+                if (received == -1 && errno == EINTR) {
+                    continue;
+                }
+
+                // 切断された. 長さの分からないボディはここで終わり
+                const auto completed = slot.reader.finish();
+                this->finish(slot_index, clock_t::now(), completed ? "" : received == 0 ? "closed" : "read");
+                return;
+            }
+        }
+
+        /**
+         * 1つのリクエストが終わった (成功・失敗とも) ので、接続を閉じて空ける
+         */
+        void finish(size_t slot_index, clock_t::time_point now, const char* error) {
+            auto &slot = this->slots[slot_index];
+            auto &outcome = this->outcomes[slot.index];
+            outcome.latency = now - slot.scheduled;
+            outcome.service_time = now - slot.sent;
+            outcome.error = error;
+            if (*error == '\0') {
+                outcome.status = slot.reader.get_status();
+            }
+
+            close(slot.fd);
+            slot.fd = -1;
+            this->free_slots.push_back(slot_index);
+        }
+    };
+
+    /**
+     * 処理時間の分布を JSON で書く (単位はマイクロ秒)
+     */
+    void write_latency_json(std::ostream &out, const latency_histogram_t &histogram, uint64_t max_ns) {
+        const auto snapshot = histogram.get_snapshot();
+        const auto to_us = [](uint64_t ns) {
+            return static_cast<double>(ns) / 1000.0;
+        };
+        out << "{\"count\":" << snapshot.count
+            << ",\"mean\":" << (snapshot.count == 0 ? 0.0 : to_us(snapshot.sum_ns) / static_cast<double>(snapshot.count))
+            << ",\"p50\":" << to_us(snapshot.get_value_at_percentile(50))
+            << ",\"p90\":" << to_us(snapshot.get_value_at_percentile(90))
+            << ",\"p99\":" << to_us(snapshot.get_value_at_percentile(99))
+            << ",\"p99.9\":" << to_us(snapshot.get_value_at_percentile(99.9))
+            << ",\"max\":" << to_us(max_ns)
+            << "}";
+    }
+
+    std::string escape_json(const std::string &value) {
+        std::string escaped;
+        for (const auto c : value) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+            }
+            escaped += c;
+        }
+        return escaped;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    options_t options;
+    try {
+        if (!parse_options(argc, argv, options)) {
+            print_usage(argv[0]);
+            return 2;
+        }
+    } catch (const std::exception &ex) {
+        std::cerr << ex.what() << std::endl;
+        print_usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<outcome_t> outcomes;
+    double elapsed_s = 0;
+    try {
+        trace_file_t trace(options.trace_path);
+        replayer_t replayer(options, trace.get_records());
+        outcomes = replayer.run();
+        elapsed_s = std::chrono::duration<double>(replayer.get_elapsed()).count();
+    } catch (const std::exception &ex) {
+        std::cerr << ex.what() << std::endl;
+        return 1;
+    }
+
+    const auto to_us = [](auto duration) {
+        return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count()) / 1000.0;
+    };
+
+    if (!options.output_path.empty()) {
+        std::ofstream csv(options.output_path);
+        csv << "index,scheduled_us,latency_us,service_us,status,bytes,error\n";
+        for (size_t i = 0; i < outcomes.size(); i++) {
+            const auto &outcome = outcomes[i];
+            csv << i << "," << to_us(outcome.scheduled_offset)
+                << "," << to_us(outcome.latency)
+                << "," << to_us(outcome.service_time)
+                << "," << outcome.status
+                << "," << outcome.bytes_received
+                << "," << outcome.error << "\n";
+        }
+    }
+
+    latency_histogram_t corrected;
+    latency_histogram_t uncorrected;
+    uint64_t corrected_max = 0;
+    uint64_t uncorrected_max = 0;
+    std::array<uint64_t, 5> status_classes{};
+    uint64_t errors = 0;
+    for (const auto &outcome : outcomes) {
+        if (*outcome.error != '\0') {
+            errors++;
+            continue;
+        }
+        status_classes[std::clamp(outcome.status / 100, 1, 5) - 1]++;
+        corrected.record(outcome.latency);
+        uncorrected.record(outcome.service_time);
+        corrected_max = std::max(corrected_max, static_cast<uint64_t>(std::chrono::nanoseconds(outcome.latency).count()));
+        uncorrected_max = std::max(uncorrected_max, static_cast<uint64_t>(std::chrono::nanoseconds(outcome.service_time).count()));
+    }
+
+    const char* status_names[] = {"1xx", "2xx", "3xx", "4xx", "5xx"};
+
+    std::ostringstream out;
+    out << "{\"name\":\"" << escape_json(options.name) << "\""
+        << ",\"target\":\"" << escape_json(options.host + ":" + options.port) << "\""
+        << ",\"trace\":\"" << escape_json(options.trace_path) << "\""
+        << ",\"speed\":" << options.speed
+        << ",\"duration_s\":" << elapsed_s
+        << ",\"requests\":" << outcomes.size()
+        << ",\"throughput_rps\":" << (elapsed_s > 0 ? static_cast<double>(outcomes.size()) / elapsed_s : 0.0)
+        << ",\"errors\":" << errors
+        << ",\"status\":{";
+    for (size_t i = 0; i < status_classes.size(); i++) {
+        out << (i == 0 ? "" : ",") << "\"" << status_names[i] << "\":" << status_classes[i];
+    }
+    out << "},\"latency_us\":{\"corrected\":";
+    write_latency_json(out, corrected, corrected_max);
+    out << ",\"uncorrected\":";
+    write_latency_json(out, uncorrected, uncorrected_max);
+    out << "}}";
+
+    std::cout << out.str() << std::endl;
+    return 0;
+}
@@ -0,0 +1,145 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <netinet/tcp.h>
+#include "admission_controller_t.h"
+#include "http_server_t.h"
+#include "server_metrics_t.h"
+
+namespace {
+    /**
+     * 断るときのレスポンスを組み立てる
+     */
+    std::string make_rejection_response(int retry_after) {
+        return "HTTP/1.1 503 Service Unavailable\r\n"
+               "Retry-After: " + std::to_string(retry_after) + "\r\n"
+               "Content-Type: text/plain\r\n"
+               "Content-Length: 0\r\n"
+               "Connection: close\r\n"
+               "\r\n";
+    }
+
+    /**
+     * 環境変数 `SIMPLE_SERVER_OVERLOAD_PROTECTION` が 0 の場合は制限しない (ベンチマーク用)
+     */
+    bool is_disabled_by_environment() {
+        const auto value = std::getenv("SIMPLE_SERVER_OVERLOAD_PROTECTION");
+        return value && std::string_view(value) == "0";
+    }
+}
+
+admission_controller_t::admission_controller_t(const config_t &config)
+    : config(config),
+      rejection_response(make_rejection_response(config.retry_after)),
+      connections(0),
+      in_flight(0),
+      in_flight_limit(std::max<size_t>(config.max_in_flight, 1)),
+      successes(0),
+      last_decrease(),
+      rejected_count(0) {
+    this->config.min_in_flight = std::clamp<size_t>(config.min_in_flight, 1, this->in_flight_limit);
+    if (is_disabled_by_environment()) {
+        this->config.enabled = false;
+    }
+}
+
+bool admission_controller_t::try_accept_connection() {
+    const auto current = this->connections.fetch_add(1, std::memory_order_relaxed);
+    if (this->config.enabled && this->config.max_connections > 0 && current >= this->config.max_connections) {
+        this->connections.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+void admission_controller_t::release_connection() {
+    this->connections.fetch_sub(1, std::memory_order_relaxed);
+}
+
+bool admission_controller_t::try_begin() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->config.enabled && this->in_flight >= this->in_flight_limit) {
+        return false;
+    }
+    this->in_flight++;
+    return true;
+}
+
+bool admission_controller_t::is_queue_time_exceeded(clock_t::time_point arrived_at) const {
+    return this->config.enabled
+           && this->config.max_queue_time.count() > 0
+           && clock_t::now() - arrived_at > this->config.max_queue_time;
+}
+
+admission_controller_t::clock_t::time_point admission_controller_t::get_arrived_at(int sd) {
+    const auto now = clock_t::now();
+    tcp_info info{};
+    socklen_t length = sizeof(info);
+    if (getsockopt(sd, IPPROTO_TCP, TCP_INFO, &info, &length) == -1) {
+        return now;
+    }
+    return now - std::chrono::milliseconds(info.tcpi_last_data_recv);
+}
+
+void admission_controller_t::end(clock_t::time_point started_at) {
+    const auto now = clock_t::now();
+    const auto latency = now - started_at;
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->in_flight > 0) {
+        this->in_flight--;
+    }
+    if (!this->config.enabled || !this->config.adaptive) {
+        return;
+    }
+
+    if (latency > this->config.target_latency) {
+        this->decrease_limit(now);
+        return;
+    }
+
+    // 加算的増加 (上限の数だけ目標内に終わったら 1 増やす)
+    this->successes++;
+    if (this->successes >= this->in_flight_limit) {
+        this->in_flight_limit = std::min(this->config.max_in_flight, this->in_flight_limit + 1);
+        this->successes = 0;
+    }
+}
+
+void admission_controller_t::shed() {
+    server_metrics_t::get_default().add_shed();
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->in_flight > 0) {
+        this->in_flight--;
+    }
+    if (this->config.adaptive) {
+        this->decrease_limit(clock_t::now());
+    }
+}
+
+void admission_controller_t::decrease_limit(clock_t::time_point now) {
+    // 乗算的減少 (同じ混雑で何回も減らさないように、目標処理時間に1回まで)
+    if (now - this->last_decrease > this->config.target_latency) {
+        this->in_flight_limit = std::max(this->config.min_in_flight, this->in_flight_limit * 9 / 10);
+        this->last_decrease = now;
+    }
+    this->successes = 0;
+}
+
+void admission_controller_t::reject(int sd) const {
+    this->rejected_count.fetch_add(1, std::memory_order_relaxed);
+    server_metrics_t::get_default().add_rejection(server_metrics_t::rejection_t::overload);
+    http_server_t::send_once_and_close(sd, this->rejection_response);
+}
+
+size_t admission_controller_t::get_in_flight_limit() const {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->in_flight_limit;
+}
+
+size_t admission_controller_t::get_in_flight() const {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->in_flight;
+}
@@ -0,0 +1,211 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_ADMISSION_CONTROLLER_T_H
+#define HTTP_SERVER_ADMISSION_CONTROLLER_T_H
+
+/**
+ * 受け付ける仕事の量を制限するクラス (アドミッション制御)
+ *
+ * 過負荷のときに全部のリクエストを受け付けると、全部が遅くなって全部タイムアウトする (goodput が 0 になる)。
+ * なので、処理しきれない分は仕事を始める前に、組み立て済みの `503 Retry-After` を返して断る。
+ *
+ * * 同時接続数の上限 (`try_accept_connection` / `release_connection`)
+ * * 同時に処理中のハンドラ数の上限 (`try_begin` / `end`)
+ * * 待ち時間 (リクエストがカーネルに届いてからハンドラが動き出すまで) が長すぎるリクエストは断る (`is_queue_time_exceeded`)
+ *
+ * ハンドラ数の上限は AIMD で自動調整できる。
+ * 処理時間が目標を超えたら上限を減らし (乗算的減少)、超えなければ少しずつ増やす (加算的増加)。
+ *
+ * 環境変数 `SIMPLE_SERVER_OVERLOAD_PROTECTION=0` の場合は断らない (ベンチマーク用。数えるだけ)。
+ */
+class admission_controller_t {
+public:
+    using clock_t = std::chrono::steady_clock;
+
+    /**
+     * アドミッション制御の設定
+     */
+    struct config_t {
+        /**
+         * 同時接続数の上限 (0 の場合は制限しない)
+         */
+        size_t max_connections = 1024;
+
+        /**
+         * 同時に処理中のハンドラ数の上限 (AIMD の場合は上限の最大値)
+         */
+        size_t max_in_flight = 64;
+
+        /**
+         * AIMD の場合の上限の最小値
+         */
+        size_t min_in_flight = 4;
+
+        /**
+         * これより長く待たされたリクエストは断る (0 の場合は断らない)
+         */
+        std::chrono::milliseconds max_queue_time = std::chrono::milliseconds(100);
+
+        /**
+         * ハンドラ数の上限を AIMD で調整するか
+         */
+        bool adaptive = true;
+
+        /**
+         * AIMD の目標処理時間. これを超えたら上限を減らす
+         */
+        std::chrono::milliseconds target_latency = std::chrono::milliseconds(200);
+
+        /**
+         * 断るときの `Retry-After` (秒)
+         */
+        int retry_after = 1;
+
+        /**
+         * `false` の場合は上限を掛けない (接続数と処理中のハンドラ数は数える)
+         */
+        bool enabled = true;
+    };
+
+    explicit admission_controller_t(const config_t &config);
+
+    admission_controller_t(const admission_controller_t &) = delete;
+
+    admission_controller_t &operator=(const admission_controller_t &) = delete;
+
+    /**
+     * 接続を受け付けてよいか判定し、よければ接続数を増やす
+     * @return 受け付けてよい場合 `true` (後で `release_connection` を呼ぶこと)
+     */
+    bool try_accept_connection();
+
+    /**
+     * 接続数を減らす (受け付けた接続をクローズしたときに呼ぶ)
+     */
+    void release_connection();
+
+    /**
+     * ハンドラを開始してよいか判定し、よければ処理中のハンドラ数を増やす
+     * @return 開始してよい場合 `true` (後で `end` を呼ぶこと)
+     */
+    bool try_begin();
+
+    /**
+     * 待ち時間が長すぎるか判定する
+     *
+     * 待たされすぎたリクエストは、今から処理してもクライアントが諦めている可能性が高いので断る。
+     *
+     * @param [in] arrived_at リクエストが届いた時刻 (`get_arrived_at`)
+     * @return 待ち時間が `max_queue_time` を超えている場合 `true`
+     */
+    [[nodiscard]] bool is_queue_time_exceeded(clock_t::time_point arrived_at) const;
+
+    /**
+     * 受け付けた接続のリクエストがカーネルに届いた時刻を推定する
+     *
+     * accept した時刻から計ると、accept のキュー (backlog) で待っていた時間が入らない。
+     * なので TCP_INFO の「最後にデータを受信してからの時間」(ミリ秒) を今の時刻から引く
+     * (まだデータを受信していない場合は、接続が確立してからの時間になる)。
+     * TCP 以外のソケット (Unix ドメインソケット) の場合は今の時刻を返す。
+     *
+     * @param [in] sd 受け付けたソケットディスクリプタ
+     * @return 届いた時刻
+     */
+    [[nodiscard]] static clock_t::time_point get_arrived_at(int sd);
+
+    /**
+     * ハンドラが終了したので、処理中のハンドラ数を減らす (AIMD の場合は上限を調整する)
+     * @param [in] started_at ハンドラを開始した時刻 (処理時間の計算に使う)
+     */
+    void end(clock_t::time_point started_at);
+
+    /**
+     * `try_begin` の後、ハンドラを実行せずに断った場合に呼ぶ
+     *
+     * 処理中のハンドラ数を減らす。待たされすぎたということなので、AIMD の場合は上限も減らす。
+     */
+    void shed();
+
+    /**
+     * 組み立て済みの `503 Service Unavailable` を送ってソケットを閉じる
+     *
+     * 送信は1回だけ試みて、待たない (過負荷のときに断る処理で詰まらないように)。
+     *
+     * @param [in] sd ソケットディスクリプタ
+     */
+    void reject(int sd) const;
+
+    /**
+     * 組み立て済みの `503 Service Unavailable` のレスポンステキストを取得する
+     * @return レスポンステキスト
+     */
+    [[nodiscard]] inline const std::string &get_rejection_response() const {
+        return this->rejection_response;
+    }
+
+    /**
+     * 今のハンドラ数の上限を取得する
+     * @return 上限
+     */
+    [[nodiscard]] size_t get_in_flight_limit() const;
+
+    /**
+     * 処理中のハンドラ数を取得する
+     * @return ハンドラ数
+     */
+    [[nodiscard]] size_t get_in_flight() const;
+
+    /**
+     * 受け付けた接続数を取得する
+     * @return 接続数
+     */
+    [[nodiscard]] inline size_t get_connection_count() const {
+        return this->connections.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * 断ったリクエストの数を取得する
+     * @return リクエスト数
+     */
+    [[nodiscard]] inline uint64_t get_rejected_count() const {
+        return this->rejected_count.load(std::memory_order_relaxed);
+    }
+
+private:
+    config_t config;
+
+    const std::string rejection_response;
+
+    std::atomic<size_t> connections;
+
+    mutable std::mutex mutex;
+
+    size_t in_flight;
+
+    /**
+     * 今のハンドラ数の上限
+     */
+    size_t in_flight_limit;
+
+    /**
+     * 加算的増加のために数える、目標内に終わったハンドラの数
+     */
+    size_t successes;
+
+    /**
+     * 最後に上限を減らした時刻 (減らしすぎないように、目標処理時間に1回までにする)
+     */
+    clock_t::time_point last_decrease;
+
+    mutable std::atomic<uint64_t> rejected_count;
+
+    /**
+     * 上限を減らす (ロックを取った状態で呼ぶこと)
+     */
+    void decrease_limit(clock_t::time_point now);
+};
+
+
+#endif //HTTP_SERVER_ADMISSION_CONTROLLER_T_H
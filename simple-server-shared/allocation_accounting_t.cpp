@@ -0,0 +1,310 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <new>
+#include "allocation_accounting_t.h"
+
+namespace {
+    const std::array<const char*, allocation_accounting_t::PHASE_COUNT> PHASE_NAMES = {
+        "other",
+        "parse",
+        "handler",
+        "serialize",
+        "write",
+    };
+}
+
+const char* allocation_accounting_t::get_phase_name(phase_t phase) {
+    return PHASE_NAMES[static_cast<size_t>(phase)];
+}
+
+#if defined(HTTP_SERVER_ALLOCATION_ACCOUNTING)
+
+namespace {
+    /**
+     * スレッド毎の状態
+     * (malloc の中から触るので、定数で初期化できる型にする. 初回アクセスで初期化の処理や確保が走らない)
+     */
+    struct thread_state_t {
+        allocation_accounting_t::phase_t phase;
+
+        /**
+         * まだ合計に足していない分
+         */
+        allocation_accounting_t::profile_t pending;
+
+        /**
+         * 処理中のリクエストの分 (リクエストの外では nullptr)
+         */
+        allocation_accounting_t::profile_t* request;
+    };
+
+    constinit thread_local thread_state_t t_state{};
+
+    std::array<std::atomic<uint64_t>, allocation_accounting_t::PHASE_COUNT> g_counts{};
+
+    std::array<std::atomic<uint64_t>, allocation_accounting_t::PHASE_COUNT> g_bytes{};
+
+    struct route_table_t {
+        std::mutex mutex;
+
+        std::map<std::string, allocation_accounting_t::route_profile_t, std::less<>> routes;
+    };
+
+    /**
+     * ルート毎の合計 (終了時の破棄の順番を気にしなくて済むように、破棄しない)
+     */
+    route_table_t &get_route_table() {
+        static auto* table = new route_table_t();
+        return *table;
+    }
+
+    /**
+     * まだ合計に足していない分を、全体の合計と処理中のリクエストに足す
+     * (処理段階を切り替える度に呼ぶので、確保する度に atomic 変数を触らずに済む)
+     */
+    void flush() {
+        auto &state = t_state;
+        for (size_t i = 0; i < allocation_accounting_t::PHASE_COUNT; i++) {
+            auto &pending = state.pending[i];
+            if (pending.count == 0) {
+                continue;
+            }
+            g_counts[i].fetch_add(pending.count, std::memory_order_relaxed);
+            g_bytes[i].fetch_add(pending.bytes, std::memory_order_relaxed);
+            if (state.request) {
+                (*state.request)[i].count += pending.count;
+                (*state.request)[i].bytes += pending.bytes;
+            }
+            pending = {0, 0};
+        }
+    }
+}
+
+void allocation_accounting_t::record_allocation(size_t bytes) noexcept {
+    auto &counts = t_state.pending[static_cast<size_t>(t_state.phase)];
+    counts.count++;
+    counts.bytes += bytes;
+}
+
+allocation_accounting_t::phase_scope_t::phase_scope_t(phase_t phase)
+    : previous(t_state.phase) {
+    flush();
+    t_state.phase = phase;
+}
+
+allocation_accounting_t::phase_scope_t::~phase_scope_t() {
+    flush();
+    t_state.phase = this->previous;
+}
+
+allocation_accounting_t::request_scope_t::request_scope_t()
+    : profile{},
+      previous(t_state.request),
+      route{},
+      route_size(0) {
+    flush();
+    t_state.request = &this->profile;
+}
+
+allocation_accounting_t::request_scope_t::~request_scope_t() {
+    flush();
+    t_state.request = this->previous;
+    if (this->route_size == 0) {
+        return;
+    }
+
+    auto &table = get_route_table();
+    std::lock_guard<std::mutex> lock(table.mutex);
+
+    std::string_view key(this->route.data(), this->route_size);
+    auto it = table.routes.find(key);
+    if (it == table.routes.end()) {
+        // ルートが多すぎる場合 (パスにIDが入っている場合など) は、まとめる
+        if (table.routes.size() >= MAX_ROUTE_COUNT) {
+            key = "other";
+            it = table.routes.find(key);
+        }
+        if (it == table.routes.end()) {
+            it = table.routes.emplace(std::string(key), route_profile_t{std::string(key), 0, {}}).first;
+        }
+    }
+
+    auto &entry = it->second;
+    entry.requests++;
+    for (size_t i = 0; i < PHASE_COUNT; i++) {
+        entry.phases[i].count += this->profile[i].count;
+        entry.phases[i].bytes += this->profile[i].bytes;
+    }
+}
+
+void allocation_accounting_t::request_scope_t::set_route(std::string_view method, std::string_view uri) {
+    const auto path = uri.substr(0, uri.find('?'));
+
+    // 固定長に入る分だけ
+    size_t size = 0;
+    const auto append = [this, &size](std::string_view text) {
+        const auto length = std::min(text.size(), this->route.size() - size);
+        std::memcpy(this->route.data() + size, text.data(), length);
+        size += length;
+    };
+    append(method);
+    append(" ");
+    append(path);
+    this->route_size = size;
+}
+
+allocation_accounting_t::profile_t allocation_accounting_t::get_phase_totals() {
+    // 呼んだスレッドの分だけは今の値にする
+    flush();
+
+    profile_t totals{};
+    for (size_t i = 0; i < PHASE_COUNT; i++) {
+        totals[i].count = g_counts[i].load(std::memory_order_relaxed);
+        totals[i].bytes = g_bytes[i].load(std::memory_order_relaxed);
+    }
+    return totals;
+}
+
+std::vector<allocation_accounting_t::route_profile_t> allocation_accounting_t::get_route_profiles() {
+    auto &table = get_route_table();
+    std::lock_guard<std::mutex> lock(table.mutex);
+
+    std::vector<route_profile_t> profiles;
+    profiles.reserve(table.routes.size());
+    for (const auto &route : table.routes) {
+        profiles.push_back(route.second);
+    }
+    return profiles;
+}
+
+/*
+ * 確保を数えるための差し替え
+ */
+
+#if defined(__GLIBC__)
+
+// glibc の本来の実装 (差し替えても、この名前で呼べる)
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* pointer);
+}
+
+extern "C" void* malloc(size_t size) noexcept {
+    allocation_accounting_t::record_allocation(size);
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t count, size_t size) noexcept {
+    allocation_accounting_t::record_allocation(count * size);
+    return __libc_calloc(count, size);
+}
+
+extern "C" void* realloc(void* pointer, size_t size) noexcept {
+    allocation_accounting_t::record_allocation(size);
+    return __libc_realloc(pointer, size);
+}
+
+extern "C" void* memalign(size_t alignment, size_t size) noexcept {
+    allocation_accounting_t::record_allocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+// pmr の new_delete_resource が呼ぶアラインメント付きの operator new は、これを使う
+extern "C" void* aligned_alloc(size_t alignment, size_t size) noexcept {
+    allocation_accounting_t::record_allocation(size);
+    return __libc_memalign(alignment, size);
+}
+
+extern "C" int posix_memalign(void** pointer, size_t alignment, size_t size) noexcept {
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    allocation_accounting_t::record_allocation(size);
+    *pointer = __libc_memalign(alignment, size);
+    return *pointer ? 0 : ENOMEM;
+}
+
+extern "C" void free(void* pointer) noexcept {
+    __libc_free(pointer);
+}
+
+#else
+
+// malloc を差し替えられない環境では operator new だけを数える
+
+void* operator new(size_t size) {
+    allocation_accounting_t::record_allocation(size);
+    if (auto pointer = std::malloc(size == 0 ? 1 : size)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return ::operator new(size);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    allocation_accounting_t::record_allocation(size);
+    const auto align = std::max(static_cast<size_t>(alignment), sizeof(void*));
+    if (auto pointer = std::aligned_alloc(align, (std::max<size_t>(size, 1) + align - 1) / align * align)) {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return ::operator new(size, alignment);
+}
+
+void operator delete(void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept {
+    std::free(pointer);
+}
+
+#endif
+
+#else
+
+allocation_accounting_t::profile_t allocation_accounting_t::get_phase_totals() {
+    return {};
+}
+
+std::vector<allocation_accounting_t::route_profile_t> allocation_accounting_t::get_route_profiles() {
+    return {};
+}
+
+#endif
@@ -0,0 +1,186 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_ALLOCATION_ACCOUNTING_T_H
+#define HTTP_SERVER_ALLOCATION_ACCOUNTING_T_H
+
+/**
+ * リクエストの処理段階毎・ルート毎に、メモリを確保した回数とバイト数を数える
+ *
+ * CMake のオプション `HTTP_SERVER_ALLOCATION_ACCOUNTING` を ON にしたビルドだけ有効になる。
+ * 有効なビルドでは `malloc` / `calloc` / `realloc` / `aligned_alloc` / `posix_memalign` を差し替えて
+ * (glibc の場合. `operator new` も `malloc` を呼ぶので一緒に数えられる。それ以外では `operator new` を差し替える)、
+ * 確保する度にスレッドローカルのカウンタを増やす。ロックも atomic 変数も使わない。
+ *
+ * * `phase_scope_t` の間の確保は、その処理段階 (`parse` `handler` `serialize` `write`) に数える。
+ *   `server_metrics_t::stage_timer_t` も処理段階を切り替えるので、時間を測っている所はそのまま数えられる
+ * * `request_scope_t` の間の確保は、そのリクエストの分としても数え、終わったときに `set_route` したルート毎に合算する
+ *
+ * 結果はメトリクス (`server_metrics_t::to_prometheus`) に出る。
+ * 無効なビルドでは、どちらのスコープも何もしない空のクラスになる。
+ *
+ * ```
+ * allocation_accounting_t::request_scope_t allocation_scope;
+ * ...
+ * allocation_scope.set_route(request->get_method(), request->get_uri());
+ * {
+ *     allocation_accounting_t::phase_scope_t phase(allocation_accounting_t::phase_t::handler);
+ *     ...
+ * }
+ * ```
+ */
+class allocation_accounting_t {
+public:
+    /**
+     * 処理段階
+     */
+    enum class phase_t : size_t {
+        /**
+         * 処理段階の外 (リクエストの処理中でも、どの段階にも入っていない所)
+         */
+        other,
+        parse,
+        handler,
+        serialize,
+        write,
+    };
+
+    static const size_t PHASE_COUNT = 5;
+
+    /**
+     * 数えるルートの上限 (超えた分は `other` にまとめる)
+     */
+    static const size_t MAX_ROUTE_COUNT = 64;
+
+    /**
+     * 確保した回数とバイト数
+     */
+    struct counts_t {
+        uint64_t count;
+
+        uint64_t bytes;
+    };
+
+    /**
+     * 処理段階毎の回数とバイト数
+     */
+    using profile_t = std::array<counts_t, PHASE_COUNT>;
+
+    /**
+     * ルート毎の合計
+     */
+    struct route_profile_t {
+        /**
+         * `メソッド パス` (クエリは除く)
+         */
+        std::string route;
+
+        uint64_t requests;
+
+        profile_t phases;
+    };
+
+    /**
+     * 確保を数えるビルドか
+     */
+    static constexpr bool is_enabled() {
+#if defined(HTTP_SERVER_ALLOCATION_ACCOUNTING)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+#if defined(HTTP_SERVER_ALLOCATION_ACCOUNTING)
+
+    /**
+     * スコープの間、このスレッドの処理段階を切り替える (抜けるときに元に戻す)
+     */
+    class phase_scope_t {
+    public:
+        explicit phase_scope_t(phase_t phase);
+
+        ~phase_scope_t();
+
+        phase_scope_t(const phase_scope_t &) = delete;
+
+        phase_scope_t &operator=(const phase_scope_t &) = delete;
+
+    private:
+        phase_t previous;
+    };
+
+    /**
+     * スコープの間の確保を、1つのリクエストの分として数える
+     */
+    class request_scope_t {
+    public:
+        request_scope_t();
+
+        ~request_scope_t();
+
+        request_scope_t(const request_scope_t &) = delete;
+
+        request_scope_t &operator=(const request_scope_t &) = delete;
+
+        /**
+         * ルートを設定する (設定しなかったリクエストは、ルート毎の合計に入れない)
+         * @param [in] method メソッド
+         * @param [in] uri URI
+         */
+        void set_route(std::string_view method, std::string_view uri);
+
+    private:
+        profile_t profile;
+
+        profile_t* previous;
+
+        /**
+         * ルートの文字列 (ここで確保すると数えてしまうので固定長)
+         */
+        std::array<char, 96> route;
+
+        size_t route_size;
+    };
+
+    /**
+     * 確保を1回数える (差し替えた malloc などから呼ぶ)
+     * @param [in] bytes バイト数
+     */
+    static void record_allocation(size_t bytes) noexcept;
+
+#else
+
+    class phase_scope_t {
+    public:
+        explicit phase_scope_t(phase_t) {
+        }
+    };
+
+    class request_scope_t {
+    public:
+        inline void set_route(std::string_view, std::string_view) {
+        }
+    };
+
+#endif
+
+    /**
+     * 処理段階毎の合計を取得する
+     */
+    [[nodiscard]] static profile_t get_phase_totals();
+
+    /**
+     * ルート毎の合計を取得する
+     */
+    [[nodiscard]] static std::vector<route_profile_t> get_route_profiles();
+
+    /**
+     * 処理段階の名前を取得する
+     */
+    [[nodiscard]] static const char* get_phase_name(phase_t phase);
+};
+
+
+#endif //HTTP_SERVER_ALLOCATION_ACCOUNTING_T_H
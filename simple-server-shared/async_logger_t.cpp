@@ -0,0 +1,489 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <ctime>
+#include "async_logger_t.h"
+
+namespace {
+    /**
+     * レコード1つのバイト数 (キャッシュラインの倍数にする)
+     */
+    const size_t RECORD_SIZE = 256;
+
+    /**
+     * レコードに入れる文字列の数の上限
+     */
+    const size_t MAX_FIELD_COUNT = 3;
+
+    /**
+     * レコードの種類
+     */
+    enum class record_kind_t : uint8_t {
+        message,
+        access,
+    };
+
+    std::atomic<uint64_t> g_next_logger_id(1);
+
+    const char* get_level_name(async_logger_t::level_t level) {
+        switch (level) {
+            case async_logger_t::level_t::debug:
+                return "debug";
+            case async_logger_t::level_t::info:
+                return "info";
+            case async_logger_t::level_t::warning:
+                return "warning";
+            case async_logger_t::level_t::error:
+                return "error";
+        }
+        return "unknown";
+    }
+
+    /**
+     * JSON の文字列として追加する
+     */
+    void append_json_string(std::string &output, std::string_view text) {
+        output.push_back('"');
+        for (auto c : text) {
+            switch (c) {
+                case '"':
+                    output.append("\\\"");
+                    break;
+                case '\\':
+                    output.append("\\\\");
+                    break;
+                case '\n':
+                    output.append("\\n");
+                    break;
+                case '\r':
+                    output.append("\\r");
+                    break;
+                case '\t':
+                    output.append("\\t");
+                    break;
+                default:
+                    if (static_cast<unsigned char>(c) < 0x20) {
+                        std::array<char, 8> escaped{};
+                        std::snprintf(escaped.data(), escaped.size(), "\\u%04x", c);
+                        output.append(escaped.data());
+                    } else {
+                        output.push_back(c);
+                    }
+                    break;
+            }
+        }
+        output.push_back('"');
+    }
+
+    /**
+     * UTC の ISO 8601 形式 (マイクロ秒まで) で追加する
+     */
+    void append_timestamp(std::string &output, int64_t timestamp_us) {
+        const auto seconds = static_cast<time_t>(timestamp_us / 1000000);
+        tm utc{};
+        gmtime_r(&seconds, &utc);
+        std::array<char, 40> text{};
+        const auto size = std::snprintf(
+            text.data(), text.size(), "%04d-%02d-%02dT%02d:%02d:%02d.%06dZ",
+            utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday,
+            utc.tm_hour, utc.tm_min, utc.tm_sec,
+            static_cast<int>(timestamp_us % 1000000)
+        );
+        output.append(text.data(), static_cast<size_t>(size));
+    }
+}
+
+struct async_logger_t::record_t {
+    /**
+     * 時刻 (UNIX 時間のマイクロ秒)
+     */
+    int64_t timestamp_us;
+
+    uint64_t bytes;
+
+    uint64_t duration_us;
+
+    /**
+     * 間引いた割合 (間引いていない場合は 1)
+     */
+    uint32_t sample;
+
+    uint16_t status;
+
+    record_kind_t kind;
+
+    level_t level;
+
+    /**
+     * `text` に詰めた文字列それぞれのバイト数
+     */
+    std::array<uint16_t, MAX_FIELD_COUNT> field_sizes;
+
+    char text[RECORD_SIZE - 32 - sizeof(uint16_t) * MAX_FIELD_COUNT];
+
+    /**
+     * 文字列を詰める (入りきらない分は切る)
+     */
+    inline void set_fields(std::initializer_list<std::string_view> fields) {
+        size_t offset = 0;
+        size_t index = 0;
+        for (auto field : fields) {
+            const auto size = std::min(field.size(), sizeof(this->text) - offset);
+            std::memcpy(this->text + offset, field.data(), size);
+            this->field_sizes[index++] = static_cast<uint16_t>(size);
+            offset += size;
+        }
+        for (; index < MAX_FIELD_COUNT; index++) {
+            this->field_sizes[index] = 0;
+        }
+    }
+
+    /**
+     * 詰めた文字列を取り出す
+     */
+    [[nodiscard]] inline std::string_view get_field(size_t index) const {
+        size_t offset = 0;
+        for (size_t i = 0; i < index; i++) {
+            offset += this->field_sizes[i];
+        }
+        return {this->text + offset, this->field_sizes[index]};
+    }
+};
+
+static_assert(sizeof(async_logger_t::record_t) == RECORD_SIZE);
+
+struct async_logger_t::ring_t {
+    explicit ring_t(size_t capacity)
+        : records(std::make_unique<record_t[]>(capacity)),
+          capacity(capacity) {
+    }
+
+    std::unique_ptr<record_t[]> records;
+
+    const size_t capacity;
+
+    /**
+     * 次に書き込む位置 (書き込むスレッドだけが更新する)
+     */
+    alignas(64) std::atomic<uint64_t> head{0};
+
+    /**
+     * 次に読み出す位置 (書き出しスレッドだけが更新する)
+     */
+    alignas(64) std::atomic<uint64_t> tail{0};
+
+    /**
+     * 書き込むスレッドが終了したか
+     */
+    std::atomic<bool> retired{false};
+
+    /**
+     * 間引いている間のカウンタ (書き込むスレッドだけが使う)
+     */
+    uint32_t sample_counter = 0;
+};
+
+namespace {
+    /**
+     * このスレッドがロガー毎に持っているリング (スレッドの終了時に、書き終わったことを知らせる)
+     */
+    struct thread_rings_t {
+        std::vector<std::pair<uint64_t, std::shared_ptr<async_logger_t::ring_t>>> rings;
+
+        ~thread_rings_t() {
+            for (auto &entry : rings) {
+                entry.second->retired.store(true, std::memory_order_release);
+            }
+        }
+    };
+
+    thread_local thread_rings_t t_rings;
+}
+
+async_logger_t::async_logger_t(const config_t &config)
+    : config(config),
+      id(g_next_logger_id.fetch_add(1)),
+      fd(STDERR_FILENO),
+      owns_fd(false),
+      dropped_count(0),
+      sampled_out_count(0),
+      forking_pid(0),
+      resume_after_fork(false),
+      running(false) {
+
+    this->config.ring_capacity = std::bit_ceil(std::max<size_t>(config.ring_capacity, 2));
+
+    if (!config.path.empty()) {
+        this->fd = open(config.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644); // NOLINT(hicpp-signed-bitwise)
+        if (this->fd == -1) {
+            throw std::runtime_error("ログファイルを開けませんでした。 path=" + config.path);
+        }
+        this->owns_fd = true;
+    }
+}
+
+async_logger_t::~async_logger_t() {
+    this->stop();
+    if (this->owns_fd) {
+        close(this->fd);
+    }
+}
+
+void async_logger_t::log(level_t level, std::string_view message) {
+    if (!this->is_enabled(level)) {
+        return;
+    }
+
+    auto &ring = this->get_ring();
+    auto record = this->begin_record(ring);
+    if (!record) {
+        return;
+    }
+    record->kind = record_kind_t::message;
+    record->level = level;
+    record->status = 0;
+    record->bytes = 0;
+    record->duration_us = 0;
+    record->sample = 1;
+    record->set_fields({message});
+    ring.head.store(ring.head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void async_logger_t::log_access(
+    std::string_view client,
+    std::string_view method,
+    std::string_view uri,
+    int status,
+    size_t bytes,
+    std::chrono::microseconds duration
+) {
+    if (!this->is_enabled(level_t::info)) {
+        return;
+    }
+
+    auto &ring = this->get_ring();
+
+    // 書き出しが追いついていない間は間引く
+    uint32_t sample = 1;
+    const auto used = ring.head.load(std::memory_order_relaxed) - ring.tail.load(std::memory_order_acquire);
+    if (this->config.sample_threshold < 1.0
+        && static_cast<double>(used) >= static_cast<double>(ring.capacity) * this->config.sample_threshold) {
+        sample = std::max<uint32_t>(this->config.sample_every, 1);
+        if (ring.sample_counter++ % sample != 0) {
+            this->sampled_out_count.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    } else {
+        ring.sample_counter = 0;
+    }
+
+    auto record = this->begin_record(ring);
+    if (!record) {
+        return;
+    }
+    record->kind = record_kind_t::access;
+    record->level = level_t::info;
+    record->status = static_cast<uint16_t>(status);
+    record->bytes = bytes;
+    record->duration_us = static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0));
+    record->sample = sample;
+    // URI が長い場合は URI を切る (クライアントとメソッドは短いので先に入れる)
+    record->set_fields({client, method, uri});
+    ring.head.store(ring.head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+void async_logger_t::start() {
+    std::lock_guard<std::mutex> lock(this->writer_mutex);
+    if (this->running) {
+        return;
+    }
+    this->running = true;
+    this->writer_thread = std::thread([this] {
+        std::unique_lock<std::mutex> writer_lock(this->writer_mutex);
+        while (this->running) {
+            this->writer_condition.wait_for(writer_lock, this->config.flush_interval);
+            writer_lock.unlock();
+            this->drain();
+            writer_lock.lock();
+        }
+    });
+}
+
+void async_logger_t::stop() {
+    {
+        std::lock_guard<std::mutex> lock(this->writer_mutex);
+        this->running = false;
+    }
+    this->writer_condition.notify_all();
+    if (this->writer_thread.joinable()) {
+        this->writer_thread.join();
+    }
+    // 残っている分を書き出す
+    this->drain();
+}
+
+void async_logger_t::before_fork() {
+    this->forking_pid = getpid();
+    this->resume_after_fork = this->running;
+    this->stop();
+    // 他のスレッドがリングを登録している途中で fork しないようにする
+    this->rings_mutex.lock();
+}
+
+void async_logger_t::after_fork() {
+    this->rings_mutex.unlock();
+
+    if (getpid() != this->forking_pid) {
+        // 他のスレッドのリングは、そのスレッドがもういないので使い回せるようにする
+        // (親プロセスがまだ書き出していないレコードは、親プロセスが書くので捨てる)
+        std::lock_guard<std::mutex> lock(this->rings_mutex);
+        for (auto &ring : this->rings) {
+            ring->tail.store(ring->head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            const auto owned = std::any_of(t_rings.rings.begin(), t_rings.rings.end(), [&ring](const auto &entry) {
+                return entry.second == ring;
+            });
+            if (!owned) {
+                ring->retired.store(true, std::memory_order_relaxed);
+            }
+        }
+    }
+
+    if (this->resume_after_fork) {
+        this->start();
+    }
+}
+
+uint64_t async_logger_t::get_dropped_count() const {
+    return this->dropped_count.load(std::memory_order_relaxed);
+}
+
+uint64_t async_logger_t::get_sampled_out_count() const {
+    return this->sampled_out_count.load(std::memory_order_relaxed);
+}
+
+async_logger_t &async_logger_t::get_default() {
+    static async_logger_t logger{config_t{}};
+    static std::once_flag started;
+    std::call_once(started, [] {
+        logger.start();
+    });
+    return logger;
+}
+
+async_logger_t::ring_t &async_logger_t::get_ring() {
+    for (auto &entry : t_rings.rings) {
+        if (entry.first == this->id) {
+            return *entry.second;
+        }
+    }
+
+    // このスレッドで初めて書く場合だけ、リングを登録する
+    std::shared_ptr<ring_t> ring;
+    {
+        std::lock_guard<std::mutex> lock(this->rings_mutex);
+        if (!this->free_rings.empty()) {
+            ring = std::move(this->free_rings.back());
+            this->free_rings.pop_back();
+        } else {
+            ring = std::make_shared<ring_t>(this->config.ring_capacity);
+        }
+        this->rings.push_back(ring);
+    }
+    t_rings.rings.emplace_back(this->id, ring);
+    return *ring;
+}
+
+async_logger_t::record_t* async_logger_t::begin_record(ring_t &ring) {
+    const auto head = ring.head.load(std::memory_order_relaxed);
+    if (head - ring.tail.load(std::memory_order_acquire) >= ring.capacity) {
+        this->dropped_count.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    auto &record = ring.records[head & (ring.capacity - 1)];
+    record.timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()
+    ).count();
+    return &record;
+}
+
+void async_logger_t::drain() {
+    std::vector<std::shared_ptr<ring_t>> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(this->rings_mutex);
+        snapshot = this->rings;
+    }
+
+    std::string output;
+    std::vector<std::shared_ptr<ring_t>> finished;
+    for (auto &ring : snapshot) {
+        // 終了したかを先に見る (終了した後の head は最後の書き込みまで含む)
+        const auto retired = ring->retired.load(std::memory_order_acquire);
+        const auto head = ring->head.load(std::memory_order_acquire);
+        auto tail = ring->tail.load(std::memory_order_relaxed);
+
+        for (; tail != head; tail++) {
+            const auto &record = ring->records[tail & (ring->capacity - 1)];
+            output.append("{\"time\":\"");
+            append_timestamp(output, record.timestamp_us);
+            output.append("\",\"level\":\"").append(get_level_name(record.level)).append("\"");
+            if (record.kind == record_kind_t::access) {
+                output.append(",\"type\":\"access\",\"client\":");
+                append_json_string(output, record.get_field(0));
+                output.append(",\"method\":");
+                append_json_string(output, record.get_field(1));
+                output.append(",\"uri\":");
+                append_json_string(output, record.get_field(2));
+                output.append(",\"status\":").append(std::to_string(record.status));
+                output.append(",\"bytes\":").append(std::to_string(record.bytes));
+                output.append(",\"duration_us\":").append(std::to_string(record.duration_us));
+                if (record.sample > 1) {
+                    output.append(",\"sample\":").append(std::to_string(record.sample));
+                }
+            } else {
+                output.append(",\"message\":");
+                append_json_string(output, record.get_field(0));
+            }
+            output.append("}\n");
+        }
+        ring->tail.store(tail, std::memory_order_release);
+
+        if (retired) {
+            finished.push_back(ring);
+        }
+    }
+
+    if (!output.empty()) {
+        this->write_all(output);
+    }
+
+    if (!finished.empty()) {
+        std::lock_guard<std::mutex> lock(this->rings_mutex);
+        for (auto &ring : finished) {
+            this->rings.erase(std::remove(this->rings.begin(), this->rings.end(), ring), this->rings.end());
+            ring->head.store(0, std::memory_order_relaxed);
+            ring->tail.store(0, std::memory_order_relaxed);
+            ring->retired.store(false, std::memory_order_relaxed);
+            ring->sample_counter = 0;
+            this->free_rings.push_back(ring);
+        }
+    }
+}
+
+void async_logger_t::write_all(const std::string &data) const {
+    size_t written = 0;
+    while (written < data.size()) {
+        const auto result = ::write(this->fd, data.data() + written, data.size() - written);
+        if (result == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // 書き出せない場合は捨てる (ログのために止まらないようにする)
+            return;
+        }
+        written += static_cast<size_t>(result);
+    }
+}
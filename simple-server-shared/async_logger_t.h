@@ -0,0 +1,237 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_ASYNC_LOGGER_T_H
+#define HTTP_SERVER_ASYNC_LOGGER_T_H
+
+/**
+ * リクエストを処理するスレッドを待たせないロガー
+ *
+ * * ログを書くスレッドは、スレッド毎のリングバッファ (SPSC: 書くのはそのスレッドだけ、読むのは書き出しスレッドだけ)
+ *   に固定長のレコードをコピーするだけ。ロックもシステムコールもしない
+ * * バックグラウンドの書き出しスレッドが、定期的に全てのリングからレコードを取り出して
+ *   1行1つの JSON に整形し、まとめて1回の write で書き出す
+ * * リングが一杯の場合は待たずにそのレコードを捨てる (捨てた数は `get_dropped_count` で分かる)
+ * * リングが `sample_threshold` 以上埋まっている (書き出しが追いついていない) 間は、
+ *   アクセスログを `sample_every` 件に1件だけ残す (残したレコードには `"sample":N` が付く)
+ *
+ * ```
+ * auto &logger = async_logger_t::get_default();
+ * logger.log(async_logger_t::level_t::warning, "request timed out");
+ * logger.log_access(client_ip, request->get_method(), request->get_uri(), 200, response_size, duration);
+ * ```
+ *
+ * レコードは固定長なので、長いメッセージや URI は途中で切る。
+ * スレッドが終わると、そのスレッドのリングは書き出した後に次に作られたスレッドで使い回す。
+ */
+class async_logger_t {
+public:
+    /**
+     * ログのレベル
+     */
+    enum class level_t : uint8_t {
+        debug,
+        info,
+        warning,
+        error,
+    };
+
+    /**
+     * ロガーの設定
+     */
+    struct config_t {
+        /**
+         * 書き出すファイルのパス (空の場合は標準エラー出力)
+         */
+        std::string path;
+
+        /**
+         * これより低いレベルのログは、リングに入れずに捨てる
+         */
+        level_t min_level = level_t::info;
+
+        /**
+         * スレッド毎のリングのレコード数 (2 のべき乗に切り上げる)
+         */
+        size_t ring_capacity = 256;
+
+        /**
+         * 書き出しスレッドがリングを見に行く間隔
+         */
+        std::chrono::milliseconds flush_interval = std::chrono::milliseconds(50);
+
+        /**
+         * リングがこの割合以上埋まったら、アクセスログを間引く (1.0 以上の場合は間引かない)
+         */
+        double sample_threshold = 0.5;
+
+        /**
+         * 間引くときに残す割合 (N 件に 1 件)
+         */
+        uint32_t sample_every = 16;
+    };
+
+    explicit async_logger_t(const config_t &config);
+
+    ~async_logger_t();
+
+    async_logger_t(const async_logger_t &) = delete;
+
+    async_logger_t &operator=(const async_logger_t &) = delete;
+
+    /**
+     * レベルのログが出力されるか
+     * (メッセージを組み立てるのが重い場合は、先にこれで確認する)
+     */
+    [[nodiscard]] inline bool is_enabled(level_t level) const {
+        return level >= this->config.min_level;
+    }
+
+    /**
+     * メッセージを記録する
+     * @param [in] level レベル
+     * @param [in] message メッセージ
+     */
+    void log(level_t level, std::string_view message);
+
+    /**
+     * アクセスログを1件記録する
+     * @param [in] client クライアントのアドレス
+     * @param [in] method メソッド
+     * @param [in] uri URI
+     * @param [in] status ステータスコード
+     * @param [in] bytes レスポンスのバイト数
+     * @param [in] duration 処理時間
+     */
+    void log_access(
+        std::string_view client,
+        std::string_view method,
+        std::string_view uri,
+        int status,
+        size_t bytes,
+        std::chrono::microseconds duration
+    );
+
+    /**
+     * 書き出しスレッドを開始する
+     */
+    void start();
+
+    /**
+     * 書き出しスレッドを停止する (リングに残っているレコードは書き出してから止める)
+     */
+    void stop();
+
+    /**
+     * fork の直前に呼ぶ
+     *
+     * 子プロセスには fork を呼んだスレッドしかないので、書き出しスレッドを止めて (溜まっている分は書き出す)、
+     * リングを登録するロックを取った状態で fork する。
+     * fork した後は、親プロセスと子プロセスの両方で `after_fork` を呼ぶこと。
+     */
+    void before_fork();
+
+    /**
+     * fork の直後に、親プロセスと子プロセスの両方で呼ぶ
+     *
+     * `before_fork` で取ったロックを離して、止めた書き出しスレッドを開始し直す。
+     * 子プロセスでは、他のスレッドのリング (子プロセスにはそのスレッドがいない) を使い回せるようにする。
+     */
+    void after_fork();
+
+    /**
+     * リングが一杯で捨てたレコード数を取得する
+     */
+    [[nodiscard]] uint64_t get_dropped_count() const;
+
+    /**
+     * 間引いたアクセスログの件数を取得する
+     */
+    [[nodiscard]] uint64_t get_sampled_out_count() const;
+
+    /**
+     * プロセス共通のロガー (標準エラー出力に書き出す、初回呼び出し時にスレッドを開始する) を取得する
+     * @return ロガー
+     */
+    static async_logger_t &get_default();
+
+    /**
+     * 固定長のレコード
+     */
+    struct record_t;
+
+    /**
+     * スレッド毎のリングバッファ
+     */
+    struct ring_t;
+
+private:
+    config_t config;
+
+    /**
+     * ロガー毎の番号 (スレッドローカルのリングをロガー毎に分けるため)
+     */
+    uint64_t id;
+
+    int fd;
+
+    bool owns_fd;
+
+    /**
+     * 書き出しスレッドが読むリング
+     */
+    std::vector<std::shared_ptr<ring_t>> rings;
+
+    /**
+     * 書き終わったスレッドのリング (次に作られたスレッドで使い回す)
+     */
+    std::vector<std::shared_ptr<ring_t>> free_rings;
+
+    std::mutex rings_mutex;
+
+    std::atomic<uint64_t> dropped_count;
+
+    std::atomic<uint64_t> sampled_out_count;
+
+    std::thread writer_thread;
+
+    /**
+     * `before_fork` を呼んだプロセス
+     */
+    pid_t forking_pid;
+
+    /**
+     * `before_fork` で書き出しスレッドを止めたか (`after_fork` で開始し直す)
+     */
+    bool resume_after_fork;
+
+    std::mutex writer_mutex;
+
+    std::condition_variable writer_condition;
+
+    bool running;
+
+    /**
+     * このスレッドのリングを取得する (初回はリングを登録する)
+     */
+    ring_t &get_ring();
+
+    /**
+     * レコードを書き込む領域を確保する (一杯の場合は nullptr)
+     */
+    record_t* begin_record(ring_t &ring);
+
+    /**
+     * 全てのリングからレコードを取り出して書き出す
+     */
+    void drain();
+
+    /**
+     * ディスクリプタに全て書き込む
+     */
+    void write_all(const std::string &data) const;
+};
+
+
+#endif //HTTP_SERVER_ASYNC_LOGGER_T_H
@@ -0,0 +1,169 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include "buffer_pool_t.h"
+
+const std::array<size_t, buffer_pool_t::CLASS_COUNT> buffer_pool_t::CLASS_SIZES = {
+    2 * 1024,
+    16 * 1024,
+    64 * 1024,
+};
+
+namespace {
+    /**
+     * スレッド毎のキャッシュに入れるクラス毎の最大数
+     */
+    const size_t MAX_THREAD_CACHED = 4;
+
+    /**
+     * 共通のリストに入れるクラス毎の最大バイト数
+     */
+    const size_t MAX_POOLED_BYTES = 8 * 1024 * 1024;
+
+    using free_lists_t = std::array<std::vector<char*>, buffer_pool_t::CLASS_COUNT>;
+
+    /**
+     * プロセス共通のリスト
+     */
+    struct shared_pool_t {
+        std::mutex mutex;
+
+        free_lists_t lists;
+    };
+
+    /**
+     * 共通のリストを取得する
+     * (終了時に、他のスレッドのキャッシュより先に破棄されないよう、わざと解放しない)
+     */
+    shared_pool_t &get_shared_pool() {
+        static auto* pool = new shared_pool_t();
+        return *pool;
+    }
+
+    std::atomic<size_t> g_outstanding_bytes(0);
+
+    /**
+     * 共通のリストに戻す (一杯の場合は解放する)
+     */
+    void give_back(char* data, size_t class_index) {
+        {
+            auto &pool = get_shared_pool();
+            std::lock_guard<std::mutex> lock(pool.mutex);
+            auto &list = pool.lists[class_index];
+            if (list.size() < MAX_POOLED_BYTES / buffer_pool_t::CLASS_SIZES[class_index]) {
+                list.push_back(data);
+                return;
+            }
+        }
+        delete[] data;
+    }
+
+    /**
+     * スレッド毎のキャッシュ (スレッドの終了時に共通のリストに戻す)
+     */
+    struct thread_cache_t {
+        free_lists_t lists;
+
+        ~thread_cache_t() {
+            for (size_t i = 0; i < lists.size(); i++) {
+                for (auto data : lists[i]) {
+                    give_back(data, i);
+                }
+            }
+        }
+    };
+
+    thread_local thread_cache_t t_cache;
+}
+
+buffer_pool_t::buffer_t::buffer_t(char* data, size_t class_index)
+    : data(data),
+      class_index(class_index) {
+}
+
+buffer_pool_t::buffer_t::buffer_t(buffer_t &&other) noexcept
+    : data(std::exchange(other.data, nullptr)),
+      class_index(other.class_index) {
+}
+
+buffer_pool_t::buffer_t &buffer_pool_t::buffer_t::operator=(buffer_t &&other) noexcept {
+    if (this != &other) {
+        this->reset();
+        this->data = std::exchange(other.data, nullptr);
+        this->class_index = other.class_index;
+    }
+    return *this;
+}
+
+buffer_pool_t::buffer_t::~buffer_t() {
+    this->reset();
+}
+
+void buffer_pool_t::buffer_t::reset() {
+    if (this->data) {
+        release(std::exchange(this->data, nullptr), this->class_index);
+    }
+}
+
+buffer_pool_t::buffer_t buffer_pool_t::acquire(size_t min_size) {
+    size_t class_index = 0;
+    while (class_index + 1 < CLASS_COUNT && CLASS_SIZES[class_index] < min_size) {
+        class_index++;
+    }
+    g_outstanding_bytes.fetch_add(CLASS_SIZES[class_index], std::memory_order_relaxed);
+
+    // スレッド毎のキャッシュ → 共通のリスト → 新しく確保 の順に探す
+    auto &cached = t_cache.lists[class_index];
+    if (!cached.empty()) {
+        auto data = cached.back();
+        cached.pop_back();
+        return {data, class_index};
+    }
+    {
+        auto &pool = get_shared_pool();
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        auto &list = pool.lists[class_index];
+        if (!list.empty()) {
+            auto data = list.back();
+            list.pop_back();
+            return {data, class_index};
+        }
+    }
+    return {new char[CLASS_SIZES[class_index]], class_index};
+}
+
+size_t buffer_pool_t::get_next_size(size_t size) {
+    for (auto class_size : CLASS_SIZES) {
+        if (class_size > size) {
+            return class_size;
+        }
+    }
+    return CLASS_SIZES.back();
+}
+
+size_t buffer_pool_t::get_outstanding_bytes() {
+    return g_outstanding_bytes.load(std::memory_order_relaxed);
+}
+
+size_t buffer_pool_t::get_pooled_bytes() {
+    auto &pool = get_shared_pool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    size_t total = 0;
+    for (size_t i = 0; i < CLASS_COUNT; i++) {
+        total += pool.lists[i].size() * CLASS_SIZES[i];
+    }
+    return total;
+}
+
+void buffer_pool_t::release(char* data, size_t class_index) {
+    g_outstanding_bytes.fetch_sub(CLASS_SIZES[class_index], std::memory_order_relaxed);
+
+    auto &cached = t_cache.lists[class_index];
+    if (cached.size() < MAX_THREAD_CACHED) {
+        cached.push_back(data);
+        return;
+    }
+    give_back(data, class_index);
+}
@@ -0,0 +1,115 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_BUFFER_POOL_T_H
+#define HTTP_SERVER_BUFFER_POOL_T_H
+
+/**
+ * サイズクラス別の受信バッファのプール
+ *
+ * バッファの大きさは 2KB / 16KB / 64KB の3種類 (サイズクラス) だけにして、クラス毎に使い回す。
+ *
+ * * 返されたバッファは、まずスレッド毎のキャッシュに入れる (ロックなしで借りられる)
+ * * キャッシュが一杯の場合やスレッドの終了時は、プロセス共通のリストに戻す
+ * * 共通のリストも一杯の場合は解放する
+ *
+ * コネクションは、ソケットが読めるようになってから小さいクラスのバッファを借り、
+ * 一度に読み切れなかった場合だけ大きいクラスに取り替える。読み終わったらすぐに返すので、
+ * 待っているだけのコネクション (keep-alive など) はバッファのメモリを使わない。
+ *
+ * ```
+ * auto buffer = buffer_pool_t::acquire(buffer_pool_t::get_min_size());
+ * const auto received = recv(sd, buffer.get_data(), buffer.get_size(), MSG_DONTWAIT);
+ * ```
+ */
+class buffer_pool_t {
+public:
+    /**
+     * サイズクラスの数
+     */
+    static const size_t CLASS_COUNT = 3;
+
+    /**
+     * サイズクラス毎のバイト数 (昇順)
+     */
+    static const std::array<size_t, CLASS_COUNT> CLASS_SIZES;
+
+    /**
+     * 借りたバッファ (破棄するとプールに返る)
+     */
+    class buffer_t {
+    public:
+        buffer_t() = default;
+
+        buffer_t(buffer_t &&other) noexcept;
+
+        buffer_t &operator=(buffer_t &&other) noexcept;
+
+        buffer_t(const buffer_t &) = delete;
+
+        buffer_t &operator=(const buffer_t &) = delete;
+
+        ~buffer_t();
+
+        [[nodiscard]] inline char* get_data() const {
+            return this->data;
+        }
+
+        [[nodiscard]] inline size_t get_size() const {
+            return this->data ? CLASS_SIZES[this->class_index] : 0;
+        }
+
+        /**
+         * プールに返す
+         */
+        void reset();
+
+    private:
+        friend class buffer_pool_t;
+
+        buffer_t(char* data, size_t class_index);
+
+        char* data = nullptr;
+
+        size_t class_index = 0;
+    };
+
+    /**
+     * バッファを借りる
+     * @param [in] min_size 必要なバイト数 (一番大きいクラスより大きい場合は、一番大きいクラスになる)
+     * @return `min_size` 以上の一番小さいクラスのバッファ
+     */
+    static buffer_t acquire(size_t min_size);
+
+    /**
+     * 一番小さいクラスのバイト数を取得する
+     */
+    static inline size_t get_min_size() {
+        return CLASS_SIZES.front();
+    }
+
+    /**
+     * 1つ大きいクラスのバイト数を取得する
+     * @param [in] size 今のバイト数
+     * @return 1つ大きいクラスのバイト数 (一番大きいクラスの場合はそのまま)
+     */
+    static size_t get_next_size(size_t size);
+
+    /**
+     * 貸し出し中のバッファの合計バイト数を取得する
+     */
+    static size_t get_outstanding_bytes();
+
+    /**
+     * プール (共通のリスト) に入っているバッファの合計バイト数を取得する
+     * (スレッド毎のキャッシュの分は含まない)
+     */
+    static size_t get_pooled_bytes();
+
+private:
+    static void release(char* data, size_t class_index);
+};
+
+
+#endif //HTTP_SERVER_BUFFER_POOL_T_H
@@ -0,0 +1,38 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include "cgi_environment_t.h"
+#include "http_request_t.h"
+#include "request_body_t.h"
+
+cgi_environment_t::cgi_environment_t(const http_request_t &request) {
+    // 大抵は数十バイトで収まる
+    this->buffer.reserve(128);
+    this->offsets.reserve(4);
+
+    this->add("CONTENT_LENGTH", std::to_string(request.get_body_storage().size()));
+
+    const auto &header = request.get_header();
+    const auto it = header.find("Content-Type");
+    if (it != header.end()) {
+        this->add("CONTENT_TYPE", it->second);
+    }
+}
+
+void cgi_environment_t::add(std::string_view name, std::string_view value) {
+    this->offsets.push_back(this->buffer.size());
+    this->buffer.append(name).append(1, '=').append(value).append(1, '\0');
+}
+
+char** cgi_environment_t::get_envp() {
+    // buffer は add で再確保されることがあるので、ポインタは取得する度に作る
+    this->envp.clear();
+    this->envp.reserve(this->offsets.size() + 1);
+    for (const auto offset : this->offsets) {
+        this->envp.push_back(this->buffer.data() + offset);
+    }
+    this->envp.push_back(nullptr);
+    return this->envp.data();
+}
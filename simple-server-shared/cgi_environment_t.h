@@ -0,0 +1,68 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_CGI_ENVIRONMENT_T_H
+#define HTTP_SERVER_CGI_ENVIRONMENT_T_H
+
+class http_request_t;
+
+/**
+ * CGI スクリプトに渡す環境変数 (`execve` の `envp`)
+ *
+ * `名前=値\0` を1つの文字列に詰めて持ち、`get_envp` でその中を指すポインタの配列を返す。
+ * 変数毎に文字列を確保しないので、確保は変数の数によらず数回で済む。
+ *
+ * ```
+ * cgi_environment_t environment(request);
+ * execve(path, argv, environment.get_envp());
+ * ```
+ */
+class cgi_environment_t {
+public:
+    /**
+     * リクエストから環境変数 (`CONTENT_LENGTH`, `CONTENT_TYPE`) を作る
+     * @param [in] request リクエスト
+     */
+    explicit cgi_environment_t(const http_request_t &request);
+
+    cgi_environment_t(const cgi_environment_t &) = delete;
+
+    cgi_environment_t &operator=(const cgi_environment_t &) = delete;
+
+    /**
+     * 環境変数を追加する
+     * @param [in] name 名前
+     * @param [in] value 値
+     */
+    void add(std::string_view name, std::string_view value);
+
+    /**
+     * 環境変数の数を取得する
+     */
+    [[nodiscard]] inline size_t size() const {
+        return this->offsets.size();
+    }
+
+    /**
+     * `execve` に渡す、nullptr で終わるポインタの配列を取得する
+     * (`add` すると作り直すので、取得した後に `add` した場合は取得し直す)
+     */
+    [[nodiscard]] char** get_envp();
+
+private:
+    /**
+     * `名前=値\0` を続けた文字列
+     */
+    std::string buffer;
+
+    /**
+     * 各変数の `buffer` の中の開始位置
+     */
+    std::vector<size_t> offsets;
+
+    std::vector<char*> envp;
+};
+
+
+#endif //HTTP_SERVER_CGI_ENVIRONMENT_T_H
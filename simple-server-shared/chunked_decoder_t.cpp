@@ -0,0 +1,139 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <boost/algorithm/string.hpp>
+#include "chunked_decoder_t.h"
+#include "http_constants_t.h"
+
+chunked_decoder_t::chunked_decoder_t(const config_t &config)
+    : config(config),
+      state(state_t::size_line),
+      chunk_remaining(0),
+      trailer_size(0),
+      decoded_size(0) {
+}
+
+size_t chunked_decoder_t::feed(const char* data, size_t size, const data_handler_t &on_data) {
+    size_t position = 0;
+
+    while (position < size && this->state != state_t::done) {
+        switch (this->state) {
+            case state_t::size_line:
+                if (this->read_line(data, size, position, this->config.max_line_size)) {
+                    this->parse_size_line();
+                }
+                break;
+
+            case state_t::data: {
+                // データ部分は受信バッファを指したままハンドラに渡す
+                const auto length = std::min(this->chunk_remaining, size - position);
+                if (on_data) {
+                    on_data(data + position, length);
+                }
+                position += length;
+                this->chunk_remaining -= length;
+                this->decoded_size += length;
+                if (this->chunk_remaining == 0) {
+                    this->state = state_t::data_crlf;
+                }
+                break;
+            }
+
+            case state_t::data_crlf:
+                if (this->read_line(data, size, position, http_constants_t::CRLF.size())) {
+                    if (!this->line.empty()) {
+                        throw std::runtime_error("チャンクのデータの後に CRLF がありません。");
+                    }
+                    this->state = state_t::size_line;
+                }
+                break;
+
+            case state_t::trailer:
+                if (this->read_line(data, size, position, this->config.max_trailer_size)) {
+                    this->trailer_size += this->line.size() + http_constants_t::CRLF.size();
+                    if (this->trailer_size > this->config.max_trailer_size) {
+                        throw std::runtime_error("トレイラーが大きすぎます。");
+                    }
+                    if (this->line.empty()) {
+                        this->state = state_t::done;
+                    } else {
+                        this->parse_trailer_line();
+                    }
+                }
+                break;
+
+            case state_t::done:
+                break;
+        }
+    }
+
+    return position;
+}
+
+bool chunked_decoder_t::read_line(const char* data, size_t size, size_t &position, size_t max_size) {
+    // 前回の受信で CR まで読んでいる場合もあるので、行の末尾とあわせて LF を探す
+    const auto begin = data + position;
+    const auto end = data + size;
+    const auto lf = std::find(begin, end, '\n');
+
+    this->line.append(begin, lf);
+    position += lf - begin;
+
+    if (this->line.size() > max_size + 1) {
+        throw std::runtime_error("チャンクの行が長すぎます。");
+    }
+
+    if (lf == end) {
+        return false;
+    }
+
+    // LF を消費する
+    position++;
+    if (this->line.empty() || this->line.back() != '\r') {
+        throw std::runtime_error("チャンクの行が CRLF で終わっていません。");
+    }
+    this->line.pop_back();
+    return true;
+}
+
+void chunked_decoder_t::parse_size_line() {
+    // chunk-ext は使わないので捨てる
+    const auto size_text = boost::trim_copy(this->line.substr(0, this->line.find(';')));
+    this->line.clear();
+
+    if (size_text.empty() || size_text.size() > 16
+        || !std::all_of(size_text.begin(), size_text.end(), [](char c) { return std::isxdigit(static_cast<unsigned char>(c)); })) {
+        throw std::runtime_error("チャンクサイズが不正です。");
+    }
+
+    const auto chunk_size = std::stoull(size_text, nullptr, 16);
+    if (chunk_size > this->config.max_chunk_size) {
+        throw std::runtime_error("チャンクが大きすぎます。");
+    }
+
+    if (chunk_size == 0) {
+        // last-chunk の後はトレイラー
+        this->state = state_t::trailer;
+        return;
+    }
+
+    this->chunk_remaining = chunk_size;
+    this->state = state_t::data;
+}
+
+void chunked_decoder_t::parse_trailer_line() {
+    const auto delimiter = this->line.find(http_constants_t::HEADER_DELIMITER);
+    if (delimiter == std::string::npos) {
+        throw std::runtime_error("トレイラーのデリミタ \":\" が含まれていません");
+    }
+
+    const auto key = this->line.substr(0, delimiter);
+    const auto value = this->line.substr(delimiter + 1);
+    this->line.clear();
+
+    if (this->trailer.count(key) == 0) {
+        this->trailer[key] = value;
+    }
+}
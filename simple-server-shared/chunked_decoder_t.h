@@ -0,0 +1,155 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_CHUNKED_DECODER_T_H
+#define HTTP_SERVER_CHUNKED_DECODER_T_H
+
+/**
+ * `Transfer-Encoding: chunked` のボディを少しずつデコードするクラス
+ *
+ * ```
+ * chunked-body = *chunk
+ *                last-chunk
+ *                trailer-part
+ *                CRLF
+ * chunk        = chunk-size [ chunk-ext ] CRLF chunk-data CRLF
+ * last-chunk   = 1*("0") [ chunk-ext ] CRLF
+ * ```
+ *
+ * 受信したバイト列をどこで区切って渡しても良い。
+ * チャンクのデータ部分は、受信バッファを指すポインタのままハンドラに渡すので、
+ * ボディ全体を組み立て直すコピーは発生しない。
+ */
+class chunked_decoder_t {
+public:
+    /**
+     * デコードの制限
+     */
+    struct config_t {
+        /**
+         * 1チャンクの最大バイト数
+         */
+        size_t max_chunk_size = 16 * 1024 * 1024;
+
+        /**
+         * チャンクサイズ行 (拡張を含む) の最大バイト数
+         */
+        size_t max_line_size = 1024;
+
+        /**
+         * トレイラー全体の最大バイト数
+         */
+        size_t max_trailer_size = 8 * 1024;
+    };
+
+    /**
+     * チャンクのデータを受け取るハンドラ
+     *
+     * `data` は `feed` に渡したバッファの中を指すので、ハンドラの外で使う場合はコピーすること。
+     */
+    using data_handler_t = std::function<void(const char* data, size_t size)>;
+
+    explicit chunked_decoder_t(const config_t &config);
+
+    /**
+     * 受信したバイト列をデコードする
+     *
+     * 不正なフォーマットや制限を超えた場合は `std::runtime_error` を投げる。
+     *
+     * @param [in] data 受信したバイト列
+     * @param [in] size バイト数
+     * @param [in] on_data チャンクのデータを受け取るハンドラ
+     * @return 消費したバイト数 (ボディの終端以降のバイト列は消費しない)
+     */
+    size_t feed(const char* data, size_t size, const data_handler_t &on_data);
+
+    /**
+     * ボディの終端 (トレイラーの後の空行) まで受信したか
+     * @return 受信済みの場合 `true`
+     */
+    [[nodiscard]] inline bool is_done() const {
+        return this->state == state_t::done;
+    }
+
+    /**
+     * デコードしたデータの合計バイト数を取得する
+     * @return 合計バイト数
+     */
+    [[nodiscard]] inline size_t get_decoded_size() const {
+        return this->decoded_size;
+    }
+
+    /**
+     * トレイラーを取得する
+     * @return トレイラー
+     */
+    [[nodiscard]] inline const std::map<std::string, std::string>& get_trailer() const {
+        return this->trailer;
+    }
+
+private:
+    enum class state_t {
+        /**
+         * チャンクサイズ行を読み込み中
+         */
+        size_line,
+        /**
+         * チャンクのデータを読み込み中
+         */
+        data,
+        /**
+         * チャンクのデータの後の CRLF を読み込み中
+         */
+        data_crlf,
+        /**
+         * トレイラーを読み込み中
+         */
+        trailer,
+        /**
+         * 終了
+         */
+        done,
+    };
+
+    config_t config;
+
+    state_t state;
+
+    /**
+     * 読み込み途中の行
+     */
+    std::string line;
+
+    /**
+     * 現在のチャンクの残りバイト数
+     */
+    size_t chunk_remaining;
+
+    /**
+     * トレイラーの合計バイト数
+     */
+    size_t trailer_size;
+
+    size_t decoded_size;
+
+    std::map<std::string, std::string> trailer;
+
+    /**
+     * 1行読み込む (CRLF まで揃ったら `true` を返し、`line` に CRLF を除いた行が入る)
+     */
+    bool read_line(const char* data, size_t size, size_t &position, size_t max_size);
+
+    /**
+     * チャンクサイズ行を解釈する
+     */
+    void parse_size_line();
+
+    /**
+     * トレイラー行を解釈する
+     */
+    void parse_trailer_line();
+};
+
+
+#endif //HTTP_SERVER_CHUNKED_DECODER_T_H
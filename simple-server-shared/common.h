@@ -1,17 +1,39 @@
 #ifndef HTTP_SERVER_COMMON_H
 #define HTTP_SERVER_COMMON_H
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <iostream>
+#include <limits>
+#include <list>
 #include <map>
+#include <memory_resource>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <system_error>
 #include <thread>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <csignal>
+#include <cstring>
 #include <cerrno>
+#include <cstdlib>
+#include <cstdint>
 
 #include <arpa/inet.h>
 #include <netinet/ip.h>
@@ -0,0 +1,16 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include "compression_stage_t.h"
+#include "compression_stream_t.h"
+#include "http_compressor_t.h"
+
+compression_stage_t::compression_stage_t(http_compressor_t &compressor)
+    : compressor(&compressor) {
+}
+
+void compression_stage_t::apply(const http_request_t &request, http_response_t &response) const {
+    this->compressor->apply(request, response);
+}
@@ -0,0 +1,37 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_COMPRESSION_STAGE_T_H
+#define HTTP_SERVER_COMPRESSION_STAGE_T_H
+
+class http_request_t;
+class http_response_t;
+class http_compressor_t;
+
+/**
+ * ハンドラが作ったレスポンスを `Accept-Encoding` に従って圧縮するミドルウェア
+ *
+ * 各ハンドラで `http_compressor_t::apply` を呼ぶかわりに、パイプラインの外側に置く。
+ */
+class compression_stage_t {
+public:
+    /**
+     * @param [in] compressor 圧縮の設定 (パイプラインより長く生きていること)
+     */
+    explicit compression_stage_t(http_compressor_t &compressor);
+
+    template<typename Next>
+    inline void handle(const http_request_t &request, http_response_t &response, Next &&next) {
+        next();
+        this->apply(request, response);
+    }
+
+private:
+    http_compressor_t* compressor;
+
+    void apply(const http_request_t &request, http_response_t &response) const;
+};
+
+
+#endif //HTTP_SERVER_COMPRESSION_STAGE_T_H
@@ -0,0 +1,199 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <zlib.h>
+#if defined(HTTP_SERVER_HAVE_ZSTD)
+#include <zstd.h>
+#endif
+#if defined(HTTP_SERVER_HAVE_BROTLI)
+#include <brotli/encode.h>
+#endif
+#include "compression_stream_t.h"
+
+namespace {
+    /**
+     * 圧縮結果を受け取る一時バッファのサイズ
+     */
+    const size_t OUTPUT_CHUNK_SIZE = 16 * 1024;
+}
+
+compression_stream_t::compression_stream_t(content_encoding_t encoding, int level)
+    : encoding(encoding),
+      stream(nullptr),
+      finished(false) {
+
+    switch (encoding) {
+        case content_encoding_t::gzip: {
+            auto z = new z_stream{};
+            // windowBits に 16 を足すと gzip ヘッダ付きになる
+            const auto ret = deflateInit2(z, std::clamp(level, 1, 9), Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+            if (ret != Z_OK) {
+                delete z;
+                throw std::runtime_error("deflateInit2 に失敗しました。");
+            }
+            this->stream = z;
+            break;
+        }
+#if defined(HTTP_SERVER_HAVE_ZSTD)
+        case content_encoding_t::zstd: {
+            auto z = ZSTD_createCCtx();
+            ZSTD_CCtx_setParameter(z, ZSTD_c_compressionLevel, std::clamp(level, 1, 19));
+            this->stream = z;
+            break;
+        }
+#endif
+#if defined(HTTP_SERVER_HAVE_BROTLI)
+        case content_encoding_t::br: {
+            auto b = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+            BrotliEncoderSetParameter(b, BROTLI_PARAM_QUALITY, static_cast<uint32_t>(std::clamp(level, 0, 11)));
+            this->stream = b;
+            break;
+        }
+#endif
+        default:
+            throw std::runtime_error("サポートしていない Content-Encoding です。");
+    }
+}
+
+compression_stream_t::~compression_stream_t() {
+    switch (this->encoding) {
+        case content_encoding_t::gzip: {
+            auto z = static_cast<z_stream*>(this->stream);
+            deflateEnd(z);
+            delete z;
+            break;
+        }
+#if defined(HTTP_SERVER_HAVE_ZSTD)
+        case content_encoding_t::zstd:
+            ZSTD_freeCCtx(static_cast<ZSTD_CCtx*>(this->stream));
+            break;
+#endif
+#if defined(HTTP_SERVER_HAVE_BROTLI)
+        case content_encoding_t::br:
+            BrotliEncoderDestroyInstance(static_cast<BrotliEncoderState*>(this->stream));
+            break;
+#endif
+        default:
+            break;
+    }
+}
+
+std::string compression_stream_t::write(const char* data, size_t size) {
+    if (this->finished) {
+        throw std::runtime_error("圧縮ストリームは終了しています。");
+    }
+    std::string output;
+    this->process(data, size, false, output);
+    return output;
+}
+
+std::string compression_stream_t::finish() {
+    std::string output;
+    if (!this->finished) {
+        this->process(nullptr, 0, true, output);
+        this->finished = true;
+    }
+    return output;
+}
+
+std::string compression_stream_t::compress(content_encoding_t encoding, int level, const std::string &data) {
+    compression_stream_t stream(encoding, level);
+    auto output = stream.write(data.data(), data.size());
+    output.append(stream.finish());
+    return output;
+}
+
+bool compression_stream_t::is_supported(content_encoding_t encoding) {
+    switch (encoding) {
+        case content_encoding_t::identity:
+        case content_encoding_t::gzip:
+            return true;
+#if defined(HTTP_SERVER_HAVE_ZSTD)
+        case content_encoding_t::zstd:
+            return true;
+#endif
+#if defined(HTTP_SERVER_HAVE_BROTLI)
+        case content_encoding_t::br:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+const char* compression_stream_t::get_name(content_encoding_t encoding) {
+    switch (encoding) {
+        case content_encoding_t::gzip:
+            return "gzip";
+        case content_encoding_t::zstd:
+            return "zstd";
+        case content_encoding_t::br:
+            return "br";
+        default:
+            return "identity";
+    }
+}
+
+void compression_stream_t::process(const char* data, size_t size, bool finish, std::string &output) {
+    char buffer[OUTPUT_CHUNK_SIZE];
+
+    switch (this->encoding) {
+        case content_encoding_t::gzip: {
+            auto z = static_cast<z_stream*>(this->stream);
+            z->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+            z->avail_in = static_cast<uInt>(size);
+            const auto flush = finish ? Z_FINISH : Z_NO_FLUSH;
+            int ret;
+            do {
+                z->next_out = reinterpret_cast<Bytef*>(buffer);
+                z->avail_out = sizeof(buffer);
+                ret = deflate(z, flush);
+                if (ret == Z_STREAM_ERROR) {
+                    throw std::runtime_error("deflate に失敗しました。");
+                }
+                output.append(buffer, sizeof(buffer) - z->avail_out);
+            } while (z->avail_out == 0 || (finish && ret != Z_STREAM_END));
+            break;
+        }
+#if defined(HTTP_SERVER_HAVE_ZSTD)
+        case content_encoding_t::zstd: {
+            auto z = static_cast<ZSTD_CCtx*>(this->stream);
+            ZSTD_inBuffer in{data, size, 0};
+            const auto directive = finish ? ZSTD_e_end : ZSTD_e_continue;
+            size_t remaining;
+            do {
+                ZSTD_outBuffer out{buffer, sizeof(buffer), 0};
+                remaining = ZSTD_compressStream2(z, &out, &in, directive);
+                if (ZSTD_isError(remaining)) {
+                    throw std::runtime_error("ZSTD_compressStream2 に失敗しました。");
+                }
+                output.append(buffer, out.pos);
+            } while (finish ? remaining != 0 : in.pos < in.size);
+            break;
+        }
+#endif
+#if defined(HTTP_SERVER_HAVE_BROTLI)
+        case content_encoding_t::br: {
+            auto b = static_cast<BrotliEncoderState*>(this->stream);
+            auto available_in = size;
+            auto next_in = reinterpret_cast<const uint8_t*>(data);
+            const auto operation = finish ? BROTLI_OPERATION_FINISH : BROTLI_OPERATION_PROCESS;
+            do {
+                size_t available_out = sizeof(buffer);
+                auto next_out = reinterpret_cast<uint8_t*>(buffer);
+                if (!BrotliEncoderCompressStream(b, operation, &available_in, &next_in,
+                                                 &available_out, &next_out, nullptr)) {
+                    throw std::runtime_error("BrotliEncoderCompressStream に失敗しました。");
+                }
+                output.append(buffer, sizeof(buffer) - available_out);
+            } while (available_in > 0 || BrotliEncoderHasMoreOutput(b)
+                     || (finish && !BrotliEncoderIsFinished(b)));
+            break;
+        }
+#endif
+        default:
+            break;
+    }
+}
@@ -0,0 +1,94 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_COMPRESSION_STREAM_T_H
+#define HTTP_SERVER_COMPRESSION_STREAM_T_H
+
+/**
+ * レスポンスの Content-Encoding
+ */
+enum class content_encoding_t : int {
+    identity,
+    gzip,
+    zstd,
+    br,
+};
+
+/**
+ * ストリーミング圧縮を行うクラス
+ *
+ * 大きなボディや chunked で送るボディを、全体を溜め込まずに少しずつ圧縮する。
+ * `write` で渡したデータの圧縮結果は、内部に溜まっている分があるので `finish` まで全部は出てこない。
+ *
+ * zstd と brotli はライブラリがある環境でビルドした場合だけ使える。
+ */
+class compression_stream_t {
+public:
+    /**
+     * @param [in] encoding エンコーディング (identity 以外)
+     * @param [in] level 圧縮レベル (エンコーディング毎の範囲に丸める)
+     */
+    compression_stream_t(content_encoding_t encoding, int level);
+
+    ~compression_stream_t();
+
+    compression_stream_t(const compression_stream_t &) = delete;
+
+    compression_stream_t &operator=(const compression_stream_t &) = delete;
+
+    /**
+     * データを圧縮する
+     * @param [in] data データ
+     * @param [in] size データのバイト数
+     * @return 圧縮結果 (まだ出力がない場合は空文字列)
+     */
+    std::string write(const char* data, size_t size);
+
+    /**
+     * ここまでに書き込んだデータを全て出力して、ストリームを終了する
+     * @return 残りの圧縮結果
+     */
+    std::string finish();
+
+    /**
+     * 一括で圧縮する
+     * @param [in] encoding エンコーディング
+     * @param [in] level 圧縮レベル
+     * @param [in] data データ
+     * @return 圧縮結果
+     */
+    static std::string compress(content_encoding_t encoding, int level, const std::string &data);
+
+    /**
+     * このビルドでエンコーディングが使えるか判定する
+     * @param [in] encoding エンコーディング
+     * @return 使える場合 `true`
+     */
+    [[nodiscard]] static bool is_supported(content_encoding_t encoding);
+
+    /**
+     * エンコーディングの名前 (Content-Encoding ヘッダの値) を取得する
+     * @param [in] encoding エンコーディング
+     * @return 名前
+     */
+    [[nodiscard]] static const char* get_name(content_encoding_t encoding);
+
+private:
+    content_encoding_t encoding;
+
+    /**
+     * 圧縮ライブラリのストリーム (エンコーディング毎に型が違うので void* で持つ)
+     */
+    void* stream;
+
+    bool finished;
+
+    /**
+     * 圧縮ライブラリにデータを渡して、出力を `output` に追加する
+     */
+    void process(const char* data, size_t size, bool finish, std::string &output);
+};
+
+
+#endif //HTTP_SERVER_COMPRESSION_STREAM_T_H
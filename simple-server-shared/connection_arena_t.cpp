@@ -0,0 +1,45 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include "connection_arena_t.h"
+
+const size_t connection_arena_t::INITIAL_SIZE = 16 * 1024;
+
+const size_t connection_arena_t::MAX_POOLED = 256;
+
+std::mutex connection_arena_t::pool_mutex;
+
+std::vector<std::unique_ptr<connection_arena_t>> connection_arena_t::pool;
+
+connection_arena_t::connection_arena_t()
+    : buffer(std::make_unique<std::byte[]>(INITIAL_SIZE)),
+      resource(buffer.get(), INITIAL_SIZE, std::pmr::new_delete_resource()) {
+}
+
+void connection_arena_t::reset() {
+    this->resource.release();
+}
+
+connection_arena_t::handle_t connection_arena_t::acquire() {
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        if (!pool.empty()) {
+            auto arena = std::move(pool.back());
+            pool.pop_back();
+            return handle_t(arena.release());
+        }
+    }
+    return handle_t(new connection_arena_t());
+}
+
+void connection_arena_t::releaser_t::operator()(connection_arena_t* arena) const {
+    arena->reset();
+
+    std::unique_ptr<connection_arena_t> owned(arena);
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    if (pool.size() < MAX_POOLED) {
+        pool.push_back(std::move(owned));
+    }
+}
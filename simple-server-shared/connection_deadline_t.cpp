@@ -0,0 +1,70 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include "timing_wheel_t.h"
+#include "connection_deadline_t.h"
+
+std::mutex connection_deadline_t::timeouts_mutex;
+connection_deadline_t::timeouts_t connection_deadline_t::timeouts;
+
+connection_deadline_t::connection_deadline_t(int sd)
+    : sd(sd),
+      phase(phase_t::idle),
+      expired(false),
+      timer([this] {
+          // タイミングホイールのロック中に呼ばれるので、ここでは shutdown だけ行う
+          // (close はソケットの持ち主が行う)
+          this->expired.store(true, std::memory_order_release);
+          ::shutdown(this->sd, SHUT_RDWR);
+      }) {
+}
+
+connection_deadline_t::~connection_deadline_t() {
+    this->cancel();
+}
+
+void connection_deadline_t::enter(phase_t _phase) {
+    this->phase = _phase;
+
+    const auto current_timeouts = get_timeouts();
+    std::chrono::milliseconds timeout{};
+    switch (_phase) {
+        case phase_t::idle:
+            timeout = current_timeouts.idle;
+            break;
+        case phase_t::header:
+            timeout = current_timeouts.header;
+            break;
+        case phase_t::body:
+            timeout = current_timeouts.body;
+            break;
+        case phase_t::write:
+            timeout = current_timeouts.write;
+            break;
+    }
+
+    if (timeout.count() <= 0) {
+        this->cancel();
+        return;
+    }
+    timing_wheel_t::get_default().arm(this->timer, timeout);
+}
+
+void connection_deadline_t::cancel() {
+    // is_armed() をロックなしで見てはいけない
+    // (ホイールのスレッドはスロットから外してからハンドラを呼ぶので、ハンドラの実行中に「登録されていない」と見える。
+    // そこで戻ってこのインスタンスを破棄すると、ハンドラが破棄した後のメモリや、別のコネクションが使い回した sd に触る)
+    timing_wheel_t::get_default().cancel(this->timer);
+}
+
+void connection_deadline_t::set_timeouts(const timeouts_t &_timeouts) {
+    std::lock_guard<std::mutex> lock(timeouts_mutex);
+    timeouts = _timeouts;
+}
+
+connection_deadline_t::timeouts_t connection_deadline_t::get_timeouts() {
+    std::lock_guard<std::mutex> lock(timeouts_mutex);
+    return timeouts;
+}
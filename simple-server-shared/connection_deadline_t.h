@@ -0,0 +1,123 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_CONNECTION_DEADLINE_T_H
+#define HTTP_SERVER_CONNECTION_DEADLINE_T_H
+
+/**
+ * コネクションのタイムアウトを管理するクラス
+ *
+ * コネクションの状態 (フェーズ) 毎にタイムアウトを設定し、期限が切れたらソケットを `shutdown` する。
+ * `shutdown` されたソケットは `recv` が 0 を返し、`send` がエラーになるので、
+ * 読み書き中のスレッドはそこで処理を打ち切れる。
+ *
+ * これで、接続したまま何も送ってこないクライアントや、1バイトずつゆっくり送ってくるクライアント (slowloris) に
+ * スレッドやソケットを占有されなくなる。
+ *
+ * タイマーはこのインスタンスに埋め込まれていて (ヒープを使わない)、プロセス共通のタイミングホイールに登録する。
+ *
+ * ※ このヘッダより先に timing_wheel_t.h をインクルードすること。
+ */
+class connection_deadline_t {
+public:
+    /**
+     * コネクションのフェーズ
+     */
+    enum class phase_t {
+        /**
+         * リクエストの最初のバイトを待っている (keep-alive の待機中も含む)
+         */
+        idle,
+        /**
+         * ヘッダを受信中
+         */
+        header,
+        /**
+         * ボディを受信中
+         */
+        body,
+        /**
+         * レスポンスを送信中
+         */
+        write,
+    };
+
+    /**
+     * フェーズ毎のタイムアウト (0 の場合はタイムアウトしない)
+     */
+    struct timeouts_t {
+        std::chrono::milliseconds idle = std::chrono::seconds(30);
+        std::chrono::milliseconds header = std::chrono::seconds(10);
+        std::chrono::milliseconds body = std::chrono::seconds(60);
+        std::chrono::milliseconds write = std::chrono::seconds(30);
+    };
+
+    /**
+     * @param [in] sd ソケットディスクリプタ
+     */
+    explicit connection_deadline_t(int sd);
+
+    ~connection_deadline_t();
+
+    connection_deadline_t(const connection_deadline_t &) = delete;
+
+    connection_deadline_t &operator=(const connection_deadline_t &) = delete;
+
+    /**
+     * フェーズに入る (そのフェーズのタイムアウトでタイマーを登録し直す)
+     * @param [in] phase フェーズ
+     */
+    void enter(phase_t phase);
+
+    /**
+     * タイマーを取り消す (ソケットを `close` する前に必ず呼ぶこと)
+     *
+     * 期限切れのハンドラが実行中の場合は、終わるまで待ってから戻る。
+     */
+    void cancel();
+
+    /**
+     * 期限切れになったか
+     * @return 期限切れの場合 `true`
+     */
+    [[nodiscard]] inline bool is_expired() const {
+        return this->expired.load(std::memory_order_acquire);
+    }
+
+    /**
+     * 現在のフェーズを取得する
+     * @return フェーズ
+     */
+    [[nodiscard]] inline phase_t get_phase() const {
+        return this->phase;
+    }
+
+    /**
+     * フェーズ毎のタイムアウトを設定する (全コネクション共通)
+     * @param [in] timeouts タイムアウト
+     */
+    static void set_timeouts(const timeouts_t &timeouts);
+
+    /**
+     * フェーズ毎のタイムアウトを取得する
+     * @return タイムアウト
+     */
+    static timeouts_t get_timeouts();
+
+private:
+    int sd;
+
+    phase_t phase;
+
+    std::atomic<bool> expired;
+
+    wheel_timer_t timer;
+
+    static std::mutex timeouts_mutex;
+
+    static timeouts_t timeouts;
+};
+
+
+#endif //HTTP_SERVER_CONNECTION_DEADLINE_T_H
@@ -0,0 +1,242 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <boost/algorithm/string.hpp>
+#include <sys/stat.h>
+#include "compression_stream_t.h"
+#include "http_compressor_t.h"
+#include "http_request_t.h"
+#include "http_response_t.h"
+
+namespace {
+    /**
+     * 優先順位の高い順のエンコーディングと、事前圧縮ファイルの拡張子
+     */
+    const std::tuple<content_encoding_t, const char*> ENCODING_PREFERENCES[] = {
+        {content_encoding_t::br, ".br"},
+        {content_encoding_t::zstd, ".zst"},
+        {content_encoding_t::gzip, ".gz"},
+    };
+
+    /**
+     * `Accept-Encoding` を解釈して、エンコーディング毎の q値を返す
+     *
+     * 指定されていないエンコーディングは `*` の q値 (なければ 0) になる。
+     */
+    std::map<content_encoding_t, double> parse_accept_encoding(const std::string &accept_encoding) {
+        std::map<content_encoding_t, double> result;
+        std::optional<double> wildcard;
+
+        std::vector<std::string> items;
+        boost::split(items, accept_encoding, boost::is_any_of(","), boost::token_compress_on);
+        for (auto &item : items) {
+            std::vector<std::string> params;
+            boost::split(params, item, boost::is_any_of(";"), boost::token_compress_on);
+            auto name = boost::to_lower_copy(boost::trim_copy(params[0]));
+
+            auto q = 1.0;
+            for (size_t i = 1; i < params.size(); i++) {
+                const auto param = boost::trim_copy(params[i]);
+                if (boost::starts_with(param, "q=")) {
+                    try {
+                        q = std::stod(param.substr(2));
+                    } catch (const std::exception &) {
+                        q = 0.0;
+                    }
+                }
+            }
+
+            if (name == "*") {
+                wildcard = q;
+            } else if (name == "gzip" || name == "x-gzip") {
+                result[content_encoding_t::gzip] = q;
+            } else if (name == "zstd") {
+                result[content_encoding_t::zstd] = q;
+            } else if (name == "br") {
+                result[content_encoding_t::br] = q;
+            }
+        }
+
+        for (const auto &preference : ENCODING_PREFERENCES) {
+            const auto encoding = std::get<0>(preference);
+            if (result.count(encoding) == 0) {
+                result[encoding] = wildcard.value_or(0.0);
+            }
+        }
+        return result;
+    }
+
+    /**
+     * 圧縮結果キャッシュのキー用のハッシュ (FNV-1a)
+     */
+    uint64_t fnv1a(const std::string &data) {
+        uint64_t hash = 14695981039346656037ULL;
+        for (const auto c : data) {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+}
+
+http_compressor_t::http_compressor_t(const config_t &config)
+    : config(config) {
+}
+
+content_encoding_t http_compressor_t::select_encoding(const std::string &accept_encoding) {
+    if (accept_encoding.empty()) {
+        return content_encoding_t::identity;
+    }
+
+    const auto q_values = parse_accept_encoding(accept_encoding);
+
+    auto selected = content_encoding_t::identity;
+    auto selected_q = 0.0;
+    for (const auto &preference : ENCODING_PREFERENCES) {
+        const auto encoding = std::get<0>(preference);
+        if (!compression_stream_t::is_supported(encoding)) {
+            continue;
+        }
+        const auto q = q_values.at(encoding);
+        if (q > selected_q) {
+            selected = encoding;
+            selected_q = q;
+        }
+    }
+    return selected;
+}
+
+content_encoding_t http_compressor_t::select_encoding(const http_request_t &request) {
+    const auto &header = request.get_header();
+    auto it = header.find("Accept-Encoding");
+    if (it == header.end()) {
+        return content_encoding_t::identity;
+    }
+    return select_encoding(std::string(it->second));
+}
+
+int http_compressor_t::get_level(const std::string &content_type) const {
+    const auto media_type = boost::to_lower_copy(boost::trim_copy(content_type.substr(0, content_type.find(';'))));
+    for (const auto &rule : this->config.level_rules) {
+        if (boost::starts_with(media_type, rule.content_type_prefix)) {
+            return std::max(rule.level, 0);
+        }
+    }
+    return 0;
+}
+
+void http_compressor_t::apply(const http_request_t &request, http_response_t &response) {
+    const auto &response_header = response.get_header();
+    if (response_header.count("Content-Encoding") != 0) {
+        return;
+    }
+
+    const auto &body = response.get_body();
+    if (body.size() < this->config.min_size) {
+        return;
+    }
+
+    auto content_type_it = response_header.find("Content-Type");
+    if (content_type_it == response_header.end()) {
+        return;
+    }
+    const auto level = this->get_level(std::string(content_type_it->second));
+    if (level <= 0) {
+        return;
+    }
+
+    // クライアントによって内容が変わるので、圧縮しない場合も Vary を付ける
+    // (既に Vary がある場合も Accept-Encoding を落とさないように、後ろに付け足す)
+    response.append_header_value("Vary", "Accept-Encoding");
+
+    const auto encoding = select_encoding(request);
+    if (encoding == content_encoding_t::identity) {
+        return;
+    }
+
+    const auto compressed = this->compress_cached(encoding, level, body);
+    if (compressed->size() >= body.size()) {
+        // 圧縮しても小さくならない場合はそのまま返す
+        return;
+    }
+
+    response.set_body(*compressed);
+    response.add_header("Content-Encoding", compression_stream_t::get_name(encoding));
+}
+
+std::optional<std::tuple<std::string, content_encoding_t>> http_compressor_t::find_precompressed(
+    const std::string &path,
+    const std::string &accept_encoding
+) {
+    struct stat original{};
+    if (stat(path.c_str(), &original) != 0) {
+        return std::nullopt;
+    }
+
+    const auto q_values = parse_accept_encoding(accept_encoding);
+
+    std::optional<std::tuple<std::string, content_encoding_t>> selected;
+    auto selected_q = 0.0;
+    for (const auto &preference : ENCODING_PREFERENCES) {
+        const auto encoding = std::get<0>(preference);
+        const auto q = q_values.at(encoding);
+        if (q <= selected_q) {
+            continue;
+        }
+
+        // 元のファイルより古い事前圧縮ファイルは使わない
+        const auto candidate = path + std::get<1>(preference);
+        struct stat sibling{};
+        if (stat(candidate.c_str(), &sibling) != 0 || sibling.st_mtime < original.st_mtime) {
+            continue;
+        }
+        selected = std::make_tuple(candidate, encoding);
+        selected_q = q;
+    }
+    return selected;
+}
+
+std::shared_ptr<const std::string> http_compressor_t::compress_cached(
+    content_encoding_t encoding,
+    int level,
+    const std::string &body
+) {
+    const auto cacheable = this->config.variant_cache_entries > 0
+                           && body.size() <= this->config.variant_cache_max_body_size;
+    if (!cacheable) {
+        return std::make_shared<const std::string>(compression_stream_t::compress(encoding, level, body));
+    }
+
+    // ボディ全体をキーにすると大きいので、サイズと2種類のハッシュで代用する
+    std::string key;
+    key.append(compression_stream_t::get_name(encoding))
+        .append(":").append(std::to_string(level))
+        .append(":").append(std::to_string(body.size()))
+        .append(":").append(std::to_string(std::hash<std::string>()(body)))
+        .append(":").append(std::to_string(fnv1a(body)));
+
+    {
+        std::lock_guard<std::mutex> lock(this->variant_mutex);
+        auto it = this->variant_index.find(key);
+        if (it != this->variant_index.end()) {
+            this->variant_lru.splice(this->variant_lru.begin(), this->variant_lru, it->second);
+            return it->second->compressed;
+        }
+    }
+
+    // 圧縮はロックの外で行う
+    auto compressed = std::make_shared<const std::string>(compression_stream_t::compress(encoding, level, body));
+
+    std::lock_guard<std::mutex> lock(this->variant_mutex);
+    if (this->variant_index.count(key) == 0) {
+        this->variant_lru.push_front({key, compressed});
+        this->variant_index[key] = this->variant_lru.begin();
+        while (this->variant_lru.size() > this->config.variant_cache_entries) {
+            this->variant_index.erase(this->variant_lru.back().key);
+            this->variant_lru.pop_back();
+        }
+    }
+    return compressed;
+}
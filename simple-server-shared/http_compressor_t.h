@@ -0,0 +1,143 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_HTTP_COMPRESSOR_T_H
+#define HTTP_SERVER_HTTP_COMPRESSOR_T_H
+
+class http_request_t;
+class http_response_t;
+enum class content_encoding_t : int;
+
+/**
+ * レスポンスボディの圧縮を行うクラス
+ *
+ * * `Accept-Encoding` から エンコーディング (gzip, zstd, br) を選ぶ
+ * * Content-Type 毎に圧縮レベルを変えられる
+ * * 同じボディを何度も圧縮しないように、圧縮結果を小さな LRU キャッシュに持つ
+ * * 静的ファイルは `.gz` / `.zst` / `.br` の事前圧縮ファイルがあればそちらを使う
+ */
+class http_compressor_t {
+public:
+    /**
+     * Content-Type 毎の圧縮レベル
+     */
+    struct level_rule_t {
+        /**
+         * Content-Type の前方一致パターン (例: "text/")
+         */
+        std::string content_type_prefix;
+
+        /**
+         * 圧縮レベル. 0 以下の場合は圧縮しない
+         */
+        int level;
+    };
+
+    /**
+     * 圧縮の設定
+     */
+    struct config_t {
+        /**
+         * 圧縮レベルのルール (先頭から順に一致するものを使う)
+         */
+        std::vector<level_rule_t> level_rules = {
+            {"text/", 6},
+            {"application/json", 6},
+            {"application/javascript", 6},
+            {"application/xml", 6},
+            {"image/svg+xml", 6},
+        };
+
+        /**
+         * これより小さいボディは圧縮しない (バイト)
+         */
+        size_t min_size = 256;
+
+        /**
+         * 圧縮結果キャッシュのエントリ数. 0 の場合はキャッシュしない
+         */
+        size_t variant_cache_entries = 128;
+
+        /**
+         * 圧縮結果キャッシュに入れるボディの最大サイズ (バイト)
+         */
+        size_t variant_cache_max_body_size = 256 * 1024;
+    };
+
+    explicit http_compressor_t(const config_t &config);
+
+    /**
+     * `Accept-Encoding` の値から使うエンコーディングを選ぶ
+     *
+     * q値が一番大きいものを選び、同じ場合は br, zstd, gzip の順に優先する。
+     *
+     * @param [in] accept_encoding `Accept-Encoding` ヘッダの値
+     * @return エンコーディング (圧縮しない場合は identity)
+     */
+    [[nodiscard]] static content_encoding_t select_encoding(const std::string &accept_encoding);
+
+    /**
+     * リクエストから使うエンコーディングを選ぶ
+     * @param [in] request リクエスト
+     * @return エンコーディング (圧縮しない場合は identity)
+     */
+    [[nodiscard]] static content_encoding_t select_encoding(const http_request_t &request);
+
+    /**
+     * Content-Type に対応する圧縮レベルを取得する
+     * @param [in] content_type Content-Type
+     * @return 圧縮レベル. 圧縮しない場合は 0
+     */
+    [[nodiscard]] int get_level(const std::string &content_type) const;
+
+    /**
+     * レスポンスボディを圧縮して、`Content-Encoding` と `Vary` ヘッダをセットする
+     *
+     * 圧縮の対象外 (小さい、Content-Type が対象外、既に圧縮済み、クライアントが非対応) の場合は何もしない。
+     *
+     * @param [in] request リクエスト
+     * @param [in,out] response レスポンス
+     */
+    void apply(const http_request_t &request, http_response_t &response);
+
+    /**
+     * 静的ファイルの事前圧縮ファイル (`.br`, `.zst`, `.gz`) を探す
+     *
+     * @param [in] path 元のファイルのパス
+     * @param [in] accept_encoding `Accept-Encoding` ヘッダの値
+     * @return {事前圧縮ファイルのパス, エンコーディング}. 見つからない場合は `std::nullopt`
+     */
+    [[nodiscard]] static std::optional<std::tuple<std::string, content_encoding_t>> find_precompressed(
+        const std::string &path,
+        const std::string &accept_encoding
+    );
+
+private:
+    config_t config;
+
+    /**
+     * 圧縮結果キャッシュのエントリ
+     */
+    struct variant_t {
+        std::string key;
+        std::shared_ptr<const std::string> compressed;
+    };
+
+    std::mutex variant_mutex;
+
+    /**
+     * 先頭が最近使われたエントリ
+     */
+    std::list<variant_t> variant_lru;
+
+    std::unordered_map<std::string, std::list<variant_t>::iterator> variant_index;
+
+    /**
+     * 圧縮結果キャッシュから探し、なければ圧縮してキャッシュする
+     */
+    std::shared_ptr<const std::string> compress_cached(content_encoding_t encoding, int level, const std::string &body);
+};
+
+
+#endif //HTTP_SERVER_HTTP_COMPRESSOR_T_H
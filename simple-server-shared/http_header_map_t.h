@@ -0,0 +1,50 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_HTTP_HEADER_MAP_T_H
+#define HTTP_SERVER_HTTP_HEADER_MAP_T_H
+
+/**
+ * ヘッダ名の比較
+ *
+ * ヘッダ名は大文字小文字を区別しない (RFC 9110 5.1) ので、ASCII の大文字を小文字にして比べる
+ * (`transfer-encoding` でも `Transfer-Encoding` で見つかる)。
+ *
+ * `std::string_view` で比較するので、`std::string`, `std::pmr::string`, 文字列リテラルのどれでも
+ * キーの文字列を作らずに (メモリを確保せずに) 検索できる。
+ */
+struct http_header_less_t {
+    using is_transparent = void;
+
+    inline bool operator()(std::string_view lhs, std::string_view rhs) const {
+        const auto length = std::min(lhs.size(), rhs.size());
+        for (size_t i = 0; i < length; i++) {
+            const auto l = to_lower(lhs[i]);
+            const auto r = to_lower(rhs[i]);
+            if (l != r) {
+                return l < r;
+            }
+        }
+        return lhs.size() < rhs.size();
+    }
+
+private:
+    /**
+     * ASCII の大文字だけを小文字にする (ロケールに依存しない)
+     */
+    static inline unsigned char to_lower(char c) {
+        const auto u = static_cast<unsigned char>(c);
+        return u >= 'A' && u <= 'Z' ? static_cast<unsigned char>(u + ('a' - 'A')) : u;
+    }
+};
+
+/**
+ * HTTP ヘッダ
+ *
+ * キーと値の文字列とマップのノードは、リクエスト (レスポンス) と同じメモリリソースから確保する。
+ */
+using http_header_map_t = std::pmr::map<std::pmr::string, std::pmr::string, http_header_less_t>;
+
+
+#endif //HTTP_SERVER_HTTP_HEADER_MAP_T_H
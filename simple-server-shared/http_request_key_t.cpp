@@ -0,0 +1,42 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <boost/algorithm/string.hpp>
+#include "http_request_key_t.h"
+#include "http_request_t.h"
+
+std::string http_request_key_t::make(const http_request_t &request, const config_t &config) {
+    std::string key;
+    key.reserve(request.get_method().size() + request.get_uri().size() + 1);
+
+    if (config.method) {
+        key.append(request.get_method());
+    }
+    key.append(" ");
+    if (config.uri) {
+        key.append(request.get_uri());
+    }
+
+    const auto &header = request.get_header();
+    if (config.all_headers) {
+        // ヘッダは名前の順に並んでいるので、順番が違うだけのリクエストも同じキーになる
+        for (const auto &item : header) {
+            key.append("\n").append(item.first).append(":").append(item.second);
+        }
+    } else {
+        for (const auto &name : config.headers) {
+            key.append("\n").append(name).append(":");
+            auto it = header.find(name);
+            if (it != header.end()) {
+                key.append(boost::trim_copy(it->second));
+            }
+        }
+    }
+
+    if (config.body) {
+        key.append("\n\n").append(request.get_body());
+    }
+    return key;
+}
@@ -0,0 +1,60 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_HTTP_REQUEST_KEY_T_H
+#define HTTP_SERVER_HTTP_REQUEST_KEY_T_H
+
+class http_request_t;
+
+/**
+ * リクエストから「同じリクエスト」とみなすためのキーを作成するクラス
+ *
+ * レスポンスキャッシュやリクエストの集約 (single-flight) で使う。
+ */
+class http_request_key_t {
+public:
+    /**
+     * キーの構成
+     */
+    struct config_t {
+        /**
+         * メソッドをキーに含めるか
+         */
+        bool method = true;
+
+        /**
+         * URI をキーに含めるか
+         */
+        bool uri = true;
+
+        /**
+         * ボディをキーに含めるか
+         */
+        bool body = false;
+
+        /**
+         * キーに含めるリクエストヘッダ名
+         */
+        std::vector<std::string> headers;
+
+        /**
+         * 全てのリクエストヘッダをキーに含めるか (`headers` は使わない)
+         *
+         * ハンドラがどのヘッダを使うか分からない場合 (ヘッダをそのまま返すなど) に、
+         * 別のクライアントの Cookie や Authorization に依存したレスポンスを返さないようにする。
+         */
+        bool all_headers = false;
+    };
+
+    /**
+     * キーを作成する
+     * @param [in] request リクエスト
+     * @param [in] config キーの構成
+     * @return キー
+     */
+    [[nodiscard]] static std::string make(const http_request_t &request, const config_t &config);
+};
+
+
+#endif //HTTP_SERVER_HTTP_REQUEST_KEY_T_H
@@ -3,139 +3,224 @@
 //
 
 #include "common.h"
+#include <charconv>
 #include <boost/algorithm/string.hpp>
 #include "http_request_t.h"
 #include "http_constants_t.h"
+#include "chunked_decoder_t.h"
+#include "request_body_t.h"
+#include "async_logger_t.h"
+
+const size_t http_request_t::MAX_HEADER_SIZE = 64 * 1024;
+const size_t http_request_t::MAX_BODY_SIZE = 1024 * 1024 * 1024;
+
+http_request_t::http_request_t(std::pmr::memory_resource* resource)
+    : request_line(resource),
+      method(resource),
+      uri(resource),
+      http_version(resource),
+      header(resource),
+      body(std::allocate_shared<request_body_t>(std::pmr::polymorphic_allocator<request_body_t>(resource))),
+      total_bytes(resource) {
+}
+
+std::string http_request_t::get_body() const {
+    return this->body->to_string();
+}
 
 void http_request_t::add_bytes(const std::string &request_parts) {
+    this->add_bytes(request_parts.data(), request_parts.size());
+}
+
+void http_request_t::add_bytes(const char* data, size_t size) {
 
-    if (request_parts.empty()) {
+    if (size == 0) {
         return;
     }
     // ヘッダが ready でない場合は ヘッダの読み込み処理を行う
     if (!this->is_header_ready()) {
 
         // リクエスト全体のバイト列に今回のバイト列を追加する
-        this->total_bytes.insert(
-            this->total_bytes.end(),
-            request_parts.begin(),
-            request_parts.end()
-        );
+        this->total_bytes.append(data, size);
+
+        // ヘッダが終わらないまま大きくなり続けるリクエストは拒否する
+        if (this->total_bytes.size() > MAX_HEADER_SIZE && !this->all_header_received()) {
+            throw std::runtime_error("ヘッダが大きすぎます。");
+        }
 
         // 試しにヘッダをパースしてみる
         this->try_parse_request();
         return;
     }
 
-    // ボディがが ready でない場合
-    if (!this->is_body_ready()) {
-        // ボディに文字列を追加する
-        this->body.append(request_parts);
+    if (this->is_body_ready()) {
+        throw std::runtime_error("すでにリクエストを受信済みです。");
     }
 
-    throw std::runtime_error("すでにリクエストを受信済みです。");
+    // ボディが ready でない場合はボディに追加する
+    this->add_body_bytes(data, size);
+}
+
+const std::map<std::string, std::string>& http_request_t::get_trailer() const {
+    static const std::map<std::string, std::string> EMPTY_TRAILER;
+    if (!this->chunked_decoder) {
+        return EMPTY_TRAILER;
+    }
+    return this->chunked_decoder->get_trailer();
+}
+
+size_t http_request_t::add_body_bytes(const char* data, size_t size) {
+    if (this->chunked_decoder) {
+        return this->chunked_decoder->feed(data, size, [this](const char* chunk, size_t chunk_size) {
+            this->on_body_data(chunk, chunk_size);
+        });
+    }
+
+    // Content-Length を超える部分は このリクエストのボディではないので捨てる
+    const auto length = std::min(size, this->content_length - this->body_received);
+    this->on_body_data(data, length);
+    return length;
+}
+
+void http_request_t::on_body_data(const char* data, size_t size) {
+    if (size > MAX_BODY_SIZE - this->body_received) {
+        throw std::runtime_error("ボディが大きすぎます。");
+    }
+    this->body_received += size;
+    if (this->body_handler) {
+        this->body_handler(data, size);
+        return;
+    }
+    this->body->append(data, size);
 }
 
 void http_request_t::try_parse_request() {
     // まだヘッダ全体を受信できていない場合は何もしない
-    if (!this->all_header_received()) {
+    const auto header_end = this->total_bytes.find(http_constants_t::CRLF2);
+    if (header_end == std::string::npos) {
         return;
     }
 
-    // デリミタでボディ部分と分割する
-    std::string header_text;
-    std::string body_text;
-    std::tie(header_text, body_text) = this->split_request_to_header_and_body();
-
-    // ヘッダ部分を各行に分割する
-    std::vector<std::string> lines = this->split_to_lines(header_text);
-    if (lines.empty()) {
-        // Request-line は必須
-        throw std::runtime_error("リクエストにRequest-line が含まれていません");
+    // ヘッダ部分を1行ずつパースする (コピーせずに受信済みのバイト列を参照する)
+    // CRLF で区切るが、LF だけの行も受け付ける
+    const std::string_view header_text(this->total_bytes.data(), header_end);
+    size_t line_begin = 0;
+    bool first_line = true;
+    while (line_begin <= header_text.size()) {
+        auto line_end = header_text.find('\n', line_begin);
+        if (line_end == std::string_view::npos) {
+            line_end = header_text.size();
+        }
+        auto line = header_text.substr(line_begin, line_end - line_begin);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+
+        if (first_line) {
+            // 先頭行が Request-line
+            this->parse_request_line(line);
+            first_line = false;
+        } else {
+            // 先頭行の次の行 〜 Body の直前までがヘッダなのでパースする
+            this->parse_header_line(line);
+        }
+        line_begin = line_end + 1;
     }
 
-    // 先頭行が Request-line
-    auto it = lines.begin();
-    this->parse_request_line(*it);
+    auto transfer_encoding_it = this->header.find("Transfer-Encoding");
+    auto content_length_it = this->header.find("Content-Length");
 
-    // 先頭行の次の行 〜 Body の直前までがヘッダなのでパースする
-    it++;
-    for (; it != lines.end(); it++) {
-        this->parse_header_line(*it);
+    // 両方ある場合は、前段のプロキシとボディの終わりの判断が食い違うと別のリクエストを紛れ込ませられる
+    // (リクエストスマグリング) ので、どちらも信じずに拒否する (RFC 9112 6.1)
+    if (transfer_encoding_it != this->header.end() && content_length_it != this->header.end()) {
+        throw std::runtime_error("Transfer-Encoding と Content-Length の両方が指定されています。");
+    }
+
+    // Transfer-Encoding: chunked の場合は chunked のデコード結果でボディの終端を判定する
+    if (transfer_encoding_it != this->header.end()) {
+        // コーディングのリストの最後のトークンが chunked であること (`xchunked` などは不可)
+        std::vector<std::string> codings;
+        boost::split(codings, transfer_encoding_it->second, boost::is_any_of(","));
+        if (!boost::iequals(boost::trim_copy(codings.back()), "chunked")) {
+            throw std::runtime_error("Transfer-Encoding の最後が chunked ではありません。");
+        }
+        this->chunked_decoder = std::allocate_shared<chunked_decoder_t>(
+            std::pmr::polymorphic_allocator<chunked_decoder_t>(this->total_bytes.get_allocator()),
+            chunked_decoder_t::config_t{}
+        );
     }
 
     // ヘッダに Content-Length が含まれる場合は Body の読み込み終了判定に必要なので、
     // 保存しておく。
-    auto content_length_it = this->header.find("Content-Length");
+    // (std::stoull は "-1" や "12abc" も受け付けるので、数字だけであることを確かめる)
     if (content_length_it != this->header.end()) {
         const auto content_length_text = boost::trim_copy(content_length_it->second);
-        this->content_length = std::stoi(content_length_text);
+        const auto is_digits = !content_length_text.empty()
+                               && std::all_of(content_length_text.begin(), content_length_text.end(), [](char c) {
+                                   return c >= '0' && c <= '9';
+                               });
+        size_t value = 0;
+        const auto [end, error] = std::from_chars(content_length_text.data(), content_length_text.data() + content_length_text.size(), value);
+        if (!is_digits || error != std::errc() || end != content_length_text.data() + content_length_text.size()) {
+            throw std::runtime_error("Content-Length が不正です。");
+        }
+        if (value > MAX_BODY_SIZE) {
+            throw std::runtime_error("ボディが大きすぎます。");
+        }
+        this->content_length = value;
     }
 
-    // ヘッダ以降の部分は全て ボディ
-    this->body.append(body_text);
-}
-
-bool http_request_t::all_header_received() const {
-    const auto size_ok = this->total_bytes.size() >= http_constants_t::CRLF2.size();
-    const auto found = this->total_bytes.find(http_constants_t::CRLF2) != std::string::npos;
-    return size_ok && found;
-}
-
-
-std::tuple<std::string, std::string> http_request_t::split_request_to_header_and_body() {
-    auto result = boost::find_first(this->total_bytes, http_constants_t::CRLF2);
-    if (!result) {
-        throw std::runtime_error("Request delimiter not found.");
+    // ボディの受け取り方をハンドラ側で決められるように、ボディを処理する前に通知する
+    if (this->header_handler) {
+        this->header_handler(*this);
     }
 
+    // ヘッダ以降の部分は全て ボディ
+    const auto body_begin = header_end + http_constants_t::CRLF2.size();
+    this->add_body_bytes(this->total_bytes.data() + body_begin, this->total_bytes.size() - body_begin);
 
-    const std::string header_text(this->total_bytes.begin(), result.begin());
-    const std::string body_text(result.end(), this->total_bytes.end());
-
-    return std::make_tuple(header_text, body_text);
+    // ヘッダのバイト列はもう使わないので解放する
+    std::pmr::string(this->total_bytes.get_allocator()).swap(this->total_bytes);
 }
 
-std::vector<std::string> http_request_t::split_to_lines(std::string text) {
-    std::vector<std::string> result;
-    boost::split(result, text, boost::is_any_of(http_constants_t::CRLF), boost::token_compress_off);
-    return result;
+bool http_request_t::all_header_received() const {
+    return this->total_bytes.find(http_constants_t::CRLF2) != std::string::npos;
 }
 
-void http_request_t::parse_request_line(const std::string &request_line) {
-    std::vector<std::string> parts;
-    boost::split(parts, request_line, boost::is_any_of(" "), boost::token_compress_off);
-
-    if (parts.size() != 3) {
+void http_request_t::parse_request_line(std::string_view line) {
+    // メソッド SP URI SP HTTPバージョン
+    const auto first_space = line.find(' ');
+    const auto second_space = first_space == std::string_view::npos ? std::string_view::npos : line.find(' ', first_space + 1);
+    if (second_space == std::string_view::npos || line.find(' ', second_space + 1) != std::string_view::npos) {
         throw std::runtime_error("Request-line のフィールド数が3ではありません。");
     }
 
-    this->request_line = request_line;
-    this->method = parts[0];
-    this->uri = parts[1];
-    this->http_version = parts[2];
+    this->request_line.assign(line);
+    this->method.assign(line.substr(0, first_space));
+    this->uri.assign(line.substr(first_space + 1, second_space - first_space - 1));
+    this->http_version.assign(line.substr(second_space + 1));
 }
 
-void http_request_t::parse_header_line(const std::string &header_line) {
+void http_request_t::parse_header_line(std::string_view header_line) {
     if (header_line.empty()) {
         return;
     }
 
-    const auto result = boost::find_first(header_line,
-                                          http_constants_t::HEADER_DELIMITER);
-    if (!result) {
+    const auto delimiter_pos = header_line.find(http_constants_t::HEADER_DELIMITER);
+    if (delimiter_pos == std::string_view::npos) {
         throw std::runtime_error("ヘッダのデリミタ \":\" が含まれていません");
     }
 
-    const std::string key(header_line.begin(), result.begin());
-    const std::string value(result.end(), header_line.end());
+    const auto key = header_line.substr(0, delimiter_pos);
+    const auto value = header_line.substr(delimiter_pos + http_constants_t::HEADER_DELIMITER.size());
 
-    if (this->header.count(key) == 0) {
-        this->header[key] = value;
+    if (this->header.find(key) == this->header.end()) {
+        this->header.emplace(key, value);
     } else {
-        std::cerr << "ヘッダのキーが重複しているため無視されました。 "
-                  << "key=" << key
-                  << std::endl;
+        auto &logger = async_logger_t::get_default();
+        if (logger.is_enabled(async_logger_t::level_t::warning)) {
+            logger.log(async_logger_t::level_t::warning, "ヘッダのキーが重複しているため無視されました。 key=" + std::string(key));
+        }
     }
 }
 
@@ -145,11 +230,16 @@ bool http_request_t::is_header_ready() const {
 }
 
 bool http_request_t::is_body_ready() const {
+    // chunked の場合は 最後のチャンクとトレイラーまで読み込んでいれば Ready とする
+    if (this->chunked_decoder) {
+        return this->chunked_decoder->is_done();
+    }
+
     // Body がない場合は常に Ready とする
     if (this->content_length == 0) {
         return true;
     }
 
     // Body を Content-Length で指定されたバイト長まで読み込んでいれば Ready とする
-    return this->body.size() >= this->content_length;
+    return this->body_received >= this->content_length;
 }
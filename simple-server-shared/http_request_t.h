@@ -5,8 +5,16 @@
 #ifndef HTTP_SERVER_HTTP_REQUEST_T_H
 #define HTTP_SERVER_HTTP_REQUEST_T_H
 
+#include "http_header_map_t.h"
+
+class chunked_decoder_t;
+class request_body_t;
+
 /**
  * HTTP リクエストを表すクラス
+ *
+ * リクエスト行やヘッダの文字列は、コンストラクタで渡したメモリリソースから確保する。
+ * コネクション毎のアリーナ (`connection_arena_t`) を渡すと、1リクエストで malloc をほとんど呼ばなくなる。
  */
 class http_request_t {
 public:
@@ -14,24 +22,113 @@ public:
      * リクエスト行を取得する
      * @return リクエスト行
      */
-    [[nodiscard]] inline const std::string& get_request_line() const {
+    [[nodiscard]] inline const std::pmr::string& get_request_line() const {
         return this->request_line;
     }
 
+    /**
+     * メソッドを取得する
+     * @return メソッド
+     */
+    [[nodiscard]] inline const std::pmr::string& get_method() const {
+        return this->method;
+    }
+
+    /**
+     * URI を取得する
+     * @return URI
+     */
+    [[nodiscard]] inline const std::pmr::string& get_uri() const {
+        return this->uri;
+    }
+
     /**
      * ヘッダを取得する
      * @return ヘッダ
      */
-    [[nodiscard]] inline const std::map<std::string, std::string>& get_header() const {
+    [[nodiscard]] inline const http_header_map_t& get_header() const {
         return this->header;
     }
 
+    /**
+     * ヘッダの最大バイト数 (リクエスト行を含む)
+     */
+    static const size_t MAX_HEADER_SIZE;
+
+    /**
+     * ボディの最大バイト数 (chunked の場合はデコードした後のバイト数)
+     */
+    static const size_t MAX_BODY_SIZE;
+
+    /**
+     * @param [in] resource 文字列やヘッダのメモリを確保するメモリリソース (リクエストより長く生きていること)
+     */
+    explicit http_request_t(std::pmr::memory_resource* resource = std::pmr::get_default_resource());
+
     /**
      * ボディを取得する
+     *
+     * ボディ全体をコピーするので、大きなボディは `get_body_storage` から参照すること。
+     *
      * @return ボディ
      */
-    [[nodiscard]] inline const std::string get_body() const {
-        return this->body;
+    [[nodiscard]] std::string get_body() const;
+
+    /**
+     * ボディの格納先を取得する
+     *
+     * 大きなボディは一時ファイルに書き出されているので、ディスクリプタや mmap で参照できる。
+     *
+     * @return ボディの格納先
+     */
+    [[nodiscard]] inline const request_body_t& get_body_storage() const {
+        return *this->body;
+    }
+
+    /**
+     * ボディの格納先を取得する (メモリ上限の変更用)
+     * @return ボディの格納先
+     */
+    [[nodiscard]] inline request_body_t& get_body_storage() {
+        return *this->body;
+    }
+
+    /**
+     * トレイラー (`Transfer-Encoding: chunked` の場合のみ) を取得する
+     * @return トレイラー
+     */
+    [[nodiscard]] const std::map<std::string, std::string>& get_trailer() const;
+
+    /**
+     * ボディが `Transfer-Encoding: chunked` で送られてくるか
+     * @return chunked の場合 `true`
+     */
+    [[nodiscard]] inline bool is_chunked() const {
+        return static_cast<bool>(this->chunked_decoder);
+    }
+
+    /**
+     * ボディのデータを受け取るハンドラをセットする
+     *
+     * セットした場合、ボディは `body` に溜め込まずに、受信した (chunked の場合はデコードした) 順にハンドラに渡す。
+     * ハンドラに渡すポインタは受信バッファを指すので、ハンドラの外で使う場合はコピーすること。
+     *
+     * @param [in] body_handler ボディのデータを受け取るハンドラ
+     */
+    inline void set_body_handler(std::function<void(const char*, size_t)> body_handler) {
+        this->body_handler = std::move(body_handler);
+    }
+
+    /**
+     * ヘッダの受信が完了したときに呼ばれるハンドラをセットする
+     *
+     * ヘッダと一緒に受信したボディを処理する前に呼ばれるので、
+     * このハンドラの中で `set_body_handler` を呼べばボディを最初から受け取れる。
+     *
+     * @param [in] header_handler ヘッダの受信が完了したときに呼ばれるハンドラ
+     */
+    inline void set_header_handler(std::function<void(http_request_t&)> header_handler) {
+        this->header_handler = std::move(header_handler);
     }
 
     /**
@@ -39,6 +136,14 @@ public:
      */
     void add_bytes(const std::string &request_parts);
 
+    /**
+     * リクエストのバイト列を追加する
+     *
+     * @param [in] data バイト列
+     * @param [in] size バイト数
+     */
+    void add_bytes(const char* data, size_t size);
+
     /**
      * リクエストの受信が完了して、使える状態か判定する
      *
@@ -52,69 +157,93 @@ private:
     /**
      * リクエスト行
      */
-    std::string request_line;
+    std::pmr::string request_line;
     /**
      * メソッド
      */
-    std::string method;
+    std::pmr::string method;
 
     /**
      * URI
      */
-    std::string uri;
+    std::pmr::string uri;
 
     /**
      * HTTPバージョン
      */
-    std::string http_version;
+    std::pmr::string http_version;
 
     /**
      * ヘッダ
      */
-    std::map<std::string, std::string> header;
+    http_header_map_t header;
 
     /**
      * ボディ
      */
-    std::string body;
+    std::shared_ptr<request_body_t> body;
 
     /**
-     * リクエスト全体のバイト列
+     * ヘッダを受信し終えるまでのバイト列 (ヘッダをパースしたら解放する)
      */
-    std::string total_bytes;
+    std::pmr::string total_bytes;
 
     /**
      * * Content-Length
      * * ヘッダの一部だが、利便性のためにフィールドで持っておく
      */
-    int content_length;
+    size_t content_length = 0;
 
     /**
-     * 現在のリクエストをパースする
+     * 受信したボディのバイト数 (chunked の場合はデコード後のバイト数)
      */
-    void try_parse_request();
+    size_t body_received = 0;
 
     /**
-     * 全てのヘッダを受信完了したか判定する
+     * `Transfer-Encoding: chunked` のデコーダ (chunked でない場合は nullptr)
+     */
+    std::shared_ptr<chunked_decoder_t> chunked_decoder;
+
+    /**
+     * ボディのデータを受け取るハンドラ
+     */
+    std::function<void(const char*, size_t)> body_handler;
+
+    /**
+     * ヘッダの受信が完了したときに呼ばれるハンドラ
+     */
+    std::function<void(http_request_t&)> header_handler;
+
+    /**
+     * ボディのバイト列を追加する
      *
-     * 受信済みのバイト列の中に CRLF が2つ連続する場合、ヘッダを受信済みと判定する.
+     * @param [in] data バイト列
+     * @param [in] size バイト数
+     * @return 消費したバイト数
+     */
+    size_t add_body_bytes(const char* data, size_t size);
+
+    /**
+     * デコード済みのボディのデータを受け取る
      *
-     * @return ヘッダを受信済みの場合 `true`, それ以外の場合 `false`.
+     * @param [in] data バイト列
+     * @param [in] size バイト数
      */
-    [[nodiscard]] bool all_header_received() const;
+    void on_body_data(const char* data, size_t size);
 
     /**
-     * リクエスト全体をヘッダとボディに分割する
-     * @return {ヘッダ, ボディ} のタプル
+     * 現在のリクエストをパースする
      */
-    std::tuple<std::string, std::string> split_request_to_header_and_body();
+    void try_parse_request();
 
     /**
-     * 1テキストを改行コード(CRLF)で分割する
+     * 全てのヘッダを受信完了したか判定する
      *
-     * @return 行文字列のリスト
+     * 受信済みのバイト列の中に CRLF が2つ連続する場合、ヘッダを受信済みと判定する.
+     *
+     * @return ヘッダを受信済みの場合 `true`, それ以外の場合 `false`.
      */
-    std::vector<std::string> split_to_lines(std::string text);
+    [[nodiscard]] bool all_header_received() const;
 
     /**
      * リクエスト行をパースする
@@ -123,7 +252,7 @@ private:
      *
      * @param request_line リクエスト行文字列
      */
-    void parse_request_line(const std::string &request_line);
+    void parse_request_line(std::string_view request_line);
 
     /**
      * ヘッダ行をパースする
@@ -133,7 +262,7 @@ private:
      *
      * @param header_line ヘッダ行文字列
      */
-    void parse_header_line(const std::string &header_line);
+    void parse_header_line(std::string_view header_line);
 
     /**
      * ヘッダの受信完了か？
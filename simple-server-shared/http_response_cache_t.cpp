@@ -0,0 +1,169 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <boost/algorithm/string.hpp>
+#include "http_response_cache_t.h"
+#include "http_request_t.h"
+#include "http_request_key_t.h"
+#include "http_response_t.h"
+
+http_response_cache_t::http_response_cache_t(const config_t &config)
+    : config(config),
+      shard_max_bytes(config.max_bytes / std::max<size_t>(config.shard_count, 1)),
+      shards(std::max<size_t>(config.shard_count, 1)) {
+}
+
+bool http_response_cache_t::is_cacheable_request(const http_request_t &request) {
+    const auto &method = request.get_method();
+    return method == "GET" || method == "HEAD";
+}
+
+std::string http_response_cache_t::make_key(const http_request_t &request) const {
+    http_request_key_t::config_t key_config;
+    key_config.headers = this->config.vary_headers;
+    return http_request_key_t::make(request, key_config);
+}
+
+http_response_cache_t::lookup_result_t http_response_cache_t::lookup(const std::string &key) {
+    auto &shard = this->get_shard(key);
+    const auto now = clock_t::now();
+
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(key);
+    if (it == shard.index.end()) {
+        return {lookup_state_t::miss, nullptr};
+    }
+
+    auto entry_it = it->second;
+    if (now >= entry_it->stale_until) {
+        // stale としても返せないので捨てる
+        shard.total_bytes -= entry_it->get_bytes();
+        shard.lru.erase(entry_it);
+        shard.index.erase(it);
+        return {lookup_state_t::miss, nullptr};
+    }
+
+    // 最近使われたので先頭に移動する
+    shard.lru.splice(shard.lru.begin(), shard.lru, entry_it);
+
+    if (now < entry_it->expires_at) {
+        return {lookup_state_t::hit, entry_it->response_text};
+    }
+
+    // 再生成は最初に気づいたリクエストだけが行う
+    if (entry_it->revalidating) {
+        return {lookup_state_t::stale_hit, entry_it->response_text};
+    }
+    entry_it->revalidating = true;
+    return {lookup_state_t::stale_revalidate, entry_it->response_text};
+}
+
+std::shared_ptr<const std::string> http_response_cache_t::store(
+    const std::string &key,
+    const http_response_t &response
+) {
+    auto response_text = std::make_shared<const std::string>(response.to_string());
+
+    int max_age = 0;
+    int stale_while_revalidate = 0;
+    std::tie(max_age, stale_while_revalidate) = this->parse_cache_control(response);
+
+    auto &shard = this->get_shard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    // 既存のエントリは置き換える (キャッシュしない場合も再生成中フラグを残さないように消す)
+    auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        shard.total_bytes -= it->second->get_bytes();
+        shard.lru.erase(it->second);
+        shard.index.erase(it);
+    }
+
+    if (response.get_status() != 200 || max_age <= 0) {
+        return response_text;
+    }
+
+    entry_t entry;
+    entry.key = key;
+    entry.response_text = response_text;
+    entry.expires_at = clock_t::now() + std::chrono::seconds(max_age);
+    entry.stale_until = entry.expires_at + std::chrono::seconds(stale_while_revalidate);
+
+    const auto bytes = entry.get_bytes();
+    if (bytes > this->shard_max_bytes) {
+        // 1エントリでシャードの容量を超える場合はキャッシュしない
+        return response_text;
+    }
+
+    shard.lru.push_front(std::move(entry));
+    shard.index[key] = shard.lru.begin();
+    shard.total_bytes += bytes;
+
+    evict(shard, this->shard_max_bytes);
+
+    return response_text;
+}
+
+size_t http_response_cache_t::get_total_bytes() const {
+    size_t total = 0;
+    for (const auto &shard : this->shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.total_bytes;
+    }
+    return total;
+}
+
+http_response_cache_t::shard_t &http_response_cache_t::get_shard(const std::string &key) {
+    return this->shards[std::hash<std::string>()(key) % this->shards.size()];
+}
+
+void http_response_cache_t::evict(shard_t &shard, size_t max_bytes) {
+    while (shard.total_bytes > max_bytes && !shard.lru.empty()) {
+        const auto &victim = shard.lru.back();
+        shard.total_bytes -= victim.get_bytes();
+        shard.index.erase(victim.key);
+        shard.lru.pop_back();
+    }
+}
+
+std::tuple<int, int> http_response_cache_t::parse_cache_control(const http_response_t &response) const {
+    const auto &header = response.get_header();
+    auto it = header.find("Cache-Control");
+    if (it == header.end()) {
+        return std::make_tuple(this->config.default_max_age, this->config.default_stale_while_revalidate);
+    }
+
+    int max_age = 0;
+    int stale_while_revalidate = this->config.default_stale_while_revalidate;
+
+    std::vector<std::string> directives;
+    boost::split(directives, it->second, boost::is_any_of(","), boost::token_compress_on);
+    for (auto &directive : directives) {
+        boost::trim(directive);
+        boost::to_lower(directive);
+
+        if (directive == "no-store" || directive == "no-cache" || directive == "private") {
+            return std::make_tuple(0, 0);
+        }
+
+        const auto equal_pos = directive.find('=');
+        if (equal_pos == std::string::npos) {
+            continue;
+        }
+        const auto name = directive.substr(0, equal_pos);
+        const auto value = directive.substr(equal_pos + 1);
+        try {
+            if (name == "max-age" || name == "s-maxage") {
+                max_age = std::stoi(value);
+            } else if (name == "stale-while-revalidate") {
+                stale_while_revalidate = std::stoi(value);
+            }
+        } catch (const std::exception &) {
+            // 解釈できない値は無視する
+        }
+    }
+
+    return std::make_tuple(max_age, stale_while_revalidate);
+}
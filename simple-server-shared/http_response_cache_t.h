@@ -0,0 +1,192 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_HTTP_RESPONSE_CACHE_T_H
+#define HTTP_SERVER_HTTP_RESPONSE_CACHE_T_H
+
+class http_request_t;
+class http_response_t;
+
+/**
+ * 動的ハンドラ (Lua, CGI) のレスポンスをメモリ上にキャッシュするクラス
+ *
+ * * キーは メソッド + URI + 設定された Vary ヘッダの値
+ * * 有効期限はハンドラが付けた `Cache-Control: max-age` に従う
+ * * 容量はバイト数で制限し、溢れたら LRU で追い出す
+ * * ロックはシャード単位なので、別スレッドの別キーへのアクセスはほぼ競合しない
+ * * `stale-while-revalidate` の期間中は古いレスポンスを返しつつ、1 リクエストだけに再生成させる
+ *
+ * キャッシュにはシリアライズ済みのレスポンステキストを持つので、ヒットしたら `send` するだけで済む。
+ */
+class http_response_cache_t {
+public:
+    /**
+     * キャッシュの設定
+     */
+    struct config_t {
+        /**
+         * キャッシュ全体の最大バイト数
+         */
+        size_t max_bytes = 16 * 1024 * 1024;
+
+        /**
+         * シャード数
+         */
+        size_t shard_count = 16;
+
+        /**
+         * キーに含めるリクエストヘッダ名
+         */
+        std::vector<std::string> vary_headers;
+
+        /**
+         * ハンドラが `Cache-Control` を付けなかった場合の max-age (秒). 0 の場合はキャッシュしない
+         */
+        int default_max_age = 0;
+
+        /**
+         * ハンドラが `stale-while-revalidate` を付けなかった場合の値 (秒)
+         */
+        int default_stale_while_revalidate = 0;
+    };
+
+    /**
+     * 検索結果の状態
+     */
+    enum class lookup_state_t {
+        /**
+         * キャッシュなし. ハンドラを実行して `store` すること
+         */
+        miss,
+        /**
+         * 有効なキャッシュあり. そのまま返すこと
+         */
+        hit,
+        /**
+         * 期限切れだが stale-while-revalidate 期間中. そのまま返すこと (他のリクエストが再生成中)
+         */
+        stale_hit,
+        /**
+         * 期限切れだが stale-while-revalidate 期間中. 返した後にハンドラを実行して `store` すること
+         */
+        stale_revalidate,
+    };
+
+    /**
+     * 検索結果
+     */
+    struct lookup_result_t {
+        lookup_state_t state;
+        /**
+         * シリアライズ済みのレスポンス (miss の場合は nullptr)
+         */
+        std::shared_ptr<const std::string> response_text;
+    };
+
+    explicit http_response_cache_t(const config_t &config);
+
+    /**
+     * キャッシュ対象のリクエストか判定する (GET と HEAD のみ)
+     * @param [in] request リクエスト
+     * @return キャッシュ対象の場合 `true`
+     */
+    [[nodiscard]] static bool is_cacheable_request(const http_request_t &request);
+
+    /**
+     * リクエストからキャッシュキーを作成する
+     * @param [in] request リクエスト
+     * @return キャッシュキー
+     */
+    [[nodiscard]] std::string make_key(const http_request_t &request) const;
+
+    /**
+     * キャッシュを検索する
+     * @param [in] key キャッシュキー
+     * @return 検索結果
+     */
+    lookup_result_t lookup(const std::string &key);
+
+    /**
+     * レスポンスをキャッシュに登録する
+     *
+     * `Cache-Control` が `no-store`, `no-cache`, `private` の場合や、ステータスが 200 以外の場合は登録しない。
+     *
+     * @param [in] key キャッシュキー
+     * @param [in] response レスポンス
+     * @return シリアライズ済みのレスポンス
+     */
+    std::shared_ptr<const std::string> store(const std::string &key, const http_response_t &response);
+
+    /**
+     * 現在のキャッシュの合計バイト数を取得する
+     * @return 合計バイト数
+     */
+    [[nodiscard]] size_t get_total_bytes() const;
+
+private:
+    using clock_t = std::chrono::steady_clock;
+
+    /**
+     * キャッシュエントリ
+     */
+    struct entry_t {
+        std::string key;
+        std::shared_ptr<const std::string> response_text;
+        /**
+         * この時刻までは fresh
+         */
+        clock_t::time_point expires_at;
+        /**
+         * この時刻までは stale として返せる
+         */
+        clock_t::time_point stale_until;
+        /**
+         * 再生成中のリクエストがあるか
+         */
+        bool revalidating = false;
+
+        [[nodiscard]] inline size_t get_bytes() const {
+            return this->key.size() + this->response_text->size() + sizeof(entry_t);
+        }
+    };
+
+    /**
+     * シャード (false sharing を避けるためにキャッシュライン境界に揃える)
+     */
+    struct alignas(64) shard_t {
+        mutable std::mutex mutex;
+        /**
+         * 先頭が最近使われたエントリ
+         */
+        std::list<entry_t> lru;
+        std::unordered_map<std::string, std::list<entry_t>::iterator> index;
+        size_t total_bytes = 0;
+    };
+
+    config_t config;
+
+    /**
+     * シャード毎のバイト数上限
+     */
+    size_t shard_max_bytes;
+
+    std::vector<shard_t> shards;
+
+    shard_t &get_shard(const std::string &key);
+
+    /**
+     * シャードの容量を超えている分を LRU で追い出す (シャードのロックを取った状態で呼ぶこと)
+     */
+    static void evict(shard_t &shard, size_t max_bytes);
+
+    /**
+     * レスポンスの `Cache-Control` を解釈して {max-age, stale-while-revalidate} を返す
+     *
+     * キャッシュしてはいけない場合は max-age を 0 にする
+     */
+    [[nodiscard]] std::tuple<int, int> parse_cache_control(const http_response_t &response) const;
+};
+
+
+#endif //HTTP_SERVER_HTTP_RESPONSE_CACHE_T_H
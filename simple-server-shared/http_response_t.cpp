@@ -3,27 +3,94 @@
 //
 
 #include "common.h"
+#include <boost/algorithm/string.hpp>
 #include "http_response_t.h"
 #include "http_constants_t.h"
-#include <boost/format.hpp>
-#include <boost/algorithm/string.hpp>
 
-std::string http_response_t::to_string() const {
-    std::vector<std::string> lines;
-    const auto status_line = (boost::format("HTTP/1.1 %d Success") % this->status_code).str();
-    lines.push_back(status_line);
+namespace {
+    /**
+     * ステータスコードに対応する理由句を取得する (知らないコードは "Success" のまま)
+     */
+    const char* get_reason_phrase(int status_code) {
+        switch (status_code) {
+            case 400:
+                return "Bad Request";
+            case 404:
+                return "Not Found";
+            case 405:
+                return "Method Not Allowed";
+            case 429:
+                return "Too Many Requests";
+            case 500:
+                return "Internal Server Error";
+            case 503:
+                return "Service Unavailable";
+            default:
+                return "Success";
+        }
+    }
+}
 
-    for(const auto& header_item: this->header) {
-        const auto line = (boost::format("%s: %s") % header_item.first % header_item.second).str();
-        lines.push_back(line);
+void http_response_t::append_header_value(std::string_view key, std::string_view value) {
+    auto it = this->header.find(key);
+    if (it == this->header.end()) {
+        this->add_header(key, value);
+        return;
     }
 
-    const auto content_length = this->body.size();
-    lines.push_back(
-        (boost::format("Content-Length: %d") % content_length).str()
-    );
+    auto &current = it->second;
+    std::vector<std::string_view> tokens;
+    boost::split(tokens, std::string_view(current), boost::is_any_of(","));
+    for (auto token : tokens) {
+        token = boost::trim_copy(token);
+        if (token == "*" || boost::iequals(token, value)) {
+            return;
+        }
+    }
+    if (boost::trim_copy(std::string_view(current)).empty()) {
+        current.assign(value);
+        return;
+    }
+    current.append(", ").append(value);
+}
+
+std::string http_response_t::to_string() const {
+    // 1回のメモリ確保で組み立てる
+    const auto content_length = std::to_string(this->body.size());
+    std::string text;
+    text.reserve(this->get_header_lines_size() + 18 + content_length.size() + 4 + this->body.size());
+
+    this->append_header_lines(text);
+    text.append("Content-Length: ").append(content_length).append(http_constants_t::CRLF);
+    text.append(http_constants_t::CRLF);
+    text.append(this->body);
+    return text;
+}
+
+std::string http_response_t::to_header_string() const {
+    std::string text;
+    text.reserve(this->get_header_lines_size() + 2);
+    this->append_header_lines(text);
+    text.append(http_constants_t::CRLF);
+    return text;
+}
 
-    lines.push_back(http_constants_t::CRLF);
+void http_response_t::append_header_lines(std::string &text) const {
+    text.append("HTTP/1.1 ")
+        .append(std::to_string(this->status_code))
+        .append(" ")
+        .append(get_reason_phrase(this->status_code))
+        .append(http_constants_t::CRLF);
 
-    return boost::join(lines, http_constants_t::CRLF) + this->body;
+    for (const auto &header_item : this->header) {
+        text.append(header_item.first).append(": ").append(header_item.second).append(http_constants_t::CRLF);
+    }
+}
+
+size_t http_response_t::get_header_lines_size() const {
+    size_t size = 9 + 3 + 1 + std::strlen(get_reason_phrase(this->status_code)) + 2;
+    for (const auto &header_item : this->header) {
+        size += header_item.first.size() + 2 + header_item.second.size() + 2;
+    }
+    return size;
 }
@@ -5,6 +5,8 @@
 #ifndef HTTP_SERVER_HTTP_RESPONSE_T_H
 #define HTTP_SERVER_HTTP_RESPONSE_T_H
 
+#include "http_header_map_t.h"
+
 /**
  * HTTP レスポンス
  */
@@ -14,13 +16,25 @@ public:
         this->status_code = _status_code;
     }
 
-    inline void add_header(std::string &&key, std::string &&value) {
-        this->header.insert(std::make_pair(key, value));
+    /**
+     * ヘッダを追加する (同じ名前のヘッダがある場合は何もしない)
+     * @param [in] key 名前
+     * @param [in] value 値
+     */
+    inline void add_header(std::string_view key, std::string_view value) {
+        this->header.try_emplace(std::pmr::string(key, this->header.get_allocator()), value);
     }
 
-    inline void add_header(const std::string &key, const std::string &value) {
-        this->header.insert(std::make_pair(key, value));
-    }
+    /**
+     * カンマ区切りのリストのヘッダ (`Vary` など) に値を追加する
+     *
+     * ヘッダがない場合は追加し、ある場合は `, value` を後ろに付ける。
+     * 既に同じ値 (大文字小文字は区別しない) が入っている場合や、値が `*` の場合は何もしない。
+     *
+     * @param [in] key 名前
+     * @param [in] value 追加する値
+     */
+    void append_header_value(std::string_view key, std::string_view value);
 
     inline void set_body(std::string &&_body) {
         this->body = std::move(_body);
@@ -30,16 +44,58 @@ public:
         this->body = _body;
     }
 
+    /**
+     * ステータスコードを取得する
+     * @return ステータスコード
+     */
+    [[nodiscard]] inline int get_status() const {
+        return this->status_code;
+    }
+
+    /**
+     * ヘッダを取得する
+     * @return ヘッダ
+     */
+    [[nodiscard]] inline const http_header_map_t& get_header() const {
+        return this->header;
+    }
+
+    /**
+     * ボディを取得する
+     * @return ボディ
+     */
+    [[nodiscard]] inline const std::string& get_body() const {
+        return this->body;
+    }
+
     /**
      * レスポンステキストに変換する
      * @return レスポンステキスト
      */
     std::string to_string() const;
 
+    /**
+     * ステータス行とヘッダだけをレスポンステキストに変換する
+     *
+     * ボディを後から送る場合に使う。`Content-Length` や `Transfer-Encoding` は付けないので、
+     * 必要な場合は事前に `add_header` しておくこと。
+     *
+     * @return ステータス行とヘッダ (最後の空行を含む)
+     */
+    std::string to_header_string() const;
+
     http_response_t()
         : status_code(200) {
     }
 
+    /**
+     * @param [in] resource ヘッダのメモリを確保するメモリリソース (コネクションのアリーナなど. レスポンスより長く生きていること)
+     */
+    explicit http_response_t(std::pmr::memory_resource* resource)
+        : status_code(200),
+          header(resource) {
+    }
+
 private:
     /**
      * ステータスコード
@@ -50,12 +106,25 @@ private:
     /**
      * HTTP ヘッダ
      */
-    std::map<std::string, std::string> header;
+    http_header_map_t header;
 
     /**
      * レスポンスボディ
+     *
+     * 大きくなることがあり、ムーブで受け渡すので、アリーナには置かない
      */
     std::string body;
+
+    /**
+     * ステータス行とヘッダ (最後の空行を除く) を追加する
+     * @param [out] text 追加先
+     */
+    void append_header_lines(std::string &text) const;
+
+    /**
+     * `append_header_lines` で追加されるバイト数を計算する (reserve 用)
+     */
+    [[nodiscard]] size_t get_header_lines_size() const;
 };
 
 
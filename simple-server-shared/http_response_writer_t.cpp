@@ -0,0 +1,283 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <boost/algorithm/string.hpp>
+#include <boost/format.hpp>
+#include <poll.h>
+#include <sys/uio.h>
+#include "compression_stream_t.h"
+#include "http_constants_t.h"
+#include "http_response_t.h"
+#include "http_response_writer_t.h"
+#include "http_server_t.h"
+#include "socket_options_t.h"
+#include "timing_wheel_t.h"
+#include "connection_deadline_t.h"
+#include "trace_probes.h"
+#include "async_logger_t.h"
+#include "server_metrics_t.h"
+
+namespace {
+    /**
+     * 1回の sendmsg で渡すバッファの最大数
+     */
+    const size_t MAX_IOV_COUNT = 64;
+
+    /**
+     * 送信フラグ (切断されたソケットに書き込んでも SIGPIPE で落ちないようにする)
+     */
+#if defined(MSG_NOSIGNAL)
+    const int SEND_FLAGS = MSG_DONTWAIT | MSG_NOSIGNAL; // NOLINT(hicpp-signed-bitwise)
+#else
+    const int SEND_FLAGS = MSG_DONTWAIT;
+#endif
+}
+
+http_response_writer_t::http_response_writer_t(int sd, const config_t &config)
+    : sd(sd),
+      config(config),
+      started(false),
+      finished(false),
+      failed(false),
+      chunked(false),
+      corked(false),
+      front_offset(0),
+      queued_bytes(0),
+      sent_bytes(0),
+      encoding(content_encoding_t::identity),
+      compression_level(0) {
+}
+
+http_response_writer_t::~http_response_writer_t() = default;
+
+void http_response_writer_t::set_compression(content_encoding_t _encoding, int level) {
+    if (this->started) {
+        throw std::runtime_error("圧縮の設定はヘッダを送信する前に行ってください。");
+    }
+    this->encoding = _encoding;
+    this->compression_level = level;
+}
+
+bool http_response_writer_t::start(const http_response_t &response, std::optional<size_t> content_length) {
+    if (this->started) {
+        throw std::runtime_error("ヘッダは送信済みです。");
+    }
+    this->started = true;
+
+    // ボディは送らないので、ステータスとヘッダだけをコピーする
+    http_response_t header_only;
+    header_only.set_status(response.get_status());
+    for (const auto &header_item : response.get_header()) {
+        header_only.add_header(header_item.first, header_item.second);
+    }
+
+    if (this->encoding != content_encoding_t::identity) {
+        this->compression = std::make_shared<compression_stream_t>(this->encoding, this->compression_level);
+        header_only.add_header("Content-Encoding", compression_stream_t::get_name(this->encoding));
+        header_only.append_header_value("Vary", "Accept-Encoding");
+        // 圧縮後のサイズは分からない
+        content_length = std::nullopt;
+    }
+
+    if (content_length) {
+        this->remaining_length = content_length;
+        header_only.add_header("Content-Length", std::to_string(*content_length));
+    } else {
+        this->chunked = true;
+        header_only.add_header("Transfer-Encoding", "chunked");
+    }
+
+    this->enqueue(header_only.to_header_string());
+
+    // ヘッダはすぐに送る
+    // (cork の場合は、カーネルに溜めて最初のボディと同じセグメントで送る)
+    return this->drain(0, true, socket_options_t::get_default().get_more_flag());
+}
+
+bool http_response_writer_t::write(const char* data, size_t size) {
+    if (!this->started || this->finished) {
+        throw std::runtime_error("ヘッダを送信する前か、レスポンスを終了した後です。");
+    }
+    if (this->failed) {
+        return false;
+    }
+    if (size == 0) {
+        return true;
+    }
+    if (this->remaining_length) {
+        // 宣言したより長いボディを送ると、超えた分が次のレスポンスとして読まれてしまう
+        if (size > *this->remaining_length) {
+            async_logger_t::get_default().log(async_logger_t::level_t::error, "response body exceeds Content-Length");
+            this->failed = true;
+            return false;
+        }
+        *this->remaining_length -= size;
+    }
+
+    if (this->compression) {
+        this->enqueue_body(this->compression->write(data, size));
+    } else {
+        this->enqueue_body(std::string(data, size));
+    }
+
+    // 送れるだけ送る
+    if (!this->drain(0, false)) {
+        return false;
+    }
+
+    // 溜まりすぎている場合は減るまで待つ
+    if (this->queued_bytes > this->config.high_watermark) {
+        return this->drain(this->config.low_watermark, true);
+    }
+    return true;
+}
+
+bool http_response_writer_t::write_event(const std::string &event, const std::string &data) {
+    std::string message;
+    if (!event.empty()) {
+        message.append("event: ").append(event).append("\n");
+    }
+
+    std::vector<std::string> lines;
+    boost::split(lines, data, boost::is_any_of("\n"), boost::token_compress_off);
+    for (const auto &line : lines) {
+        message.append("data: ").append(boost::trim_right_copy_if(line, boost::is_any_of("\r"))).append("\n");
+    }
+    message.append("\n");
+
+    if (!this->write(message)) {
+        return false;
+    }
+    // イベントはすぐにクライアントに届ける
+    return this->flush();
+}
+
+bool http_response_writer_t::flush() {
+    if (this->failed) {
+        return false;
+    }
+    if (!this->drain(0, true)) {
+        return false;
+    }
+    // キューが空で送らなかった場合も、カーネルに溜めたヘッダは送り出す
+    if (this->corked) {
+        socket_options_t::push(this->sd);
+        this->corked = false;
+    }
+    return true;
+}
+
+bool http_response_writer_t::finish() {
+    if (this->finished) {
+        return !this->failed;
+    }
+    this->finished = true;
+    if (this->failed) {
+        return false;
+    }
+    if (this->remaining_length && *this->remaining_length > 0) {
+        // 足りないまま終わると、クライアントは残りのボディを待ち続ける
+        async_logger_t::get_default().log(async_logger_t::level_t::error, "response body is shorter than Content-Length");
+        this->failed = true;
+        return false;
+    }
+
+    if (this->compression) {
+        this->enqueue_body(this->compression->finish());
+    }
+    if (this->chunked) {
+        // last-chunk と、トレイラーなしの終わりの空行
+        this->enqueue("0" + http_constants_t::CRLF2);
+    }
+    return this->flush();
+}
+
+void http_response_writer_t::enqueue_body(std::string &&data) {
+    if (data.empty()) {
+        return;
+    }
+    if (this->chunked) {
+        this->enqueue((boost::format("%x") % data.size()).str() + http_constants_t::CRLF);
+        this->enqueue(std::move(data));
+        this->enqueue(std::string(http_constants_t::CRLF));
+        return;
+    }
+    this->enqueue(std::move(data));
+}
+
+void http_response_writer_t::enqueue(std::string &&data) {
+    this->queued_bytes += data.size();
+    this->queue.push_back(std::move(data));
+}
+
+bool http_response_writer_t::drain(size_t target, bool wait, int more_flag) {
+    while (this->queued_bytes > target) {
+        // キューの中身をまとめて送る (sendmsg は writev と同じく複数のバッファを1回で送れる)
+        std::array<iovec, MAX_IOV_COUNT> iov{};
+        size_t count = 0;
+        for (auto it = this->queue.begin(); it != this->queue.end() && count < iov.size(); ++it, ++count) {
+            const auto offset = count == 0 ? this->front_offset : 0;
+            iov[count].iov_base = const_cast<char*>(it->data()) + offset;
+            iov[count].iov_len = it->size() - offset;
+        }
+
+        msghdr message{};
+        message.msg_iov = iov.data();
+        message.msg_iovlen = count;
+        const auto sent = sendmsg(this->sd, &message, SEND_FLAGS | more_flag); // NOLINT(hicpp-signed-bitwise)
+        if (sent == -1) {
+            if (errno == EINTR) {
+                if (http_server_t::is_shutdown_required()) {
+                    this->failed = true;
+                    return false;
+                }
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                if (!wait) {
+                    return true;
+                }
+                // 書き込めるようになるまで待つ
+                // (受信しないクライアントに占有されないよう、待っている間だけ書き込みのタイムアウトを掛ける)
+                connection_deadline_t deadline(this->sd);
+                deadline.enter(connection_deadline_t::phase_t::write);
+                pollfd fds{this->sd, POLLOUT, 0};
+                if (poll(&fds, 1, -1) == -1 && errno != EINTR) {
+                    http_server_t::print_error(errno);
+                    this->failed = true;
+                    return false;
+                }
+                if (deadline.is_expired()) {
+                    async_logger_t::get_default().log(async_logger_t::level_t::warning, "response write timed out");
+                    this->failed = true;
+                    return false;
+                }
+                continue;
+            }
+            http_server_t::print_error(errno);
+            this->failed = true;
+            return false;
+        }
+
+        // 送信済みの分をキューから取り除く
+        auto remaining = static_cast<size_t>(sent);
+        this->queued_bytes -= remaining;
+        this->sent_bytes += remaining;
+        this->corked = more_flag != 0;
+        server_metrics_t::get_default().add_sent_bytes(remaining);
+        HTTP_SERVER_PROBE3(response__sent, this->sd, sent, this->queued_bytes);
+        while (remaining > 0) {
+            const auto front_size = this->queue.front().size() - this->front_offset;
+            if (remaining < front_size) {
+                this->front_offset += remaining;
+                break;
+            }
+            remaining -= front_size;
+            this->queue.pop_front();
+            this->front_offset = 0;
+        }
+    }
+    return true;
+}
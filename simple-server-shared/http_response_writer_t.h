@@ -0,0 +1,214 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_HTTP_RESPONSE_WRITER_T_H
+#define HTTP_SERVER_HTTP_RESPONSE_WRITER_T_H
+
+class http_response_t;
+class compression_stream_t;
+enum class content_encoding_t : int;
+
+/**
+ * レスポンスを少しずつ送信するクラス
+ *
+ * `http_response_t::to_string` はボディ全体を組み立ててから送るが、このクラスは
+ *
+ * 1. `start` でステータス行とヘッダをすぐに送り、
+ * 2. `write` でボディを何回にも分けて送り、
+ * 3. `finish` で終わる
+ *
+ * という流れで送信する。`Content-Length` が分からない場合は `Transfer-Encoding: chunked` で送る。
+ * Server-Sent Events やロングポーリングのように、ボディ全体が揃わないレスポンスに使う。
+ *
+ * 書き込んだデータはこのインスタンスの送信キューに入り、ソケットに書き込める分だけ送る
+ * (1つのレスポンスに1つのインスタンスを使うので、キューはレスポンス毎)。
+ * キューが `high_watermark` を超えたら、`low_watermark` を下回るまで `write` を待たせる (バックプレッシャー)。
+ *
+ * `Content-Length` を指定した場合は、ボディがそのバイト数ちょうどになるかを確かめる。
+ * 超える `write` は送らずに `false` を返し、足りないまま `finish` した場合も `false` を返す。
+ * どちらの場合もクライアントはボディの終わりが分からないので、呼び出し側はコネクションを閉じること。
+ */
+class http_response_writer_t {
+public:
+    /**
+     * 送信キューの設定
+     */
+    struct config_t {
+        /**
+         * キューのバイト数がこれを超えたら `write` を待たせる
+         */
+        size_t high_watermark = 256 * 1024;
+
+        /**
+         * 待たせた `write` は、キューのバイト数がこれを下回ったら再開する
+         */
+        size_t low_watermark = 64 * 1024;
+    };
+
+    /**
+     * @param [in] sd クライアントとの通信用ソケットディスクリプタ
+     * @param [in] config 送信キューの設定
+     */
+    http_response_writer_t(int sd, const config_t &config);
+
+    ~http_response_writer_t();
+
+    http_response_writer_t(const http_response_writer_t &) = delete;
+
+    http_response_writer_t &operator=(const http_response_writer_t &) = delete;
+
+    /**
+     * ボディを圧縮して送るようにする (`start` の前に呼ぶこと)
+     *
+     * 圧縮後のサイズは分からないので、chunked で送る。
+     *
+     * @param [in] encoding エンコーディング
+     * @param [in] level 圧縮レベル
+     */
+    void set_compression(content_encoding_t encoding, int level);
+
+    /**
+     * ステータス行とヘッダを送信する
+     *
+     * `response` のボディは無視する。
+     * セグメントの送り方が `cork` (`socket_options_t`) の場合は、最初のボディと同じセグメントにまとめて送る
+     * (ボディを書かずにヘッダだけをすぐに届けたい場合は `flush` を呼ぶ)。
+     *
+     * @param [in] response ステータスとヘッダ
+     * @param [in] content_length ボディのバイト数. 分からない場合は `std::nullopt` (chunked で送る)
+     * @return 送信できた場合 `true`
+     */
+    bool start(const http_response_t &response, std::optional<size_t> content_length);
+
+    /**
+     * ボディの一部を送信する
+     * @param [in] data データ
+     * @param [in] size バイト数
+     * @return 送信できた場合 `true`. クライアントが切断した場合や、`Content-Length` を超える場合は `false`
+     */
+    bool write(const char* data, size_t size);
+
+    /**
+     * ボディの一部を送信する
+     * @param [in] data データ
+     * @return 送信できた場合 `true`
+     */
+    inline bool write(const std::string &data) {
+        return this->write(data.data(), data.size());
+    }
+
+    /**
+     * Server-Sent Events のイベントを1つ送信する
+     *
+     * `start` で `Content-Type: text/event-stream` を付けておくこと。
+     *
+     * @param [in] event イベント名 (空の場合は省略)
+     * @param [in] data データ (改行を含む場合は複数の data 行にする)
+     * @return 送信できた場合 `true`
+     */
+    bool write_event(const std::string &event, const std::string &data);
+
+    /**
+     * 送信キューが空になるまで送信する
+     * @return 送信できた場合 `true`
+     */
+    bool flush();
+
+    /**
+     * ボディの終わりを送信して、送信キューが空になるまで送信する
+     * @return 送信できた場合 `true`. ボディが `Content-Length` より短い場合は `false`
+     */
+    bool finish();
+
+    /**
+     * 送信キューに残っているバイト数を取得する
+     * @return バイト数
+     */
+    [[nodiscard]] inline size_t get_queued_bytes() const {
+        return this->queued_bytes;
+    }
+
+    /**
+     * ソケットに書き込んだバイト数 (ヘッダを含む) を取得する
+     * @return バイト数
+     */
+    [[nodiscard]] inline size_t get_sent_bytes() const {
+        return this->sent_bytes;
+    }
+
+private:
+    int sd;
+
+    config_t config;
+
+    bool started;
+
+    bool finished;
+
+    /**
+     * 送信に失敗したか (失敗した後は何も送らない)
+     */
+    bool failed;
+
+    /**
+     * chunked で送るか
+     */
+    bool chunked;
+
+    /**
+     * `Content-Length` で送る場合の、ボディの残りのバイト数 (chunked の場合は `std::nullopt`)
+     */
+    std::optional<size_t> remaining_length;
+
+    /**
+     * MSG_MORE で送って、まだカーネルに溜まっているセグメントがあるか
+     */
+    bool corked;
+
+    /**
+     * 送信キュー
+     */
+    std::deque<std::string> queue;
+
+    /**
+     * キューの先頭の送信済みバイト数
+     */
+    size_t front_offset;
+
+    size_t queued_bytes;
+
+    size_t sent_bytes;
+
+    /**
+     * 圧縮する場合の圧縮ストリーム
+     */
+    std::shared_ptr<compression_stream_t> compression;
+
+    content_encoding_t encoding;
+
+    int compression_level;
+
+    /**
+     * ボディのデータを (chunked の場合はチャンクにして) キューに入れる
+     */
+    void enqueue_body(std::string &&data);
+
+    /**
+     * キューに入れる
+     */
+    void enqueue(std::string &&data);
+
+    /**
+     * キューのバイト数が `target` 以下になるまで送信する
+     *
+     * @param [in] target 目標のバイト数
+     * @param [in] wait `false` の場合は、ソケットに書き込めなくなったら待たずに戻る
+     * @param [in] more_flag 続きを書く予定の場合は MSG_MORE (カーネルがセグメントを送らずに溜める)
+     * @return 送信に失敗した場合 `false`
+     */
+    bool drain(size_t target, bool wait, int more_flag = 0);
+};
+
+
+#endif //HTTP_SERVER_HTTP_RESPONSE_WRITER_T_H
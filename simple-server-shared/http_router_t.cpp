@@ -0,0 +1,268 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <boost/algorithm/string/join.hpp>
+#include "http_router_t.h"
+#include "http_request_t.h"
+#include "http_response_t.h"
+
+/**
+ * 基数木のノード
+ */
+struct http_router_t::node_t {
+    /**
+     * このノードが表す固定のパスの断片
+     */
+    std::string prefix;
+
+    /**
+     * 固定のパスの子 (先頭の文字は全て違う)
+     */
+    std::vector<std::unique_ptr<node_t>> children;
+
+    /**
+     * パスパラメータの子と、その名前
+     */
+    std::unique_ptr<node_t> param_child;
+    std::string param_name;
+
+    /**
+     * 残り全部の子と、その名前
+     */
+    std::unique_ptr<node_t> wildcard_child;
+    std::string wildcard_name;
+
+    /**
+     * ここで終わるパスのハンドラ (メソッド毎)
+     */
+    std::vector<std::pair<std::string, handler_t>> handlers;
+
+    /**
+     * 固定のパスを追加して、その終わりのノードを返す
+     */
+    node_t &insert_static(std::string_view text) {
+        auto* node = this;
+        while (!text.empty()) {
+            auto it = std::find_if(node->children.begin(), node->children.end(), [&text](const auto &child) {
+                return child->prefix[0] == text[0];
+            });
+            if (it == node->children.end()) {
+                auto child = std::make_unique<node_t>();
+                child->prefix = std::string(text);
+                node->children.push_back(std::move(child));
+                return *node->children.back();
+            }
+
+            auto &child = **it;
+            // 共通の接頭辞の長さ
+            size_t common = 0;
+            while (common < child.prefix.size() && common < text.size() && child.prefix[common] == text[common]) {
+                common++;
+            }
+
+            if (common < child.prefix.size()) {
+                // 子を共通部分と残りに分ける
+                auto rest = std::make_unique<node_t>();
+                rest->prefix = child.prefix.substr(common);
+                rest->children = std::move(child.children);
+                rest->param_child = std::move(child.param_child);
+                rest->param_name = std::move(child.param_name);
+                rest->wildcard_child = std::move(child.wildcard_child);
+                rest->wildcard_name = std::move(child.wildcard_name);
+                rest->handlers = std::move(child.handlers);
+
+                child.prefix.resize(common);
+                child.children.clear();
+                child.children.push_back(std::move(rest));
+                child.param_child = nullptr;
+                child.param_name.clear();
+                child.wildcard_child = nullptr;
+                child.wildcard_name.clear();
+                child.handlers.clear();
+            }
+
+            text.remove_prefix(common);
+            node = &child;
+        }
+        return *node;
+    }
+
+    [[nodiscard]] const handler_t* find_handler(std::string_view method) const {
+        const handler_t* any = nullptr;
+        for (const auto &item : this->handlers) {
+            if (item.first == method) {
+                return &item.second;
+            }
+            if (item.first == "*") {
+                any = &item.second;
+            }
+        }
+        return any;
+    }
+};
+
+std::optional<std::string_view> http_router_t::params_t::get(std::string_view name) const {
+    for (const auto &item : this->values) {
+        if (item.first == name) {
+            return item.second;
+        }
+    }
+    return std::nullopt;
+}
+
+http_router_t::http_router_t()
+    : root(std::make_unique<node_t>()) {
+}
+
+http_router_t::~http_router_t() = default;
+
+void http_router_t::add(const std::string &method, const std::string &pattern, handler_t handler) {
+    if (pattern.empty() || pattern[0] != '/') {
+        throw std::runtime_error("ルートのパターンは \"/\" で始めてください: " + pattern);
+    }
+
+    auto* node = this->root.get();
+    std::string_view rest(pattern);
+    while (!rest.empty()) {
+        const auto special_pos = rest.find_first_of(":*");
+        if (special_pos != 0) {
+            // 次のパラメータまでは固定のパス
+            const auto static_part = rest.substr(0, special_pos);
+            node = &node->insert_static(static_part);
+            rest.remove_prefix(static_part.size());
+            continue;
+        }
+
+        if (rest[0] == ':') {
+            const auto end_pos = rest.find('/');
+            const auto name = std::string(rest.substr(1, end_pos == std::string_view::npos ? std::string_view::npos : end_pos - 1));
+            if (name.empty()) {
+                throw std::runtime_error("パスパラメータの名前がありません: " + pattern);
+            }
+            if (!node->param_child) {
+                node->param_child = std::make_unique<node_t>();
+                node->param_name = name;
+            } else if (node->param_name != name) {
+                throw std::runtime_error("同じ位置に別の名前のパスパラメータがあります: " + pattern);
+            }
+            node = node->param_child.get();
+            rest.remove_prefix(end_pos == std::string_view::npos ? rest.size() : end_pos);
+            continue;
+        }
+
+        // `*` は残り全部
+        const auto name = std::string(rest.substr(1));
+        if (name.empty() || name.find('/') != std::string::npos) {
+            throw std::runtime_error("\"*\" はパターンの最後にだけ書けます: " + pattern);
+        }
+        if (!node->wildcard_child) {
+            node->wildcard_child = std::make_unique<node_t>();
+            node->wildcard_name = name;
+        } else if (node->wildcard_name != name) {
+            throw std::runtime_error("同じ位置に別の名前の \"*\" があります: " + pattern);
+        }
+        node = node->wildcard_child.get();
+        break;
+    }
+
+    for (auto &item : node->handlers) {
+        if (item.first == method) {
+            item.second = std::move(handler);
+            return;
+        }
+    }
+    node->handlers.emplace_back(method, std::move(handler));
+}
+
+const http_router_t::handler_t* http_router_t::find(std::string_view method, std::string_view path, params_t &params) const {
+    params.clear();
+    const auto node = match(*this->root, path, params);
+    if (!node) {
+        return nullptr;
+    }
+    return node->find_handler(method);
+}
+
+bool http_router_t::dispatch(const http_request_t &request, http_response_t &response) const {
+    params_t params;
+    const auto path = get_path(request.get_uri());
+    const auto node = match(*this->root, path, params);
+    if (!node || node->handlers.empty()) {
+        response.set_status(404);
+        response.add_header("Content-Type", "text/plain");
+        response.set_body("Not Found");
+        return false;
+    }
+
+    const auto handler = node->find_handler(request.get_method());
+    if (!handler) {
+        std::vector<std::string> methods;
+        for (const auto &item : node->handlers) {
+            methods.push_back(item.first);
+        }
+        response.set_status(405);
+        response.add_header("Allow", boost::join(methods, ", "));
+        response.add_header("Content-Type", "text/plain");
+        response.set_body("Method Not Allowed");
+        return false;
+    }
+
+    response.set_status(200);
+    (*handler)(request, params, response);
+    return true;
+}
+
+std::string_view http_router_t::get_path(std::string_view uri) {
+    const auto query_pos = uri.find_first_of("?#");
+    return query_pos == std::string_view::npos ? uri : uri.substr(0, query_pos);
+}
+
+const http_router_t::node_t* http_router_t::match(const node_t &node, std::string_view path, params_t &params) {
+    if (path.empty()) {
+        if (!node.handlers.empty()) {
+            return &node;
+        }
+        // `/files/*path` は `/files/` にも一致させる (残りは空)
+        if (node.wildcard_child && !node.wildcard_child->handlers.empty()) {
+            params.add(node.wildcard_name, path);
+            return node.wildcard_child.get();
+        }
+        return nullptr;
+    }
+
+    // 固定のパス
+    for (const auto &child : node.children) {
+        if (child->prefix[0] != path[0]) {
+            continue;
+        }
+        if (path.substr(0, child->prefix.size()) == child->prefix) {
+            if (const auto found = match(*child, path.substr(child->prefix.size()), params)) {
+                return found;
+            }
+        }
+        // 先頭の文字が同じ子は1つだけ
+        break;
+    }
+
+    // パスパラメータ (次の `/` まで、空は不可)
+    if (node.param_child) {
+        const auto end_pos = std::min(path.find('/'), path.size());
+        if (end_pos > 0) {
+            const auto saved_size = params.values.size();
+            params.add(node.param_name, path.substr(0, end_pos));
+            if (const auto found = match(*node.param_child, path.substr(end_pos), params)) {
+                return found;
+            }
+            params.values.resize(saved_size);
+        }
+    }
+
+    // 残り全部
+    if (node.wildcard_child && !node.wildcard_child->handlers.empty()) {
+        params.add(node.wildcard_name, path);
+        return node.wildcard_child.get();
+    }
+    return nullptr;
+}
@@ -0,0 +1,127 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_HTTP_ROUTER_T_H
+#define HTTP_SERVER_HTTP_ROUTER_T_H
+
+class http_request_t;
+class http_response_t;
+
+/**
+ * メソッドとパスでハンドラを選ぶルーター (基数木)
+ *
+ * パスのパターンには次のものを書ける。
+ *
+ * * `/users` : 固定のパス
+ * * `/users/:id` : `:` で始まるセグメントはパスパラメータ (次の `/` まで)
+ * * `/static/\*path` : `*` で始まるセグメントは残り全部 (パターンの最後にだけ書ける)
+ *
+ * 複数のパターンに一致する場合は、固定のパス > パスパラメータ > 残り全部 の順に優先する。
+ * メソッドに `*` を指定すると、全てのメソッドに一致する。
+ *
+ * 固定のパスは共通の接頭辞をまとめた木 (基数木) にするので、
+ * ルートの数が増えても、探索はパスの長さ程度の比較で済む。
+ */
+class http_router_t {
+public:
+    /**
+     * パスパラメータ
+     *
+     * 値はリクエストのパスを指しているので、リクエストより長く使わないこと。
+     */
+    class params_t {
+    public:
+        /**
+         * パスパラメータを取得する
+         * @param [in] name 名前 (`:` や `*` は付けない)
+         * @return 値. ない場合は `std::nullopt`
+         */
+        [[nodiscard]] std::optional<std::string_view> get(std::string_view name) const;
+
+        /**
+         * パスパラメータを追加する
+         * @param [in] name 名前
+         * @param [in] value 値
+         */
+        inline void add(std::string_view name, std::string_view value) {
+            this->values.emplace_back(name, value);
+        }
+
+        /**
+         * 全て削除する
+         */
+        inline void clear() {
+            this->values.clear();
+        }
+
+    private:
+        std::vector<std::pair<std::string_view, std::string_view>> values;
+
+        friend class http_router_t;
+    };
+
+    /**
+     * ルートのハンドラ
+     *
+     * `response` はステータス 200 の空のレスポンスで渡されるので、ボディやヘッダをセットする。
+     */
+    using handler_t = std::function<void(const http_request_t &request, const params_t &params, http_response_t &response)>;
+
+    http_router_t();
+
+    ~http_router_t();
+
+    http_router_t(const http_router_t &) = delete;
+
+    http_router_t &operator=(const http_router_t &) = delete;
+
+    /**
+     * ルートを追加する
+     * @param [in] method メソッド (`*` の場合は全て)
+     * @param [in] pattern パスのパターン
+     * @param [in] handler ハンドラ
+     */
+    void add(const std::string &method, const std::string &pattern, handler_t handler);
+
+    /**
+     * ハンドラを探す
+     *
+     * @param [in] method メソッド
+     * @param [in] path パス (クエリ文字列は含めない)
+     * @param [out] params パスパラメータ
+     * @return ハンドラ. 見つからない場合は nullptr
+     */
+    const handler_t* find(std::string_view method, std::string_view path, params_t &params) const;
+
+    /**
+     * リクエストに一致するハンドラを実行する
+     *
+     * 一致するパスがない場合は 404、パスはあるがメソッドが違う場合は 405 (`Allow` 付き) をレスポンスにセットする。
+     *
+     * @param [in] request リクエスト
+     * @param [out] response レスポンス
+     * @return ハンドラを実行した場合 `true`
+     */
+    bool dispatch(const http_request_t &request, http_response_t &response) const;
+
+    /**
+     * URI からクエリ文字列を除いたパスを取得する
+     * @param [in] uri URI
+     * @return パス
+     */
+    static std::string_view get_path(std::string_view uri);
+
+private:
+    struct node_t;
+
+    std::unique_ptr<node_t> root;
+
+    /**
+     * パスに一致するノードを探す (固定 > パラメータ > 残り全部 の順に試して、だめなら戻る)
+     */
+    static const node_t* match(const node_t &node, std::string_view path, params_t &params);
+};
+
+
+#endif //HTTP_SERVER_HTTP_ROUTER_T_H
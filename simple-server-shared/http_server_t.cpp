@@ -5,13 +5,75 @@
 #include "common.h"
 #include <strings.h>
 #include <sys/fcntl.h>
+#include <poll.h>
+#include <charconv>
 
 
 #include "http_server_t.h"
 #include "http_request_t.h"
+#include "timing_wheel_t.h"
+#include "connection_deadline_t.h"
+#include "admission_controller_t.h"
+#include "rate_limiter_t.h"
+#include "buffer_pool_t.h"
+#include "async_logger_t.h"
+#include "server_metrics_t.h"
+#include "allocation_accounting_t.h"
+#include "request_capture_t.h"
+#include "worker_stats_t.h"
+#include "worker_supervisor_t.h"
+#include "listener_handoff_t.h"
+#include "unix_listener_t.h"
+#include "socket_options_t.h"
+#include "trace_probes.h"
 
 bool http_server_t::signal_handlers_registered = false;
 volatile bool http_server_t::shutdown_required = false;
+volatile bool http_server_t::upgrade_required = false;
+
+namespace {
+    /**
+     * 環境変数 `SIMPLE_SERVER_WORKERS` のワーカー数 (設定されていない場合は 0)
+     */
+    size_t get_worker_count_from_environment() {
+        const auto value = std::getenv("SIMPLE_SERVER_WORKERS");
+        if (!value) {
+            return 0;
+        }
+        if (std::string_view(value) == "auto") {
+            return std::max(std::thread::hardware_concurrency(), 1U);
+        }
+        return std::strtoul(value, nullptr, 10);
+    }
+
+    bool get_reuse_port_from_environment() {
+        const auto value = std::getenv("SIMPLE_SERVER_REUSE_PORT");
+        return value && std::string_view(value) == "1";
+    }
+
+    /**
+     * 環境変数 `SIMPLE_SERVER_LISTEN_TCP=0` の場合は、TCP で待ち受けない
+     */
+    bool get_listen_tcp_from_environment() {
+        const auto value = std::getenv("SIMPLE_SERVER_LISTEN_TCP");
+        return !value || std::string_view(value) != "0";
+    }
+
+    int get_family(int sd) {
+        sockaddr_storage addr{};
+        socklen_t length = sizeof(addr);
+        if (getsockname(sd, reinterpret_cast<sockaddr*>(&addr), &length) == -1) {
+            return AF_UNSPEC;
+        }
+        return addr.ss_family;
+    }
+
+    void close_all(const std::vector<int> &sds) {
+        for (const auto sd : sds) {
+            close(sd);
+        }
+    }
+}
 
 void http_server_t::start(
     const char* ip_address,
@@ -22,6 +84,87 @@ void http_server_t::start(
         signal_handlers_registered = true;
     }
 
+    if (!this->unix_socket) {
+        this->unix_socket = unix_listener_t::get_config_from_environment();
+    }
+
+    // 前のプロセスが動いていれば、待ち受けのソケットを引き継ぐ
+    // (SIGUSR2 で起動し直した場合、systemd のソケット起動、SIMPLE_SERVER_HANDOFF_PATH)
+    listener_handoff_t handoff(listener_handoff_t::get_path_from_environment());
+    auto inherited = handoff.take_listener();
+
+    const auto workers = this->worker_count.value_or(get_worker_count_from_environment());
+    if (workers > 0) {
+        this->start_prefork(ip_address, port, workers, this->reuse_port.value_or(get_reuse_port_from_environment()), handoff, inherited);
+        return;
+    }
+
+    const auto listeners = this->open_listeners(ip_address, port, inherited, true);
+    if (listeners.empty()) {
+        return;
+    }
+    handoff.serve(listeners);
+
+    // 受け付けられるようになったので、前のプロセスを止める
+    listener_handoff_t::notify_predecessor(inherited);
+    this->accept_loop(listeners, true);
+
+    // 受け付けるのをやめたので、処理中の接続が終わるのを待つ
+    handoff.stop();
+    if (this->unix_socket) {
+        unix_listener_t::remove(*this->unix_socket);
+    }
+    this->drain();
+}
+
+std::vector<int> http_server_t::open_listeners(
+    const char* ip_address,
+    ushort port,
+    listener_handoff_t::inherited_t &inherited,
+    bool open_tcp
+) const {
+    std::vector<int> listeners;
+
+    // TCP (引き継いだソケットがある場合は、ワーカー毎に開く設定でもそれを使う)
+    if (this->listen_tcp.value_or(get_listen_tcp_from_environment())) {
+        auto sd = inherited.take(AF_INET);
+        if (sd != -1) {
+            // 前のプロセスと設定が違っていてもいいように、このプロセスの設定を付け直す
+            socket_options_t::get_default().apply_to_listener(sd);
+        } else if (open_tcp) {
+            sd = this->open_listener(ip_address, port, false);
+            if (sd == -1) {
+                inherited.close_rest();
+                return {};
+            }
+        }
+        if (sd != -1) {
+            listeners.push_back(sd);
+        }
+    }
+
+    // Unix ドメインソケット
+    if (this->unix_socket) {
+        auto sd = inherited.take(AF_UNIX, this->unix_socket->path);
+        if (sd == -1) {
+            sd = unix_listener_t::open(*this->unix_socket, this->backlog);
+            if (sd == -1) {
+                close_all(listeners);
+                inherited.close_rest();
+                return {};
+            }
+        }
+        listeners.push_back(sd);
+        async_logger_t::get_default().log(async_logger_t::level_t::info, "listening on unix socket " + this->unix_socket->path);
+    }
+
+    // 設定が変わって使わなくなったソケット
+    inherited.close_rest();
+    return listeners;
+}
+
+int http_server_t::open_listener(const char* ip_address, ushort port, bool reuse_port) const {
+
     /* #####################################################################
        * 待ち受けるIPアドレスにソケットをバインドする
        * ##################################################################### */
@@ -31,7 +174,7 @@ void http_server_t::start(
     //  AF_INET は普通のIPV4ソケット
     //  他に普通に使う定数としては以下がある
     //      * AF_INET6 => IPv6 ソケット
-    //      * AF_UNIX => ユニックスソケット (ドキュメントで別途説明する)
+    //      * AF_UNIX => ユニックスソケット (unix_listener_t で開く)
     //
     // 第二引数:
     //  SOCK_STREAM は TCP通信するときにしている
@@ -62,7 +205,7 @@ void http_server_t::start(
 
     if (sd == -1) {
         print_error(errno);
-        return;
+        return -1;
     }
 
     // fork したときに 親のSDハクローズする
@@ -70,6 +213,17 @@ void http_server_t::start(
     fd_flags |= FD_CLOEXEC; // NOLINT(hicpp-signed-bitwise)
     fcntl(sd, F_SETFD, fd_flags);
 
+    // SO_REUSEADDR, TCP_DEFER_ACCEPT, TCP_FASTOPEN などは bind する前に付ける
+    // (受け付けたソケットにも引き継がれる)
+    socket_options_t::get_default().apply_to_listener(sd);
+
+    // prefork のワーカー毎に開く場合は、同じポートで何度も bind できるようにする
+    // (カーネルが接続を各ソケットに振り分ける)
+    if (reuse_port) {
+        const int on = 1;
+        setsockopt(sd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on));
+    }
+
     /* #####################################################################
      * 待ち受けるIPアドレスにソケットをバインドする
      * ##################################################################### */
@@ -95,19 +249,69 @@ void http_server_t::start(
     if (ret == -1) {
         print_error(errno);
         close(sd);
+        return -1;
     }
 
     /* #####################################################################
      * クライアントからの接続を待ち受ける
      *
-     * 第二引数の 10 は 接続待ちキューの最大数です。
-     * 次の accept() を呼ぶまでの間に 11 以上のクライアントがアクセスしてくると、
+     * 第二引数は 接続待ちキューの最大数です (`set_backlog` で変更できる)。
+     * 次の accept() を呼ぶまでの間にそれより多いクライアントがアクセスしてくると、
      * クライアントは、ECONNREFUSED を受け取ります。
+     *
+     * キューで待っている間は処理が始まらないので、大きくしすぎると過負荷のときに待ち時間が伸びるだけになる。
      * ##################################################################### */
-    ret = listen(sd, 10);
+    ret = listen(sd, this->backlog);
     if (ret == -1) {
         print_error(errno);
     }
+    return sd;
+}
+
+int http_server_t::accept_client(const std::vector<int> &listeners, sockaddr_storage &client_addr) {
+    const auto &options = socket_options_t::get_default();
+    socklen_t client_addr_size = sizeof(client_addr);
+
+    // 1つだけの場合は、ブロックする accept で待つ
+    // (prefork で共有している場合も、接続が来るとどれか1つのワーカーだけが起こされる)
+    if (listeners.size() == 1) {
+        return options.accept(listeners.front(), reinterpret_cast<sockaddr*>(&client_addr), &client_addr_size);
+    }
+
+    // 複数の場合は、どれかで受け付けられるようになるまで待つ
+    // (ソケットはノンブロッキングなので、他のワーカーに先に取られた場合は EAGAIN になる)
+    std::array<pollfd, listener_handoff_t::MAX_LISTENERS> fds{};
+    const auto count = std::min(listeners.size(), fds.size());
+    for (size_t i = 0; i < count; i++) {
+        fds[i] = {listeners[i], POLLIN, 0};
+    }
+    if (poll(fds.data(), count, -1) == -1) {
+        return -1;
+    }
+    // 1つのソケットばかり受け付けないように、見始める位置をずらす
+    for (size_t n = 0; n < count; n++) {
+        const auto i = (this->next_listener + n) % count;
+        if ((fds[i].revents & POLLIN) == 0) { // NOLINT(hicpp-signed-bitwise)
+            continue;
+        }
+        client_addr_size = sizeof(client_addr);
+        const auto client_sd = options.accept(listeners[i], reinterpret_cast<sockaddr*>(&client_addr), &client_addr_size);
+        if (client_sd != -1 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+            this->next_listener = i + 1;
+            return client_sd;
+        }
+    }
+    errno = EAGAIN;
+    return -1;
+}
+
+void http_server_t::accept_loop(const std::vector<int> &listeners, bool upgradable) {
+    // 複数の場合は poll で待ってから受け付けるのでノンブロッキングに、1つの場合は accept で待つのでブロッキングにする
+    // (引き継いだソケットは、前のプロセスの設定のままなので)
+    for (const auto sd : listeners) {
+        const auto flags = fcntl(sd, F_GETFL);
+        fcntl(sd, F_SETFL, listeners.size() > 1 ? flags | O_NONBLOCK : flags & ~O_NONBLOCK); // NOLINT(hicpp-signed-bitwise)
+    }
 
     /* #####################################################################
      * クライアントからの接続を受け付ける
@@ -116,18 +320,22 @@ void http_server_t::start(
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wmissing-noreturn"
     for (;;) {
-        struct sockaddr_in client_addr{};
-        auto client_addr_size = sizeof(client_addr);
-        bzero(&client_addr, client_addr_size);
-
-        auto client_sd = accept(sd,
-                                reinterpret_cast<sockaddr*>(&client_addr),
-                                reinterpret_cast<socklen_t*>(&client_addr_size)
-        );
+        struct sockaddr_storage client_addr{};
+        auto client_sd = this->accept_client(listeners, client_addr);
 
         if (client_sd > 0) {
-            this->handle_client(client_sd, &client_addr);
-        } else if (errno != EINTR) {
+            HTTP_SERVER_PROBE1(connection__accept, client_sd);
+            server_metrics_t::get_default().add_connection();
+
+            // 同時接続数が上限に達している場合は、何もせずに断る
+            if (this->admission_controller && !this->admission_controller->try_accept_connection()) {
+                this->admission_controller->reject(client_sd);
+            } else {
+                this->handle_client(client_sd, &client_addr);
+            }
+            // prefork のワーカーの場合は、共有メモリのカウンタを更新する
+            server_metrics_t::get_default().publish();
+        } else if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
             // EINTR は シグナル受信による中断を示す。
             // このプログラムはシグナルを受け取る予定がないので、エラー扱いにしても良いのだが、
             // デバッグ時にブレークポイントを設定すると、SIGNALが発生するようなので、リトライする。
@@ -143,20 +351,182 @@ void http_server_t::start(
         // 終了系のシグナルが送られた場合はソケットを閉じて終了する
         if (http_server_t::shutdown_required) {
             shutdown(client_sd, SHUT_RDWR);
-            close(sd);
+            close_all(listeners);
             break;
         }
+        // 入れ替えのシグナルの場合は、新しいプロセスを起動して、止められるまでは受け付け続ける
+        // (prefork のワーカーは無視する. マスターが起動し直す)
+        if (http_server_t::upgrade_required) {
+            http_server_t::upgrade_required = false;
+            if (upgradable) {
+                listener_handoff_t::spawn_successor(listeners);
+            }
+        }
     }
 #pragma clang diagnostic pop
 }
 
+void http_server_t::drain() const {
+    const auto is_idle = [this] {
+        if (server_metrics_t::get_default().get_connections_active() > 0) {
+            return false;
+        }
+        // 1接続 1スレッドのサーバは、スレッドが動き出すまで接続のゲージに入らないので、受け付けた数も見る
+        return !this->admission_controller || this->admission_controller->get_connection_count() == 0;
+    };
+
+    const auto deadline = std::chrono::steady_clock::now() + this->drain_timeout;
+    while (!is_idle()) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            async_logger_t::get_default().log(
+                async_logger_t::level_t::warning,
+                "drain timed out: " + std::to_string(server_metrics_t::get_default().get_connections_active()) + " connections"
+            );
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+void http_server_t::start_prefork(
+    const char* ip_address,
+    ushort port,
+    size_t workers,
+    bool per_worker_socket,
+    listener_handoff_t &handoff,
+    listener_handoff_t::inherited_t &inherited
+) {
+    // 共有する場合は fork する前に開いておき、ワーカーは同じソケットで accept する
+    // (ブロックしている accept は、接続が来るとどれか1つのワーカーだけが起こされる)
+    // Unix ドメインソケットと、引き継いだ TCP のソケットは、ワーカー毎に開く設定でも共有する
+    const auto listeners = this->open_listeners(ip_address, port, inherited, !per_worker_socket);
+    per_worker_socket = this->listen_tcp.value_or(get_listen_tcp_from_environment())
+                        && std::none_of(listeners.begin(), listeners.end(), [](int sd) {
+                            return get_family(sd) == AF_INET;
+                        });
+    if (listeners.empty() && !per_worker_socket) {
+        return;
+    }
+    handoff.serve(listeners);
+
+    worker_stats_t stats(workers);
+    worker_supervisor_t::config_t config;
+    config.worker_count = workers;
+    // ワーカーが処理中の接続を待ち終わるまでは強制終了しない
+    config.shutdown_timeout = this->drain_timeout + std::chrono::seconds(1);
+    // バックグラウンドのスレッドはワーカーに付いてこないので、fork の間は止めておく
+    // (ロガーは他が止まるまでログを書けるように最後に止めて、最初に開始し直す)
+    config.before_fork = [this] {
+        if (this->rate_limiter) {
+            this->rate_limiter->before_fork();
+        }
+        timing_wheel_t::get_default().before_fork();
+        async_logger_t::get_default().before_fork();
+    };
+    config.after_fork = [this] {
+        async_logger_t::get_default().after_fork();
+        timing_wheel_t::get_default().after_fork();
+        if (this->rate_limiter) {
+            this->rate_limiter->after_fork();
+        }
+    };
+    worker_supervisor_t supervisor(config, stats);
+
+    async_logger_t::get_default().log(
+        async_logger_t::level_t::info,
+        "prefork: " + std::to_string(workers) + " workers" + (per_worker_socket ? " (SO_REUSEPORT)" : "")
+    );
+    // ワーカーを起動する前でも、接続は共有するソケットのキューで待つので断られない
+    // (ワーカー毎に開く場合は、古いワーカーのキューに残った接続はリセットされる)
+    listener_handoff_t::notify_predecessor(inherited);
+    // 記録するファイルは fork する前に1回だけ開く (ワーカーが開くと、互いに切り詰めて上書きしてしまう)
+    request_capture_t::get_default();
+    supervisor.run(
+        [this, &stats, &listeners, per_worker_socket, ip_address, port](size_t index) {
+            return this->run_worker(index, stats, listeners, per_worker_socket, ip_address, port);
+        },
+        [&listeners] {
+            // 入れ替えは、マスターが自分を起動し直して行う (新しいマスターから SIGTERM が来たら止める)
+            if (http_server_t::upgrade_required) {
+                http_server_t::upgrade_required = false;
+                listener_handoff_t::spawn_successor(listeners);
+            }
+            return http_server_t::is_shutdown_required();
+        }
+    );
+    handoff.stop();
+
+    close_all(listeners);
+    if (this->unix_socket) {
+        unix_listener_t::remove(*this->unix_socket);
+    }
+}
+
+int http_server_t::run_worker(
+    size_t index,
+    worker_stats_t &stats,
+    std::vector<int> listeners,
+    bool per_worker_socket,
+    const char* ip_address,
+    ushort port
+) {
+    // バックグラウンドのスレッドは、マスターの after_fork で開始し直してある
+    server_metrics_t::get_default().attach_worker(&stats, index);
+    request_capture_t::get_default().attach_worker(index);
+
+    if (per_worker_socket) {
+        const auto sd = this->open_listener(ip_address, port, true);
+        if (sd == -1) {
+            return 1;
+        }
+        listeners.push_back(sd);
+    }
+    this->accept_loop(listeners, false);
+    this->drain();
+    return 0;
+}
+
+void http_server_t::log_access(
+    const char* client_addr,
+    const http_request_t &request,
+    const std::string &response_text,
+    std::chrono::steady_clock::time_point started
+) {
+    // "HTTP/1.1 200 OK" の 200 の部分
+    int status = 0;
+    const auto space_pos = response_text.find(' ');
+    if (space_pos != std::string::npos) {
+        std::from_chars(response_text.data() + space_pos + 1, response_text.data() + response_text.size(), status);
+    }
+    log_access(client_addr, request, status, response_text.size(), started);
+}
+
+void http_server_t::log_access(
+    const char* client_addr,
+    const http_request_t &request,
+    int status,
+    size_t response_size,
+    std::chrono::steady_clock::time_point started
+) {
+    server_metrics_t::get_default().add_request(status);
+    async_logger_t::get_default().log_access(
+        client_addr ? client_addr : "",
+        request.get_method(),
+        request.get_uri(),
+        status,
+        response_size,
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started)
+    );
+}
+
 void http_server_t::print_error(int _errno) {
     std::vector<char> buffer(1024, '\0');
     strerror_r(_errno, &*buffer.begin(), buffer.size());
-    std::cerr << "error: "
-              << _errno
-              << " " << std::string(&*buffer.begin())
-              << std::endl;
+    server_metrics_t::get_default().add_error();
+    async_logger_t::get_default().log(
+        async_logger_t::level_t::error,
+        "error: " + std::to_string(_errno) + " " + std::string(&*buffer.begin())
+    );
 }
 
 void http_server_t::register_signal_handlers() {
@@ -171,7 +541,8 @@ void http_server_t::register_signal_handlers() {
     int target_signals[] = {
         SIGINT,
         SIGHUP,
-        SIGTERM
+        SIGTERM,
+        SIGUSR2
     };
 
     for (auto signal_number : target_signals) {
@@ -188,6 +559,10 @@ void http_server_t::register_signal_handlers() {
 }
 
 void http_server_t::signal_handler(int signum) {
+    if (signum == SIGUSR2) {
+        http_server_t::upgrade_required = true;
+        return;
+    }
     http_server_t::shutdown_required = true;
 }
 
@@ -195,12 +570,26 @@ void http_server_t::set_client_handler(std::function<void(int, const char*)> cli
     this->client_handler = client_handler;
 }
 
-void http_server_t::handle_client(int sd, const sockaddr_in* client_addr) {
+void http_server_t::handle_client(int sd, const sockaddr_storage* client_addr) {
 
     // クライアントのIPアドレスを文字列形式で保持する。
-    std::vector<char> client_address_buffer(INET_ADDRSTRLEN + 1, '\0');
-    ::inet_ntop(AF_INET, &client_addr->sin_addr, &*client_address_buffer.begin(), INET_ADDRSTRLEN);
-    const std::string client_ip(&*client_address_buffer.begin());
+    // Unix ドメインソケットの場合はIPアドレスがないので "unix" にする
+    std::string client_ip = "unix";
+    if (client_addr->ss_family == AF_INET) {
+        std::vector<char> client_address_buffer(INET_ADDRSTRLEN + 1, '\0');
+        ::inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in*>(client_addr)->sin_addr, &*client_address_buffer.begin(), INET_ADDRSTRLEN);
+        client_ip = &*client_address_buffer.begin();
+    }
+
+    // レート制限を超えている場合は、リクエストを読まずに断る
+    // (Unix ドメインソケットは同じホストのサイドカーからなので、全てのクライアントが1つにまとまってしまう。制限しない)
+    if (this->rate_limiter && client_addr->ss_family == AF_INET && !this->rate_limiter->try_acquire(client_ip)) {
+        this->rate_limiter->reject(sd);
+        if (this->admission_controller) {
+            this->admission_controller->release_connection();
+        }
+        return;
+    }
 
     // ハンドラが登録されていれば処理する
     if (this->client_handler) {
@@ -209,14 +598,57 @@ void http_server_t::handle_client(int sd, const sockaddr_in* client_addr) {
 }
 
 std::shared_ptr<http_request_t> http_server_t::read_request(int sd) {
-    const size_t TEMP_BUFFER_SIZE = 1024;
-    const char BUFFER_INITIAL_VALUE = '\0';
+    return read_request(sd, nullptr);
+}
+
+std::shared_ptr<http_request_t> http_server_t::read_request(
+    int sd,
+    const std::function<void(http_request_t&)> &header_handler,
+    std::pmr::memory_resource* resource
+) {
+    // フェーズ毎のタイムアウト (期限が切れるとソケットが shutdown され、recv が 0 を返す)
+    connection_deadline_t deadline(sd);
+    deadline.enter(connection_deadline_t::phase_t::idle);
+
+    // 最初のバイトまでの時間と、ヘッダの解析までの時間を計る
+    auto &metrics = server_metrics_t::get_default();
+    const auto started = server_metrics_t::clock_t::now();
+
+    // 受信と解析 (ヘッダのハンドラも含む) の間の確保は parse に数える
+    allocation_accounting_t::phase_scope_t allocation_phase(allocation_accounting_t::phase_t::parse);
+
+    // ヘッダのハンドラから使うもの
+    // (まとめて1つの参照でキャプチャして、std::function がメモリを確保しないようにする)
+    struct header_context_t {
+        int sd;
+        connection_deadline_t &deadline;
+        const std::function<void(http_request_t&)> &header_handler;
+        server_metrics_t &metrics;
+        server_metrics_t::clock_t::time_point first_byte_at;
+    } context{sd, deadline, header_handler, metrics, started};
+
+    // 記録する設定の場合は、受信したバイト列をそのまま記録する
+    auto &capture = request_capture_t::get_default();
+    request_capture_t::recording_t recording;
 
     // HTTPリクエスト
-    auto request = std::make_shared<http_request_t>();
+    auto request = std::allocate_shared<http_request_t>(std::pmr::polymorphic_allocator<http_request_t>(resource), resource);
+    request->set_header_handler([&context](http_request_t &parsed_request) {
+        HTTP_SERVER_PROBE3(request__headers, context.sd, parsed_request.get_method().c_str(), parsed_request.get_uri().c_str());
+        context.metrics.record(
+            server_metrics_t::stage_t::header_parse,
+            server_metrics_t::clock_t::now() - context.first_byte_at
+        );
+
+        // ヘッダを受信し終わったので、ここからはボディのタイムアウト
+        context.deadline.enter(connection_deadline_t::phase_t::body);
+        if (context.header_handler) {
+            context.header_handler(parsed_request);
+        }
+    });
 
-    // 一時バッファ
-    std::vector<char> temp_buffer(TEMP_BUFFER_SIZE, BUFFER_INITIAL_VALUE);
+    // 受信バッファのバイト数 (一度に読み切れなかったら、次からは1つ大きいサイズクラスにする)
+    auto buffer_size = buffer_pool_t::get_min_size();
 
     /* #####################################################################
      * クライアントからのリクエストを受信する
@@ -228,51 +660,154 @@ std::shared_ptr<http_request_t> http_server_t::read_request(int sd) {
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wmissing-noreturn"
     for (;;) {
-        // 受信する
-        // 今回はノンブロッキングで受信して、
-        // データを受信する毎にリクエストの最後まで読み込んだかチェックする
-        auto received_size = recv(
-            sd,
-            &*temp_buffer.begin(),
-            temp_buffer.size() - 1,
-            MSG_DONTWAIT
-        );
-        if (static_cast<int>(received_size) == -1) {
+        // 受信できるようになるまで待つ
+        // (待っている間はバッファを持たないので、待っているだけのコネクションはバッファのメモリを使わない)
+        pollfd fds{sd, POLLIN, 0};
+        if (poll(&fds, 1, -1) == -1) {
             // シグナル割り込みの場合はリトライ
-            if (errno == EINTR) {
-                if (!http_server_t::is_shutdown_required()) {
-                    continue;
-                }
-            }
-            // ブロックされた場合 (まだデータが受信できる状態ではない場合)もリトライ
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            // (シャットダウンの場合も、受信し始めたリクエストは最後まで処理する)
+            if (errno == EINTR && (!http_server_t::is_shutdown_required() || deadline.get_phase() != connection_deadline_t::phase_t::idle)) {
                 continue;
             }
-
-            // それ以外のエラーコードの場合はエラーにする
             http_server_t::print_error(errno);
             break;
         }
 
-        // バッファの内容を `string` にする (下のように書くと最初の '\0' までの文字列になる)
-        const std::string current_text(&*temp_buffer.begin());
+        // 読めるようになってからバッファを借りて、読めるだけ読む
+        auto buffer = buffer_pool_t::acquire(buffer_size);
+        for (;;) {
+            // 受信する
+            // 今回はノンブロッキングで受信して、
+            // データを受信する毎にリクエストの最後まで読み込んだかチェックする
+            auto received_size = recv(
+                sd,
+                buffer.get_data(),
+                buffer.get_size(),
+                MSG_DONTWAIT
+            );
+            if (static_cast<int>(received_size) == -1) {
+                // シグナル割り込みの場合はリトライ
+                if (errno == EINTR && !http_server_t::is_shutdown_required()) {
+                    continue;
+                }
+                // 読み切った場合は、バッファを返して次のデータを待つ
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    break;
+                }
 
-        // 一時バッファをクリアする
-        std::vector<char>(TEMP_BUFFER_SIZE, BUFFER_INITIAL_VALUE).swap(temp_buffer);
+                // それ以外のエラーコードの場合はエラーにする
+                http_server_t::print_error(errno);
+                return nullptr;
+            }
 
-        // 今回読み込んだ内容をリクエストに追加する
-        try {
-            request->add_bytes(current_text);
-        } catch (const std::exception &ex) {
-            std::cerr << ex.what() << std::endl;
-            break;
-        }
+            // 0 バイトの場合はクライアントが切断した (またはタイムアウトで shutdown した)
+            if (received_size == 0) {
+                if (deadline.is_expired()) {
+                    async_logger_t::get_default().log(async_logger_t::level_t::warning, "request timed out");
+                }
+                return nullptr;
+            }
+
+            // 最初のバイトを受信したら、ここからはヘッダのタイムアウト
+            if (deadline.get_phase() == connection_deadline_t::phase_t::idle) {
+                deadline.enter(connection_deadline_t::phase_t::header);
+                context.first_byte_at = server_metrics_t::clock_t::now();
+                metrics.record(server_metrics_t::stage_t::accept_to_first_byte, context.first_byte_at - started);
+                if (capture.is_enabled()) {
+                    recording = capture.start(context.first_byte_at);
+                }
+            }
+            metrics.add_received_bytes(static_cast<size_t>(received_size));
+            HTTP_SERVER_PROBE2(request__chunk, sd, received_size);
+
+            // 今回読み込んだ内容をリクエストに追加する
+            // (chunked のボディなどは '\0' を含むことがあるので、受信したバイト数で渡す)
+            recording.append(buffer.get_data(), static_cast<size_t>(received_size));
+            try {
+                request->add_bytes(buffer.get_data(), received_size);
+            } catch (const std::exception &ex) {
+                async_logger_t::get_default().log(async_logger_t::level_t::warning, ex.what());
+                metrics.add_error();
+                return nullptr;
+            }
 
-        // リクエストヘッダ全体を受信したか判定する
-        if (request->is_ready()) {
-            return request;
+            // リクエストヘッダ全体を受信したか判定する
+            if (request->is_ready()) {
+                recording.commit();
+                return request;
+            }
+
+            // バッファが一杯になった場合は、大きいヘッダやボディが続いているので大きいバッファに替える
+            // (読み込んだ内容はリクエストにコピー済みなので、中身を移す必要はない)
+            if (static_cast<size_t>(received_size) == buffer.get_size() && buffer_size < buffer_pool_t::CLASS_SIZES.back()) {
+                buffer_size = buffer_pool_t::get_next_size(buffer_size);
+                buffer = buffer_pool_t::acquire(buffer_size);
+            }
         }
     }
     return nullptr;
 #pragma clang diagnostic pop
 }
+
+bool http_server_t::send_all(int sd, const std::string &data) {
+    server_metrics_t::stage_timer_t timer(server_metrics_t::get_default(), server_metrics_t::stage_t::write);
+
+    // 受信しないクライアントに送り続けてスレッドを占有されないようにする
+    connection_deadline_t deadline(sd);
+    deadline.enter(connection_deadline_t::phase_t::write);
+
+    auto remaining_size = data.size();
+
+    while (remaining_size > 0) {
+#if defined(MSG_NOSIGNAL)
+        // タイムアウトで shutdown したソケットに書き込んでも SIGPIPE で落ちないようにする
+        const int flags = MSG_DONTWAIT | MSG_NOSIGNAL; // NOLINT(hicpp-signed-bitwise)
+#else
+        const int flags = MSG_DONTWAIT;
+#endif
+        auto current_size = ::send(sd, data.data() + (data.size() - remaining_size), remaining_size, flags);
+        if (static_cast<int>(current_size) == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // 書き込めるようになるまで待つ (空回りしない)
+                // 期限が切れるとタイマーがソケットを shutdown するので、poll はそこで戻る
+                pollfd fds{sd, POLLOUT, 0};
+                if (poll(&fds, 1, -1) == -1 && errno != EINTR) {
+                    http_server_t::print_error(errno);
+                    return false;
+                }
+                if (deadline.is_expired()) {
+                    async_logger_t::get_default().log(async_logger_t::level_t::warning, "response write timed out");
+                    return false;
+                }
+                continue;
+            }
+
+            if (errno == EINTR) {
+                if (http_server_t::is_shutdown_required()) {
+                    return false;
+                }
+                continue;
+            }
+            http_server_t::print_error(errno);
+            return false;
+        }
+        remaining_size -= current_size;
+        server_metrics_t::get_default().add_sent_bytes(static_cast<size_t>(current_size));
+        HTTP_SERVER_PROBE3(response__sent, sd, current_size, remaining_size);
+    }
+    return true;
+}
+
+void http_server_t::send_once_and_close(int sd, const std::string &data) {
+#if defined(MSG_NOSIGNAL)
+    const int flags = MSG_DONTWAIT | MSG_NOSIGNAL; // NOLINT(hicpp-signed-bitwise)
+#else
+    const int flags = MSG_DONTWAIT;
+#endif
+    // 小さいので大抵は1回で送れる. 送れなくても待たない
+    const auto sent = ::send(sd, data.data(), data.size(), flags);
+    HTTP_SERVER_PROBE3(response__sent, sd, sent, 0);
+    shutdown(sd, SHUT_RDWR);
+    HTTP_SERVER_PROBE1(connection__close, sd);
+    close(sd);
+}
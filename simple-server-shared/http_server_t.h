@@ -6,9 +6,31 @@
 #define HTTP_SERVER_HTTP_SERVER_T_H
 
 class http_request_t;
+class admission_controller_t;
+class rate_limiter_t;
+class worker_stats_t;
+
+#include "listener_handoff_t.h"
+#include "unix_listener_t.h"
 
 /**
  * HTTPサーバークラス
+ *
+ * ワーカー数 (`set_worker_count`、環境変数 `SIMPLE_SERVER_WORKERS`) を指定すると prefork で動く。
+ * マスターが待ち受けのソケットを開いてからワーカーを fork し、各ワーカーが同じソケットで accept する
+ * (`set_reuse_port`、環境変数 `SIMPLE_SERVER_REUSE_PORT=1` の場合は、ワーカー毎に SO_REUSEPORT で開く)。
+ * ワーカーが死んだらマスターが起動し直すので (`worker_supervisor_t`)、1つのクラッシュでサーバ全体は止まらない。
+ *
+ * SIGUSR2 を送ると、同じ実行ファイルを起動し直して待ち受けのソケットを引き継ぐ (`listener_handoff_t`)。
+ * 古いプロセスは新しいプロセスが受け付けを始めるまで受け付け続け、その後は処理中の接続を待って
+ * (`set_drain_timeout` まで) 終了するので、入れ替えの間も接続は断られない。
+ *
+ * `set_unix_socket` (環境変数 `SIMPLE_SERVER_UNIX_SOCKET`) を指定すると、TCP と一緒に Unix ドメインソケットでも待ち受ける
+ * (同じホストのサイドカーのプロキシから受ける用。`set_listen_tcp(false)` で Unix ドメインソケットだけにもできる)。
+ * どちらで受け付けた接続も、同じハンドラで処理する。
+ *
+ * TCP の待ち受けのソケットには、環境変数で設定したオプション (SO_REUSEADDR, TCP_DEFER_ACCEPT など) を付けて、
+ * accept4 で受け付ける (`socket_options_t`)。
  */
 class http_server_t {
 public:
@@ -45,10 +67,101 @@ public:
      *
      * ※ この中でソケットの `shutdown` と `close` も行ってください。
      *
+     * ※ アドミッション制御を設定した場合は、クローズしたときに `admission_controller_t::release_connection` も呼んでください。
+     *
+     * ※ 既定では accept4 で受け付けるので、渡すソケットはノンブロッキングで FD_CLOEXEC が付いています
+     * (`SIMPLE_SERVER_ACCEPT4=0` の場合はブロッキング)。
+     *
      * @param [in] client_handler ソケット処理ハンドラ
      */
     void set_client_handler(std::function<void(int, const char*)> client_handler);
 
+    /**
+     * 接続待ちキューの最大数をセットする (`start` の前に呼ぶこと)
+     * @param [in] backlog 接続待ちキューの最大数
+     */
+    inline void set_backlog(int backlog) {
+        this->backlog = backlog;
+    }
+
+    /**
+     * prefork のワーカー数をセットする (`start` の前に呼ぶこと)
+     *
+     * 0 の場合は prefork せずに、このプロセスで accept する。
+     * 呼ばなかった場合は環境変数 `SIMPLE_SERVER_WORKERS` (数か `auto` = CPU 数) に従う。
+     *
+     * @param [in] worker_count ワーカー数
+     */
+    inline void set_worker_count(size_t worker_count) {
+        this->worker_count = worker_count;
+    }
+
+    /**
+     * prefork のワーカー毎に、SO_REUSEPORT で待ち受けのソケットを開くか (`start` の前に呼ぶこと)
+     *
+     * 開かない場合 (既定) は、全ワーカーでマスターが開いた1つのソケットを共有する。
+     * 開く場合は、カーネルが接続をワーカーに振り分ける (accept で取り合わないが、詰まったワーカーの分は待たされる)。
+     *
+     * @param [in] reuse_port ワーカー毎に開く場合 `true`
+     */
+    inline void set_reuse_port(bool reuse_port) {
+        this->reuse_port = reuse_port;
+    }
+
+    /**
+     * Unix ドメインソケットでも待ち受ける (`start` の前に呼ぶこと)
+     *
+     * 呼ばなかった場合は環境変数 `SIMPLE_SERVER_UNIX_SOCKET` (`@` で始まる場合は抽象名前空間) と
+     * `SIMPLE_SERVER_UNIX_SOCKET_MODE` (8進数のパーミッション) に従う。
+     * この接続のハンドラには、クライアントのアドレスとして "unix" を渡す (レート制限は掛けない)。
+     *
+     * @param [in] config パスとパーミッション
+     */
+    inline void set_unix_socket(const unix_listener_t::config_t &config) {
+        this->unix_socket = config;
+    }
+
+    /**
+     * TCP で待ち受けるか (`start` の前に呼ぶこと. 既定は待ち受ける)
+     *
+     * 呼ばなかった場合は環境変数 `SIMPLE_SERVER_LISTEN_TCP=0` で待ち受けない。
+     *
+     * @param [in] listen_tcp 待ち受ける場合 `true`
+     */
+    inline void set_listen_tcp(bool listen_tcp) {
+        this->listen_tcp = listen_tcp;
+    }
+
+    /**
+     * 終了するときに、処理中の接続が終わるのを待つ最大の時間をセットする (既定 30秒)
+     * @param [in] drain_timeout 待つ時間
+     */
+    inline void set_drain_timeout(std::chrono::milliseconds drain_timeout) {
+        this->drain_timeout = drain_timeout;
+    }
+
+    /**
+     * アドミッション制御をセットする
+     *
+     * 同時接続数が上限に達している場合は、ハンドラを呼ばずに `503` を返してクローズする。
+     *
+     * @param [in] admission_controller アドミッション制御 (nullptr の場合は制限しない)
+     */
+    inline void set_admission_controller(std::shared_ptr<admission_controller_t> admission_controller) {
+        this->admission_controller = std::move(admission_controller);
+    }
+
+    /**
+     * クライアントのIPアドレス毎のレート制限をセットする
+     *
+     * 制限を超えたクライアントには、リクエストを読み込む前に `429` を返してクローズする (ハンドラは呼ばない)。
+     *
+     * @param [in] rate_limiter レート制限 (nullptr の場合は制限しない)
+     */
+    inline void set_rate_limiter(std::shared_ptr<rate_limiter_t> rate_limiter) {
+        this->rate_limiter = std::move(rate_limiter);
+    }
+
     /**
      * ソケットからリクエストを読み込む
      * @param [in] sd ソケットディスクリプタ
@@ -56,24 +169,219 @@ public:
      */
     static std::shared_ptr<http_request_t> read_request(int sd);
 
+    /**
+     * ソケットからリクエストを読み込む
+     *
+     * `header_handler` はヘッダの受信が完了した時点で呼ばれる。
+     * この中で `http_request_t::set_body_handler` を呼ぶと、ボディを溜め込まずに受信した順に受け取れる。
+     * ボディのハンドラは受信と同じスレッドで呼ばれるので、ハンドラの処理が終わるまで次の受信は行わない。
+     *
+     * `resource` にコネクション毎のアリーナ (`connection_arena_t`) を渡すと、
+     * リクエスト本体とヘッダなどをアリーナから確保する。
+     * その場合、返したリクエストはアリーナをリセットする前に破棄すること。
+     *
+     * @param [in] sd ソケットディスクリプタ
+     * @param [in] header_handler ヘッダの受信が完了したときに呼ばれるハンドラ
+     * @param [in] resource リクエストを確保するメモリリソース
+     * @return リクエスト
+     */
+    static std::shared_ptr<http_request_t> read_request(
+        int sd,
+        const std::function<void(http_request_t&)> &header_handler,
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource()
+    );
+
+    /**
+     * ソケットにデータを全て書き込む
+     * @param [in] sd ソケットディスクリプタ
+     * @param [in] data 書き込むデータ
+     * @return 全て書き込めた場合 `true`
+     */
+    static bool send_all(int sd, const std::string &data);
+
+    /**
+     * 組み立て済みの小さなレスポンスを送ってソケットを閉じる (リクエストを断るとき用)
+     *
+     * 送信は1回だけ試みて、待たない (過負荷や攻撃のときに、断る処理で詰まらないように)。
+     *
+     * @param [in] sd ソケットディスクリプタ
+     * @param [in] data 書き込むデータ
+     */
+    static void send_once_and_close(int sd, const std::string &data);
+
+    /**
+     * アクセスログを1件記録して、リクエスト数のメトリクスを増やす
+     * (`async_logger_t::get_default` に書くので、呼んだスレッドは待たない)
+     * @param [in] client_addr クライアントのアドレス
+     * @param [in] request リクエスト
+     * @param [in] response_text 送信したレスポンス (ステータス行からステータスコードを取り出す)
+     * @param [in] started 処理を始めた時刻
+     */
+    static void log_access(
+        const char* client_addr,
+        const http_request_t &request,
+        const std::string &response_text,
+        std::chrono::steady_clock::time_point started
+    );
+
+    /**
+     * アクセスログを1件記録して、リクエスト数のメトリクスを増やす
+     * (組み立て済みのレスポンスがない場合用. `http_response_writer_t` で送った場合など)
+     * @param [in] client_addr クライアントのアドレス
+     * @param [in] request リクエスト
+     * @param [in] status ステータスコード
+     * @param [in] response_size 送信したレスポンスのバイト数
+     * @param [in] started 処理を始めた時刻
+     */
+    static void log_access(
+        const char* client_addr,
+        const http_request_t &request,
+        int status,
+        size_t response_size,
+        std::chrono::steady_clock::time_point started
+    );
+
 private:
     /**
      * クライアントソケット処理ハンドラ
      */
     std::function<void(int, const char*)> client_handler;
 
+    /**
+     * 接続待ちキューの最大数
+     */
+    int backlog = 128;
+
+    /**
+     * アドミッション制御
+     */
+    std::shared_ptr<admission_controller_t> admission_controller;
+
+    /**
+     * レート制限
+     */
+    std::shared_ptr<rate_limiter_t> rate_limiter;
+
+    /**
+     * prefork のワーカー数 (未設定の場合は環境変数に従う)
+     */
+    std::optional<size_t> worker_count;
+
+    /**
+     * prefork のワーカー毎に SO_REUSEPORT で開くか (未設定の場合は環境変数に従う)
+     */
+    std::optional<bool> reuse_port;
+
+    /**
+     * Unix ドメインソケットの設定 (未設定の場合は環境変数に従う)
+     */
+    std::optional<unix_listener_t::config_t> unix_socket;
+
+    /**
+     * TCP で待ち受けるか (未設定の場合は環境変数に従う)
+     */
+    std::optional<bool> listen_tcp;
+
+    /**
+     * 複数のソケットで待ち受けている場合に、次に見始めるソケット
+     */
+    size_t next_listener = 0;
+
+    /**
+     * 終了するときに、処理中の接続を待つ最大の時間
+     */
+    std::chrono::milliseconds drain_timeout = std::chrono::seconds(30);
+
+    /**
+     * 待ち受けのソケットを開く
+     * @param [in] ip_address リッスンするIPアドレス。 nullptr が指定された場合は全て
+     * @param [in] port リッスンするポート
+     * @param [in] reuse_port SO_REUSEPORT を付けるか
+     * @return ソケットディスクリプタ (開けなかった場合は -1)
+     */
+    int open_listener(const char* ip_address, ushort port, bool reuse_port) const;
+
+    /**
+     * 設定に従って、待ち受けのソケットを開く (引き継いだソケットがあればそれを使う)
+     * @param [in] ip_address リッスンするIPアドレス
+     * @param [in] port リッスンするポート
+     * @param [in,out] inherited 引き継いだソケット (使わなかったものは閉じる)
+     * @param [in] open_tcp 引き継いでいない場合に TCP のソケットを開くか (ワーカー毎に開く場合は `false`)
+     * @return ソケットディスクリプタ (開けなかった場合は空)
+     */
+    std::vector<int> open_listeners(
+        const char* ip_address,
+        ushort port,
+        listener_handoff_t::inherited_t &inherited,
+        bool open_tcp
+    ) const;
+
+    /**
+     * 接続を1つ受け付ける
+     * @param [in] listeners 待ち受けのソケットディスクリプタ
+     * @param [out] client_addr クライアントのアドレス
+     * @return ソケットディスクリプタ (受け付けられなかった場合は -1 で、errno を設定する)
+     */
+    int accept_client(const std::vector<int> &listeners, sockaddr_storage &client_addr);
+
+    /**
+     * シャットダウンが要求されるまで、接続を受け付けて処理する
+     * @param [in] listeners 待ち受けのソケットディスクリプタ (抜けるときに閉じる)
+     * @param [in] upgradable SIGUSR2 で起動し直すか (prefork のワーカーは `false`)
+     */
+    void accept_loop(const std::vector<int> &listeners, bool upgradable);
+
+    /**
+     * 処理中の接続が終わるまで (`drain_timeout` まで) 待つ
+     */
+    void drain() const;
+
+    /**
+     * prefork のマスターとして、ワーカーを起動して見張る
+     */
+    void start_prefork(
+        const char* ip_address,
+        ushort port,
+        size_t workers,
+        bool per_worker_socket,
+        listener_handoff_t &handoff,
+        listener_handoff_t::inherited_t &inherited
+    );
+
+    /**
+     * prefork のワーカー (子プロセスで呼ばれる)
+     * @param [in] index ワーカーの番号
+     * @param [in,out] stats ワーカーのカウンタを書く共有メモリ
+     * @param [in] listeners マスターが開いたソケット
+     * @param [in] per_worker_socket TCP のソケットをワーカー毎に SO_REUSEPORT で開くか
+     * @return 終了コード
+     */
+    int run_worker(
+        size_t index,
+        worker_stats_t &stats,
+        std::vector<int> listeners,
+        bool per_worker_socket,
+        const char* ip_address,
+        ushort port
+    );
+
     /**
      * 接続されたクライアントを処理する
      * @param [in] sd ソケットディスクリプタ
      * @param [in] client_addr クライアントのアドレス
      */
-    void handle_client(int sd, const sockaddr_in* client_addr);
+    void handle_client(int sd, const sockaddr_storage* client_addr);
 
     /**
      * シャットダウン要求フラグ
      */
     static volatile bool shutdown_required;
 
+    /**
+     * 入れ替え要求フラグ (SIGUSR2)
+     */
+    static volatile bool upgrade_required;
+
     /**
      * シグナルハンドラ登録フラグ
      */
@@ -85,7 +393,7 @@ private:
     static void register_signal_handlers();
 
     /**
-     * シグナルハンドラ (SIGINT的ななシグナルをトラップして、サーバーを停止するため)
+     * シグナルハンドラ (SIGINT的ななシグナルをトラップして、サーバーを停止するため. SIGUSR2 は入れ替え)
      * @param [in] signum シグナル番号
      */
     static void signal_handler(int signum);
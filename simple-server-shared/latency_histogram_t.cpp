@@ -0,0 +1,76 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <cmath>
+#include "latency_histogram_t.h"
+
+latency_histogram_t::latency_histogram_t()
+    : shards(std::make_unique<shard_t[]>(sharded_counter_t::SHARD_COUNT)) {
+    for (size_t i = 0; i < sharded_counter_t::SHARD_COUNT; i++) {
+        for (auto &count : this->shards[i].counts) {
+            count.store(0, std::memory_order_relaxed);
+        }
+        this->shards[i].sum_ns.store(0, std::memory_order_relaxed);
+    }
+}
+
+latency_histogram_t::snapshot_t latency_histogram_t::get_snapshot() const {
+    snapshot_t snapshot;
+    for (size_t i = 0; i < sharded_counter_t::SHARD_COUNT; i++) {
+        const auto &shard = this->shards[i];
+        for (size_t bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+            const auto count = shard.counts[bucket].load(std::memory_order_relaxed);
+            snapshot.counts[bucket] += count;
+            snapshot.count += count;
+        }
+        snapshot.sum_ns += shard.sum_ns.load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+uint64_t latency_histogram_t::get_bucket_upper_bound(size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    if (index >= BUCKET_COUNT - 1) {
+        return std::numeric_limits<uint64_t>::max();
+    }
+    // 区間 (一番上のビット) と区間の中の位置から、次のバケットの下限を求めて 1 引く
+    const auto top_bit = index / SUB_BUCKET_COUNT + SUB_BUCKET_BITS - 1;
+    const auto sub_bucket = index % SUB_BUCKET_COUNT;
+    const auto shift = top_bit - SUB_BUCKET_BITS;
+    const auto lower = ((SUB_BUCKET_COUNT | sub_bucket) << shift);
+    return lower + (1ULL << shift) - 1;
+}
+
+uint64_t latency_histogram_t::snapshot_t::get_value_at_percentile(double percentile) const {
+    if (this->count == 0) {
+        return 0;
+    }
+    const auto clamped = std::clamp(percentile, 0.0, 100.0);
+    const auto target = std::max<uint64_t>(
+        static_cast<uint64_t>(std::ceil(static_cast<double>(this->count) * clamped / 100.0)),
+        1
+    );
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+        seen += this->counts[bucket];
+        if (seen >= target) {
+            return get_bucket_upper_bound(bucket);
+        }
+    }
+    return get_bucket_upper_bound(BUCKET_COUNT - 1);
+}
+
+uint64_t latency_histogram_t::snapshot_t::get_count_at_or_below(uint64_t value_ns) const {
+    uint64_t total = 0;
+    for (size_t bucket = 0; bucket < BUCKET_COUNT; bucket++) {
+        if (get_bucket_upper_bound(bucket) > value_ns) {
+            break;
+        }
+        total += this->counts[bucket];
+    }
+    return total;
+}
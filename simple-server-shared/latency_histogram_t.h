@@ -0,0 +1,116 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_LATENCY_HISTOGRAM_T_H
+#define HTTP_SERVER_LATENCY_HISTOGRAM_T_H
+
+#include "sharded_counter_t.h"
+
+/**
+ * 処理時間のヒストグラム (HdrHistogram と同じ対数・線形のバケット)
+ *
+ * 2 のべき乗の区間それぞれを 16 等分したバケットに数える。
+ * なので、どの大きさの値でも誤差は 1/16 (約 6%) 以内に収まり、バケット数は 528 で済む。
+ * 記録できるのは 2^36 ns (約 68 秒) まで。それより長い値は一番上のバケットに入れる。
+ *
+ * * `record` はバケットの番号を計算して atomic 変数を2つ増やすだけ (ロックしない)
+ * * カウンタはスレッド毎のシャード (`sharded_counter_t` と同じ割り当て) に分けて持つので、
+ *   別スレッドの記録と同じキャッシュラインを取り合わない
+ * * 読むときは `get_snapshot` で全シャードを合算する
+ */
+class latency_histogram_t {
+public:
+    /**
+     * 2 のべき乗の区間をいくつに分けるか (2^SUB_BUCKET_BITS)
+     */
+    static const size_t SUB_BUCKET_BITS = 4;
+
+    static const size_t SUB_BUCKET_COUNT = 1U << SUB_BUCKET_BITS;
+
+    /**
+     * 記録できる値のビット数 (ns)
+     */
+    static const size_t MAX_VALUE_BITS = 36;
+
+    static const size_t BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    /**
+     * 合算したヒストグラム
+     */
+    struct snapshot_t {
+        std::array<uint64_t, BUCKET_COUNT> counts{};
+
+        uint64_t count = 0;
+
+        uint64_t sum_ns = 0;
+
+        /**
+         * パーセンタイルの値を取得する
+         * @param [in] percentile パーセンタイル (0〜100)
+         * @return その値が入っているバケットの上限 (ns)。1件もない場合は 0
+         */
+        [[nodiscard]] uint64_t get_value_at_percentile(double percentile) const;
+
+        /**
+         * 値が `value_ns` 以下の件数を取得する (バケットの上限が `value_ns` 以下のものを数える)
+         */
+        [[nodiscard]] uint64_t get_count_at_or_below(uint64_t value_ns) const;
+    };
+
+    latency_histogram_t();
+
+    latency_histogram_t(const latency_histogram_t &) = delete;
+
+    latency_histogram_t &operator=(const latency_histogram_t &) = delete;
+
+    /**
+     * 1件記録する
+     * @param [in] duration 処理時間
+     */
+    inline void record(std::chrono::nanoseconds duration) {
+        const auto value = static_cast<uint64_t>(std::max<int64_t>(duration.count(), 0));
+        auto &shard = this->shards[sharded_counter_t::get_shard_index()];
+        shard.counts[get_bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+        shard.sum_ns.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    /**
+     * 全シャードを合算する
+     */
+    [[nodiscard]] snapshot_t get_snapshot() const;
+
+    /**
+     * 値が入るバケットの番号を取得する
+     */
+    static inline size_t get_bucket_index(uint64_t value_ns) {
+        if (value_ns < SUB_BUCKET_COUNT) {
+            return static_cast<size_t>(value_ns);
+        }
+        const auto top_bit = static_cast<size_t>(std::bit_width(value_ns)) - 1;
+        if (top_bit >= MAX_VALUE_BITS) {
+            return BUCKET_COUNT - 1;
+        }
+        // 一番上のビットで区間を、その下の SUB_BUCKET_BITS ビットで区間の中の位置を決める
+        const auto shift = top_bit - SUB_BUCKET_BITS;
+        return (top_bit - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT
+               + static_cast<size_t>((value_ns >> shift) & (SUB_BUCKET_COUNT - 1));
+    }
+
+    /**
+     * バケットに入る値の上限を取得する (ns)
+     */
+    static uint64_t get_bucket_upper_bound(size_t index);
+
+private:
+    struct alignas(64) shard_t {
+        std::array<std::atomic<uint64_t>, BUCKET_COUNT> counts;
+
+        std::atomic<uint64_t> sum_ns;
+    };
+
+    std::unique_ptr<shard_t[]> shards;
+};
+
+
+#endif //HTTP_SERVER_LATENCY_HISTOGRAM_T_H
@@ -0,0 +1,469 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <fcntl.h>
+#include <fstream>
+#include <poll.h>
+#include <climits>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "listener_handoff_t.h"
+#include "async_logger_t.h"
+#include "unix_listener_t.h"
+
+namespace {
+    /**
+     * systemd のソケット起動で、最初に渡される fd
+     */
+    const int LISTEN_FDS_START = 3;
+
+    /**
+     * 渡す側のスレッドが止める要求を見る間隔
+     */
+    const int POLL_INTERVAL_MS = 200;
+
+    /**
+     * 受け取る側が、渡されるのを待つ最大の時間
+     */
+    const int RECEIVE_TIMEOUT_SECONDS = 5;
+
+    /**
+     * 起動し直すときに、引き継がない環境変数
+     */
+    const std::array<std::string_view, 4> HANDOFF_VARIABLES = {
+        "LISTEN_FDS=",
+        "LISTEN_PID=",
+        "LISTEN_FDNAMES=",
+        "SIMPLE_SERVER_UPGRADE_FROM=",
+    };
+
+    void log(async_logger_t::level_t level, const std::string &message) {
+        async_logger_t::get_default().log(level, "handoff: " + message);
+    }
+
+    bool is_listening(int sd) {
+        int listening = 0;
+        socklen_t size = sizeof(listening);
+        return getsockopt(sd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &size) == 0 && listening != 0;
+    }
+
+    bool make_address(const std::string &path, sockaddr_un &addr) {
+        addr = {};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) {
+            log(async_logger_t::level_t::error, "path too long: " + path);
+            return false;
+        }
+        std::memcpy(addr.sun_path, path.data(), path.size());
+        return true;
+    }
+
+    /**
+     * 10進数の文字列にする (fork した後でも呼べるように、確保しない)
+     * @return 書いた後ろの位置
+     */
+    char* format_decimal(char* out, long value) {
+        std::array<char, 24> digits{};
+        size_t count = 0;
+        do {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value > 0);
+        while (count > 0) {
+            *out++ = digits[--count];
+        }
+        *out = '\0';
+        return out;
+    }
+
+    /**
+     * systemd 形式 (`LISTEN_FDS` / `LISTEN_PID`) で渡されたソケットを受け取る
+     */
+    std::vector<int> take_socket_activation() {
+        std::vector<int> sds;
+        const auto fds = std::getenv("LISTEN_FDS");
+        const auto pid = std::getenv("LISTEN_PID");
+        if (!fds || !pid || std::strtol(pid, nullptr, 10) != getpid()) {
+            return sds;
+        }
+        const auto count = std::strtol(fds, nullptr, 10);
+        // 子プロセス (CGI など) には引き継がない
+        unsetenv("LISTEN_FDS");
+        unsetenv("LISTEN_PID");
+        unsetenv("LISTEN_FDNAMES");
+
+        for (auto sd = LISTEN_FDS_START; sd < LISTEN_FDS_START + count; sd++) {
+            if (!is_listening(sd)) {
+                log(async_logger_t::level_t::warning, "fd " + std::to_string(sd) + " is not a listening socket");
+                continue;
+            }
+            fcntl(sd, F_SETFD, FD_CLOEXEC);
+            sds.push_back(sd);
+        }
+        return sds;
+    }
+
+    /**
+     * パスで待っているプロセスから `SCM_RIGHTS` でソケットを受け取る
+     */
+    std::vector<int> receive_sockets(const std::string &path, pid_t &peer) {
+        std::vector<int> sds;
+        sockaddr_un addr{};
+        if (!make_address(path, addr)) {
+            return sds;
+        }
+        const auto client = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0); // NOLINT(hicpp-signed-bitwise)
+        if (client == -1) {
+            return sds;
+        }
+        // 動いているサーバがいない (パスがない、古いパスが残っている) 場合は、普通に開く
+        if (connect(client, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == -1) {
+            close(client);
+            return sds;
+        }
+
+        timeval timeout{RECEIVE_TIMEOUT_SECONDS, 0};
+        setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+        char byte = 0;
+        iovec iov{&byte, sizeof(byte)};
+        alignas(cmsghdr) std::array<char, CMSG_SPACE(sizeof(int) * listener_handoff_t::MAX_LISTENERS)> control{};
+        msghdr message{};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control.data();
+        message.msg_controllen = control.size();
+
+        ssize_t received;
+        while ((received = recvmsg(client, &message, MSG_CMSG_CLOEXEC)) == -1 && errno == EINTR) {
+        }
+        const auto cmsg = received > 0 ? CMSG_FIRSTHDR(&message) : nullptr;
+        if (cmsg && cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            const auto count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            sds.resize(count);
+            std::memcpy(sds.data(), CMSG_DATA(cmsg), count * sizeof(int));
+        }
+
+        ucred credentials{};
+        socklen_t size = sizeof(credentials);
+        if (getsockopt(client, SOL_SOCKET, SO_PEERCRED, &credentials, &size) == 0) {
+            peer = credentials.pid;
+        }
+        close(client);
+
+        const auto not_listening = std::remove_if(sds.begin(), sds.end(), [](int sd) {
+            if (is_listening(sd)) {
+                return false;
+            }
+            log(async_logger_t::level_t::warning, "received socket is not listening");
+            close(sd);
+            return true;
+        });
+        sds.erase(not_listening, sds.end());
+        return sds;
+    }
+
+    bool send_sockets(int client, const std::vector<int> &sds) {
+        char byte = 'L';
+        iovec iov{&byte, sizeof(byte)};
+        alignas(cmsghdr) std::array<char, CMSG_SPACE(sizeof(int) * listener_handoff_t::MAX_LISTENERS)> control{};
+        msghdr message{};
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control.data();
+        message.msg_controllen = CMSG_SPACE(sizeof(int) * sds.size());
+
+        const auto cmsg = CMSG_FIRSTHDR(&message);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int) * sds.size());
+        std::memcpy(CMSG_DATA(cmsg), sds.data(), sizeof(int) * sds.size());
+
+        ssize_t sent;
+        while ((sent = sendmsg(client, &message, MSG_NOSIGNAL)) == -1 && errno == EINTR) {
+        }
+        return sent == 1;
+    }
+
+    /**
+     * 自分の実行ファイルのパス (入れ替えで上書きされた場合も、同じパスの新しい方を起動する)
+     */
+    std::string get_executable_path() {
+        std::array<char, PATH_MAX> buffer{};
+        const auto size = readlink("/proc/self/exe", buffer.data(), buffer.size() - 1);
+        if (size <= 0) {
+            return {};
+        }
+        std::string path(buffer.data(), static_cast<size_t>(size));
+        const std::string_view deleted = " (deleted)";
+        if (path.size() > deleted.size() && path.compare(path.size() - deleted.size(), deleted.size(), deleted) == 0) {
+            path.resize(path.size() - deleted.size());
+        }
+        return path;
+    }
+
+    /**
+     * 自分の起動時の引数
+     */
+    std::vector<std::string> get_arguments() {
+        std::ifstream cmdline("/proc/self/cmdline", std::ios::binary);
+        std::vector<std::string> arguments;
+        std::string argument;
+        while (std::getline(cmdline, argument, '\0')) {
+            arguments.push_back(argument);
+        }
+        return arguments;
+    }
+}
+
+int listener_handoff_t::inherited_t::take(int family, std::string_view unix_path) {
+    for (auto it = this->sds.begin(); it != this->sds.end(); ++it) {
+        sockaddr_storage addr{};
+        socklen_t length = sizeof(addr);
+        if (getsockname(*it, reinterpret_cast<sockaddr*>(&addr), &length) == -1 || addr.ss_family != family) {
+            continue;
+        }
+        if (family == AF_UNIX && !unix_listener_t::is_bound_to(*it, unix_path)) {
+            continue;
+        }
+        const auto sd = *it;
+        this->sds.erase(it);
+        return sd;
+    }
+    return -1;
+}
+
+void listener_handoff_t::inherited_t::close_rest() {
+    for (const auto sd : this->sds) {
+        close(sd);
+    }
+    this->sds.clear();
+}
+
+listener_handoff_t::listener_handoff_t(std::string path)
+    : path(std::move(path)),
+      server_sd(-1),
+      path_inode(0),
+      stopping(false) {
+}
+
+listener_handoff_t::~listener_handoff_t() {
+    this->stop();
+}
+
+listener_handoff_t::inherited_t listener_handoff_t::take_listener() const {
+    inherited_t inherited;
+
+    inherited.sds = take_socket_activation();
+    if (!inherited.sds.empty()) {
+        // SIGUSR2 で起動し直した場合は、起動した側が前のプロセス
+        // (systemd から渡された場合は、止める相手はいない)
+        if (const auto from = std::getenv("SIMPLE_SERVER_UPGRADE_FROM")) {
+            inherited.predecessor = static_cast<pid_t>(std::strtol(from, nullptr, 10));
+        }
+        unsetenv("SIMPLE_SERVER_UPGRADE_FROM");
+        log(async_logger_t::level_t::info, "inherited listener from LISTEN_FDS");
+        return inherited;
+    }
+    unsetenv("SIMPLE_SERVER_UPGRADE_FROM");
+
+    if (!this->path.empty()) {
+        inherited.sds = receive_sockets(this->path, inherited.predecessor);
+        if (!inherited.sds.empty()) {
+            log(
+                async_logger_t::level_t::info,
+                "received " + std::to_string(inherited.sds.size()) + " listeners from pid " + std::to_string(inherited.predecessor)
+            );
+        } else {
+            inherited.predecessor = 0;
+        }
+    }
+    return inherited;
+}
+
+void listener_handoff_t::serve(const std::vector<int> &sds) {
+    if (this->path.empty() || sds.empty() || sds.size() > MAX_LISTENERS || this->thread.joinable()) {
+        return;
+    }
+
+    sockaddr_un addr{};
+    if (!make_address(this->path, addr)) {
+        return;
+    }
+    this->server_sd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0); // NOLINT(hicpp-signed-bitwise)
+    if (this->server_sd == -1) {
+        return;
+    }
+
+    // 前のプロセスのパスが残っている場合は、受け取り済み (または死んでいる) ので置き換える
+    unlink(this->path.c_str());
+    if (bind(this->server_sd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == -1
+        || listen(this->server_sd, 4) == -1) {
+        log(async_logger_t::level_t::error, "cannot listen on " + this->path + ": " + std::strerror(errno));
+        close(this->server_sd);
+        this->server_sd = -1;
+        return;
+    }
+    // 同じユーザーのプロセスだけが接続できるようにする
+    chmod(this->path.c_str(), S_IRUSR | S_IWUSR); // NOLINT(hicpp-signed-bitwise)
+    struct stat status{};
+    if (::stat(this->path.c_str(), &status) == 0) {
+        this->path_inode = status.st_ino;
+    }
+
+    for (const auto sd : sds) {
+        this->listener_sds.push_back(fcntl(sd, F_DUPFD_CLOEXEC, 0));
+    }
+    this->stopping.store(false, std::memory_order_relaxed);
+    this->thread = std::thread([this] {
+        this->run();
+    });
+}
+
+void listener_handoff_t::stop() {
+    if (!this->thread.joinable()) {
+        return;
+    }
+    this->stopping.store(true, std::memory_order_relaxed);
+    this->thread.join();
+
+    close(this->server_sd);
+    this->server_sd = -1;
+    for (const auto sd : this->listener_sds) {
+        close(sd);
+    }
+    this->listener_sds.clear();
+
+    struct stat status{};
+    if (::stat(this->path.c_str(), &status) == 0 && status.st_ino == this->path_inode) {
+        unlink(this->path.c_str());
+    }
+}
+
+void listener_handoff_t::run() {
+    while (!this->stopping.load(std::memory_order_relaxed)) {
+        pollfd fds{this->server_sd, POLLIN, 0};
+        if (poll(&fds, 1, POLL_INTERVAL_MS) <= 0) {
+            continue;
+        }
+        const auto client = accept4(this->server_sd, nullptr, nullptr, SOCK_CLOEXEC);
+        if (client == -1) {
+            continue;
+        }
+
+        ucred credentials{};
+        socklen_t size = sizeof(credentials);
+        if (getsockopt(client, SOL_SOCKET, SO_PEERCRED, &credentials, &size) == -1
+            || (credentials.uid != geteuid() && credentials.uid != 0)) {
+            log(async_logger_t::level_t::warning, "refused handoff to uid " + std::to_string(credentials.uid));
+            close(client);
+            continue;
+        }
+
+        if (send_sockets(client, this->listener_sds)) {
+            log(async_logger_t::level_t::info, "handed listener to pid " + std::to_string(credentials.pid));
+        }
+        close(client);
+    }
+}
+
+void listener_handoff_t::notify_predecessor(const inherited_t &inherited) {
+    if (inherited.predecessor <= 0 || inherited.predecessor == getpid()) {
+        return;
+    }
+    log(async_logger_t::level_t::info, "ready, stopping pid " + std::to_string(inherited.predecessor));
+    kill(inherited.predecessor, SIGTERM);
+}
+
+bool listener_handoff_t::spawn_successor(const std::vector<int> &sds) {
+    // fork した後はメモリを確保できないので、引数と環境変数は先に組み立てておく
+    const auto executable = get_executable_path();
+    const auto arguments = get_arguments();
+    if (executable.empty() || arguments.empty()) {
+        log(async_logger_t::level_t::error, "cannot determine own executable");
+        return false;
+    }
+    std::vector<char*> argv;
+    for (const auto &argument : arguments) {
+        argv.push_back(const_cast<char*>(argument.c_str()));
+    }
+    argv.push_back(nullptr);
+
+    std::vector<char*> envp;
+    for (auto variable = environ; *variable; ++variable) {
+        const std::string_view entry(*variable);
+        const auto is_handoff_variable = std::any_of(HANDOFF_VARIABLES.begin(), HANDOFF_VARIABLES.end(), [entry](std::string_view prefix) {
+            return entry.starts_with(prefix);
+        });
+        if (!is_handoff_variable) {
+            envp.push_back(*variable);
+        }
+    }
+    auto upgrade_from = "SIMPLE_SERVER_UPGRADE_FROM=" + std::to_string(getpid());
+    envp.push_back(upgrade_from.data());
+    auto listen_fds = "LISTEN_FDS=" + std::to_string(sds.size());
+    // 起動したプロセスのIDは fork するまで分からないので、書き込む場所だけ用意する
+    const std::string_view listen_pid_prefix = "LISTEN_PID=";
+    std::array<char, 40> listen_pid{};
+    std::memcpy(listen_pid.data(), listen_pid_prefix.data(), listen_pid_prefix.size());
+    if (!sds.empty()) {
+        envp.push_back(listen_fds.data());
+        envp.push_back(listen_pid.data());
+    }
+    envp.push_back(nullptr);
+    // 3 から並べ直すときに、まだ移していないソケットを上書きしないように、一度ずらした先
+    std::vector<int> moved(sds.size(), -1);
+
+    const auto child = fork();
+    if (child == -1) {
+        log(async_logger_t::level_t::error, std::string("fork failed: ") + std::strerror(errno));
+        return false;
+    }
+    if (child == 0) {
+        // 新しいプロセスがこのプロセスの子として残らないように、もう一度 fork してすぐ終了する
+        // (古いプロセスが終了を待たなくてよく、古いプロセスが先に終了してもゾンビにならない)
+        const auto grandchild = fork();
+        if (grandchild != 0) {
+            _exit(grandchild == -1 ? 1 : 0);
+        }
+
+        sigset_t mask;
+        sigemptyset(&mask);
+        sigprocmask(SIG_SETMASK, &mask, nullptr);
+
+        if (!sds.empty()) {
+            const auto first_free = LISTEN_FDS_START + static_cast<int>(sds.size());
+            for (size_t i = 0; i < sds.size(); i++) {
+                // (ずらした先は exec で閉じる. dup2 で並べ直した方は閉じない)
+                moved[i] = fcntl(sds[i], F_DUPFD_CLOEXEC, first_free);
+            }
+            for (size_t i = 0; i < sds.size(); i++) {
+                const auto target = LISTEN_FDS_START + static_cast<int>(i);
+                dup2(moved[i], target);
+                // exec しても閉じないようにする
+                fcntl(target, F_SETFD, 0);
+            }
+            format_decimal(listen_pid.data() + listen_pid_prefix.size(), getpid());
+        }
+        execve(executable.c_str(), argv.data(), envp.data());
+        _exit(127);
+    }
+
+    int status = 0;
+    while (waitpid(child, &status, 0) == -1 && errno == EINTR) {
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        log(async_logger_t::level_t::error, "cannot spawn successor");
+        return false;
+    }
+    log(async_logger_t::level_t::info, "spawned successor " + executable);
+    return true;
+}
+
+std::string listener_handoff_t::get_path_from_environment() {
+    const auto path = std::getenv("SIMPLE_SERVER_HANDOFF_PATH");
+    return path ? path : "";
+}
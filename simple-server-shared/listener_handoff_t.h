@@ -0,0 +1,138 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_LISTENER_HANDOFF_T_H
+#define HTTP_SERVER_LISTENER_HANDOFF_T_H
+
+/**
+ * 待ち受けのソケットを次のプロセスに引き継いで、接続を断らずにサーバを入れ替える
+ *
+ * 受け取り方 (`take_listener`)
+ *
+ * * systemd のソケット起動と同じ `LISTEN_FDS` / `LISTEN_PID` (fd 3 から)。SIGUSR2 で入れ替える場合もこれで渡す
+ * * 環境変数 `SIMPLE_SERVER_HANDOFF_PATH` の Unix ソケットでサーバが動いていれば、そこから `SCM_RIGHTS` で受け取る
+ *   (別に起動した新しいバージョンに入れ替える場合)
+ *
+ * 渡し方
+ *
+ * * `spawn_successor` 自分と同じ実行ファイルを起動し直して、fd 3 から順に渡す
+ * * `serve` `SIMPLE_SERVER_HANDOFF_PATH` で待って、接続してきたプロセス (同じユーザーだけ) に渡す
+ *
+ * 古いプロセスは、新しいプロセスが `notify_predecessor` で SIGTERM を送ってくるまで accept し続ける。
+ * 両方が同じソケット (同じ接続待ちキュー) を持っているので、入れ替えの間も接続は断られない。
+ * 新しいプロセスが起動に失敗した場合は、古いプロセスがそのまま動き続ける。
+ *
+ * TCP と Unix ドメインソケットの両方で待ち受けている場合は、まとめて渡す。
+ */
+class listener_handoff_t {
+public:
+    /**
+     * 一度に渡せるソケットの数
+     */
+    static const size_t MAX_LISTENERS = 8;
+
+    /**
+     * 引き継いだソケット
+     */
+    struct inherited_t {
+        /**
+         * 待ち受けのソケットディスクリプタ (引き継がなかった場合は空)
+         */
+        std::vector<int> sds;
+
+        /**
+         * 前のプロセスのID (止めるように知らせる相手. いない場合は 0)
+         */
+        pid_t predecessor = 0;
+
+        /**
+         * 引き継いだソケットから、アドレスファミリが同じものを取り出す
+         * @param [in] family `AF_INET` か `AF_UNIX`
+         * @param [in] unix_path `AF_UNIX` の場合は、待ち受けているパス
+         * @return ソケットディスクリプタ (ない場合は -1)
+         */
+        int take(int family, std::string_view unix_path = {});
+
+        /**
+         * 取り出さなかった (設定が変わって使わない) ソケットを閉じる
+         */
+        void close_rest();
+    };
+
+    /**
+     * @param [in] path 渡すときに待つ Unix ソケットのパス (空の場合はパスでは受け渡ししない)
+     */
+    explicit listener_handoff_t(std::string path);
+
+    ~listener_handoff_t();
+
+    listener_handoff_t(const listener_handoff_t &) = delete;
+
+    listener_handoff_t &operator=(const listener_handoff_t &) = delete;
+
+    /**
+     * 前のプロセスから待ち受けのソケットを受け取る
+     * @return 引き継いだソケット
+     */
+    [[nodiscard]] inherited_t take_listener() const;
+
+    /**
+     * パスで待って、接続してきたプロセスにソケットを渡す (バックグラウンドのスレッドで待つ)
+     * @param [in] sds 待ち受けのソケットディスクリプタ (複製して持つので、呼んだ側は閉じてよい)
+     */
+    void serve(const std::vector<int> &sds);
+
+    /**
+     * 渡すのをやめる (スレッドを止めて、まだ自分のものならパスを消す)
+     */
+    void stop();
+
+    /**
+     * 前のプロセスに、accept をやめて終了するように知らせる (accept を始める直前に呼ぶ)
+     * @param [in] inherited 引き継いだソケット
+     */
+    static void notify_predecessor(const inherited_t &inherited);
+
+    /**
+     * 同じ実行ファイルを同じ引数で起動し直して、待ち受けのソケットを fd 3 から順に渡す
+     *
+     * 起動したプロセスはこのプロセスの子として残らない (終了を待たなくてよい)。
+     *
+     * @param [in] sds 待ち受けのソケットディスクリプタ (空の場合は渡さずに起動する. SO_REUSEPORT で開き直す場合)
+     * @return 起動できた場合 `true`
+     */
+    static bool spawn_successor(const std::vector<int> &sds);
+
+    /**
+     * 環境変数 `SIMPLE_SERVER_HANDOFF_PATH` を取得する
+     */
+    static std::string get_path_from_environment();
+
+private:
+    std::string path;
+
+    /**
+     * パスで待つソケット
+     */
+    int server_sd;
+
+    /**
+     * 渡す待ち受けのソケット (複製)
+     */
+    std::vector<int> listener_sds;
+
+    /**
+     * バインドしたパスの i-node (後から来たプロセスがバインドし直した場合は消さない)
+     */
+    ino_t path_inode;
+
+    std::atomic<bool> stopping;
+
+    std::thread thread;
+
+    void run();
+};
+
+
+#endif //HTTP_SERVER_LISTENER_HANDOFF_T_H
@@ -0,0 +1,181 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_MIDDLEWARE_PIPELINE_T_H
+#define HTTP_SERVER_MIDDLEWARE_PIPELINE_T_H
+
+class http_request_t;
+class http_response_t;
+
+/**
+ * ミドルウェアの `next` の例 (何もしない). コンセプトの判定にだけ使う
+ */
+struct middleware_next_archetype_t {
+    void operator()() const {}
+};
+
+/**
+ * ミドルウェア (パイプラインの段) のコンセプト
+ *
+ * `handle(request, response, next)` を持つ型。
+ * `next()` を呼ぶと次の段 (最後は終端のハンドラ) が実行される。
+ * `next()` の前に書いた処理はリクエスト側、後に書いた処理はレスポンス側の処理になる。
+ * `next()` を呼ばなければ、そこで打ち切れる (認証エラーなど)。
+ */
+template<typename T>
+concept middleware_stage = requires(T &stage, const http_request_t &request, http_response_t &response,
+                                    middleware_next_archetype_t next) {
+    stage.handle(request, response, next);
+};
+
+/**
+ * パイプラインの終端のハンドラのコンセプト
+ */
+template<typename T>
+concept request_handler = requires(T &handler, const http_request_t &request, http_response_t &response) {
+    handler(request, response);
+};
+
+/**
+ * コンパイル時に組み立てるミドルウェアのパイプライン
+ *
+ * 段の型をテンプレート引数で受け取り、段から次の段への呼び出しはラムダで渡すので、
+ * `std::function` や仮想関数を経由しない。最適化すると全体が1つの関数にインライン展開される。
+ *
+ * 終端のハンドラは呼び出す度に渡す (これもテンプレート引数なのでインライン展開される)。
+ * なので、同じパイプラインをルート毎の違うハンドラで使い回せる。
+ *
+ * ```
+ * auto pipeline = make_middleware_pipeline(
+ *     response_header_stage_t{...},
+ *     compression_stage_t{...}
+ * );
+ * pipeline(request, response, [](const http_request_t &request, http_response_t &response) { ... });
+ * ```
+ *
+ * 段は引数の順 (左が外側) に実行される。
+ *
+ * @tparam Stages 段の型
+ */
+template<middleware_stage... Stages>
+class middleware_pipeline_t {
+public:
+    explicit middleware_pipeline_t(Stages... stages)
+        : stages(std::move(stages)...) {
+    }
+
+    /**
+     * パイプラインを実行する
+     * @param [in] request リクエスト
+     * @param [out] response レスポンス
+     * @param [in] handler 終端のハンドラ
+     */
+    template<request_handler Handler>
+    inline void operator()(const http_request_t &request, http_response_t &response, Handler &&handler) {
+        this->invoke<0>(request, response, handler);
+    }
+
+    /**
+     * 段を取得する
+     * @tparam I 段の番号
+     */
+    template<size_t I>
+    inline auto &get_stage() {
+        return std::get<I>(this->stages);
+    }
+
+private:
+    std::tuple<Stages...> stages;
+
+    template<size_t I, typename Handler>
+    inline void invoke(const http_request_t &request, http_response_t &response, Handler &handler) {
+        if constexpr (I == sizeof...(Stages)) {
+            handler(request, response);
+        } else {
+            std::get<I>(this->stages).handle(request, response, [this, &request, &response, &handler]() {
+                this->invoke<I + 1>(request, response, handler);
+            });
+        }
+    }
+};
+
+/**
+ * パイプラインを作る (型を書かずに済むように)
+ * @param [in] stages 段 (左が外側)
+ * @return パイプライン
+ */
+template<middleware_stage... Stages>
+inline middleware_pipeline_t<Stages...> make_middleware_pipeline(Stages... stages) {
+    return middleware_pipeline_t<Stages...>(std::move(stages)...);
+}
+
+/**
+ * 実行時に段を追加できるミドルウェアの段 (型消去版)
+ *
+ * 設定ファイルや Lua から組み立てる段のように、コンパイル時に型が決まらないものに使う。
+ * 段の呼び出しは `std::function` を経由するので、コンパイル時のパイプラインより遅い。
+ * これ自身も1つの段なので、コンパイル時のパイプラインの中に入れられる。
+ */
+class dynamic_middleware_stage_t {
+public:
+    /**
+     * 実行時の段
+     */
+    using stage_t = std::function<void(const http_request_t &request, http_response_t &response,
+                                       const std::function<void()> &next)>;
+
+    /**
+     * 段を追加する (後に追加したものほど内側)
+     * @param [in] stage 段
+     */
+    inline void add(stage_t stage) {
+        this->stages.push_back(std::move(stage));
+    }
+
+    /**
+     * コンパイル時の段を型消去して追加する
+     * @param [in] stage 段
+     */
+    template<middleware_stage Stage>
+    inline void add_stage(Stage stage) {
+        this->stages.push_back([stage = std::move(stage)](const http_request_t &request, http_response_t &response,
+                                                          const std::function<void()> &next) mutable {
+            stage.handle(request, response, next);
+        });
+    }
+
+    template<typename Next>
+    inline void handle(const http_request_t &request, http_response_t &response, Next &&next) {
+        // ラムダのキャプチャを小さくして、std::function がメモリを確保しないようにする
+        const std::function<void()> last = [&next]() { next(); };
+        const invocation_t invocation{this, &request, &response, &last};
+        invocation.invoke(0);
+    }
+
+private:
+    /**
+     * 1回の実行の状態 (各段の `next` はこれへのポインタと段の番号だけを持つ)
+     */
+    struct invocation_t {
+        dynamic_middleware_stage_t* self;
+        const http_request_t* request;
+        http_response_t* response;
+        const std::function<void()>* last;
+
+        inline void invoke(size_t index) const {
+            if (index == this->self->stages.size()) {
+                (*this->last)();
+                return;
+            }
+            this->self->stages[index](*this->request, *this->response, [this, index]() {
+                this->invoke(index + 1);
+            });
+        }
+    };
+
+    std::vector<stage_t> stages;
+};
+
+
+#endif //HTTP_SERVER_MIDDLEWARE_PIPELINE_T_H
@@ -0,0 +1,59 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include "multipart_form_t.h"
+#include "multipart_parser_t.h"
+#include "http_request_t.h"
+#include "request_body_t.h"
+
+const size_t multipart_form_t::FIELD_MEMORY_LIMIT = 64 * 1024;
+
+multipart_form_t::multipart_form_t() = default;
+
+bool multipart_form_t::attach(http_request_t &request) {
+    const auto &header = request.get_header();
+    auto it = header.find("Content-Type");
+    if (it == header.end()) {
+        return false;
+    }
+
+    const auto boundary = multipart_parser_t::get_boundary(std::string(it->second));
+    if (!boundary) {
+        return false;
+    }
+
+    multipart_parser_t::handlers_t handlers;
+    handlers.on_part_begin = [this](const multipart_parser_t::part_t &part) {
+        part_t saved;
+        saved.name = part.name;
+        saved.filename = part.filename;
+        saved.content_type = part.content_type;
+        saved.data = std::make_shared<request_body_t>();
+        // ファイルはメモリを経由せずに一時ファイルに書き出す
+        saved.data->set_memory_limit(part.filename.empty() ? FIELD_MEMORY_LIMIT : 0);
+        this->parts.push_back(std::move(saved));
+    };
+    handlers.on_part_data = [this](const char* data, size_t size) {
+        this->parts.back().data->append(data, size);
+    };
+
+    this->parser = std::make_shared<multipart_parser_t>(*boundary, std::move(handlers));
+
+    request.set_body_handler([this](const char* data, size_t size) {
+        this->feed(data, size);
+    });
+    return true;
+}
+
+void multipart_form_t::feed(const char* data, size_t size) {
+    if (!this->parser) {
+        throw std::runtime_error("multipart/form-data のリクエストではありません。");
+    }
+    this->parser->feed(data, size);
+}
+
+bool multipart_form_t::is_complete() const {
+    return !this->parser || this->parser->is_done();
+}
@@ -0,0 +1,101 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_MULTIPART_FORM_T_H
+#define HTTP_SERVER_MULTIPART_FORM_T_H
+
+class http_request_t;
+class multipart_parser_t;
+class request_body_t;
+
+/**
+ * `multipart/form-data` のリクエストを受信しながらパートに分けて保存するクラス
+ *
+ * ファイルのパート (filename があるもの) は最初から一時ファイルに書き出し、
+ * それ以外の小さなフィールドはメモリに持つ。
+ *
+ * 使い方:
+ * ```
+ * auto form = std::make_shared<multipart_form_t>();
+ * auto request = http_server_t::read_request(sd, [&form](http_request_t &request) {
+ *     form->attach(request);
+ * });
+ * if (form->is_attached() && !form->is_complete()) { ... 400 を返す ... }
+ * for (const auto &part : form->get_parts()) { ... }
+ * ```
+ */
+class multipart_form_t {
+public:
+    /**
+     * 保存したパート
+     */
+    struct part_t {
+        std::string name;
+        std::string filename;
+        std::string content_type;
+
+        /**
+         * パートのデータ
+         */
+        std::shared_ptr<request_body_t> data;
+    };
+
+    multipart_form_t();
+
+    /**
+     * リクエストが multipart/form-data の場合に、ボディをこのインスタンスで受け取るようにする
+     *
+     * `http_server_t::read_request` のヘッダハンドラから呼ぶこと。
+     *
+     * @param [in,out] request リクエスト
+     * @return multipart/form-data の場合 `true`
+     */
+    bool attach(http_request_t &request);
+
+    /**
+     * ボディのバイト列をパースする
+     * @param [in] data バイト列
+     * @param [in] size バイト数
+     */
+    void feed(const char* data, size_t size);
+
+    /**
+     * multipart/form-data のリクエストだったか
+     * @return multipart/form-data の場合 `true`
+     */
+    [[nodiscard]] inline bool is_attached() const {
+        return static_cast<bool>(this->parser);
+    }
+
+    /**
+     * 終端の境界 (`--boundary--`) まで受信したか
+     *
+     * ボディが終端の境界より前で終わった場合 (Content-Length が足りない場合など) は `false`。
+     * その場合、最後のパートは途中までしか入っていないので、パートを使わずに 400 を返すこと。
+     *
+     * @return 受信した場合、または multipart/form-data のリクエストではない場合 `true`
+     */
+    [[nodiscard]] bool is_complete() const;
+
+    /**
+     * パートを取得する
+     * @return パートのリスト (受信した順)
+     */
+    [[nodiscard]] inline const std::vector<part_t>& get_parts() const {
+        return this->parts;
+    }
+
+    /**
+     * フィールド (ファイル以外) のメモリに持つ最大バイト数. 超えた分は一時ファイルに書き出す
+     */
+    static const size_t FIELD_MEMORY_LIMIT;
+
+private:
+    std::shared_ptr<multipart_parser_t> parser;
+
+    std::vector<part_t> parts;
+};
+
+
+#endif //HTTP_SERVER_MULTIPART_FORM_T_H
@@ -0,0 +1,310 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <boost/algorithm/string.hpp>
+#include "multipart_parser_t.h"
+#include "http_constants_t.h"
+
+const size_t multipart_parser_t::MAX_PART_HEADER_SIZE = 8 * 1024;
+
+namespace {
+    /**
+     * 境界の直後の行の最大バイト数
+     */
+    const size_t MAX_DELIMITER_LINE_SIZE = 256;
+
+    /**
+     * `key=value; key="value"` 形式のパラメータを解釈する (キーは小文字にする)
+     */
+    std::map<std::string, std::string> parse_parameters(const std::string &text) {
+        std::map<std::string, std::string> result;
+
+        size_t position = 0;
+        while (position < text.size()) {
+            const auto equal_pos = text.find('=', position);
+            const auto semicolon_pos = text.find(';', position);
+            if (equal_pos == std::string::npos || (semicolon_pos != std::string::npos && semicolon_pos < equal_pos)) {
+                // 値のないパラメータ (form-data など) は読み飛ばす
+                if (semicolon_pos == std::string::npos) {
+                    break;
+                }
+                position = semicolon_pos + 1;
+                continue;
+            }
+
+            const auto key = boost::to_lower_copy(boost::trim_copy(text.substr(position, equal_pos - position)));
+            position = equal_pos + 1;
+            while (position < text.size() && (text[position] == ' ' || text[position] == '\t')) {
+                position++;
+            }
+
+            std::string value;
+            if (position < text.size() && text[position] == '"') {
+                // quoted-string
+                position++;
+                while (position < text.size() && text[position] != '"') {
+                    if (text[position] == '\\' && position + 1 < text.size()) {
+                        position++;
+                    }
+                    value.push_back(text[position]);
+                    position++;
+                }
+                position++;
+                const auto next = text.find(';', position);
+                position = next == std::string::npos ? text.size() : next + 1;
+            } else {
+                const auto next = text.find(';', position);
+                value = boost::trim_copy(text.substr(position, next == std::string::npos ? std::string::npos : next - position));
+                position = next == std::string::npos ? text.size() : next + 1;
+            }
+            result[key] = value;
+        }
+        return result;
+    }
+}
+
+multipart_parser_t::multipart_parser_t(const std::string &boundary, handlers_t handlers)
+    : delimiter(http_constants_t::CRLF + "--" + boundary),
+      skip_table{},
+      handlers(std::move(handlers)),
+      state(state_t::preamble),
+      // 最初の境界は CRLF なしでボディの先頭に来ることがあるので、直前に CRLF があったことにする
+      tail(http_constants_t::CRLF) {
+
+    if (boundary.empty() || boundary.size() > 70) {
+        throw std::runtime_error("multipart の boundary が不正です。");
+    }
+
+    // ずらし量の表: 境界の最後の文字以外に出てくる文字は、最後に出てくる位置から末尾までの距離
+    const auto length = this->delimiter.size();
+    this->skip_table.fill(length);
+    for (size_t i = 0; i + 1 < length; i++) {
+        this->skip_table[static_cast<unsigned char>(this->delimiter[i])] = length - 1 - i;
+    }
+}
+
+std::optional<std::string> multipart_parser_t::get_boundary(const std::string &content_type) {
+    const auto semicolon_pos = content_type.find(';');
+    const auto media_type = boost::to_lower_copy(boost::trim_copy(content_type.substr(0, semicolon_pos)));
+    if (media_type != "multipart/form-data" || semicolon_pos == std::string::npos) {
+        return std::nullopt;
+    }
+
+    const auto parameters = parse_parameters(content_type.substr(semicolon_pos + 1));
+    auto it = parameters.find("boundary");
+    if (it == parameters.end() || it->second.empty()) {
+        return std::nullopt;
+    }
+    return it->second;
+}
+
+void multipart_parser_t::feed(const char* data, size_t size) {
+    size_t position = 0;
+
+    while (position < size && this->state != state_t::epilogue) {
+        switch (this->state) {
+            case state_t::preamble:
+                if (this->consume_until_delimiter(data, size, position, false)) {
+                    this->state = state_t::delimiter_line;
+                }
+                break;
+
+            case state_t::delimiter_line:
+                this->consume_delimiter_line(data, size, position);
+                break;
+
+            case state_t::part_header:
+                if (this->consume_part_header(data, size, position)) {
+                    if (this->handlers.on_part_begin) {
+                        this->handlers.on_part_begin(this->current_part);
+                    }
+                    this->state = state_t::part_data;
+                }
+                break;
+
+            case state_t::part_data:
+                if (this->consume_until_delimiter(data, size, position, true)) {
+                    if (this->handlers.on_part_end) {
+                        this->handlers.on_part_end();
+                    }
+                    this->state = state_t::delimiter_line;
+                }
+                break;
+
+            case state_t::epilogue:
+                break;
+        }
+    }
+}
+
+size_t multipart_parser_t::find_delimiter(const char* data, size_t size) const {
+    const auto length = this->delimiter.size();
+    if (size < length) {
+        return std::string::npos;
+    }
+
+    const auto last = length - 1;
+    size_t position = 0;
+    while (position <= size - length) {
+        // 末尾から比較する
+        auto i = last;
+        while (data[position + i] == this->delimiter[i]) {
+            if (i == 0) {
+                return position;
+            }
+            i--;
+        }
+        position += this->skip_table[static_cast<unsigned char>(data[position + last])];
+    }
+    return std::string::npos;
+}
+
+bool multipart_parser_t::consume_until_delimiter(const char* data, size_t size, size_t &position, bool emit) {
+    const auto length = this->delimiter.size();
+
+    // 前回の末尾と今回の先頭をまたいで境界があるか確認する
+    // (コピーするのは高々 境界の長さ * 2 バイト)
+    if (!this->tail.empty()) {
+        const auto head_size = std::min(size - position, length - 1);
+        std::string window = this->tail;
+        window.append(data + position, head_size);
+
+        const auto found = this->find_delimiter(window.data(), window.size());
+        if (found != std::string::npos && found < this->tail.size()) {
+            this->emit_data(this->tail.data(), found, emit);
+            position += found + length - this->tail.size();
+            this->tail.clear();
+            return true;
+        }
+
+        if (found == std::string::npos && head_size == size - position) {
+            // 今回のデータが短くて、まだ境界かどうか判定できない場合は持ち越す
+            auto keep = std::min(window.size(), length - 1);
+            while (keep > 0 && window.compare(window.size() - keep, keep, this->delimiter, 0, keep) != 0) {
+                keep--;
+            }
+            this->emit_data(window.data(), window.size() - keep, emit);
+            this->tail = window.substr(window.size() - keep);
+            position = size;
+            return false;
+        }
+
+        // 持ち越した部分は境界ではなかった
+        this->emit_data(this->tail.data(), this->tail.size(), emit);
+        this->tail.clear();
+    }
+
+    const auto remaining = size - position;
+    const auto found = this->find_delimiter(data + position, remaining);
+    if (found != std::string::npos) {
+        this->emit_data(data + position, found, emit);
+        position += found + length;
+        return true;
+    }
+
+    // 末尾が境界の先頭と一致している場合は、次の受信まで持ち越す
+    auto keep = std::min(remaining, length - 1);
+    while (keep > 0 && this->delimiter.compare(0, keep, data + size - keep, keep) != 0) {
+        keep--;
+    }
+    this->emit_data(data + position, remaining - keep, emit);
+    this->tail.assign(data + size - keep, keep);
+    position = size;
+    return false;
+}
+
+void multipart_parser_t::emit_data(const char* data, size_t size, bool emit) const {
+    if (emit && size > 0 && this->handlers.on_part_data) {
+        this->handlers.on_part_data(data, size);
+    }
+}
+
+bool multipart_parser_t::consume_delimiter_line(const char* data, size_t size, size_t &position) {
+    const auto begin = data + position;
+    const auto end = data + size;
+    const auto lf = std::find(begin, end, '\n');
+    this->line.append(begin, lf);
+    position += lf - begin;
+
+    if (this->line.size() > MAX_DELIMITER_LINE_SIZE) {
+        throw std::runtime_error("multipart の境界の後の行が長すぎます。");
+    }
+
+    // 終端の境界は `--` が続く (この後に CRLF が来なくても終端とみなす)
+    if (boost::starts_with(this->line, "--")) {
+        this->line.clear();
+        this->state = state_t::epilogue;
+        return true;
+    }
+
+    if (lf == end) {
+        return false;
+    }
+    position++;
+
+    // 境界の後には空白 (transport-padding) と CRLF だけが来る
+    if (!boost::trim_copy(this->line).empty()) {
+        throw std::runtime_error("multipart の境界の後に不正な文字があります。");
+    }
+    this->line.clear();
+    this->state = state_t::part_header;
+    return true;
+}
+
+bool multipart_parser_t::consume_part_header(const char* data, size_t size, size_t &position) {
+    while (position < size) {
+        this->line.push_back(data[position]);
+        position++;
+
+        if (this->line.size() > MAX_PART_HEADER_SIZE) {
+            throw std::runtime_error("multipart のパートのヘッダが大きすぎます。");
+        }
+
+        // ヘッダがない場合は空行だけ、ある場合は CRLF が2つ続いたら終わり
+        if (this->line == http_constants_t::CRLF || boost::ends_with(this->line, http_constants_t::CRLF2)) {
+            this->parse_part_header();
+            this->line.clear();
+            return true;
+        }
+    }
+    return false;
+}
+
+void multipart_parser_t::parse_part_header() {
+    this->current_part = part_t();
+
+    std::vector<std::string> lines;
+    boost::split(lines, this->line, boost::is_any_of(http_constants_t::CRLF), boost::token_compress_on);
+    for (const auto &header_line : lines) {
+        if (header_line.empty()) {
+            continue;
+        }
+        const auto delimiter_pos = header_line.find(http_constants_t::HEADER_DELIMITER);
+        if (delimiter_pos == std::string::npos) {
+            throw std::runtime_error("multipart のパートのヘッダにデリミタ \":\" が含まれていません");
+        }
+        const auto key = boost::to_lower_copy(boost::trim_copy(header_line.substr(0, delimiter_pos)));
+        const auto value = boost::trim_copy(header_line.substr(delimiter_pos + 1));
+        this->current_part.header.emplace(key, value);
+    }
+
+    auto disposition_it = this->current_part.header.find("content-disposition");
+    if (disposition_it != this->current_part.header.end()) {
+        const auto parameters = parse_parameters(disposition_it->second);
+        auto name_it = parameters.find("name");
+        if (name_it != parameters.end()) {
+            this->current_part.name = name_it->second;
+        }
+        auto filename_it = parameters.find("filename");
+        if (filename_it != parameters.end()) {
+            this->current_part.filename = filename_it->second;
+        }
+    }
+
+    auto content_type_it = this->current_part.header.find("content-type");
+    this->current_part.content_type = content_type_it != this->current_part.header.end()
+                                      ? content_type_it->second
+                                      : "text/plain";
+}
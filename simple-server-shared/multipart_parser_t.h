@@ -0,0 +1,187 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_MULTIPART_PARSER_T_H
+#define HTTP_SERVER_MULTIPART_PARSER_T_H
+
+/**
+ * `multipart/form-data` のボディを少しずつパースするクラス
+ *
+ * ボディは分割されて届くので、受信した順に `feed` に渡す。
+ * パートのデータは受信バッファを指したまま `on_part_data` に渡し、
+ * 境界 (boundary) をまたいでいるかもしれない末尾の数バイトだけを内部にコピーして持つ。
+ *
+ * 境界の検索は Boyer-Moore-Horspool 法で行うので、データ1バイトあたりの比較回数は境界の長さに反比例して少なくなる。
+ */
+class multipart_parser_t {
+public:
+    /**
+     * パートの情報
+     */
+    struct part_t {
+        /**
+         * パートのヘッダ (キーは小文字に変換済み、値は前後の空白を除去済み)
+         */
+        std::map<std::string, std::string> header;
+
+        /**
+         * Content-Disposition の name
+         */
+        std::string name;
+
+        /**
+         * Content-Disposition の filename (ファイルでない場合は空)
+         */
+        std::string filename;
+
+        /**
+         * パートの Content-Type (指定がない場合は text/plain)
+         */
+        std::string content_type;
+    };
+
+    /**
+     * パース結果を受け取るハンドラ
+     */
+    struct handlers_t {
+        /**
+         * パートのヘッダを読み終えたときに呼ばれる
+         */
+        std::function<void(const part_t &part)> on_part_begin;
+
+        /**
+         * パートのデータを受け取る (ポインタは `feed` に渡したバッファか内部のバッファを指す)
+         */
+        std::function<void(const char* data, size_t size)> on_part_data;
+
+        /**
+         * パートのデータが終わったときに呼ばれる
+         */
+        std::function<void()> on_part_end;
+    };
+
+    /**
+     * パートのヘッダの最大バイト数
+     */
+    static const size_t MAX_PART_HEADER_SIZE;
+
+    /**
+     * @param [in] boundary Content-Type の boundary パラメータ
+     * @param [in] handlers パース結果を受け取るハンドラ
+     */
+    multipart_parser_t(const std::string &boundary, handlers_t handlers);
+
+    /**
+     * Content-Type から boundary を取り出す
+     * @param [in] content_type Content-Type ヘッダの値
+     * @return boundary (multipart/form-data でない場合は `std::nullopt`)
+     */
+    [[nodiscard]] static std::optional<std::string> get_boundary(const std::string &content_type);
+
+    /**
+     * ボディのバイト列をパースする
+     *
+     * 不正なフォーマットの場合は `std::runtime_error` を投げる。
+     *
+     * @param [in] data バイト列
+     * @param [in] size バイト数
+     */
+    void feed(const char* data, size_t size);
+
+    /**
+     * 終端の境界 (`--boundary--`) まで読み込んだか
+     * @return 読み込んだ場合 `true`
+     */
+    [[nodiscard]] inline bool is_done() const {
+        return this->state == state_t::epilogue;
+    }
+
+private:
+    enum class state_t {
+        /**
+         * 最初の境界より前 (読み捨てる)
+         */
+        preamble,
+        /**
+         * 境界の直後の行 (`--` なら終端、空行ならパートのヘッダが続く)
+         */
+        delimiter_line,
+        /**
+         * パートのヘッダ
+         */
+        part_header,
+        /**
+         * パートのデータ
+         */
+        part_data,
+        /**
+         * 終端の境界より後 (読み捨てる)
+         */
+        epilogue,
+    };
+
+    /**
+     * 境界 (CRLF "--" boundary)
+     */
+    std::string delimiter;
+
+    /**
+     * Boyer-Moore-Horspool 法のずらし量の表
+     */
+    std::array<size_t, 256> skip_table;
+
+    handlers_t handlers;
+
+    state_t state;
+
+    /**
+     * 前回の `feed` の末尾で、境界の先頭と一致しているかもしれないバイト列
+     */
+    std::string tail;
+
+    /**
+     * 読み込み途中の行またはヘッダ
+     */
+    std::string line;
+
+    part_t current_part;
+
+    /**
+     * `data` の中から境界を探す (Boyer-Moore-Horspool 法)
+     * @return 見つかった位置. 見つからない場合は `std::string::npos`
+     */
+    [[nodiscard]] size_t find_delimiter(const char* data, size_t size) const;
+
+    /**
+     * 境界を探しながらデータを読み進める
+     *
+     * 境界の前のデータは `emit` が `true` の場合だけハンドラに渡す。
+     *
+     * @return 境界が見つかった場合 `true`. `position` は境界の直後を指す
+     */
+    bool consume_until_delimiter(const char* data, size_t size, size_t &position, bool emit);
+
+    /**
+     * データをハンドラに渡す
+     */
+    void emit_data(const char* data, size_t size, bool emit) const;
+
+    /**
+     * 境界の直後の行を読み込む
+     */
+    bool consume_delimiter_line(const char* data, size_t size, size_t &position);
+
+    /**
+     * パートのヘッダを読み込む
+     */
+    bool consume_part_header(const char* data, size_t size, size_t &position);
+
+    /**
+     * パートのヘッダをパースして `current_part` にセットする
+     */
+    void parse_part_header();
+};
+
+
+#endif //HTTP_SERVER_MULTIPART_PARSER_T_H
@@ -0,0 +1,218 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include "rate_limiter_t.h"
+#include "http_server_t.h"
+#include "server_metrics_t.h"
+
+namespace {
+    /**
+     * トークン数の単位 (1トークン = 1000)
+     */
+    const uint64_t TOKEN_SCALE = 1000;
+
+    const uint64_t TOKENS_MASK = 0xffffffffULL;
+
+    inline uint64_t pack(uint32_t time_ms, uint64_t tokens) {
+        return (static_cast<uint64_t>(time_ms) << 32U) | (tokens & TOKENS_MASK);
+    }
+
+    inline uint32_t get_time(uint64_t state) {
+        return static_cast<uint32_t>(state >> 32U);
+    }
+
+    inline uint64_t get_tokens(uint64_t state) {
+        return state & TOKENS_MASK;
+    }
+
+    /**
+     * 断るときのレスポンスを組み立てる
+     */
+    std::string make_rejection_response(int retry_after) {
+        return "HTTP/1.1 429 Too Many Requests\r\n"
+               "Retry-After: " + std::to_string(retry_after) + "\r\n"
+               "Content-Type: text/plain\r\n"
+               "Content-Length: 0\r\n"
+               "Connection: close\r\n"
+               "\r\n";
+    }
+
+    /**
+     * 環境変数 `SIMPLE_SERVER_OVERLOAD_PROTECTION` が 0 の場合は制限しない (ベンチマーク用)
+     */
+    bool is_disabled_by_environment() {
+        const auto value = std::getenv("SIMPLE_SERVER_OVERLOAD_PROTECTION");
+        return value && std::string_view(value) == "0";
+    }
+}
+
+rate_limiter_t::rate_limiter_t(const config_t &config)
+    : config(config),
+      rejection_response(make_rejection_response(config.retry_after)),
+      origin(clock_t::now()),
+      shards(std::max<size_t>(config.shard_count, 1)),
+      rejected_count(0),
+      stopping(false) {
+
+    // 32 ビットに収まるようにトークン数を制限する
+    const auto max_burst = static_cast<uint32_t>(TOKENS_MASK / TOKEN_SCALE);
+    this->config.burst = std::clamp<uint32_t>(config.burst, 1, max_burst);
+    if (is_disabled_by_environment()) {
+        this->config.enabled = false;
+    }
+
+    this->start_eviction();
+}
+
+rate_limiter_t::~rate_limiter_t() {
+    this->stop_eviction();
+}
+
+void rate_limiter_t::before_fork() {
+    // マスターではリクエストを受けないので、シャードのロックを取るのはバケットを捨てるスレッドだけ。
+    // そのスレッドを止めれば、ロックを持ったまま fork することはない
+    // (std::shared_mutex は書き込みロックを取ったスレッドの ID を覚えているので、
+    // 子プロセスでは ID が変わって離せなくなる。なのでロックを取ったまま fork はしない)
+    this->stop_eviction();
+}
+
+void rate_limiter_t::after_fork() {
+    this->stopping = false;
+    this->start_eviction();
+}
+
+bool rate_limiter_t::try_acquire(const std::string &key) {
+    if (!this->config.enabled) {
+        return true;
+    }
+    auto &shard = this->get_shard(key);
+    const auto now_ms = this->get_now_ms();
+
+    {
+        // 既にバケットがあれば共有ロックだけで済む
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.buckets.find(key);
+        if (it != shard.buckets.end()) {
+            if (this->consume(it->second, now_ms)) {
+                return true;
+            }
+            this->rejected_count.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    // 初めてのキーの場合は、満タンのバケットを作ってから1つ使う
+    // (別のスレッドが先に作っていた場合は、そのバケットを使う)
+    std::unique_lock<std::shared_mutex> lock(shard.mutex);
+    auto it = shard.buckets.try_emplace(key, pack(now_ms, this->config.burst * TOKEN_SCALE)).first;
+    if (this->consume(it->second, now_ms)) {
+        return true;
+    }
+    this->rejected_count.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void rate_limiter_t::reject(int sd) const {
+    server_metrics_t::get_default().add_rejection(server_metrics_t::rejection_t::rate_limit);
+    http_server_t::send_once_and_close(sd, this->rejection_response);
+}
+
+size_t rate_limiter_t::evict_idle() {
+    const auto now_ms = this->get_now_ms();
+    const auto idle_ms = static_cast<uint32_t>(this->config.idle_timeout.count());
+    size_t evicted = 0;
+
+    for (auto &shard : this->shards) {
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        for (auto it = shard.buckets.begin(); it != shard.buckets.end();) {
+            // 他のスレッドがこちらより少し後の時刻で更新している場合は、差が負 (符号なしだと巨大な値) になる
+            const auto state = it->second.state.load(std::memory_order_relaxed);
+            const auto elapsed_ms = static_cast<uint32_t>(now_ms - get_time(state));
+            if (elapsed_ms > idle_ms && elapsed_ms <= std::numeric_limits<uint32_t>::max() / 2) {
+                it = shard.buckets.erase(it);
+                evicted++;
+            } else {
+                ++it;
+            }
+        }
+    }
+    return evicted;
+}
+
+size_t rate_limiter_t::get_size() const {
+    size_t size = 0;
+    for (const auto &shard : this->shards) {
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        size += shard.buckets.size();
+    }
+    return size;
+}
+
+rate_limiter_t::shard_t &rate_limiter_t::get_shard(const std::string &key) {
+    return this->shards[std::hash<std::string>{}(key) % this->shards.size()];
+}
+
+uint32_t rate_limiter_t::get_now_ms() const {
+    return static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(clock_t::now() - this->origin).count()
+    );
+}
+
+bool rate_limiter_t::consume(bucket_t &bucket, uint32_t now_ms) const {
+    const auto capacity = static_cast<uint64_t>(this->config.burst) * TOKEN_SCALE;
+
+    auto state = bucket.state.load(std::memory_order_relaxed);
+    for (;;) {
+        // 前回からの経過時間分を補充する (1ミリ秒で rate / 1000 トークン = rate 単位)
+        const auto last_ms = get_time(state);
+        const auto elapsed_ms = static_cast<uint32_t>(now_ms - last_ms);
+        // 別のスレッドが少し先の時刻で更新していた場合は補充しない
+        const auto refilled = elapsed_ms > std::numeric_limits<uint32_t>::max() / 2
+            ? get_tokens(state)
+            : std::min(capacity, get_tokens(state) + static_cast<uint64_t>(elapsed_ms) * this->config.rate);
+        const auto new_time = elapsed_ms > std::numeric_limits<uint32_t>::max() / 2 ? last_ms : now_ms;
+
+        if (refilled < TOKEN_SCALE) {
+            // トークンが足りない (補充した分だけは書き戻しておく)
+            if (bucket.state.compare_exchange_weak(state, pack(new_time, refilled), std::memory_order_relaxed)) {
+                return false;
+            }
+            continue;
+        }
+        if (bucket.state.compare_exchange_weak(state, pack(new_time, refilled - TOKEN_SCALE), std::memory_order_relaxed)) {
+            return true;
+        }
+    }
+}
+
+void rate_limiter_t::stop_eviction() {
+    {
+        std::lock_guard<std::mutex> lock(this->eviction_mutex);
+        this->stopping = true;
+    }
+    this->eviction_condition.notify_all();
+    if (this->eviction_thread.joinable()) {
+        this->eviction_thread.join();
+    }
+}
+
+void rate_limiter_t::start_eviction() {
+    // 制限しない場合はバケットを作らないので、捨てるスレッドもいらない
+    if (!this->config.enabled || this->config.eviction_interval.count() <= 0) {
+        return;
+    }
+    this->eviction_thread = std::thread([this] {
+        std::unique_lock<std::mutex> lock(this->eviction_mutex);
+        while (!this->stopping) {
+            this->eviction_condition.wait_for(lock, this->config.eviction_interval);
+            if (this->stopping) {
+                break;
+            }
+            lock.unlock();
+            this->evict_idle();
+            lock.lock();
+        }
+    });
+}
@@ -0,0 +1,189 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_RATE_LIMITER_T_H
+#define HTTP_SERVER_RATE_LIMITER_T_H
+
+/**
+ * クライアント毎 (IPアドレス毎、必要ならルート毎) のレート制限を行うクラス
+ *
+ * キー毎にトークンバケットを持ち、1リクエストで1トークン使う。
+ * トークンは `rate` 個/秒 で `burst` 個まで貯まる。
+ *
+ * * バケットはシャードに分けたハッシュテーブルに入れる (シャードはキャッシュライン境界に揃える)
+ * * シャードのロックは読み込み用 (共有ロック) しか取らないので、別スレッドからのアクセスは互いに待たない
+ * * トークンの補充と消費はバケットの atomic 変数を CAS で更新するだけ (ロックしない)
+ * * しばらくアクセスのないバケットはバックグラウンドのスレッドが捨てる
+ *
+ * 捨てたバケットは、次のアクセスで満タンの状態から作り直す。
+ * なので、`idle_timeout` は `burst / rate` 秒 (満タンになるまでの時間) 以上にしておくこと。
+ *
+ * 環境変数 `SIMPLE_SERVER_OVERLOAD_PROTECTION=0` の場合は制限しない
+ * (ベンチマークで 429 ばかり返してしまわないように。`admission_controller_t` も同じ環境変数で止まる)。
+ */
+class rate_limiter_t {
+public:
+    /**
+     * レート制限の設定
+     */
+    struct config_t {
+        /**
+         * 1秒あたりに補充するトークン数
+         */
+        uint32_t rate = 50;
+
+        /**
+         * 貯められるトークン数の上限 (一度に連続して送れるリクエスト数)
+         */
+        uint32_t burst = 100;
+
+        /**
+         * シャード数
+         */
+        size_t shard_count = 64;
+
+        /**
+         * これより長くアクセスのないバケットは捨てる
+         */
+        std::chrono::milliseconds idle_timeout = std::chrono::seconds(60);
+
+        /**
+         * バケットを捨てるスレッドの実行間隔 (0 の場合はスレッドを起動しない)
+         */
+        std::chrono::milliseconds eviction_interval = std::chrono::seconds(10);
+
+        /**
+         * 断るときの `Retry-After` (秒)
+         */
+        int retry_after = 1;
+
+        /**
+         * `false` の場合は制限しない (全てのリクエストを通す)
+         */
+        bool enabled = true;
+    };
+
+    explicit rate_limiter_t(const config_t &config);
+
+    ~rate_limiter_t();
+
+    rate_limiter_t(const rate_limiter_t &) = delete;
+
+    rate_limiter_t &operator=(const rate_limiter_t &) = delete;
+
+    /**
+     * トークンを1つ使う
+     *
+     * キーは普通はクライアントのIPアドレス。ルート毎に制限したい場合は、リクエストを解析した後に
+     * `IPアドレス + " " + URI` のようなキーで呼ぶ。
+     *
+     * @param [in] key キー
+     * @return トークンが残っていた場合 `true`. 制限を超えている場合 `false`
+     */
+    bool try_acquire(const std::string &key);
+
+    /**
+     * 組み立て済みの `429 Too Many Requests` を送ってソケットを閉じる
+     * @param [in] sd ソケットディスクリプタ
+     */
+    void reject(int sd) const;
+
+    /**
+     * アクセスのないバケットを捨てる (バックグラウンドのスレッドから呼ばれる)
+     * @return 捨てたバケットの数
+     */
+    size_t evict_idle();
+
+    /**
+     * fork の直前に呼ぶ
+     * (子プロセスにはスレッドが付いてこないので、バケットを捨てるスレッドを止めてから fork する。
+     * prefork の場合はワーカー毎にバケットを持つので、全体ではワーカー数倍まで通る)
+     */
+    void before_fork();
+
+    /**
+     * fork の直後に、親プロセスと子プロセスの両方で呼ぶ (止めたスレッドを開始し直す)
+     */
+    void after_fork();
+
+    /**
+     * 今あるバケットの数を取得する
+     * @return バケットの数
+     */
+    [[nodiscard]] size_t get_size() const;
+
+    /**
+     * 断ったリクエストの数を取得する
+     * @return リクエスト数
+     */
+    [[nodiscard]] inline uint64_t get_rejected_count() const {
+        return this->rejected_count.load(std::memory_order_relaxed);
+    }
+
+private:
+    using clock_t = std::chrono::steady_clock;
+
+    /**
+     * トークンバケット
+     *
+     * 上位 32 ビットに最後に補充した時刻 (ミリ秒)、下位 32 ビットにトークン数 (1/1000 単位) を詰めて、
+     * 1回の CAS で両方を更新する。
+     */
+    struct alignas(64) bucket_t {
+        std::atomic<uint64_t> state;
+
+        explicit bucket_t(uint64_t state) : state(state) {}
+    };
+
+    /**
+     * シャード (false sharing を避けるためにキャッシュライン境界に揃える)
+     */
+    struct alignas(64) shard_t {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<std::string, bucket_t> buckets;
+    };
+
+    config_t config;
+
+    const std::string rejection_response;
+
+    clock_t::time_point origin;
+
+    std::vector<shard_t> shards;
+
+    mutable std::atomic<uint64_t> rejected_count;
+
+    std::thread eviction_thread;
+
+    std::mutex eviction_mutex;
+
+    std::condition_variable eviction_condition;
+
+    bool stopping;
+
+    shard_t &get_shard(const std::string &key);
+
+    /**
+     * バケットを捨てるスレッドを止める
+     */
+    void stop_eviction();
+
+    /**
+     * バケットを捨てるスレッドを開始する
+     */
+    void start_eviction();
+
+    /**
+     * `origin` からの経過ミリ秒 (32 ビットで一周するので、差を取るときは符号なしで引く)
+     */
+    [[nodiscard]] uint32_t get_now_ms() const;
+
+    /**
+     * バケットからトークンを1つ使う (ロックしない)
+     */
+    [[nodiscard]] bool consume(bucket_t &bucket, uint32_t now_ms) const;
+};
+
+
+#endif //HTTP_SERVER_RATE_LIMITER_T_H
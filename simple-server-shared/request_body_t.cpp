@@ -0,0 +1,142 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include "request_body_t.h"
+
+const size_t request_body_t::DEFAULT_MEMORY_LIMIT = 1024 * 1024;
+
+namespace {
+    /**
+     * 一時ファイルを作るディレクトリを取得する
+     */
+    std::string get_temp_directory() {
+        const auto tmpdir = std::getenv("TMPDIR");
+        if (tmpdir && *tmpdir) {
+            return tmpdir;
+        }
+        return "/tmp";
+    }
+
+    /**
+     * 名前のない一時ファイルを作る
+     *
+     * Linux では O_TMPFILE を使う。使えない環境では mkstemp で作ってすぐに unlink する。
+     */
+    int open_anonymous_file() {
+        const auto directory = get_temp_directory();
+#if defined(O_TMPFILE)
+        auto fd = open(directory.c_str(), O_TMPFILE | O_RDWR | O_CLOEXEC, S_IRUSR | S_IWUSR); // NOLINT(hicpp-signed-bitwise)
+        if (fd != -1) {
+            return fd;
+        }
+        // ファイルシステムが O_TMPFILE に対応していない場合は下に続く
+#endif
+        auto path = directory + "/http-server-body-XXXXXX";
+        auto fd_fallback = mkstemp(&*path.begin());
+        if (fd_fallback == -1) {
+            return -1;
+        }
+        unlink(path.c_str());
+        fcntl(fd_fallback, F_SETFD, FD_CLOEXEC);
+        return fd_fallback;
+    }
+
+    /**
+     * ファイルにデータを全て書き込む
+     */
+    void write_all(int fd, const char* data, size_t size) {
+        while (size > 0) {
+            const auto written = ::write(fd, data, size);
+            if (written == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error("リクエストボディを一時ファイルに書き込めませんでした。");
+            }
+            data += written;
+            size -= written;
+        }
+    }
+}
+
+request_body_t::request_body_t()
+    : memory_limit(DEFAULT_MEMORY_LIMIT),
+      fd(-1),
+      total_size(0),
+      mapped(nullptr),
+      mapped_size(0) {
+}
+
+request_body_t::~request_body_t() {
+    this->unmap();
+    if (this->fd != -1) {
+        close(this->fd);
+    }
+}
+
+void request_body_t::append(const char* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+
+    if (!this->is_spilled() && this->memory.size() + size > this->memory_limit) {
+        this->spill();
+    }
+
+    if (this->is_spilled()) {
+        // 追記したので古い mmap は使えない
+        this->unmap();
+        write_all(this->fd, data, size);
+    } else {
+        this->memory.append(data, size);
+    }
+    this->total_size += size;
+}
+
+std::string_view request_body_t::view() const {
+    if (!this->is_spilled()) {
+        return std::string_view(this->memory);
+    }
+    if (this->total_size == 0) {
+        return std::string_view();
+    }
+
+    if (!this->mapped) {
+        auto address = mmap(nullptr, this->total_size, PROT_READ, MAP_PRIVATE, this->fd, 0);
+        if (address == MAP_FAILED) {
+            throw std::runtime_error("リクエストボディの一時ファイルを mmap できませんでした。");
+        }
+        this->mapped = address;
+        this->mapped_size = this->total_size;
+    }
+    return std::string_view(static_cast<const char*>(this->mapped), this->mapped_size);
+}
+
+std::string request_body_t::to_string() const {
+    const auto body = this->view();
+    return std::string(body.begin(), body.end());
+}
+
+void request_body_t::spill() {
+    this->fd = open_anonymous_file();
+    if (this->fd == -1) {
+        throw std::runtime_error("リクエストボディの一時ファイルを作成できませんでした。");
+    }
+
+    write_all(this->fd, this->memory.data(), this->memory.size());
+
+    // メモリ上のボディは解放する
+    std::string().swap(this->memory);
+}
+
+void request_body_t::unmap() const {
+    if (this->mapped) {
+        munmap(this->mapped, this->mapped_size);
+        this->mapped = nullptr;
+        this->mapped_size = 0;
+    }
+}
@@ -0,0 +1,123 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_REQUEST_BODY_T_H
+#define HTTP_SERVER_REQUEST_BODY_T_H
+
+/**
+ * リクエストボディの格納先
+ *
+ * 小さいボディはメモリに持ち、`memory_limit` を超えたら無名の一時ファイル (`O_TMPFILE`) に書き出す。
+ * これで 1GB のアップロードでもリクエスト1つあたりのメモリ使用量は `memory_limit` で抑えられる。
+ *
+ * 一時ファイルに書き出したボディは、`get_fd` で取得したディスクリプタを
+ * そのまま CGI の標準入力に dup2 したり、`view` で mmap したりして使う。
+ */
+class request_body_t {
+public:
+    /**
+     * メモリに持つボディの最大バイト数の既定値
+     */
+    static const size_t DEFAULT_MEMORY_LIMIT;
+
+    request_body_t();
+
+    ~request_body_t();
+
+    request_body_t(const request_body_t &) = delete;
+
+    request_body_t &operator=(const request_body_t &) = delete;
+
+    /**
+     * メモリに持つボディの最大バイト数をセットする (データを追加する前に呼ぶこと)
+     * @param [in] memory_limit 最大バイト数
+     */
+    inline void set_memory_limit(size_t memory_limit) {
+        this->memory_limit = memory_limit;
+    }
+
+    /**
+     * データを追加する
+     * @param [in] data データ
+     * @param [in] size バイト数
+     */
+    void append(const char* data, size_t size);
+
+    /**
+     * ボディのバイト数を取得する
+     * @return バイト数
+     */
+    [[nodiscard]] inline size_t size() const {
+        return this->total_size;
+    }
+
+    /**
+     * 一時ファイルに書き出しているか
+     * @return 一時ファイルに書き出している場合 `true`
+     */
+    [[nodiscard]] inline bool is_spilled() const {
+        return this->fd != -1;
+    }
+
+    /**
+     * 一時ファイルのディスクリプタを取得する
+     *
+     * 読み込み位置は呼び出し側で `lseek` すること。
+     *
+     * @return ディスクリプタ (メモリに持っている場合は -1)
+     */
+    [[nodiscard]] inline int get_fd() const {
+        return this->fd;
+    }
+
+    /**
+     * ボディ全体を参照する
+     *
+     * 一時ファイルに書き出している場合は mmap する (mmap した領域は次に `append` するか、このインスタンスが破棄されるまで有効)。
+     *
+     * @return ボディ全体
+     */
+    std::string_view view() const;
+
+    /**
+     * ボディ全体を文字列にコピーする
+     * @return ボディ全体
+     */
+    [[nodiscard]] std::string to_string() const;
+
+private:
+    size_t memory_limit;
+
+    /**
+     * メモリ上のボディ
+     */
+    std::string memory;
+
+    /**
+     * 一時ファイルのディスクリプタ
+     */
+    int fd;
+
+    size_t total_size;
+
+    /**
+     * mmap した領域
+     */
+    mutable void* mapped;
+
+    mutable size_t mapped_size;
+
+    /**
+     * メモリ上のボディを一時ファイルに書き出す
+     */
+    void spill();
+
+    /**
+     * mmap した領域を解放する
+     */
+    void unmap() const;
+};
+
+
+#endif //HTTP_SERVER_REQUEST_BODY_T_H
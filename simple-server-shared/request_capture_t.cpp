@@ -0,0 +1,181 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "request_capture_t.h"
+#include "async_logger_t.h"
+
+namespace {
+    const std::array<char, request_capture_t::RECORD_ALIGNMENT> PADDING{};
+
+    request_capture_t::config_t get_config_from_environment() {
+        request_capture_t::config_t config;
+        if (const auto path = std::getenv("SIMPLE_SERVER_CAPTURE_PATH")) {
+            config.path = path;
+        }
+        if (const auto sample_every = std::getenv("SIMPLE_SERVER_CAPTURE_SAMPLE_EVERY")) {
+            config.sample_every = static_cast<uint32_t>(std::max(std::strtoul(sample_every, nullptr, 10), 1UL));
+        }
+        if (const auto max_bytes = std::getenv("SIMPLE_SERVER_CAPTURE_MAX_BYTES")) {
+            config.max_file_bytes = std::strtoull(max_bytes, nullptr, 10);
+        }
+        return config;
+    }
+}
+
+void request_capture_t::recording_t::append(const char* _data, size_t size) {
+    if (!this->capture) {
+        return;
+    }
+    // 大きすぎるリクエストは記録をやめる
+    if (this->data.size() + size > this->capture->config.max_request_bytes) {
+        this->capture = nullptr;
+        this->data = std::string();
+        return;
+    }
+    this->data.append(_data, size);
+}
+
+void request_capture_t::recording_t::commit() {
+    if (!this->capture) {
+        return;
+    }
+    this->capture->write_record(*this);
+    this->capture = nullptr;
+    this->data.clear();
+}
+
+request_capture_t::request_capture_t(const config_t &config)
+    : config(config),
+      fd(-1),
+      owner_pid(getpid()),
+      origin(clock_t::now()),
+      sequence(0),
+      next_connection_id(1),
+      file_bytes(0) {
+    if (config.path.empty()) {
+        return;
+    }
+
+    // prefork のワーカーが同じファイルに書くので、O_APPEND で開く (1回の write が他のワーカーの書き込みと混ざらない)
+    this->fd = open(config.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644); // NOLINT(hicpp-signed-bitwise)
+    if (this->fd == -1) {
+        async_logger_t::get_default().log(async_logger_t::level_t::error, "cannot open capture file: " + config.path);
+        return;
+    }
+
+    file_header_t header{};
+    header.magic = MAGIC;
+    header.version = VERSION;
+    header.header_size = sizeof(file_header_t);
+    header.started_at_ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count()
+    );
+    // ヘッダは fork する前にすぐに書いておく (ワーカーのレコードより前に来るように)
+    this->write_all(std::string(reinterpret_cast<const char*>(&header), sizeof(header)));
+    this->file_bytes = sizeof(header);
+}
+
+request_capture_t::~request_capture_t() {
+    if (this->fd == -1) {
+        return;
+    }
+    this->flush();
+    close(this->fd);
+}
+
+request_capture_t::recording_t request_capture_t::start(clock_t::time_point first_byte_at, uint32_t connection_id) {
+    recording_t recording;
+    if (!this->is_enabled()) {
+        return recording;
+    }
+    if (this->sequence.fetch_add(1, std::memory_order_relaxed) % this->config.sample_every != 0) {
+        return recording;
+    }
+
+    recording.capture = this;
+    recording.arrival_ns = static_cast<uint64_t>(std::max<int64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(first_byte_at - this->origin).count(), 0
+    ));
+    recording.connection_id = connection_id != 0
+                              ? connection_id
+                              : this->next_connection_id.fetch_add(1, std::memory_order_relaxed);
+    return recording;
+}
+
+void request_capture_t::flush() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->fd == -1 || this->buffer.empty() || getpid() != this->owner_pid) {
+        return;
+    }
+    this->write_buffer();
+}
+
+void request_capture_t::attach_worker(size_t index) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->owner_pid = getpid();
+    this->buffer.clear();
+    // 接続毎の番号がワーカー同士で重ならないように、上位のビットにワーカーの番号を入れる
+    this->next_connection_id.store(static_cast<uint32_t>((index + 1) << 24U) + 1, std::memory_order_relaxed);
+}
+
+request_capture_t &request_capture_t::get_default() {
+    static request_capture_t capture(get_config_from_environment());
+    return capture;
+}
+
+void request_capture_t::write_record(const recording_t &recording) {
+    record_header_t header{};
+    header.size = static_cast<uint32_t>(recording.data.size());
+    header.connection_id = recording.connection_id;
+    header.arrival_ns = recording.arrival_ns;
+    const auto padding = (RECORD_ALIGNMENT - recording.data.size() % RECORD_ALIGNMENT) % RECORD_ALIGNMENT;
+    const auto record_size = sizeof(header) + recording.data.size() + padding;
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    // fork しただけの子プロセス (attach_worker を呼んでいない) は書き出さない
+    if (getpid() != this->owner_pid) {
+        return;
+    }
+    if (this->file_bytes + record_size > this->config.max_file_bytes) {
+        return;
+    }
+    this->file_bytes += record_size;
+
+    // ヘッダとリクエストと詰め物を 1 回の write で書く (O_APPEND なので他のワーカーのレコードと混ざらない)
+    this->buffer.append(reinterpret_cast<const char*>(&header), sizeof(header));
+    this->buffer.append(recording.data);
+    this->buffer.append(PADDING.data(), padding);
+    this->write_buffer();
+}
+
+void request_capture_t::write_buffer() {
+    this->write_all(this->buffer);
+    this->buffer.clear();
+    // 他のワーカーが書いた分も最大のバイト数に数える
+    struct stat st{};
+    if (fstat(this->fd, &st) == 0) {
+        this->file_bytes = std::max(this->file_bytes, static_cast<uint64_t>(st.st_size));
+    }
+}
+
+void request_capture_t::write_all(const std::string &data) const {
+    if (data.empty()) {
+        return;
+    }
+    size_t written = 0;
+    while (written < data.size()) {
+        const auto result = ::write(this->fd, data.data() + written, data.size() - written);
+        if (result == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // 書き出せない場合は捨てる (記録のために止まらないようにする)
+            return;
+        }
+        written += static_cast<size_t>(result);
+    }
+}
@@ -0,0 +1,236 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_REQUEST_CAPTURE_T_H
+#define HTTP_SERVER_REQUEST_CAPTURE_T_H
+
+/**
+ * 受信したリクエストのバイト列と到着時刻を、バイナリのトレースファイルに記録する
+ *
+ * 環境変数 `SIMPLE_SERVER_CAPTURE_PATH` にファイルのパスを設定すると記録する (設定しない場合は何もしない)。
+ *
+ * * `SIMPLE_SERVER_CAPTURE_SAMPLE_EVERY` N 件に 1 件だけ記録する (既定 1 = 全て)
+ * * `SIMPLE_SERVER_CAPTURE_MAX_BYTES` ファイルの最大バイト数 (既定 1GB. 超えたら記録をやめる)
+ *
+ * ファイルの形式 (リトルエンディアン、mmap してそのまま読めるように各レコードは 8 バイト境界に置く)
+ *
+ * ```
+ * file_header_t                      (32 バイト)
+ * record_header_t + リクエスト + 詰め物  (レコード毎)
+ * ```
+ *
+ * リクエストは受信したバイト列そのまま (ヘッダとボディ)。到着時刻は最初のバイトを受信した時刻で、
+ * 記録を始めてからのナノ秒で持つ。`simple-server-bench/replay` で同じ間隔で送り直せる。
+ *
+ * ```
+ * auto recording = request_capture_t::get_default().start(first_byte_at);
+ * recording.append(data, size);   // 受信する度に
+ * recording.commit();              // リクエストを読み終わったら
+ * ```
+ *
+ * レコードは `commit` する度に 1 回の write で書き出す (溜めておくと、ワーカーが落ちたり
+ * SIGKILL されたときに、まだ書いていないレコードが失われるので)。
+ * prefork の場合は、マスターが fork する前にファイルを開き、各ワーカーが O_APPEND で書き足す
+ * (レコードは読み終わった順に書かれるので、到着順には並ばない。`replay` は到着時刻で並べ直す)。
+ */
+class request_capture_t {
+public:
+    using clock_t = std::chrono::steady_clock;
+
+    /**
+     * ファイルの先頭を表す文字列
+     */
+    static constexpr std::array<char, 8> MAGIC = {'S', 'S', 'C', 'A', 'P', 'T', '0', '1'};
+
+    static const uint32_t VERSION = 1;
+
+    /**
+     * レコードの境界
+     */
+    static const size_t RECORD_ALIGNMENT = 8;
+
+    /**
+     * ファイルのヘッダ
+     */
+    struct file_header_t {
+        std::array<char, 8> magic;
+
+        uint32_t version;
+
+        /**
+         * このヘッダのバイト数 (最初のレコードの位置)
+         */
+        uint32_t header_size;
+
+        /**
+         * 記録を始めた時刻 (UNIX 時刻のナノ秒)
+         */
+        uint64_t started_at_ns;
+
+        uint64_t reserved;
+    };
+
+    /**
+     * レコードのヘッダ
+     */
+    struct record_header_t {
+        /**
+         * リクエストのバイト数 (詰め物は含まない)
+         */
+        uint32_t size;
+
+        /**
+         * 接続毎の番号 (同じ接続で続けて来たリクエストは同じ番号)
+         */
+        uint32_t connection_id;
+
+        /**
+         * 記録を始めてから、リクエストの最初のバイトを受信するまでのナノ秒
+         */
+        uint64_t arrival_ns;
+    };
+
+    /**
+     * 記録の設定
+     */
+    struct config_t {
+        /**
+         * 書き出すファイル (空の場合は記録しない)
+         */
+        std::string path;
+
+        uint32_t sample_every = 1;
+
+        uint64_t max_file_bytes = 1024ULL * 1024 * 1024;
+
+        /**
+         * これより大きいリクエストは記録しない
+         */
+        size_t max_request_bytes = 1024 * 1024;
+    };
+
+    /**
+     * 1つのリクエストの記録 (記録しないリクエストの場合は空で、何もしない)
+     */
+    class recording_t {
+    public:
+        recording_t() = default;
+
+        recording_t(recording_t &&) noexcept = default;
+
+        recording_t &operator=(recording_t &&) noexcept = default;
+
+        recording_t(const recording_t &) = delete;
+
+        recording_t &operator=(const recording_t &) = delete;
+
+        /**
+         * 記録するリクエストか
+         */
+        explicit inline operator bool() const {
+            return this->capture != nullptr;
+        }
+
+        /**
+         * 受信したバイト列を追加する
+         */
+        void append(const char* data, size_t size);
+
+        /**
+         * リクエストを読み終わったので、ファイルに書き出す
+         */
+        void commit();
+
+    private:
+        friend class request_capture_t;
+
+        request_capture_t* capture = nullptr;
+
+        uint64_t arrival_ns = 0;
+
+        uint32_t connection_id = 0;
+
+        std::string data;
+    };
+
+    explicit request_capture_t(const config_t &config);
+
+    ~request_capture_t();
+
+    request_capture_t(const request_capture_t &) = delete;
+
+    request_capture_t &operator=(const request_capture_t &) = delete;
+
+    /**
+     * 記録するか (ファイルを開けた場合)
+     */
+    [[nodiscard]] inline bool is_enabled() const {
+        return this->fd != -1;
+    }
+
+    /**
+     * リクエストの記録を始める (記録しない場合は空の記録を返す)
+     * @param [in] first_byte_at 最初のバイトを受信した時刻
+     * @param [in] connection_id 接続毎の番号 (0 の場合は新しく振る)
+     * @return 記録
+     */
+    [[nodiscard]] recording_t start(clock_t::time_point first_byte_at, uint32_t connection_id = 0);
+
+    /**
+     * 溜めているレコードを書き出す
+     */
+    void flush();
+
+    /**
+     * prefork のワーカーとして記録する (fork した子プロセスで呼ぶ)
+     *
+     * ファイルはマスターが fork する前に開いておき、各ワーカーは自分で溜めたレコードを O_APPEND で書き足す。
+     *
+     * @param [in] index ワーカーの番号 (接続毎の番号がワーカー同士で重ならないようにする)
+     */
+    void attach_worker(size_t index);
+
+    /**
+     * プロセス共通の記録 (環境変数で設定する) を取得する
+     */
+    static request_capture_t &get_default();
+
+private:
+    config_t config;
+
+    int fd;
+
+    /**
+     * レコードを書き出すプロセス (ファイルを開いたプロセスか、`attach_worker` を呼んだワーカー.
+     * それ以外の fork した子プロセスは書き出さない)
+     */
+    pid_t owner_pid;
+
+    clock_t::time_point origin;
+
+    std::atomic<uint64_t> sequence;
+
+    std::atomic<uint32_t> next_connection_id;
+
+    std::mutex mutex;
+
+    std::string buffer;
+
+    uint64_t file_bytes;
+
+    /**
+     * レコードを1つ書き出す
+     */
+    void write_record(const recording_t &recording);
+
+    /**
+     * 溜めているレコードを書き出す (ロックを取ってから呼ぶ)
+     */
+    void write_buffer();
+
+    void write_all(const std::string &data) const;
+};
+
+
+#endif //HTTP_SERVER_REQUEST_CAPTURE_T_H
@@ -0,0 +1,18 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include "response_header_stage_t.h"
+#include "http_response_t.h"
+
+response_header_stage_t::response_header_stage_t(std::vector<std::pair<std::string, std::string>> headers)
+    : headers(std::move(headers)) {
+}
+
+void response_header_stage_t::apply(http_response_t &response) const {
+    // ヘッダは同じ名前があれば追加されないので、ハンドラの値が残る
+    for (const auto &header : this->headers) {
+        response.add_header(header.first, header.second);
+    }
+}
@@ -0,0 +1,36 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_RESPONSE_HEADER_STAGE_T_H
+#define HTTP_SERVER_RESPONSE_HEADER_STAGE_T_H
+
+class http_request_t;
+class http_response_t;
+
+/**
+ * 全てのレスポンスに決まったヘッダ (`Server` やセキュリティ関連のヘッダなど) を付けるミドルウェア
+ *
+ * ハンドラが同じ名前のヘッダを付けた場合は、ハンドラの値を優先する。
+ */
+class response_header_stage_t {
+public:
+    /**
+     * @param [in] headers 付けるヘッダ
+     */
+    explicit response_header_stage_t(std::vector<std::pair<std::string, std::string>> headers);
+
+    template<typename Next>
+    inline void handle(const http_request_t &, http_response_t &response, Next &&next) {
+        next();
+        this->apply(response);
+    }
+
+private:
+    std::vector<std::pair<std::string, std::string>> headers;
+
+    void apply(http_response_t &response) const;
+};
+
+
+#endif //HTTP_SERVER_RESPONSE_HEADER_STAGE_T_H
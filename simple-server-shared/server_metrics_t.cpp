@@ -0,0 +1,353 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include "server_metrics_t.h"
+#include "http_request_t.h"
+#include "http_response_t.h"
+#include "http_router_t.h"
+
+namespace {
+    const std::array<const char*, server_metrics_t::STAGE_COUNT> STAGE_NAMES = {
+        "accept_to_first_byte",
+        "header_parse",
+        "handler",
+        "serialize",
+        "write",
+    };
+
+    const std::array<const char*, server_metrics_t::REJECTION_COUNT> REJECTION_NAMES = {
+        "overload",
+        "rate_limit",
+    };
+
+    /**
+     * ヒストグラムの `le` (秒)
+     */
+    const std::array<double, 18> BUCKET_BOUNDS = {
+        0.00001, 0.00005, 0.0001, 0.00025, 0.0005,
+        0.001, 0.0025, 0.005, 0.01, 0.025, 0.05,
+        0.1, 0.25, 0.5, 1, 2.5, 5, 10,
+    };
+
+    /**
+     * 出力するパーセンタイル
+     */
+    const std::array<double, 4> QUANTILES = {0.5, 0.9, 0.99, 0.999};
+
+    void append_header(std::string &output, const char* name, const char* type, const char* help) {
+        output.append("# HELP ").append(name).append(" ").append(help).append("\n");
+        output.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+    }
+
+    void append_sample(std::string &output, const char* name, const std::string &labels, double value) {
+        std::array<char, 64> text{};
+        std::snprintf(text.data(), text.size(), "%.9g", value);
+        output.append(name);
+        if (!labels.empty()) {
+            output.append("{").append(labels).append("}");
+        }
+        output.append(" ").append(text.data()).append("\n");
+    }
+
+    void append_sample(std::string &output, const char* name, const std::string &labels, uint64_t value) {
+        output.append(name);
+        if (!labels.empty()) {
+            output.append("{").append(labels).append("}");
+        }
+        output.append(" ").append(std::to_string(value)).append("\n");
+    }
+
+    /**
+     * ラベルの値をエスケープする
+     */
+    std::string escape_label(const std::string &value) {
+        std::string escaped;
+        escaped.reserve(value.size());
+        for (const auto c : value) {
+            if (c == '"' || c == '\\') {
+                escaped += '\\';
+                escaped += c;
+            } else if (c == '\n') {
+                escaped += "\\n";
+            } else {
+                escaped += c;
+            }
+        }
+        return escaped;
+    }
+
+    std::string get_metrics_path_from_environment() {
+        const auto path = std::getenv("SIMPLE_SERVER_METRICS_PATH");
+        return path && *path ? std::string(path) : server_metrics_t::config_t{}.path;
+    }
+}
+
+server_metrics_t::server_metrics_t(const config_t &config)
+    : config(config),
+      connections_active(0),
+      in_flight(0) {
+}
+
+std::string server_metrics_t::to_prometheus() const {
+    std::string output;
+    output.reserve(16 * 1024);
+
+    append_header(output, "simple_server_connections_total", "counter", "Accepted connections.");
+    append_sample(output, "simple_server_connections_total", "", this->connections_total.get());
+
+    append_header(output, "simple_server_connections_active", "gauge", "Connections currently open.");
+    append_sample(output, "simple_server_connections_active", "",
+                  static_cast<double>(this->connections_active.load(std::memory_order_relaxed)));
+
+    append_header(output, "simple_server_requests_in_flight", "gauge", "Requests currently being processed.");
+    append_sample(output, "simple_server_requests_in_flight", "",
+                  static_cast<double>(this->in_flight.load(std::memory_order_relaxed)));
+
+    append_header(output, "simple_server_requests_total", "counter", "Responded requests by status class.");
+    for (size_t i = 0; i < this->requests_total.size(); i++) {
+        append_sample(output, "simple_server_requests_total",
+                      "code=\"" + std::to_string(i + 1) + "xx\"", this->requests_total[i].get());
+    }
+
+    append_header(output, "simple_server_received_bytes_total", "counter", "Bytes received from clients.");
+    append_sample(output, "simple_server_received_bytes_total", "", this->received_bytes_total.get());
+
+    append_header(output, "simple_server_sent_bytes_total", "counter", "Bytes sent to clients.");
+    append_sample(output, "simple_server_sent_bytes_total", "", this->sent_bytes_total.get());
+
+    append_header(output, "simple_server_errors_total", "counter", "Socket errors, unparsable requests and 5xx responses.");
+    append_sample(output, "simple_server_errors_total", "", this->errors_total.get());
+
+    append_header(output, "simple_server_rejections_total", "counter", "Connections or requests refused before processing.");
+    for (size_t i = 0; i < REJECTION_COUNT; i++) {
+        append_sample(output, "simple_server_rejections_total",
+                      std::string("reason=\"") + REJECTION_NAMES[i] + "\"", this->rejections_total[i].get());
+    }
+
+    append_header(output, "simple_server_shed_total", "counter", "Accepted requests dropped because they queued too long.");
+    append_sample(output, "simple_server_shed_total", "", this->shed_total.get());
+
+    append_header(output, "simple_server_stage_duration_seconds", "histogram", "Time spent in each request stage.");
+    std::vector<latency_histogram_t::snapshot_t> snapshots;
+    snapshots.reserve(STAGE_COUNT);
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+        snapshots.push_back(this->stages[i].get_snapshot());
+        const auto &snapshot = snapshots.back();
+        const std::string stage_label = std::string("stage=\"") + STAGE_NAMES[i] + "\"";
+
+        for (auto bound : BUCKET_BOUNDS) {
+            std::array<char, 32> le{};
+            std::snprintf(le.data(), le.size(), "%g", bound);
+            append_sample(output, "simple_server_stage_duration_seconds_bucket",
+                          stage_label + ",le=\"" + le.data() + "\"",
+                          snapshot.get_count_at_or_below(static_cast<uint64_t>(bound * 1e9)));
+        }
+        append_sample(output, "simple_server_stage_duration_seconds_bucket", stage_label + ",le=\"+Inf\"", snapshot.count);
+        append_sample(output, "simple_server_stage_duration_seconds_sum", stage_label,
+                      static_cast<double>(snapshot.sum_ns) / 1e9);
+        append_sample(output, "simple_server_stage_duration_seconds_count", stage_label, snapshot.count);
+    }
+
+    // ヒストグラムの `le` は粗いので、細かいバケットから求めたパーセンタイルも出す
+    append_header(output, "simple_server_stage_duration_quantile_seconds", "gauge", "Percentiles of the time spent in each request stage.");
+    for (size_t i = 0; i < STAGE_COUNT; i++) {
+        for (auto quantile : QUANTILES) {
+            std::array<char, 32> label{};
+            std::snprintf(label.data(), label.size(), "%g", quantile);
+            append_sample(output, "simple_server_stage_duration_quantile_seconds",
+                          std::string("stage=\"") + STAGE_NAMES[i] + "\",quantile=\"" + label.data() + "\"",
+                          static_cast<double>(snapshots[i].get_value_at_percentile(quantile * 100)) / 1e9);
+        }
+    }
+
+    if (allocation_accounting_t::is_enabled()) {
+        append_allocations(output);
+    }
+
+    if (this->worker_stats) {
+        this->append_workers(output);
+    }
+
+    return output;
+}
+
+void server_metrics_t::attach_worker(worker_stats_t* stats, size_t index) {
+    this->worker_stats = stats;
+    this->worker_index = index;
+    if (!stats) {
+        return;
+    }
+    for (size_t i = 0; i < worker_stats_t::COUNTER_COUNT; i++) {
+        this->worker_base[i] = stats->get(index, static_cast<worker_stats_t::counter_t>(i));
+    }
+    this->publish();
+}
+
+void server_metrics_t::publish() const {
+    if (!this->worker_stats) {
+        return;
+    }
+
+    // worker_stats_t::counter_t の順
+    const std::array<uint64_t, worker_stats_t::COUNTER_COUNT> values = {
+        this->connections_total.get(),
+        this->requests_total[0].get(),
+        this->requests_total[1].get(),
+        this->requests_total[2].get(),
+        this->requests_total[3].get(),
+        this->requests_total[4].get(),
+        this->received_bytes_total.get(),
+        this->sent_bytes_total.get(),
+        this->errors_total.get(),
+        this->rejections_total[static_cast<size_t>(rejection_t::overload)].get(),
+        this->rejections_total[static_cast<size_t>(rejection_t::rate_limit)].get(),
+        this->shed_total.get(),
+    };
+
+    auto &slot = this->worker_stats->get_slot(this->worker_index);
+    for (size_t i = 0; i < values.size(); i++) {
+        slot.counters[i].store(this->worker_base[i] + values[i], std::memory_order_relaxed);
+    }
+    slot.connections_active.store(this->connections_active.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    slot.in_flight.store(this->in_flight.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void server_metrics_t::append_workers(std::string &output) const {
+    using counter_t = worker_stats_t::counter_t;
+
+    // 返すワーカー自身の分は今の値にする
+    this->publish();
+
+    const auto &stats = *this->worker_stats;
+    const auto count = stats.get_worker_count();
+    const auto worker_label = [](size_t index) {
+        return "worker=\"" + std::to_string(index) + "\"";
+    };
+
+    append_header(output, "simple_server_worker_up", "gauge", "Whether the prefork worker is running.");
+    for (size_t i = 0; i < count; i++) {
+        append_sample(output, "simple_server_worker_up", worker_label(i),
+                      stats.get_slot(i).pid.load(std::memory_order_relaxed) != 0 ? 1.0 : 0.0);
+    }
+
+    append_header(output, "simple_server_worker_restarts_total", "counter", "Times the supervisor restarted the worker.");
+    for (size_t i = 0; i < count; i++) {
+        append_sample(output, "simple_server_worker_restarts_total", worker_label(i),
+                      static_cast<uint64_t>(stats.get_slot(i).restarts.load(std::memory_order_relaxed)));
+    }
+
+    append_header(output, "simple_server_worker_connections_active", "gauge", "Connections currently open per worker.");
+    for (size_t i = 0; i < count; i++) {
+        append_sample(output, "simple_server_worker_connections_active", worker_label(i),
+                      static_cast<double>(stats.get_slot(i).connections_active.load(std::memory_order_relaxed)));
+    }
+
+    append_header(output, "simple_server_worker_requests_in_flight", "gauge", "Requests currently being processed per worker.");
+    for (size_t i = 0; i < count; i++) {
+        append_sample(output, "simple_server_worker_requests_in_flight", worker_label(i),
+                      static_cast<double>(stats.get_slot(i).in_flight.load(std::memory_order_relaxed)));
+    }
+
+    // ラベルのないカウンタ
+    const std::array<std::tuple<const char*, const char*, counter_t>, 5> counters = {{
+        {"simple_server_worker_connections_total", "Accepted connections per worker.", counter_t::connections},
+        {"simple_server_worker_received_bytes_total", "Bytes received from clients per worker.", counter_t::received_bytes},
+        {"simple_server_worker_sent_bytes_total", "Bytes sent to clients per worker.", counter_t::sent_bytes},
+        {"simple_server_worker_errors_total", "Socket errors, unparsable requests and 5xx responses per worker.", counter_t::errors},
+        {"simple_server_worker_shed_total", "Accepted requests dropped because they queued too long per worker.", counter_t::shed},
+    }};
+    for (const auto &[name, help, counter] : counters) {
+        append_header(output, name, "counter", help);
+        for (size_t i = 0; i < count; i++) {
+            append_sample(output, name, worker_label(i), stats.get(i, counter));
+        }
+    }
+
+    append_header(output, "simple_server_worker_requests_total", "counter", "Responded requests by status class per worker.");
+    for (size_t i = 0; i < count; i++) {
+        for (size_t code = 0; code < 5; code++) {
+            append_sample(output, "simple_server_worker_requests_total",
+                          worker_label(i) + ",code=\"" + std::to_string(code + 1) + "xx\"",
+                          stats.get(i, static_cast<counter_t>(static_cast<size_t>(counter_t::requests_1xx) + code)));
+        }
+    }
+
+    append_header(output, "simple_server_worker_rejections_total", "counter", "Connections or requests refused before processing per worker.");
+    for (size_t i = 0; i < count; i++) {
+        for (size_t reason = 0; reason < REJECTION_COUNT; reason++) {
+            append_sample(output, "simple_server_worker_rejections_total",
+                          worker_label(i) + ",reason=\"" + REJECTION_NAMES[reason] + "\"",
+                          stats.get(i, static_cast<counter_t>(static_cast<size_t>(counter_t::rejections_overload) + reason)));
+        }
+    }
+}
+
+void server_metrics_t::append_allocations(std::string &output) {
+    using accounting_t = allocation_accounting_t;
+
+    const auto totals = accounting_t::get_phase_totals();
+    append_header(output, "simple_server_allocations_total", "counter", "Heap allocations in each request phase.");
+    for (size_t i = 0; i < accounting_t::PHASE_COUNT; i++) {
+        append_sample(output, "simple_server_allocations_total",
+                      std::string("phase=\"") + accounting_t::get_phase_name(static_cast<accounting_t::phase_t>(i)) + "\"",
+                      totals[i].count);
+    }
+    append_header(output, "simple_server_allocated_bytes_total", "counter", "Heap bytes allocated in each request phase.");
+    for (size_t i = 0; i < accounting_t::PHASE_COUNT; i++) {
+        append_sample(output, "simple_server_allocated_bytes_total",
+                      std::string("phase=\"") + accounting_t::get_phase_name(static_cast<accounting_t::phase_t>(i)) + "\"",
+                      totals[i].bytes);
+    }
+
+    // ルート毎 (リクエスト数で割ると、1リクエストあたりの確保の回数とバイト数になる)
+    const auto profiles = accounting_t::get_route_profiles();
+    append_header(output, "simple_server_route_requests_total", "counter", "Requests counted for allocation profiles.");
+    for (const auto &profile : profiles) {
+        append_sample(output, "simple_server_route_requests_total", "route=\"" + escape_label(profile.route) + "\"", profile.requests);
+    }
+    append_header(output, "simple_server_route_allocations_total", "counter", "Heap allocations per route and request phase.");
+    for (const auto &profile : profiles) {
+        for (size_t i = 0; i < accounting_t::PHASE_COUNT; i++) {
+            append_sample(output, "simple_server_route_allocations_total",
+                          "route=\"" + escape_label(profile.route) + "\",phase=\""
+                          + accounting_t::get_phase_name(static_cast<accounting_t::phase_t>(i)) + "\"",
+                          profile.phases[i].count);
+        }
+    }
+    append_header(output, "simple_server_route_allocated_bytes_total", "counter", "Heap bytes allocated per route and request phase.");
+    for (const auto &profile : profiles) {
+        for (size_t i = 0; i < accounting_t::PHASE_COUNT; i++) {
+            append_sample(output, "simple_server_route_allocated_bytes_total",
+                          "route=\"" + escape_label(profile.route) + "\",phase=\""
+                          + accounting_t::get_phase_name(static_cast<accounting_t::phase_t>(i)) + "\"",
+                          profile.phases[i].bytes);
+        }
+    }
+}
+
+bool server_metrics_t::is_metrics_request(const http_request_t &request) const {
+    return request.get_method() == "GET" && http_router_t::get_path(request.get_uri()) == this->config.path;
+}
+
+std::optional<http_response_t> server_metrics_t::handle_request(const http_request_t &request) const {
+    if (!this->is_metrics_request(request)) {
+        return std::nullopt;
+    }
+    std::optional<http_response_t> response(std::in_place);
+    this->write_response(*response);
+    return response;
+}
+
+void server_metrics_t::write_response(http_response_t &response) const {
+    response.set_status(200);
+    response.add_header("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+    response.add_header("Cache-Control", "no-store");
+    response.set_body(this->to_prometheus());
+}
+
+server_metrics_t &server_metrics_t::get_default() {
+    static server_metrics_t metrics{config_t{get_metrics_path_from_environment()}};
+    return metrics;
+}
@@ -0,0 +1,358 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_SERVER_METRICS_T_H
+#define HTTP_SERVER_SERVER_METRICS_T_H
+
+#include "sharded_counter_t.h"
+#include "latency_histogram_t.h"
+#include "allocation_accounting_t.h"
+#include "worker_stats_t.h"
+
+class http_request_t;
+class http_response_t;
+
+/**
+ * サーバのメトリクス (処理段階毎の処理時間のヒストグラムとカウンタ)
+ *
+ * 処理段階は
+ *
+ * * `accept_to_first_byte` 接続を受け付けてから (またはリクエストを読み始めてから) 最初のバイトを受信するまで
+ * * `header_parse` 最初のバイトからヘッダを解析し終わるまで
+ * * `handler` レスポンスを作る処理 (Lua / CGI / ネイティブのハンドラ)
+ * * `serialize` レスポンスを送信用の文字列にするまで
+ * * `write` 送信
+ *
+ * ヒストグラムもカウンタもスレッド毎のシャードに記録するので、記録するスレッドは互いに待たない。
+ * 設定したパス (既定は `/metrics`、環境変数 `SIMPLE_SERVER_METRICS_PATH` で変えられる) への GET に、
+ * 全シャードを合算して Prometheus のテキスト形式で返す。
+ *
+ * prefork のワーカーでは `attach_worker` しておくと、カウンタを共有メモリ (`worker_stats_t`) にも書き出し、
+ * 全ワーカーのカウンタを `simple_server_worker_*` として一緒に返す (ヒストグラムはワーカー毎)。
+ *
+ * ```
+ * auto &metrics = server_metrics_t::get_default();
+ * {
+ *     server_metrics_t::stage_timer_t timer(metrics, server_metrics_t::stage_t::handler);
+ *     ...
+ * }
+ * ```
+ */
+class server_metrics_t {
+public:
+    /**
+     * 処理段階
+     */
+    enum class stage_t : size_t {
+        accept_to_first_byte,
+        header_parse,
+        handler,
+        serialize,
+        write,
+    };
+
+    static const size_t STAGE_COUNT = 5;
+
+    /**
+     * 断った理由
+     */
+    enum class rejection_t : size_t {
+        /**
+         * アドミッション制御 (接続数・処理中のリクエスト数の上限)
+         */
+        overload,
+
+        /**
+         * クライアント毎のレート制限
+         */
+        rate_limit,
+    };
+
+    static const size_t REJECTION_COUNT = 2;
+
+    using clock_t = std::chrono::steady_clock;
+
+    /**
+     * メトリクスの設定
+     */
+    struct config_t {
+        /**
+         * メトリクスを返すパス
+         */
+        std::string path = "/metrics";
+    };
+
+    /**
+     * スコープを抜けるときに処理時間を記録するタイマー
+     * (確保を数えるビルドでは、スコープの間の確保をその処理段階に数える)
+     */
+    class stage_timer_t {
+    public:
+        stage_timer_t(server_metrics_t &metrics, stage_t stage)
+            : metrics(metrics),
+              stage(stage),
+              phase_scope(get_allocation_phase(stage)),
+              started(clock_t::now()) {
+        }
+
+        ~stage_timer_t() {
+            this->metrics.record(this->stage, clock_t::now() - this->started);
+        }
+
+        stage_timer_t(const stage_timer_t &) = delete;
+
+        stage_timer_t &operator=(const stage_timer_t &) = delete;
+
+    private:
+        server_metrics_t &metrics;
+
+        stage_t stage;
+
+        allocation_accounting_t::phase_scope_t phase_scope;
+
+        clock_t::time_point started;
+    };
+
+    /**
+     * 処理段階に対応する、確保を数える処理段階を取得する
+     */
+    static constexpr allocation_accounting_t::phase_t get_allocation_phase(stage_t stage) {
+        switch (stage) {
+            case stage_t::header_parse:
+                return allocation_accounting_t::phase_t::parse;
+            case stage_t::handler:
+                return allocation_accounting_t::phase_t::handler;
+            case stage_t::serialize:
+                return allocation_accounting_t::phase_t::serialize;
+            case stage_t::write:
+                return allocation_accounting_t::phase_t::write;
+            default:
+                return allocation_accounting_t::phase_t::other;
+        }
+    }
+
+    /**
+     * スコープの間だけゲージを 1 増やす (接続数・処理中のリクエスト数用)
+     */
+    class gauge_scope_t {
+    public:
+        explicit gauge_scope_t(std::atomic<int64_t> &gauge)
+            : gauge(gauge) {
+            this->gauge.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        ~gauge_scope_t() {
+            this->gauge.fetch_sub(1, std::memory_order_relaxed);
+        }
+
+        gauge_scope_t(const gauge_scope_t &) = delete;
+
+        gauge_scope_t &operator=(const gauge_scope_t &) = delete;
+
+    private:
+        std::atomic<int64_t> &gauge;
+    };
+
+    explicit server_metrics_t(const config_t &config);
+
+    server_metrics_t(const server_metrics_t &) = delete;
+
+    server_metrics_t &operator=(const server_metrics_t &) = delete;
+
+    /**
+     * 処理段階の処理時間を記録する
+     */
+    inline void record(stage_t stage, std::chrono::nanoseconds duration) {
+        this->stages[static_cast<size_t>(stage)].record(duration);
+    }
+
+    /**
+     * 接続を受け付けた
+     */
+    inline void add_connection() {
+        this->connections_total.add();
+    }
+
+    /**
+     * 接続中の間、接続数のゲージを増やしておく
+     */
+    [[nodiscard]] inline gauge_scope_t track_connection() {
+        return gauge_scope_t(this->connections_active);
+    }
+
+    /**
+     * 接続中の数を取得する
+     */
+    [[nodiscard]] inline int64_t get_connections_active() const {
+        return this->connections_active.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * リクエストの処理中の間、処理中のリクエスト数のゲージを増やしておく
+     */
+    [[nodiscard]] inline gauge_scope_t track_in_flight() {
+        return gauge_scope_t(this->in_flight);
+    }
+
+    /**
+     * 処理中のリクエスト数を増減する (スコープで囲めない非同期の処理用)
+     */
+    inline void add_in_flight(int64_t delta) {
+        this->in_flight.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    /**
+     * レスポンスを返したリクエストを数える
+     * @param [in] status ステータスコード (5xx はエラーとしても数える)
+     */
+    inline void add_request(int status) {
+        const auto status_class = std::clamp(status / 100, 1, 5);
+        this->requests_total[status_class - 1].add();
+        if (status_class == 5) {
+            this->errors_total.add();
+        }
+    }
+
+    inline void add_received_bytes(size_t bytes) {
+        this->received_bytes_total.add(bytes);
+    }
+
+    inline void add_sent_bytes(size_t bytes) {
+        this->sent_bytes_total.add(bytes);
+    }
+
+    /**
+     * エラー (ソケットのエラーや、解析できないリクエスト) を数える
+     */
+    inline void add_error() {
+        this->errors_total.add();
+    }
+
+    /**
+     * 断った接続やリクエストを数える
+     */
+    inline void add_rejection(rejection_t reason) {
+        this->rejections_total[static_cast<size_t>(reason)].add();
+    }
+
+    /**
+     * 受け付けた後で、待たされすぎたために処理せずに断ったリクエスト (ロードシェディング) を数える
+     */
+    inline void add_shed() {
+        this->shed_total.add();
+    }
+
+    /**
+     * メトリクスを返すパスを取得する
+     */
+    [[nodiscard]] inline const std::string &get_path() const {
+        return this->config.path;
+    }
+
+    /**
+     * 処理段階のヒストグラムを取得する
+     */
+    [[nodiscard]] inline const latency_histogram_t &get_histogram(stage_t stage) const {
+        return this->stages[static_cast<size_t>(stage)];
+    }
+
+    /**
+     * Prometheus のテキスト形式で出力する
+     * @return テキスト
+     */
+    [[nodiscard]] std::string to_prometheus() const;
+
+    /**
+     * メトリクスのパスへの GET か
+     * @param [in] request リクエスト
+     * @return メトリクスへのリクエストの場合 `true`
+     */
+    [[nodiscard]] bool is_metrics_request(const http_request_t &request) const;
+
+    /**
+     * メトリクスのパスへの GET の場合は、メトリクスのレスポンスを作る
+     * @param [in] request リクエスト
+     * @return レスポンス. メトリクスへのリクエストでない場合は `std::nullopt`
+     */
+    [[nodiscard]] std::optional<http_response_t> handle_request(const http_request_t &request) const;
+
+    /**
+     * メトリクスのレスポンスを作る
+     * @param [out] response レスポンス
+     */
+    void write_response(http_response_t &response) const;
+
+    /**
+     * prefork のワーカーとして、共有メモリのスロットに書き出すようにする (ワーカーの中で呼ぶ)
+     *
+     * スロットに前のワーカーの値が残っている場合は、それに足していく。
+     *
+     * @param [in] stats 共有メモリ
+     * @param [in] index ワーカーの番号
+     */
+    void attach_worker(worker_stats_t* stats, size_t index);
+
+    /**
+     * 今のカウンタを共有メモリのスロットに書き出す (`attach_worker` していない場合は何もしない)
+     * (全シャードを読むので、リクエスト毎ではなく接続の処理が終わる度くらいに呼ぶ)
+     */
+    void publish() const;
+
+    /**
+     * プロセス共通のメトリクスを取得する
+     * @return メトリクス
+     */
+    static server_metrics_t &get_default();
+
+private:
+    config_t config;
+
+    std::array<latency_histogram_t, STAGE_COUNT> stages;
+
+    sharded_counter_t connections_total;
+
+    std::atomic<int64_t> connections_active;
+
+    std::atomic<int64_t> in_flight;
+
+    /**
+     * ステータスコードの 1xx〜5xx 毎のリクエスト数
+     */
+    std::array<sharded_counter_t, 5> requests_total;
+
+    sharded_counter_t received_bytes_total;
+
+    sharded_counter_t sent_bytes_total;
+
+    sharded_counter_t errors_total;
+
+    std::array<sharded_counter_t, REJECTION_COUNT> rejections_total;
+
+    sharded_counter_t shed_total;
+
+    /**
+     * prefork の共有メモリ (ワーカーでない場合は nullptr)
+     */
+    worker_stats_t* worker_stats = nullptr;
+
+    size_t worker_index = 0;
+
+    /**
+     * スロットに残っていた前のワーカーの値
+     */
+    std::array<uint64_t, worker_stats_t::COUNTER_COUNT> worker_base{};
+
+    /**
+     * 全ワーカーのカウンタを出力する
+     */
+    void append_workers(std::string &output) const;
+
+    /**
+     * 確保を数えるビルドの場合に、処理段階毎・ルート毎の確保の回数とバイト数を出力する
+     */
+    static void append_allocations(std::string &output);
+};
+
+
+#endif //HTTP_SERVER_SERVER_METRICS_T_H
@@ -0,0 +1,60 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_SHARDED_COUNTER_T_H
+#define HTTP_SERVER_SHARDED_COUNTER_T_H
+
+/**
+ * 複数のスレッドから増やしても互いに待たないカウンタ
+ *
+ * 値をキャッシュライン毎のシャードに分けて持ち、スレッド毎に決まったシャードを増やす。
+ * 1つの atomic 変数を全スレッドで増やすと、キャッシュラインの取り合いでそこが詰まるため。
+ * 読むときは全シャードを足す (読むのはメトリクスの出力のときだけなので遅くてよい)。
+ */
+class sharded_counter_t {
+public:
+    /**
+     * シャード数 (2 のべき乗)
+     */
+    static const size_t SHARD_COUNT = 16;
+
+    /**
+     * 値を増やす
+     * @param [in] value 増やす値
+     */
+    inline void add(uint64_t value = 1) {
+        this->shards[get_shard_index()].value.fetch_add(value, std::memory_order_relaxed);
+    }
+
+    /**
+     * 全シャードの合計を取得する
+     */
+    [[nodiscard]] inline uint64_t get() const {
+        uint64_t total = 0;
+        for (const auto &shard : this->shards) {
+            total += shard.value.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    /**
+     * このスレッドが使うシャードの番号を取得する (スレッド毎に順番に割り当てる)
+     */
+    static inline size_t get_shard_index() {
+        thread_local const size_t index = next_shard_index.fetch_add(1, std::memory_order_relaxed) & (SHARD_COUNT - 1);
+        return index;
+    }
+
+private:
+    struct alignas(64) shard_t {
+        std::atomic<uint64_t> value{0};
+    };
+
+    std::array<shard_t, SHARD_COUNT> shards;
+
+    static inline std::atomic<size_t> next_shard_index{0};
+};
+
+
+#endif //HTTP_SERVER_SHARDED_COUNTER_T_H
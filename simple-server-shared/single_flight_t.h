@@ -0,0 +1,115 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_SINGLE_FLIGHT_T_H
+#define HTTP_SERVER_SINGLE_FLIGHT_T_H
+
+/**
+ * 同じキーの処理が同時に要求された場合に、1回だけ実行して結果を全員で共有するクラス (single-flight)
+ *
+ * キャッシュの期限切れ直後やキャッシュできないURLにリクエストが集中したときに、
+ * Lua スクリプトや CGI が同時に何十回も実行される (thundering herd) のを防ぐ。
+ *
+ * 先に来たリクエスト (リーダー) が処理を実行し、後から来たリクエストはその完了を待つ。
+ * 待っているリクエストが `max_waiters` に達した場合、それ以降のリクエストは待たずに自分で実行する。
+ *
+ * @tparam T 処理結果の型
+ */
+template<typename T>
+class single_flight_t {
+public:
+    /**
+     * @param [in] max_waiters 1つの処理を待てるリクエストの最大数
+     */
+    explicit single_flight_t(size_t max_waiters)
+        : max_waiters(max_waiters) {
+    }
+
+    /**
+     * キーに対応する処理を実行する
+     *
+     * 同じキーの処理が実行中の場合は、その完了を待って結果を返す。
+     * 処理が例外を投げた場合は、待っていた全てのリクエストに同じ例外を投げる。
+     *
+     * @param [in] key キー
+     * @param [in] function 処理
+     * @return 処理結果
+     */
+    std::shared_ptr<const T> execute(const std::string &key, const std::function<std::shared_ptr<const T>()> &function) {
+        std::shared_ptr<call_t> call;
+        {
+            std::unique_lock<std::mutex> lock(this->mutex);
+            auto it = this->calls.find(key);
+            if (it != this->calls.end()) {
+                call = it->second;
+                if (call->waiters < this->max_waiters) {
+                    // 実行中の処理に相乗りする
+                    call->waiters++;
+                    this->condition.wait(lock, [&call] { return call->done; });
+                    if (call->error) {
+                        std::rethrow_exception(call->error);
+                    }
+                    return call->result;
+                }
+                // 待ちが多すぎる場合は自分で実行する
+                call = nullptr;
+            } else {
+                call = std::make_shared<call_t>();
+                this->calls.emplace(key, call);
+            }
+        }
+
+        if (!call) {
+            return function();
+        }
+
+        // リーダーとして処理を実行する
+        std::shared_ptr<const T> result;
+        std::exception_ptr error;
+        try {
+            result = function();
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            call->result = result;
+            call->error = error;
+            call->done = true;
+            this->calls.erase(key);
+        }
+        this->condition.notify_all();
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+        return result;
+    }
+
+private:
+    /**
+     * 実行中の処理
+     */
+    struct call_t {
+        bool done = false;
+        size_t waiters = 0;
+        std::shared_ptr<const T> result;
+        std::exception_ptr error;
+    };
+
+    size_t max_waiters;
+
+    std::mutex mutex;
+
+    std::condition_variable condition;
+
+    /**
+     * 実行中の処理 (キー毎)
+     */
+    std::unordered_map<std::string, std::shared_ptr<call_t>> calls;
+};
+
+
+#endif //HTTP_SERVER_SINGLE_FLIGHT_T_H
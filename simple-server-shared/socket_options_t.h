@@ -0,0 +1,130 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_SOCKET_OPTIONS_T_H
+#define HTTP_SERVER_SOCKET_OPTIONS_T_H
+
+/**
+ * TCP の待ち受けソケットと、受け付けたソケットに設定するオプション
+ *
+ * 待ち受けのソケットに設定したオプションは、受け付けたソケットに引き継がれる (Linux)。
+ * なので接続毎には setsockopt を呼ばず、受け付けるときは accept4 のフラグだけを付ける。
+ *
+ * 環境変数で1つずつ設定できる。
+ *
+ * * `SIMPLE_SERVER_TCP_REUSEADDR=0` SO_REUSEADDR を付けない (既定は付ける. TIME_WAIT が残っていても再起動できる)
+ * * `SIMPLE_SERVER_TCP_DEFER_ACCEPT` TCP_DEFER_ACCEPT の秒数。リクエストのデータが届くまで accept が返らないので、
+ *   接続しただけのクライアントをワーカーが待たない (秒数を過ぎてもデータが来ない場合は、そのまま受け付ける)
+ * * `SIMPLE_SERVER_TCP_FASTOPEN` TCP_FASTOPEN のキューの長さ (sysctl `net.ipv4.tcp_fastopen` の 2 のビットも要る)
+ * * `SIMPLE_SERVER_SO_BUSY_POLL` SO_BUSY_POLL のマイクロ秒。受信を待つときに割り込みを待たずにデバイスのキューを見に行く
+ *   (CPU を使う代わりに遅延が減る. sysctl `net.core.busy_read` より大きくする場合は CAP_NET_ADMIN が要る)
+ * * `SIMPLE_SERVER_TCP_SEGMENTS` セグメントの送り方 (`nagle` (既定) / `nodelay` / `cork`)
+ * * `SIMPLE_SERVER_ACCEPT4=0` accept4 (SOCK_NONBLOCK | SOCK_CLOEXEC) ではなく、accept と fcntl で受け付ける
+ *
+ * `cork` は、ヘッダとボディを別々に書く場合 (`http_response_writer_t`) にヘッダを MSG_MORE で送って、
+ * ボディと同じセグメントにまとめる (TCP_CORK を付け外しするより setsockopt が減る)。
+ * 組み立て済みのレスポンスを1回で送る場合は、どれにしても1回の send になる。
+ */
+class socket_options_t {
+public:
+    /**
+     * セグメントの送り方
+     */
+    enum class segment_mode_t : int {
+        /**
+         * カーネルの既定 (Nagle アルゴリズム. 小さいセグメントは前の ACK を待つ)
+         */
+        nagle,
+
+        /**
+         * TCP_NODELAY (書いたらすぐ送る)
+         */
+        nodelay,
+
+        /**
+         * TCP_NODELAY と、続きがある書き込みは MSG_MORE (ヘッダとボディをまとめる)
+         */
+        cork,
+    };
+
+    /**
+     * 設定
+     */
+    struct config_t {
+        bool reuse_address = true;
+
+        /**
+         * TCP_DEFER_ACCEPT で、データが届くのを待つ秒数 (0 の場合は付けない)
+         */
+        int defer_accept_seconds = 0;
+
+        /**
+         * TCP_FASTOPEN のキューの長さ (0 の場合は付けない)
+         */
+        int fastopen_queue_length = 0;
+
+        /**
+         * SO_BUSY_POLL のマイクロ秒 (0 の場合は付けない)
+         */
+        int busy_poll_microseconds = 0;
+
+        segment_mode_t segment_mode = segment_mode_t::nagle;
+
+        /**
+         * accept4 で SOCK_NONBLOCK | SOCK_CLOEXEC を付けて受け付けるか (付けない場合は accept の後に fcntl で付ける)
+         */
+        bool accept4 = true;
+    };
+
+    explicit socket_options_t(const config_t &config);
+
+    [[nodiscard]] inline const config_t &get_config() const {
+        return this->config;
+    }
+
+    /**
+     * 続きを書く予定の書き込みに付けるフラグ (`cork` の場合は MSG_MORE、それ以外は 0)
+     */
+    [[nodiscard]] inline int get_more_flag() const {
+        return this->config.segment_mode == segment_mode_t::cork ? MSG_MORE : 0;
+    }
+
+    /**
+     * TCP の待ち受けのソケットに設定する (bind の前に呼ぶ. 引き継いだソケットの場合は bind 済みでもよい)
+     *
+     * 設定できなかったオプションは警告をログに出して、そのまま続ける。
+     *
+     * @param [in] sd ソケットディスクリプタ
+     */
+    void apply_to_listener(int sd) const;
+
+    /**
+     * 接続を受け付ける (設定に従って accept4 か、accept と fcntl)
+     *
+     * どちらの場合も、受け付けたソケットはノンブロッキングで、exec した子プロセスには引き継がれない。
+     *
+     * @param [in] sd 待ち受けのソケットディスクリプタ
+     * @param [out] addr クライアントのアドレス
+     * @param [in,out] addr_length アドレスのバイト数
+     * @return ソケットディスクリプタ (受け付けられなかった場合は -1 で、errno を設定する)
+     */
+    int accept(int sd, sockaddr* addr, socklen_t* addr_length) const;
+
+    /**
+     * MSG_MORE で送って溜まっているセグメントを、すぐに送る
+     * @param [in] sd ソケットディスクリプタ
+     */
+    static void push(int sd);
+
+    /**
+     * プロセス共通の設定 (環境変数で設定する) を取得する
+     */
+    static const socket_options_t &get_default();
+
+private:
+    config_t config;
+};
+
+
+#endif //HTTP_SERVER_SOCKET_OPTIONS_T_H
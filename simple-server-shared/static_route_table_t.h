@@ -0,0 +1,182 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_STATIC_ROUTE_TABLE_T_H
+#define HTTP_SERVER_STATIC_ROUTE_TABLE_T_H
+
+class http_request_t;
+class http_response_t;
+
+/**
+ * テンプレート引数に渡せる文字列 (C++20)
+ * @tparam N 終端の '\0' を含む長さ
+ */
+template<size_t N>
+struct fixed_string_t {
+    char value[N]{};
+
+    constexpr fixed_string_t(const char (&text)[N]) { // NOLINT(google-explicit-constructor)
+        for (size_t i = 0; i < N; i++) {
+            this->value[i] = text[i];
+        }
+    }
+
+    [[nodiscard]] constexpr std::string_view view() const {
+        return std::string_view(this->value, N - 1);
+    }
+};
+
+/**
+ * コンパイル時に決まるルート
+ *
+ * `static_route_t<"GET", "/health", handle_health>` のように書く。
+ *
+ * @tparam Method メソッド
+ * @tparam Path パス (パスパラメータは使えない. 使う場合は `http_router_t` に登録する)
+ * @tparam Handler ハンドラ `void (const http_request_t &, http_response_t &)`
+ */
+template<fixed_string_t Method, fixed_string_t Path, auto Handler>
+struct static_route_t {
+    static constexpr std::string_view method = Method.view();
+    static constexpr std::string_view path = Path.view();
+    static constexpr auto handler = Handler;
+};
+
+/**
+ * コンパイル時に決まるルートの表
+ *
+ * コンパイル時に、全てのルートの (メソッド, パス) のハッシュが衝突しない表の大きさとシードを探して (完全ハッシュ)、
+ * ハンドラの関数ポインタの表を作っておく。
+ * 実行時はハッシュを1回計算して、表の1か所の文字列を比較するだけでハンドラが決まる。
+ *
+ * ```
+ * using routes_t = static_route_table_t<
+ *     static_route_t<"GET", "/health", handle_health>,
+ *     static_route_t<"GET", "/version", handle_version>
+ * >;
+ * routes_t::dispatch(request.get_method(), request.get_uri(), request, response);
+ * ```
+ *
+ * 同じメソッドとパスのルートが2つあるとコンパイルエラーになる。
+ *
+ * @tparam Routes `static_route_t` のリスト
+ */
+template<typename... Routes>
+class static_route_table_t {
+public:
+    using handler_t = void (*)(const http_request_t &, http_response_t &);
+
+    /**
+     * ハンドラを探す
+     * @param [in] method メソッド
+     * @param [in] path パス (クエリ文字列は含めない)
+     * @return ハンドラ. 見つからない場合は nullptr
+     */
+    static constexpr handler_t find(std::string_view method, std::string_view path) {
+        if constexpr (COUNT == 0) {
+            return nullptr;
+        } else {
+            const auto &entry = TABLE[hash(LAYOUT.seed, method, path) & (LAYOUT.size - 1)];
+            if (entry.handler && entry.method == method && entry.path == path) {
+                return entry.handler;
+            }
+            return nullptr;
+        }
+    }
+
+    /**
+     * 一致するルートのハンドラを実行する
+     * @param [in] method メソッド
+     * @param [in] uri URI (クエリ文字列は無視する)
+     * @param [in] request リクエスト
+     * @param [out] response レスポンス
+     * @return ハンドラを実行した場合 `true`
+     */
+    static bool dispatch(std::string_view method, std::string_view uri, const http_request_t &request, http_response_t &response) {
+        const auto query_pos = uri.find_first_of("?#");
+        const auto handler = find(method, query_pos == std::string_view::npos ? uri : uri.substr(0, query_pos));
+        if (!handler) {
+            return false;
+        }
+        handler(request, response);
+        return true;
+    }
+
+private:
+    struct entry_t {
+        std::string_view method;
+        std::string_view path;
+        handler_t handler = nullptr;
+    };
+
+    struct layout_t {
+        uint64_t seed;
+        size_t size;
+    };
+
+    static constexpr size_t COUNT = sizeof...(Routes);
+
+    /**
+     * FNV-1a (メソッドとパスを ' ' でつないだものをハッシュする)
+     */
+    static constexpr uint64_t hash(uint64_t seed, std::string_view method, std::string_view path) {
+        uint64_t value = 14695981039346656037ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+        const auto mix = [&value](char c) {
+            value ^= static_cast<unsigned char>(c);
+            value *= 1099511628211ULL;
+        };
+        for (const auto c : method) {
+            mix(c);
+        }
+        mix(' ');
+        for (const auto c : path) {
+            mix(c);
+        }
+        // 下位ビットだけを使うので、上位ビットを混ぜ込む
+        return value ^ (value >> 29U);
+    }
+
+    /**
+     * 衝突しない表の大きさ (2の累乗) とシードを探す
+     */
+    static constexpr layout_t find_layout() {
+        constexpr std::array<std::string_view, COUNT> methods{Routes::method...};
+        constexpr std::array<std::string_view, COUNT> paths{Routes::path...};
+
+        for (size_t size = std::bit_ceil(COUNT * 2); size <= COUNT * 64; size <<= 1U) {
+            for (uint64_t seed = 0; seed < 1024; seed++) {
+                bool collided = false;
+                for (size_t i = 0; i < COUNT && !collided; i++) {
+                    const auto slot_i = hash(seed, methods[i], paths[i]) & (size - 1);
+                    for (size_t j = i + 1; j < COUNT; j++) {
+                        if (slot_i == (hash(seed, methods[j], paths[j]) & (size - 1))) {
+                            collided = true;
+                            break;
+                        }
+                    }
+                }
+                if (!collided) {
+                    return {seed, size};
+                }
+            }
+        }
+        return {0, 0};
+    }
+
+    static constexpr layout_t LAYOUT = COUNT == 0 ? layout_t{0, 1} : find_layout();
+
+    static_assert(LAYOUT.size != 0, "ルートの表を作れません (同じメソッドとパスのルートがありませんか?)");
+
+    static constexpr std::array<entry_t, LAYOUT.size> make_table() {
+        std::array<entry_t, LAYOUT.size> table{};
+        ((table[hash(LAYOUT.seed, Routes::method, Routes::path) & (LAYOUT.size - 1)]
+            = entry_t{Routes::method, Routes::path, Routes::handler}), ...);
+        return table;
+    }
+
+    static constexpr std::array<entry_t, LAYOUT.size> TABLE = make_table();
+};
+
+
+#endif //HTTP_SERVER_STATIC_ROUTE_TABLE_T_H
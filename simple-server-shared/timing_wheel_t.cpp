@@ -0,0 +1,168 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include "timing_wheel_t.h"
+
+timing_wheel_t::timing_wheel_t(std::chrono::milliseconds resolution)
+    : resolution(std::max(resolution, std::chrono::milliseconds(1))),
+      origin(clock_t::now()),
+      current_tick(0),
+      slots{},
+      resume_after_fork(false),
+      running(false) {
+}
+
+timing_wheel_t::~timing_wheel_t() {
+    this->stop();
+}
+
+void timing_wheel_t::arm(wheel_timer_t &timer, std::chrono::milliseconds delay) {
+    // 端数は切り上げて、指定より早く期限切れにならないようにする
+    const auto ticks = static_cast<uint64_t>((delay + this->resolution - std::chrono::milliseconds(1)) / this->resolution);
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (timer.is_armed()) {
+        unlink(timer);
+    }
+    timer.expires = this->get_now_tick() + std::max<uint64_t>(ticks, 1);
+    this->insert(timer);
+}
+
+void timing_wheel_t::cancel(wheel_timer_t &timer) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (timer.is_armed()) {
+        unlink(timer);
+    }
+}
+
+void timing_wheel_t::advance() {
+    const auto target_tick = this->get_now_tick();
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    while (this->current_tick < target_tick) {
+        this->current_tick++;
+
+        // 1段目が一周したら、上の段の次のスロットを下に移す
+        if ((this->current_tick & SLOT_MASK) == 0) {
+            for (size_t level = 1; level < LEVEL_COUNT; level++) {
+                if (!this->cascade(level)) {
+                    break;
+                }
+            }
+        }
+
+        // 1段目の今のスロットにあるタイマーは全て期限切れ
+        auto &slot = this->slots[0][this->current_tick & SLOT_MASK];
+        while (slot) {
+            auto &timer = *slot;
+            unlink(timer);
+            if (timer.callback) {
+                timer.callback();
+            }
+        }
+    }
+}
+
+void timing_wheel_t::start() {
+    if (this->running) {
+        return;
+    }
+    this->running = true;
+    this->thread = std::thread([this] {
+        while (this->running) {
+            std::this_thread::sleep_for(this->resolution);
+            this->advance();
+        }
+    });
+}
+
+void timing_wheel_t::stop() {
+    this->running = false;
+    if (this->thread.joinable()) {
+        this->thread.join();
+    }
+}
+
+void timing_wheel_t::before_fork() {
+    this->resume_after_fork = this->running;
+    this->stop();
+    // 他のスレッドがタイマーを付け外ししている途中で fork しないようにする
+    this->mutex.lock();
+}
+
+void timing_wheel_t::after_fork() {
+    this->mutex.unlock();
+    if (this->resume_after_fork) {
+        this->start();
+    }
+}
+
+timing_wheel_t &timing_wheel_t::get_default() {
+    static timing_wheel_t wheel(std::chrono::milliseconds(10));
+    static std::once_flag started;
+    std::call_once(started, [] {
+        wheel.start();
+    });
+    return wheel;
+}
+
+void timing_wheel_t::insert(wheel_timer_t &timer) {
+    // 既に処理済みのティックには入れられないので、次のティックにする
+    if (timer.expires <= this->current_tick) {
+        timer.expires = this->current_tick + 1;
+    }
+
+    // 一番上の段でも表せない先の期限は、表せる一番先に丸める
+    const uint64_t max_delta = (1ULL << (SLOT_BITS * LEVEL_COUNT)) - 1;
+    if (timer.expires - this->current_tick > max_delta) {
+        timer.expires = this->current_tick + max_delta;
+    }
+
+    const auto delta = timer.expires - this->current_tick;
+    size_t level = 0;
+    while (level + 1 < LEVEL_COUNT && delta >= (1ULL << (SLOT_BITS * (level + 1)))) {
+        level++;
+    }
+    const auto index = (timer.expires >> (SLOT_BITS * level)) & SLOT_MASK;
+
+    auto &slot = this->slots[level][index];
+    timer.prev = nullptr;
+    timer.next = slot;
+    if (slot) {
+        slot->prev = &timer;
+    }
+    slot = &timer;
+    timer.slot = &slot;
+}
+
+void timing_wheel_t::unlink(wheel_timer_t &timer) {
+    if (timer.prev) {
+        timer.prev->next = timer.next;
+    } else {
+        *timer.slot = timer.next;
+    }
+    if (timer.next) {
+        timer.next->prev = timer.prev;
+    }
+    timer.prev = nullptr;
+    timer.next = nullptr;
+    timer.slot = nullptr;
+}
+
+bool timing_wheel_t::cascade(size_t level) {
+    const auto index = (this->current_tick >> (SLOT_BITS * level)) & SLOT_MASK;
+    auto &slot = this->slots[level][index];
+
+    while (slot) {
+        auto &timer = *slot;
+        unlink(timer);
+        this->insert(timer);
+    }
+    return index == 0;
+}
+
+uint64_t timing_wheel_t::get_now_tick() const {
+    return static_cast<uint64_t>((clock_t::now() - this->origin) / this->resolution);
+}
@@ -0,0 +1,190 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_TIMING_WHEEL_T_H
+#define HTTP_SERVER_TIMING_WHEEL_T_H
+
+class timing_wheel_t;
+
+/**
+ * タイミングホイールに登録するタイマー
+ *
+ * リストのノードを兼ねているので、登録・取り消しでメモリを確保しない。
+ * コネクションのオブジェクトやスタックに埋め込んで使う。
+ */
+class wheel_timer_t {
+public:
+    /**
+     * @param [in] callback 期限切れのときに呼ばれるハンドラ
+     */
+    explicit wheel_timer_t(std::function<void()> callback)
+        : callback(std::move(callback)) {
+    }
+
+    wheel_timer_t(const wheel_timer_t &) = delete;
+
+    wheel_timer_t &operator=(const wheel_timer_t &) = delete;
+
+    /**
+     * 登録中か (ホイールのロックの外から見た値は、ハンドラの実行中でも `false` になることがある)
+     * @return 登録中の場合 `true`
+     */
+    [[nodiscard]] inline bool is_armed() const {
+        return this->slot != nullptr;
+    }
+
+private:
+    friend class timing_wheel_t;
+
+    std::function<void()> callback;
+
+    wheel_timer_t* prev = nullptr;
+
+    wheel_timer_t* next = nullptr;
+
+    /**
+     * 登録先のスロット (登録されていない場合は nullptr)
+     */
+    wheel_timer_t** slot = nullptr;
+
+    /**
+     * 期限のティック
+     */
+    uint64_t expires = 0;
+};
+
+/**
+ * 階層型タイミングホイール
+ *
+ * 64 スロットのホイールを 4 段重ねたもの。
+ * 1段目は1ティック単位、2段目は64ティック単位… で期限を管理し、
+ * 上の段のスロットの時刻になったら、そのスロットのタイマーを下の段に移す (カスケード)。
+ *
+ * * 登録と取り消しは O(1) (リストへの挿入と削除だけ)
+ * * タイマーの数に関係なく、1ティックで見るのは1スロット (とたまにカスケード) だけ
+ *
+ * なので、10万コネクションのタイムアウトをヒープ (priority_queue) で管理するよりずっと安い。
+ *
+ * 期限切れのハンドラはホイールのロックを取ったまま呼ぶので、
+ * `cancel` から戻った後にハンドラが呼ばれることはない。
+ * そのかわり、ハンドラの中で同じホイールの `arm` や `cancel` を呼んではいけない。
+ */
+class timing_wheel_t {
+public:
+    /**
+     * @param [in] resolution 1ティックの長さ
+     */
+    explicit timing_wheel_t(std::chrono::milliseconds resolution);
+
+    ~timing_wheel_t();
+
+    /**
+     * タイマーを登録する (登録済みの場合は登録し直す)
+     * @param [in,out] timer タイマー
+     * @param [in] delay 期限までの時間
+     */
+    void arm(wheel_timer_t &timer, std::chrono::milliseconds delay);
+
+    /**
+     * タイマーを取り消す
+     *
+     * ハンドラはホイールのロックを取ったまま呼ぶので、このタイマーのハンドラが実行中の場合は、
+     * 終わるまで待ってから戻る (戻った後は、タイマーを埋め込んだオブジェクトを破棄してよい)。
+     *
+     * @param [in,out] timer タイマー
+     */
+    void cancel(wheel_timer_t &timer);
+
+    /**
+     * 現在時刻までホイールを進めて、期限切れのタイマーのハンドラを呼ぶ
+     */
+    void advance();
+
+    /**
+     * バックグラウンドでホイールを進めるスレッドを開始する
+     */
+    void start();
+
+    /**
+     * バックグラウンドのスレッドを停止する
+     */
+    void stop();
+
+    /**
+     * fork の直前に呼ぶ
+     * (子プロセスにはスレッドが付いてこないので、バックグラウンドのスレッドを止めて、ロックを取った状態で fork する)
+     */
+    void before_fork();
+
+    /**
+     * fork の直後に、親プロセスと子プロセスの両方で呼ぶ (ロックを離して、止めたスレッドを開始し直す)
+     */
+    void after_fork();
+
+    /**
+     * プロセス共通のホイール (10ms 単位、初回呼び出し時にスレッドを開始する) を取得する
+     * @return ホイール
+     */
+    static timing_wheel_t &get_default();
+
+private:
+    using clock_t = std::chrono::steady_clock;
+
+    static const size_t LEVEL_COUNT = 4;
+
+    static const size_t SLOT_BITS = 6;
+
+    static const size_t SLOT_COUNT = 1U << SLOT_BITS;
+
+    static const size_t SLOT_MASK = SLOT_COUNT - 1;
+
+    std::chrono::milliseconds resolution;
+
+    clock_t::time_point origin;
+
+    /**
+     * ホイールが処理済みのティック
+     */
+    uint64_t current_tick;
+
+    /**
+     * スロット (各スロットはタイマーの双方向リストの先頭)
+     */
+    std::array<std::array<wheel_timer_t*, SLOT_COUNT>, LEVEL_COUNT> slots;
+
+    std::mutex mutex;
+
+    std::thread thread;
+
+    /**
+     * `before_fork` でスレッドを止めたか (`after_fork` で開始し直す)
+     */
+    bool resume_after_fork;
+
+    volatile bool running;
+
+    /**
+     * 期限に応じたスロットに入れる (ロックを取った状態で呼ぶこと)
+     */
+    void insert(wheel_timer_t &timer);
+
+    /**
+     * スロットから外す (ロックを取った状態で呼ぶこと)
+     */
+    static void unlink(wheel_timer_t &timer);
+
+    /**
+     * 上の段のスロットのタイマーを下の段に移す (ロックを取った状態で呼ぶこと)
+     * @return 次の段もカスケードが必要な場合 `true`
+     */
+    bool cascade(size_t level);
+
+    /**
+     * 現在時刻に対応するティックを取得する
+     */
+    [[nodiscard]] uint64_t get_now_tick() const;
+};
+
+
+#endif //HTTP_SERVER_TIMING_WHEEL_T_H
@@ -0,0 +1,64 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_TRACE_PROBES_H
+#define HTTP_SERVER_TRACE_PROBES_H
+
+/*
+ * USDT (静的トレースポイント) のマクロ
+ *
+ * `HTTP_SERVER_HAVE_USDT` が定義されている場合 (CMake のオプション `HTTP_SERVER_ENABLE_USDT` が ON で、
+ * `sys/sdt.h` がある場合) は、プロバイダ `simple_server` のプローブを埋め込む。
+ * プローブは nop 命令1つで、トレーサがアタッチしたときだけ書き換えられる。
+ * 定義されていない場合は何もせず、引数も評価しない。
+ *
+ * 引数は既に手元にある値 (ディスクリプタやサイズ) だけにする。時刻はトレーサ側で取れるので
+ * (bpftrace の `nsecs` は CLOCK_MONOTONIC)、プローブのために時刻を取得することはしない。
+ *
+ * ```
+ * $ sudo bpftrace -l 'usdt:./simple-server-01:simple_server:*'
+ * $ sudo bpftrace -p $(pidof simple-server-01) scripts/request_latency.bt
+ * ```
+ *
+ * プローブの一覧 (引数)
+ *
+ * | プローブ              | 引数                                     | 場所                          |
+ * |-----------------------|------------------------------------------|-------------------------------|
+ * | connection__accept    | fd                                       | 接続を受け付けた              |
+ * | request__chunk        | fd, 受信したバイト数                     | リクエストを受信した (recv 毎) |
+ * | request__headers      | fd, メソッド, URI                        | ヘッダを解析し終わった        |
+ * | handler__start        | fd, 種類 ("echo" "cgi" "lua" "native")   | レスポンスを作り始めた        |
+ * | handler__end          | fd, 種類                                 | レスポンスを作り終わった      |
+ * | response__sent        | fd, 送信したバイト数, 残りのバイト数     | レスポンスを送信した (send 毎) |
+ * | connection__close     | fd                                       | 接続を閉じた                  |
+ * | lua__acquire          | lua_State*                               | Lua の状態を作った            |
+ * | lua__release          | lua_State*                               | Lua の状態を閉じた            |
+ * | cgi__spawn            | pid                                      | CGI のプロセスを起動した      |
+ * | cgi__exit             | pid, waitpid の status                   | CGI のプロセスが終了した      |
+ */
+
+#if defined(HTTP_SERVER_HAVE_USDT)
+
+#include <sys/sdt.h>
+
+#define HTTP_SERVER_PROBE1(name, arg1) \
+    DTRACE_PROBE1(simple_server, name, arg1)
+#define HTTP_SERVER_PROBE2(name, arg1, arg2) \
+    DTRACE_PROBE2(simple_server, name, arg1, arg2)
+#define HTTP_SERVER_PROBE3(name, arg1, arg2, arg3) \
+    DTRACE_PROBE3(simple_server, name, arg1, arg2, arg3)
+
+#else
+
+// 引数は評価しないが、sizeof で使ったことにする (プローブにしか渡さない変数が未使用の警告にならないように)
+#define HTTP_SERVER_PROBE1(name, arg1) \
+    do { (void)sizeof(arg1); } while (false)
+#define HTTP_SERVER_PROBE2(name, arg1, arg2) \
+    do { (void)sizeof(arg1); (void)sizeof(arg2); } while (false)
+#define HTTP_SERVER_PROBE3(name, arg1, arg2, arg3) \
+    do { (void)sizeof(arg1); (void)sizeof(arg2); (void)sizeof(arg3); } while (false)
+
+#endif
+
+#endif //HTTP_SERVER_TRACE_PROBES_H
@@ -0,0 +1,123 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <cstddef>
+#include <sys/stat.h>
+#include "unix_listener_t.h"
+#include "async_logger_t.h"
+
+namespace {
+    /**
+     * そのパスで待ち受けているプロセスがいるか (接続できるか)
+     */
+    bool is_listening(const sockaddr_un &addr, socklen_t length) {
+        const auto sd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0); // NOLINT(hicpp-signed-bitwise)
+        if (sd == -1) {
+            return false;
+        }
+        const auto connected = connect(sd, reinterpret_cast<const sockaddr*>(&addr), length) == 0;
+        close(sd);
+        return connected;
+    }
+}
+
+std::optional<unix_listener_t::config_t> unix_listener_t::get_config_from_environment() {
+    const auto path = std::getenv("SIMPLE_SERVER_UNIX_SOCKET");
+    if (!path || *path == '\0') {
+        return std::nullopt;
+    }
+    config_t config;
+    config.path = path;
+    if (const auto mode = std::getenv("SIMPLE_SERVER_UNIX_SOCKET_MODE")) {
+        config.mode = static_cast<mode_t>(std::strtoul(mode, nullptr, 8));
+    }
+    return config;
+}
+
+socklen_t unix_listener_t::make_address(std::string_view path, sockaddr_un &addr) {
+    addr = {};
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(addr.sun_path)) {
+        return 0;
+    }
+    std::memcpy(addr.sun_path, path.data(), path.size());
+    if (is_abstract(path)) {
+        // 抽象名前空間は先頭が '\0' で、名前の長さまでがアドレス ('\0' で終わらない)
+        addr.sun_path[0] = '\0';
+        return static_cast<socklen_t>(offsetof(sockaddr_un, sun_path) + path.size());
+    }
+    return static_cast<socklen_t>(sizeof(addr));
+}
+
+int unix_listener_t::open(const config_t &config, int backlog) {
+    sockaddr_un addr{};
+    const auto length = make_address(config.path, addr);
+    if (length == 0) {
+        async_logger_t::get_default().log(async_logger_t::level_t::error, "invalid unix socket path: " + config.path);
+        return -1;
+    }
+
+    if (!is_abstract(config.path)) {
+        // 別のサーバが待ち受けているファイルは消さない
+        if (is_listening(addr, length)) {
+            async_logger_t::get_default().log(async_logger_t::level_t::error, "unix socket in use: " + config.path);
+            return -1;
+        }
+        // 前に終了したときに残ったファイル
+        unlink(config.path.c_str());
+    }
+
+    const auto sd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0); // NOLINT(hicpp-signed-bitwise)
+    if (sd == -1) {
+        return -1;
+    }
+    if (bind(sd, reinterpret_cast<const sockaddr*>(&addr), length) == -1) {
+        async_logger_t::get_default().log(
+            async_logger_t::level_t::error,
+            "cannot bind " + config.path + ": " + std::strerror(errno)
+        );
+        close(sd);
+        return -1;
+    }
+    // bind したときは umask が掛かっているので、指定されたパーミッションにする
+    if (!is_abstract(config.path)) {
+        chmod(config.path.c_str(), config.mode);
+    }
+    if (listen(sd, backlog) == -1) {
+        close(sd);
+        return -1;
+    }
+    return sd;
+}
+
+bool unix_listener_t::is_bound_to(int sd, std::string_view path) {
+    sockaddr_un expected{};
+    const auto expected_length = make_address(path, expected);
+    sockaddr_un actual{};
+    socklen_t actual_length = sizeof(actual);
+    if (expected_length == 0 || getsockname(sd, reinterpret_cast<sockaddr*>(&actual), &actual_length) == -1) {
+        return false;
+    }
+    if (actual.sun_family != AF_UNIX) {
+        return false;
+    }
+    // パスの場合は、getsockname が返す長さに '\0' が含まれるかどうかが一定しないので文字列で比べる
+    if (!is_abstract(path)) {
+        return std::strncmp(actual.sun_path, expected.sun_path, sizeof(actual.sun_path)) == 0;
+    }
+    return actual_length == expected_length
+           && std::memcmp(actual.sun_path, expected.sun_path, expected_length - offsetof(sockaddr_un, sun_path)) == 0;
+}
+
+void unix_listener_t::remove(const config_t &config) {
+    if (is_abstract(config.path)) {
+        return;
+    }
+    sockaddr_un addr{};
+    const auto length = make_address(config.path, addr);
+    if (length != 0 && !is_listening(addr, length)) {
+        unlink(config.path.c_str());
+    }
+}
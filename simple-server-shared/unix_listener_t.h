@@ -0,0 +1,83 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_UNIX_LISTENER_T_H
+#define HTTP_SERVER_UNIX_LISTENER_T_H
+
+#include <sys/un.h>
+
+/**
+ * Unix ドメインソケットで待ち受ける (同じホストのサイドカーのプロキシから受ける用)
+ *
+ * ループバックの TCP と違って TCP/IP のスタックを通らないので、1リクエスト毎の処理が軽い。
+ *
+ * * パスが `@` で始まる場合は抽象名前空間 (ファイルを作らない。プロセスが終わると消える)
+ * * それ以外はファイルシステムのパスで、`mode` のパーミッションを付ける
+ *   (既に別のサーバが待ち受けている場合は開かない。残っているだけのファイルは消して開き直す)
+ *
+ * 環境変数 `SIMPLE_SERVER_UNIX_SOCKET` にパスを、`SIMPLE_SERVER_UNIX_SOCKET_MODE` にパーミッション (8進数) を設定できる。
+ */
+class unix_listener_t {
+public:
+    /**
+     * 待ち受けの設定
+     */
+    struct config_t {
+        /**
+         * パス (`@` で始まる場合は抽象名前空間の名前)
+         */
+        std::string path;
+
+        /**
+         * ファイルのパーミッション (抽象名前空間の場合は使わない)
+         */
+        mode_t mode = 0660;
+    };
+
+    /**
+     * 環境変数から設定を取得する
+     * @return 設定 (`SIMPLE_SERVER_UNIX_SOCKET` が設定されていない場合は空)
+     */
+    static std::optional<config_t> get_config_from_environment();
+
+    /**
+     * 抽象名前空間の名前か
+     */
+    [[nodiscard]] static inline bool is_abstract(std::string_view path) {
+        return !path.empty() && path.front() == '@';
+    }
+
+    /**
+     * パスからアドレスを組み立てる
+     * @param [in] path パス
+     * @param [out] addr アドレス
+     * @return アドレスのバイト数 (パスが長すぎる場合は 0)
+     */
+    static socklen_t make_address(std::string_view path, sockaddr_un &addr);
+
+    /**
+     * 待ち受けのソケットを開く
+     * @param [in] config 設定
+     * @param [in] backlog 接続待ちキューの最大数
+     * @return ソケットディスクリプタ (開けなかった場合は -1)
+     */
+    static int open(const config_t &config, int backlog);
+
+    /**
+     * ソケットがこのパスで待ち受けているか (引き継いだソケットから探す用)
+     */
+    [[nodiscard]] static bool is_bound_to(int sd, std::string_view path);
+
+    /**
+     * 閉じた後にソケットのファイルを消す
+     *
+     * 入れ替えで次のプロセスが同じソケットを引き継いで待ち受けている場合は消さない。
+     *
+     * @param [in] config 設定
+     */
+    static void remove(const config_t &config);
+};
+
+
+#endif //HTTP_SERVER_UNIX_LISTENER_T_H
@@ -0,0 +1,31 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <sys/mman.h>
+#include "worker_stats_t.h"
+
+// プロセス間で共有するので、ロックを使わずに読み書きできること
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+static_assert(std::atomic<int64_t>::is_always_lock_free);
+
+worker_stats_t::worker_stats_t(size_t worker_count)
+    : worker_count(std::max<size_t>(worker_count, 1)),
+      slots(nullptr) {
+    const auto size = sizeof(slot_t) * this->worker_count;
+    auto address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0); // NOLINT(hicpp-signed-bitwise)
+    if (address == MAP_FAILED) {
+        throw std::system_error(errno, std::generic_category(), "mmap");
+    }
+
+    // 匿名の領域は 0 で埋まっているが、atomic はコンストラクタで作っておく
+    this->slots = static_cast<slot_t*>(address);
+    for (size_t i = 0; i < this->worker_count; i++) {
+        new(&this->slots[i]) slot_t{};
+    }
+}
+
+worker_stats_t::~worker_stats_t() {
+    munmap(this->slots, sizeof(slot_t) * this->worker_count);
+}
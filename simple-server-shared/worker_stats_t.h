@@ -0,0 +1,111 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_WORKER_STATS_T_H
+#define HTTP_SERVER_WORKER_STATS_T_H
+
+/**
+ * prefork のワーカー毎の状態とカウンタを置く共有メモリ
+ *
+ * マスターが fork する前に `mmap(MAP_SHARED | MAP_ANONYMOUS)` で作るので、
+ * マスターと全てのワーカーから同じ領域が見える。
+ *
+ * * ワーカーの状態 (`pid` `restarts` など) はマスターが書く
+ * * カウンタは各ワーカーが自分のスロットにだけ書く (`server_metrics_t::publish`)。
+ *   スロットはキャッシュライン境界に揃えるので、ワーカー同士で取り合わない
+ *
+ * どのワーカーの `/metrics` からでも、全ワーカーの値を読める。
+ * ワーカーが入れ替わってもスロットのカウンタは引き継ぐ (新しいワーカーは前の値に足していく)。
+ */
+class worker_stats_t {
+public:
+    /**
+     * ワーカー毎のカウンタ (`server_metrics_t` のカウンタと同じもの)
+     */
+    enum class counter_t : size_t {
+        connections,
+        requests_1xx,
+        requests_2xx,
+        requests_3xx,
+        requests_4xx,
+        requests_5xx,
+        received_bytes,
+        sent_bytes,
+        errors,
+        rejections_overload,
+        rejections_rate_limit,
+        shed,
+    };
+
+    static const size_t COUNTER_COUNT = 12;
+
+    /**
+     * ワーカー1つ分
+     */
+    struct alignas(64) slot_t {
+        /**
+         * 動いているワーカーのプロセスID (動いていない場合は 0)
+         */
+        std::atomic<pid_t> pid;
+
+        /**
+         * 起動し直した回数
+         */
+        std::atomic<uint32_t> restarts;
+
+        /**
+         * 最後に終了したときの `waitpid` のステータス
+         */
+        std::atomic<int32_t> last_exit_status;
+
+        /**
+         * 起動した時刻 (UNIX 時間の秒)
+         */
+        std::atomic<int64_t> started_at;
+
+        std::atomic<int64_t> connections_active;
+
+        std::atomic<int64_t> in_flight;
+
+        std::array<std::atomic<uint64_t>, COUNTER_COUNT> counters;
+    };
+
+    /**
+     * @param [in] worker_count ワーカー数
+     */
+    explicit worker_stats_t(size_t worker_count);
+
+    ~worker_stats_t();
+
+    worker_stats_t(const worker_stats_t &) = delete;
+
+    worker_stats_t &operator=(const worker_stats_t &) = delete;
+
+    [[nodiscard]] inline size_t get_worker_count() const {
+        return this->worker_count;
+    }
+
+    [[nodiscard]] inline slot_t &get_slot(size_t index) {
+        return this->slots[index];
+    }
+
+    [[nodiscard]] inline const slot_t &get_slot(size_t index) const {
+        return this->slots[index];
+    }
+
+    /**
+     * カウンタの値を取得する
+     */
+    [[nodiscard]] inline uint64_t get(size_t index, counter_t counter) const {
+        return this->slots[index].counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+    }
+
+private:
+    size_t worker_count;
+
+    slot_t* slots;
+};
+
+
+#endif //HTTP_SERVER_WORKER_STATS_T_H
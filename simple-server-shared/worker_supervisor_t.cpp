@@ -0,0 +1,201 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#include "common.h"
+#include <poll.h>
+#include <sys/wait.h>
+#include "worker_supervisor_t.h"
+#include "async_logger_t.h"
+
+namespace {
+    /**
+     * マスターが `should_stop` や起動し直す時刻を見る間隔
+     */
+    const int POLL_INTERVAL_MS = 100;
+
+    /**
+     * `waitpid` のステータスを文字列にする
+     */
+    std::string describe_status(int status) {
+        if (WIFSIGNALED(status)) {
+            return "killed by signal " + std::to_string(WTERMSIG(status));
+        }
+        if (WIFEXITED(status)) {
+            return "exited with " + std::to_string(WEXITSTATUS(status));
+        }
+        return "stopped";
+    }
+}
+
+worker_supervisor_t::worker_supervisor_t(const config_t &config, worker_stats_t &stats)
+    : config(config),
+      stats(stats),
+      workers(std::min(std::max<size_t>(config.worker_count, 1), stats.get_worker_count())),
+      stopping(false) {
+}
+
+void worker_supervisor_t::run(const std::function<int(size_t)> &worker_main, const std::function<bool()> &should_stop) {
+    for (size_t i = 0; i < this->workers.size(); i++) {
+        this->spawn(i, worker_main);
+    }
+
+    while (!should_stop()) {
+        this->reap(false);
+        // 止めるシグナルでワーカーも終了した場合は、起動し直さない
+        if (should_stop()) {
+            break;
+        }
+
+        const auto now = clock_t::now();
+        for (size_t i = 0; i < this->workers.size(); i++) {
+            auto &worker = this->workers[i];
+            if (worker.pid == 0 && worker.restart_at <= now) {
+                this->spawn(i, worker_main);
+            }
+        }
+
+        // シグナルで起こされた場合も、次の周で should_stop を見る
+        poll(nullptr, 0, POLL_INTERVAL_MS);
+    }
+
+    this->stop_all();
+}
+
+bool worker_supervisor_t::spawn(size_t index, const std::function<int(size_t)> &worker_main) {
+    auto &worker = this->workers[index];
+    auto &slot = this->stats.get_slot(index);
+
+    if (this->config.before_fork) {
+        this->config.before_fork();
+    }
+    const auto pid = fork();
+    const auto fork_errno = errno;
+    if (this->config.after_fork) {
+        this->config.after_fork();
+    }
+
+    if (pid == -1) {
+        // プロセスを作れない場合は、少し待ってからやり直す
+        async_logger_t::get_default().log(
+            async_logger_t::level_t::error,
+            "fork worker " + std::to_string(index) + ": " + std::strerror(fork_errno)
+        );
+        worker.restart_at = clock_t::now() + this->config.min_backoff;
+        return false;
+    }
+
+    if (pid == 0) {
+        // ワーカー (exit で終わるので、static なオブジェクトの後始末もされる)
+        std::exit(worker_main(index));
+    }
+
+    worker.pid = pid;
+    worker.started = clock_t::now();
+    slot.pid.store(pid, std::memory_order_relaxed);
+    slot.started_at.store(
+        std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count(),
+        std::memory_order_relaxed
+    );
+    return true;
+}
+
+size_t worker_supervisor_t::reap(bool block) {
+    size_t reaped = 0;
+    while (true) {
+        int status = 0;
+        const auto pid = waitpid(-1, &status, block && reaped == 0 ? 0 : WNOHANG);
+        if (pid == 0 || (pid == -1 && errno != EINTR)) {
+            return reaped;
+        }
+        if (pid == -1) {
+            // シグナルで中断された
+            if (block) {
+                return reaped;
+            }
+            continue;
+        }
+
+        const auto index = this->find_worker(pid);
+        if (!index) {
+            continue;
+        }
+        reaped++;
+
+        auto &worker = this->workers[*index];
+        auto &slot = this->stats.get_slot(*index);
+        const auto now = clock_t::now();
+        worker.pid = 0;
+        slot.pid.store(0, std::memory_order_relaxed);
+        slot.last_exit_status.store(status, std::memory_order_relaxed);
+        // 死んだワーカーの接続は、もうない
+        slot.connections_active.store(0, std::memory_order_relaxed);
+        slot.in_flight.store(0, std::memory_order_relaxed);
+
+        if (this->stopping) {
+            async_logger_t::get_default().log(
+                async_logger_t::level_t::info,
+                "worker " + std::to_string(*index) + " (pid " + std::to_string(pid) + ") " + describe_status(status)
+            );
+            continue;
+        }
+
+        // 動いていた時間が短い場合だけ、待ち時間を延ばす
+        if (now - worker.started >= this->config.stable_after) {
+            worker.failures = 0;
+        } else {
+            worker.failures++;
+        }
+        const auto backoff = worker.failures == 0
+                             ? std::chrono::milliseconds(0)
+                             : std::min<std::chrono::milliseconds>(this->config.min_backoff * (1LL << std::min<uint32_t>(worker.failures - 1, 16)),
+                                        this->config.max_backoff);
+        worker.restart_at = now + backoff;
+        slot.restarts.fetch_add(1, std::memory_order_relaxed);
+
+        async_logger_t::get_default().log(
+            WIFEXITED(status) && WEXITSTATUS(status) == 0 ? async_logger_t::level_t::info : async_logger_t::level_t::error,
+            "worker " + std::to_string(*index) + " (pid " + std::to_string(pid) + ") " + describe_status(status)
+            + ", restarting in " + std::to_string(backoff.count()) + "ms"
+        );
+    }
+}
+
+void worker_supervisor_t::stop_all() {
+    this->stopping = true;
+    for (const auto &worker : this->workers) {
+        if (worker.pid != 0) {
+            kill(worker.pid, SIGTERM);
+        }
+    }
+
+    const auto deadline = clock_t::now() + this->config.shutdown_timeout;
+    const auto is_running = [this] {
+        return std::any_of(this->workers.begin(), this->workers.end(), [](const worker_t &worker) {
+            return worker.pid != 0;
+        });
+    };
+    while (is_running() && clock_t::now() < deadline) {
+        if (this->reap(false) == 0) {
+            poll(nullptr, 0, POLL_INTERVAL_MS);
+        }
+    }
+
+    // 終わらないワーカーは強制的に止める
+    for (const auto &worker : this->workers) {
+        if (worker.pid != 0) {
+            kill(worker.pid, SIGKILL);
+        }
+    }
+    while (is_running() && this->reap(true) > 0) {
+    }
+}
+
+std::optional<size_t> worker_supervisor_t::find_worker(pid_t pid) const {
+    for (size_t i = 0; i < this->workers.size(); i++) {
+        if (this->workers[i].pid == pid) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
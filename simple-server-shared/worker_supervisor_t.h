@@ -0,0 +1,130 @@
+//
+// Created by munenaga on 2026/10/19.
+//
+
+#ifndef HTTP_SERVER_WORKER_SUPERVISOR_T_H
+#define HTTP_SERVER_WORKER_SUPERVISOR_T_H
+
+#include "worker_stats_t.h"
+
+/**
+ * prefork のマスター (ワーカーを fork して、死んだら起動し直す)
+ *
+ * * ワーカーは `worker_main` を子プロセスで呼んで、その戻り値で終了する
+ * * ワーカーが終了したら (クラッシュした場合も) 同じ番号で起動し直す。
+ *   続けて死ぬ場合は `min_backoff` から倍々に `max_backoff` まで待つ
+ *   (起動してから `stable_after` 以上動いていた場合は、待ち時間を戻す)
+ * * `should_stop` が `true` を返したら全てのワーカーに SIGTERM を送り、
+ *   `shutdown_timeout` 待っても終わらないワーカーは SIGKILL で止める
+ *
+ * ワーカーの状態は `worker_stats_t` に書くので、ワーカーのメトリクスから見える。
+ */
+class worker_supervisor_t {
+public:
+    /**
+     * マスターの設定
+     */
+    struct config_t {
+        size_t worker_count = 1;
+
+        std::chrono::milliseconds min_backoff = std::chrono::milliseconds(100);
+
+        std::chrono::milliseconds max_backoff = std::chrono::seconds(10);
+
+        /**
+         * これより長く動いていたワーカーが死んだ場合は、すぐに起動し直す
+         */
+        std::chrono::milliseconds stable_after = std::chrono::seconds(10);
+
+        std::chrono::milliseconds shutdown_timeout = std::chrono::seconds(10);
+
+        /**
+         * ワーカーを fork する直前に、マスターで呼ぶ (バックグラウンドのスレッドを止めるなど)
+         */
+        std::function<void()> before_fork;
+
+        /**
+         * fork の直後に、マスターとワーカーの両方で呼ぶ (`before_fork` で止めたものを開始し直す)
+         */
+        std::function<void()> after_fork;
+    };
+
+    /**
+     * @param [in] config 設定
+     * @param [in,out] stats ワーカーの状態を書く共有メモリ (ワーカー数は `config.worker_count` 以上であること)
+     */
+    worker_supervisor_t(const config_t &config, worker_stats_t &stats);
+
+    worker_supervisor_t(const worker_supervisor_t &) = delete;
+
+    worker_supervisor_t &operator=(const worker_supervisor_t &) = delete;
+
+    /**
+     * ワーカーを起動して、止めるまで見張る
+     * @param [in] worker_main ワーカーの処理 (引数はワーカーの番号、戻り値は終了コード)
+     * @param [in] should_stop 止めるか (マスターが定期的に呼ぶ)
+     */
+    void run(const std::function<int(size_t)> &worker_main, const std::function<bool()> &should_stop);
+
+private:
+    using clock_t = std::chrono::steady_clock;
+
+    /**
+     * マスターから見たワーカー1つ分
+     */
+    struct worker_t {
+        /**
+         * 動いている場合はプロセスID (動いていない場合は 0)
+         */
+        pid_t pid = 0;
+
+        clock_t::time_point started;
+
+        /**
+         * 続けて早死にした回数
+         */
+        uint32_t failures = 0;
+
+        /**
+         * 次に起動する時刻 (動いていない場合)
+         */
+        clock_t::time_point restart_at;
+    };
+
+    config_t config;
+
+    worker_stats_t &stats;
+
+    std::vector<worker_t> workers;
+
+    /**
+     * 止めている最中か (止めたワーカーは起動し直さない)
+     */
+    bool stopping;
+
+    /**
+     * ワーカーを起動する
+     * @return 起動できた場合 `true`
+     */
+    bool spawn(size_t index, const std::function<int(size_t)> &worker_main);
+
+    /**
+     * 終了したワーカーを回収して、起動し直す時刻を決める
+     * @param [in] block 1つ終了するまで待つか
+     * @return 回収した数
+     */
+    size_t reap(bool block);
+
+    /**
+     * 全てのワーカーを止める
+     */
+    void stop_all();
+
+    /**
+     * ワーカーの番号を探す
+     */
+    [[nodiscard]] std::optional<size_t> find_worker(pid_t pid) const;
+};
+
+
+#endif //HTTP_SERVER_WORKER_SUPERVISOR_T_H